@@ -43,6 +43,8 @@ core.features = {
 	hotbar_hud_element = true,
 	bulk_lbms = true,
 	abm_without_neighbors = true,
+	vmanip_packed_data = true,
+	find_nodes_packed = true,
 }
 
 function core.has_feature(arg)
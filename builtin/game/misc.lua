@@ -323,7 +323,7 @@ function core.run_lbm(id, pos_list, dtime_s)
 	-- emulate non-bulk LBMs
 	local expect = core.get_node(pos_list[1]).name
 	-- engine guarantees that
-	-- 1) all nodes are the same content type
+	-- 1) all nodes are the same content type (unlike for bulk_action)
 	-- 2) the list is up-to-date when we're called
 	assert(expect ~= "ignore")
 	for _, pos in ipairs(pos_list) do
@@ -330,3 +330,35 @@ local function test_ipc_poll(cb)
 	print("delta: " .. (core.get_us_time() - t0) .. "us")
 end
 unittests.register("test_ipc_poll", test_ipc_poll)
+
+local function test_vmanip_packed_data(_, pos)
+	local vm = core.get_voxel_manip(pos, pos)
+	local emin, emax = vm:read_from_map(pos, pos)
+	local volume = VoxelArea(emin, emax):getVolume()
+
+	local data = vm:get_data()
+	local packed = vm:get_packed_data()
+	assert(#packed == volume * 2)
+	for i = 1, volume, 97 do
+		local lo, hi = packed:byte(2 * i - 1, 2 * i)
+		assert(lo + hi * 256 == data[i])
+	end
+	assert(#vm:get_packed_data("param2") == volume)
+	assert(not pcall(vm.get_packed_data, vm, "foo"))
+	assert(not pcall(vm.set_packed_data, vm, "x"))
+
+	local c_stone = core.get_content_id("basenodes:stone")
+	vm:fill_content(core.CONTENT_AIR)
+	assert(vm:count_content(core.CONTENT_AIR) == volume)
+	vm:fill_content(c_stone, pos, pos)
+	assert(vm:count_content(c_stone) == 1)
+	assert(vm:replace_content(core.CONTENT_AIR, c_stone) == volume - 1)
+	assert(vm:count_content(c_stone, emin, emax) == volume)
+
+	vm:set_packed_data(packed)
+	local again = vm:get_data()
+	for i = 1, volume do
+		assert(again[i] == data[i])
+	end
+end
+unittests.register("test_vmanip_packed_data", test_vmanip_packed_data, {map=true})
@@ -0,0 +1,108 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "noise.h"
+#include "serverenvironment.h"
+
+namespace {
+
+constexpr s16 ACTIVE_BLOCK_RANGE = 4;
+constexpr s16 CONE_RANGE = 8;
+
+// Players walking about an area where some of them meet
+struct Crowd
+{
+	std::vector<ActiveBlockList::Viewer> viewers;
+	std::vector<v3s16> directions;
+
+	Crowd(u16 count, bool cones)
+	{
+		PseudoRandom pr(count);
+		const s16 area = 4 + count / 2;
+		for (u16 id = 1; id <= count; id++) {
+			ActiveBlockList::Viewer viewer;
+			viewer.id = id;
+			viewer.pos = v3s16(pr.range(-area, area), pr.range(-2, 2), pr.range(-area, area));
+			viewer.radius = ACTIVE_BLOCK_RANGE;
+			if (cones) {
+				viewer.cone_range = CONE_RANGE;
+				viewer.camera_pos = intToFloat(viewer.pos * MAP_BLOCKSIZE, BS);
+				viewer.camera_dir = v3f(0, 0, 1);
+				viewer.fov = 1.5f;
+			}
+			viewers.emplace_back(viewer);
+			directions.emplace_back(pr.range(-1, 1), 0, pr.range(0, 1) * 2 - 1);
+		}
+	}
+
+	// Everyone goes into the next block
+	void step()
+	{
+		for (size_t i = 0; i < viewers.size(); i++) {
+			auto &viewer = viewers[i];
+			viewer.pos += directions[i];
+			viewer.camera_pos = intToFloat(viewer.pos * MAP_BLOCKSIZE, BS);
+			viewer.camera_dir = v3f(directions[i].X, 0, directions[i].Z).normalize();
+			if (std::abs(viewer.pos.X) > 100 || std::abs(viewer.pos.Z) > 100)
+				directions[i] = -directions[i];
+		}
+	}
+};
+
+size_t update(ActiveBlockList &list, const Crowd &crowd)
+{
+	std::set<v3s16> removed, added, extra_added;
+	list.update(crowd.viewers, removed, added, extra_added);
+	return removed.size() + added.size() + extra_added.size();
+}
+
+}
+
+#define BENCH_ACTIVE_BLOCKS(_count, _cones, _suffix) \
+	BENCHMARK_ADVANCED("moving_" #_count _suffix)(Catch::Benchmark::Chronometer meter) { \
+		Crowd crowd(_count, _cones); \
+		ActiveBlockList list; \
+		update(list, crowd); \
+		meter.measure([&] { \
+			crowd.step(); \
+			return update(list, crowd); \
+		}); \
+	}; \
+	BENCHMARK_ADVANCED("standing_" #_count _suffix)(Catch::Benchmark::Chronometer meter) { \
+		Crowd crowd(_count, _cones); \
+		ActiveBlockList list; \
+		update(list, crowd); \
+		meter.measure([&] { return update(list, crowd); }); \
+	}; \
+	BENCHMARK_ADVANCED("rebuild_" #_count _suffix)(Catch::Benchmark::Chronometer meter) { \
+		Crowd crowd(_count, _cones); \
+		ActiveBlockList list; \
+		meter.measure([&] { \
+			list.clear(); \
+			return update(list, crowd); \
+		}); \
+	};
+
+TEST_CASE("ActiveBlockList")
+{
+	// Moving players only count the blocks they enter and leave
+	{
+		Crowd crowd(20, false);
+		ActiveBlockList list;
+		update(list, crowd);
+		for (int i = 0; i < 10; i++) {
+			crowd.step();
+			update(list, crowd);
+		}
+		ActiveBlockList rebuilt;
+		update(rebuilt, crowd);
+		REQUIRE(list.size() == rebuilt.size());
+		REQUIRE(list.m_abm_list == rebuilt.m_abm_list);
+	}
+
+	BENCH_ACTIVE_BLOCKS(10, false, "")
+	BENCH_ACTIVE_BLOCKS(100, false, "")
+	BENCH_ACTIVE_BLOCKS(100, true, "_cones")
+}
@@ -0,0 +1,183 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "fm_block_dictionary.h"
+#include "mapblock.h"
+#include "noise.h"
+#include "serialization.h"
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+// Blocks of a world, every other one is used for training
+constexpr s16 WORLD_BLOCKS_XZ = 16;
+constexpr s16 WORLD_BLOCKS_Y = 2;
+constexpr size_t DICTIONARY_SIZE = 110 * 1024;
+
+struct Contents
+{
+	content_t stone, dirt, grass, sand, water, ore, leaves;
+};
+
+Contents registerNodes(NodeDefManager *ndef)
+{
+	auto add = [&](const char *name) {
+		ContentFeatures f;
+		f.name = name;
+		return ndef->set(f.name, f);
+	};
+	Contents c;
+	c.stone = add("default:stone");
+	c.dirt = add("default:dirt");
+	c.grass = add("default:dirt_with_grass");
+	c.sand = add("default:sand");
+	c.water = add("default:water_source");
+	c.ore = add("default:stone_with_coal");
+	c.leaves = add("default:leaves");
+	return c;
+}
+
+// Hills with water, sand at the shore and some ore and bushes
+void generate(MapBlock &block, const Contents &c, PseudoRandom &pr)
+{
+	const v3pos_t base = block.getPosRelative();
+	MapNode *data = block.getData();
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		const s16 wx = base.X + x, wz = base.Z + z;
+		const s16 height = 4 + 6 * std::sin(wx / 13.0f) + 4 * std::cos(wz / 9.0f);
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+			const s16 wy = base.Y + y;
+			MapNode n(CONTENT_AIR, 15, 0);
+			if (wy < height - 3)
+				n = MapNode(pr.range(0, 50) ? c.stone : c.ore);
+			else if (wy < height)
+				n = MapNode(height <= 1 ? c.sand : c.dirt);
+			else if (wy == height)
+				n = MapNode(height <= 1 ? c.sand : c.grass);
+			else if (wy <= 1)
+				n = MapNode(c.water, 15, 0);
+			else if (wy <= height + 2 && !pr.range(0, 30))
+				n = MapNode(c.leaves, 13, pr.range(0, 3));
+			data[z * MapBlock::zstride + y * MapBlock::ystride + x] = n;
+		}
+	}
+	block.setGenerated(true);
+}
+
+// The data compress() gets, as saved and as sent
+std::string raw(MapBlock &block, bool disk)
+{
+	std::ostringstream os(std::ios_base::binary);
+	block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, disk, -1);
+	std::istringstream is(os.str(), std::ios_base::binary);
+	std::ostringstream os_raw(std::ios_base::binary);
+	decompressZstd(is, os_raw);
+	return os_raw.str();
+}
+
+std::vector<std::string> compressAll(
+		const std::vector<std::string> &blocks, const BlockDictionary *dict)
+{
+	std::vector<std::string> compressed;
+	compressed.reserve(blocks.size());
+	for (const auto &data : blocks) {
+		std::ostringstream os(std::ios_base::binary);
+		compress(data, os, SER_FMT_VER_HIGHEST_WRITE, -1, dict);
+		compressed.emplace_back(os.str());
+	}
+	return compressed;
+}
+
+size_t decompressAll(const std::vector<std::string> &compressed)
+{
+	size_t size = 0;
+	for (const auto &data : compressed) {
+		std::istringstream is(data, std::ios_base::binary);
+		std::ostringstream os(std::ios_base::binary);
+		decompress(is, os, SER_FMT_VER_HIGHEST_WRITE);
+		size += os.tellp();
+	}
+	return size;
+}
+
+template <typename F>
+double seconds(F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+TEST_CASE("benchmark_block_dictionary")
+{
+	DummyGameDef gamedef;
+	const Contents contents = registerNodes(gamedef.getWritableNodeDefManager());
+
+	PseudoRandom pr(13);
+	std::vector<std::string> samples, disk, net;
+	for (s16 bz = 0; bz < WORLD_BLOCKS_XZ; bz++)
+	for (s16 by = -1; by < WORLD_BLOCKS_Y - 1; by++)
+	for (s16 bx = 0; bx < WORLD_BLOCKS_XZ; bx++) {
+		MapBlock block({bx, by, bz}, &gamedef);
+		generate(block, contents, pr);
+		const bool train = (bx + by + bz) % 2;
+		(train ? samples : disk).emplace_back(raw(block, true));
+		(train ? samples : net).emplace_back(raw(block, false));
+	}
+
+	const std::shared_ptr<const BlockDictionary> dict = BlockDictionary::create(
+			BlockDictionary::train(samples, DICTIONARY_SIZE));
+	REQUIRE(dict);
+	const BlockDictionary *const variants[] = {nullptr, dict.get()};
+
+	for (const auto &[name, blocks] : {std::make_pair("disk", &disk),
+				 std::make_pair("net", &net)}) {
+		size_t raw_size = 0;
+		for (const auto &data : *blocks)
+			raw_size += data.size();
+
+		for (const BlockDictionary *with : variants) {
+			std::vector<std::string> compressed;
+			const double compress_time =
+					seconds([&] { compressed = compressAll(*blocks, with); });
+			size_t compressed_size = 0;
+			for (const auto &data : compressed)
+				compressed_size += data.size();
+			size_t decompressed = 0;
+			const double decompress_time =
+					seconds([&] { decompressed = decompressAll(compressed); });
+			REQUIRE(decompressed == raw_size);
+
+			WARN(name << (with ? " dictionary" : " plain") << ": ratio "
+					<< (double)raw_size / compressed_size << ", "
+					<< compressed_size / blocks->size() << " bytes per block, compress "
+					<< raw_size / compress_time / 1e6 << " MB/s, decompress "
+					<< raw_size / decompress_time / 1e6 << " MB/s");
+		}
+	}
+
+	// one iteration compresses or decompresses the blocks of a 16x2x16 area
+	// as they are saved, half of them
+	BENCHMARK("block_compress_plain") {
+		return compressAll(disk, nullptr);
+	};
+	BENCHMARK("block_compress_dictionary") {
+		return compressAll(disk, dict.get());
+	};
+	const auto disk_plain = compressAll(disk, nullptr);
+	const auto disk_dict = compressAll(disk, dict.get());
+	BENCHMARK("block_decompress_plain") {
+		return decompressAll(disk_plain);
+	};
+	BENCHMARK("block_decompress_dictionary") {
+		return decompressAll(disk_dict);
+	};
+}
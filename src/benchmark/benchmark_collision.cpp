@@ -0,0 +1,184 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include <cmath>
+#include "collision.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "environment.h"
+#include "nodedef.h"
+#include "noise.h"
+
+namespace {
+
+constexpr size_t ENTITY_COUNT = 5000;
+constexpr f32 DTIME = 0.05f;
+
+class MapEnvironment : public Environment
+{
+public:
+	MapEnvironment(IGameDef *gamedef, Map &map) : Environment(gamedef), m_map(map) {}
+
+	void step(f32 dtime, double uptime, unsigned int max_cycle_ms) override {}
+	Map &getMap() override { return m_map; }
+	void getSelectedActiveObjects(const core::line3d<f32> &shootline_on_map,
+			std::vector<PointedThing> &objects,
+			const std::optional<Pointabilities> &pointabilities) override {}
+
+private:
+	Map &m_map;
+};
+
+struct Contents
+{
+	content_t stone, slab, bouncy;
+};
+
+Contents registerNodes(NodeDefManager *ndef)
+{
+	Contents c;
+	{
+		ContentFeatures f;
+		f.name = "default:stone";
+		c.stone = ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "stairs:slab_stone";
+		f.drawtype = NDT_NODEBOX;
+		f.node_box.type = NODEBOX_FIXED;
+		f.node_box.fixed = {aabb3f(-BS / 2, -BS / 2, -BS / 2, BS / 2, 0, BS / 2)};
+		f.param_type_2 = CPT2_FACEDIR;
+		c.slab = ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "default:trampoline";
+		f.groups["bouncy"] = 70;
+		c.bouncy = ndef->set(f.name, f);
+	}
+	return c;
+}
+
+// Steep hills with slabs and trampolines on them
+void generate(Map &map, v3s16 bpmin, v3s16 bpmax, const Contents &c)
+{
+	PseudoRandom pr(11);
+	std::map<v3s16, MapBlock*> modified_blocks;
+	MMVManip vm(&map);
+	vm.initialEmerge(bpmin, bpmax, false);
+	const VoxelArea &area = vm.m_area;
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+		const s16 height = 6 * std::sin(x / 7.0f) + 5 * std::cos(z / 5.0f) +
+				pr.range(0, 1);
+		const int top = pr.range(0, 9);
+		for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+			MapNode n(CONTENT_AIR);
+			if (y < height)
+				n = MapNode(c.stone);
+			else if (y == height && top < 3)
+				n = MapNode(c.slab, 0, pr.range(0, 23));
+			else if (y == height && top == 3)
+				n = MapNode(c.bouncy);
+			vm.m_data[area.index(x, y, z)] = n;
+		}
+	}
+	vm.blitBackAll(&modified_blocks);
+}
+
+struct Entity
+{
+	v3f pos, speed;
+	bool touching_ground = false;
+};
+
+std::vector<Entity> spawn(v3s16 pmin, v3s16 pmax)
+{
+	PseudoRandom pr(5);
+	std::vector<Entity> entities(ENTITY_COUNT);
+	for (auto &e : entities) {
+		e.pos = v3f(pr.range(pmin.X + 4, pmax.X - 4), 14,
+				pr.range(pmin.Z + 4, pmax.Z - 4)) * BS;
+		e.speed = v3f(pr.range(-30, 30), 0, pr.range(-30, 30)) / 10.0f * BS;
+	}
+	return entities;
+}
+
+void step(Environment &env, IGameDef &gamedef, std::vector<Entity> &entities,
+		v3s16 pmin, v3s16 pmax)
+{
+	const aabb3f box(-0.3f * BS, -0.5f * BS, -0.3f * BS, 0.3f * BS, 1.2f * BS, 0.3f * BS);
+	const v3f accel(0, -9.81f * BS, 0);
+	for (auto &e : entities) {
+		collisionMoveResult r = collisionMoveSimple(&env, &gamedef, BS * 0.5f, box,
+				0.6f * BS, DTIME, &e.pos, &e.speed, accel, nullptr, false);
+		e.touching_ground = r.touching_ground;
+
+		// Walk around within the map, jump when blocked
+		if (e.pos.X < (pmin.X + 4) * BS || e.pos.X > (pmax.X - 4) * BS)
+			e.speed.X = -e.speed.X;
+		if (e.pos.Z < (pmin.Z + 4) * BS || e.pos.Z > (pmax.Z - 4) * BS)
+			e.speed.Z = -e.speed.Z;
+		if (r.collides && e.touching_ground)
+			e.speed.Y = 6.5f * BS;
+	}
+}
+
+}
+
+TEST_CASE("benchmark_collision")
+{
+	DummyGameDef gamedef;
+	const Contents c = registerNodes(gamedef.getWritableNodeDefManager());
+
+	// 128x64x128 nodes
+	const v3s16 bpmin(-4, -2, -4), bpmax(3, 1, 3);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	generate(map, bpmin, bpmax, c);
+	MapEnvironment env(&gamedef, map);
+	const v3s16 pmin = bpmin * MAP_BLOCKSIZE;
+	const v3s16 pmax = (bpmax + 1) * MAP_BLOCKSIZE - 1;
+
+	SECTION("correctness") {
+		auto by_node = spawn(pmin, pmax);
+		auto cached = by_node;
+		for (int i = 0; i < 40; i++) {
+			map.collision_box_cache.setEnabled(false);
+			step(env, gamedef, by_node, pmin, pmax);
+			map.collision_box_cache.setEnabled(true);
+			step(env, gamedef, cached, pmin, pmax);
+		}
+		size_t on_ground = 0;
+		for (size_t i = 0; i < ENTITY_COUNT; i++) {
+			REQUIRE(cached[i].pos == by_node[i].pos);
+			REQUIRE(cached[i].speed == by_node[i].speed);
+			REQUIRE(cached[i].touching_ground == by_node[i].touching_ground);
+			on_ground += cached[i].touching_ground;
+		}
+		REQUIRE(on_ground > 0);
+	}
+
+	auto entities = spawn(pmin, pmax);
+	map.collision_box_cache.setEnabled(false);
+	BENCHMARK("move_5k_entities_node_by_node") {
+		step(env, gamedef, entities, pmin, pmax);
+	};
+
+	entities = spawn(pmin, pmax);
+	map.collision_box_cache.setEnabled(true);
+	BENCHMARK("move_5k_entities_cached") {
+		step(env, gamedef, entities, pmin, pmax);
+	};
+
+	BENCHMARK_ADVANCED("move_5k_entities_cached_after_change")(
+			Catch::Benchmark::Chronometer meter) {
+		meter.measure([&](int i) {
+			// Every change makes one block again
+			map.setNode(v3s16(0, 20, 0), MapNode(i % 2 ? c.stone : CONTENT_AIR));
+			step(env, gamedef, entities, pmin, pmax);
+		});
+	};
+}
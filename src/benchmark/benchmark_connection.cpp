@@ -0,0 +1,94 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "network/mtp/internal.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+
+constexpr int IN_FLIGHT = 10000;
+constexpr int LOSS_PERCENT = 5;
+
+std::vector<con::BufferedPacketPtr> makePackets(u16 first_seqnum)
+{
+	Address address(127, 0, 0, 1, 30000);
+	SharedBuffer<u8> data(400);
+	std::vector<con::BufferedPacketPtr> packets;
+	for (int i = 0; i < IN_FLIGHT; i++) {
+		packets.push_back(con::makePacket(address,
+				con::makeReliablePacket(data, first_seqnum + i), PROTOCOL_ID, 1, 0));
+	}
+	return packets;
+}
+
+// Sends all packets, acks them in random order, losing some, and resends
+// the lost ones until they are acked too
+u32 sendAndAck(std::vector<con::BufferedPacketPtr> &packets, std::mt19937 &rng)
+{
+	con::ReliablePacketBuffer buffer;
+	for (auto &p : packets) {
+		p->resend_count = 0;
+		buffer.insert(p, p->getSeqnum() + 1 - MAX_RELIABLE_WINDOW_SIZE);
+	}
+
+	std::vector<u16> acks;
+	for (auto &p : packets)
+		acks.push_back(p->getSeqnum());
+	std::shuffle(acks.begin(), acks.end(), rng);
+
+	u32 resent = 0;
+	while (!buffer.empty()) {
+		std::vector<u16> lost;
+		for (u16 seqnum : acks) {
+			if (rng() % 100 < LOSS_PERCENT)
+				lost.push_back(seqnum);
+			else
+				buffer.popSeqnum(seqnum);
+		}
+
+		buffer.incrementTimeouts(0.1f);
+		auto resend = buffer.getResend(0.1f, IN_FLIGHT);
+		resent += resend.size();
+		acks.clear();
+		for (auto &p : resend)
+			acks.push_back(p->getSeqnum());
+	}
+	return resent;
+}
+
+// Receives all packets in random order and takes them out in order
+u32 receiveOutOfOrder(std::vector<con::BufferedPacketPtr> &packets, std::mt19937 &rng)
+{
+	const u16 next_expected = packets.front()->getSeqnum() - 1;
+	std::vector<con::BufferedPacketPtr> order(packets);
+	std::shuffle(order.begin(), order.end(), rng);
+
+	con::ReliablePacketBuffer buffer;
+	for (auto &p : order)
+		buffer.insert(p, next_expected);
+
+	u32 sum = 0;
+	while (!buffer.empty())
+		sum += buffer.popFirst()->getSeqnum();
+	return sum;
+}
+
+}
+
+TEST_CASE("benchmark_connection")
+{
+	std::mt19937 rng(42);
+	// Across the wrap of the seqnums
+	auto packets = makePackets(65535 - IN_FLIGHT / 2);
+
+	// one iteration handles IN_FLIGHT packets
+	BENCHMARK("reliable_send_ack_10k") {
+		return sendAndAck(packets, rng);
+	};
+	BENCHMARK("reliable_receive_reorder_10k") {
+		return receiveOutOfOrder(packets, rng);
+	};
+}
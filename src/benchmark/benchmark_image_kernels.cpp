@@ -0,0 +1,318 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include <IImage.h>
+#include <IVideoDriver.h>
+#include <IrrlichtDevice.h>
+#include <cstring>
+#include "irrlicht.h"
+#include "irr_ptr.h"
+#include "noise.h"
+#include "client/fm_image_kernels.h"
+
+// Texture modifiers done by the image kernels against the per-pixel
+// SColor code of imagesource.cpp they replaced, on a null video driver
+
+namespace {
+
+using Image = irr_ptr<video::IImage>;
+
+// Tiles with some transparent and semi-transparent pixels
+Image makeImage(video::IVideoDriver *driver, u32 size, u32 seed)
+{
+	Image img(driver->createImage(video::ECF_A8R8G8B8, {size, size}));
+	PseudoRandom pr(seed);
+	for (u32 y = 0; y < size; y++)
+	for (u32 x = 0; x < size; x++) {
+		const int a = pr.range(0, 3);
+		img->setPixel(x, y, video::SColor(a == 0 ? 0 : a == 1 ? pr.range(1, 254) : 255,
+				pr.range(0, 255), pr.range(0, 255), pr.range(0, 255)));
+	}
+	return img;
+}
+
+Image copyImage(video::IVideoDriver *driver, video::IImage *img)
+{
+	Image copy(driver->createImage(video::ECF_A8R8G8B8, img->getDimension()));
+	img->copyTo(copy.get());
+	return copy;
+}
+
+u32 *pixels(video::IImage *img)
+{
+	return reinterpret_cast<u32 *>(img->getData());
+}
+
+bool sameImage(video::IImage *a, video::IImage *b)
+{
+	const auto dim = a->getDimension();
+	return dim == b->getDimension() &&
+			!memcmp(a->getData(), b->getData(), dim.getArea() * 4);
+}
+
+namespace old {
+
+template <bool overlay>
+void blit_pixel(video::SColor src_col, video::SColor &dst_col)
+{
+	u8 dst_a = (u8)dst_col.getAlpha();
+	if constexpr (overlay) {
+		if (dst_a != 255)
+			return;
+	}
+	u8 src_a = (u8)src_col.getAlpha();
+	if (src_a == 0)
+		return;
+	if (src_a == 255 || dst_a == 0) {
+		dst_col = src_col;
+		return;
+	}
+	struct Color { u8 r, g, b; };
+	Color src{(u8)src_col.getRed(), (u8)src_col.getGreen(), (u8)src_col.getBlue()};
+	Color dst{(u8)dst_col.getRed(), (u8)dst_col.getGreen(), (u8)dst_col.getBlue()};
+	dst.r = (dst.r * (255 - src_a) + src.r * src_a) / 255;
+	dst.g = (dst.g * (255 - src_a) + src.g * src_a) / 255;
+	dst.b = (dst.b * (255 - src_a) + src.b * src_a) / 255;
+	if (dst_a != 255)
+		dst_a = dst_a + (255 - dst_a) * src_a * src_a / (255 * 255);
+	dst_col.set(dst_a, dst.r, dst.g, dst.b);
+}
+
+template <bool overlay>
+void blit(video::IImage *src, video::IImage *dst)
+{
+	auto *s = reinterpret_cast<video::SColor *>(src->getData());
+	auto *d = reinterpret_cast<video::SColor *>(dst->getData());
+	for (u32 i = 0; i < dst->getDimension().getArea(); i++)
+		blit_pixel<overlay>(s[i], d[i]);
+}
+
+void colorize(video::IImage *dst, video::SColor color, int ratio)
+{
+	const auto dim = dst->getDimension();
+	float interp = ratio / 255.0f;
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		video::SColor dst_c = dst->getPixel(x, y);
+		if (dst_c.getAlpha() > 0)
+			dst->setPixel(x, y, color.getInterpolated(dst_c, interp));
+	}
+}
+
+void colorizeAlpha(video::IImage *dst, video::SColor color)
+{
+	const auto dim = dst->getDimension();
+	video::SColor dst_c = color;
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		u32 dst_alpha = dst->getPixel(x, y).getAlpha();
+		if (dst_alpha > 0) {
+			dst_c.setAlpha(dst_alpha * color.getAlpha() / 255);
+			dst->setPixel(x, y, dst_c);
+		}
+	}
+}
+
+void multiply(video::IImage *dst, video::SColor color)
+{
+	const auto dim = dst->getDimension();
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		video::SColor dst_c = dst->getPixel(x, y);
+		dst_c.set(dst_c.getAlpha(),
+				(dst_c.getRed() * color.getRed()) / 255,
+				(dst_c.getGreen() * color.getGreen()) / 255,
+				(dst_c.getBlue() * color.getBlue()) / 255);
+		dst->setPixel(x, y, dst_c);
+	}
+}
+
+void screen(video::IImage *dst, video::SColor color)
+{
+	const auto dim = dst->getDimension();
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		video::SColor dst_c = dst->getPixel(x, y);
+		dst_c.set(dst_c.getAlpha(),
+				255 - ((255 - dst_c.getRed()) * (255 - color.getRed())) / 255,
+				255 - ((255 - dst_c.getGreen()) * (255 - color.getGreen())) / 255,
+				255 - ((255 - dst_c.getBlue()) * (255 - color.getBlue())) / 255);
+		dst->setPixel(x, y, dst_c);
+	}
+}
+
+void overlay(video::IImage *blend, video::IImage *dst)
+{
+	const auto dim = dst->getDimension();
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		video::SColor blend_c = blend->getPixel(x, y);
+		video::SColor base_c = dst->getPixel(x, y);
+		double blend_r = blend_c.getRed() / 255.0;
+		double blend_g = blend_c.getGreen() / 255.0;
+		double blend_b = blend_c.getBlue() / 255.0;
+		double base_r = base_c.getRed() / 255.0;
+		double base_g = base_c.getGreen() / 255.0;
+		double base_b = base_c.getBlue() / 255.0;
+		base_c.set(base_c.getAlpha(),
+			(u32)((base_r < 0.5 ? 2 * base_r * blend_r : 1 - 2 * (1 - base_r) * (1 - blend_r)) * 255),
+			(u32)((base_g < 0.5 ? 2 * base_g * blend_g : 1 - 2 * (1 - base_g) * (1 - blend_g)) * 255),
+			(u32)((base_b < 0.5 ? 2 * base_b * blend_b : 1 - 2 * (1 - base_b) * (1 - blend_b)) * 255));
+		dst->setPixel(x, y, base_c);
+	}
+}
+
+void contrast(video::IImage *dst, double slope, double c)
+{
+	const auto dim = dst->getDimension();
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		video::SColor dst_c = dst->getPixel(x, y);
+		dst_c.set(dst_c.getAlpha(),
+			core::clamp((int)(slope * dst_c.getRed() + c), 0, 255),
+			core::clamp((int)(slope * dst_c.getGreen() + c), 0, 255),
+			core::clamp((int)(slope * dst_c.getBlue() + c), 0, 255));
+		dst->setPixel(x, y, dst_c);
+	}
+}
+
+void mask(video::IImage *mask, video::IImage *dst)
+{
+	const auto dim = dst->getDimension();
+	for (u32 y = 0; y < dim.Height; y++)
+	for (u32 x = 0; x < dim.Width; x++) {
+		video::SColor dst_c = dst->getPixel(x, y);
+		dst_c.color &= mask->getPixel(x, y).color;
+		dst->setPixel(x, y, dst_c);
+	}
+}
+
+}
+
+namespace kernels {
+
+template <bool overlay>
+void blit(video::IImage *src, video::IImage *dst)
+{
+	const auto count = dst->getDimension().getArea();
+	if (overlay)
+		image_kernels::blitOverlay(pixels(src), pixels(dst), count);
+	else
+		image_kernels::blit(pixels(src), pixels(dst), count);
+}
+
+void colorize(video::IImage *dst, video::SColor color, int ratio)
+{
+	image_kernels::ChannelTables tables;
+	for (u32 v = 0; v < 256; v++) {
+		video::SColor c = color.getInterpolated(video::SColor(v, v, v, v), ratio / 255.0f);
+		tables.a[v] = c.getAlpha();
+		tables.r[v] = c.getRed();
+		tables.g[v] = c.getGreen();
+		tables.b[v] = c.getBlue();
+	}
+	image_kernels::lookup(pixels(dst), dst->getDimension().getArea(), tables, true);
+}
+
+void contrast(video::IImage *dst, double slope, double c)
+{
+	image_kernels::ChannelTables tables;
+	for (u32 v = 0; v < 256; v++) {
+		tables.a[v] = v;
+		tables.r[v] = tables.g[v] = tables.b[v] = core::clamp((int)(slope * v + c), 0, 255);
+	}
+	image_kernels::lookup(pixels(dst), dst->getDimension().getArea(), tables, false);
+}
+
+}
+
+const video::SColor COLOR(200, 128, 64, 32);
+constexpr double SLOPE = 1.3, OFFSET = -20.5;
+
+// "base^ore^[colorize:C:96^[multiply:C^[overlay:base^[contrast^[mask:ore"
+template <bool use_kernels>
+void generate(video::IVideoDriver *driver, video::IImage *base, video::IImage *ore)
+{
+	Image img = copyImage(driver, base);
+	if (use_kernels) {
+		const auto count = img->getDimension().getArea();
+		kernels::blit<false>(ore, img.get());
+		kernels::colorize(img.get(), COLOR, 96);
+		image_kernels::multiply(pixels(img.get()), count, COLOR.color);
+		image_kernels::overlay(pixels(base), pixels(img.get()), pixels(img.get()), count);
+		kernels::contrast(img.get(), SLOPE, OFFSET);
+		image_kernels::mask(pixels(ore), pixels(img.get()), count);
+	} else {
+		old::blit<false>(ore, img.get());
+		old::colorize(img.get(), COLOR, 96);
+		old::multiply(img.get(), COLOR);
+		old::overlay(base, img.get());
+		old::contrast(img.get(), SLOPE, OFFSET);
+		old::mask(ore, img.get());
+	}
+}
+
+}
+
+TEST_CASE("benchmark_image_kernels")
+{
+	irr::SIrrlichtCreationParameters params;
+	params.DriverType = video::EDT_NULL;
+	irr_ptr<IrrlichtDevice> device(irr::createDeviceEx(params));
+	REQUIRE(device);
+	video::IVideoDriver *driver = device->getVideoDriver();
+
+	SECTION("same as per pixel") {
+		// Odd widths leave a tail after the vectorized part
+		for (const u32 size : {1u, 7u, 16u, 67u}) {
+			Image a = makeImage(driver, size, size), b = makeImage(driver, size, size + 1);
+			const auto count = size * size;
+			const auto check = [&](auto &&old_func, auto &&kernel_func) {
+				Image expected = copyImage(driver, a.get()), got = copyImage(driver, a.get());
+				old_func(expected.get());
+				kernel_func(got.get());
+				REQUIRE(sameImage(expected.get(), got.get()));
+			};
+			check([&](auto *img) { old::blit<false>(b.get(), img); },
+				[&](auto *img) { kernels::blit<false>(b.get(), img); });
+			check([&](auto *img) { old::blit<true>(b.get(), img); },
+				[&](auto *img) { kernels::blit<true>(b.get(), img); });
+			check([&](auto *img) { old::colorize(img, COLOR, 96); },
+				[&](auto *img) { kernels::colorize(img, COLOR, 96); });
+			check([&](auto *img) { old::colorizeAlpha(img, COLOR); },
+				[&](auto *img) { image_kernels::replaceColor(pixels(img), count, COLOR.color, true); });
+			check([&](auto *img) { old::multiply(img, COLOR); },
+				[&](auto *img) { image_kernels::multiply(pixels(img), count, COLOR.color); });
+			check([&](auto *img) { old::screen(img, COLOR); },
+				[&](auto *img) { image_kernels::screen(pixels(img), count, COLOR.color); });
+			check([&](auto *img) { old::overlay(b.get(), img); },
+				[&](auto *img) { image_kernels::overlay(pixels(b.get()), pixels(img), pixels(img), count); });
+			check([&](auto *img) { old::contrast(img, SLOPE, OFFSET); },
+				[&](auto *img) { kernels::contrast(img, SLOPE, OFFSET); });
+			check([&](auto *img) { old::mask(b.get(), img); },
+				[&](auto *img) { image_kernels::mask(pixels(b.get()), pixels(img), count); });
+		}
+	}
+
+	// Many small textures like those of nodes, and some large ones
+	for (const u32 size : {16u, 128u}) {
+		const u32 textures = size == 16 ? 1000 : 20;
+		std::vector<Image> bases, ores;
+		for (u32 i = 0; i < 8; i++) {
+			bases.emplace_back(makeImage(driver, size, i));
+			ores.emplace_back(makeImage(driver, size, i + 100));
+		}
+		const std::string suffix = std::to_string(textures) + "x" + std::to_string(size);
+
+		BENCHMARK("texture_modifiers_per_pixel_" + suffix) {
+			for (u32 i = 0; i < textures; i++)
+				generate<false>(driver, bases[i % 8].get(), ores[i / 8 % 8].get());
+		};
+		BENCHMARK("texture_modifiers_kernels_" + suffix) {
+			for (u32 i = 0; i < textures; i++)
+				generate<true>(driver, bases[i % 8].get(), ores[i / 8 % 8].get());
+		};
+	}
+}
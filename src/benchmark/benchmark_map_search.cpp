@@ -0,0 +1,194 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "face_position_cache.h"
+#include "fm_map_search.h"
+#include "nodedef.h"
+#include "noise.h"
+#include <cmath>
+
+namespace {
+
+struct Contents
+{
+	content_t stone, dirt, grass, ore, tree;
+};
+
+Contents registerNodes(NodeDefManager *ndef)
+{
+	auto add = [&](const char *name) {
+		ContentFeatures f;
+		f.name = name;
+		return ndef->set(f.name, f);
+	};
+	Contents c;
+	c.stone = add("default:stone");
+	c.dirt = add("default:dirt");
+	c.grass = add("default:dirt_with_grass");
+	c.ore = add("default:stone_with_coal");
+	c.tree = add("default:tree");
+	return c;
+}
+
+// Hills with some ore below and trees on them, air blocks above
+void generate(Map &map, v3s16 bpmin, v3s16 bpmax, const Contents &c)
+{
+	PseudoRandom pr(13);
+	const v3s16 pmin = bpmin * MAP_BLOCKSIZE;
+	const v3s16 pmax = (bpmax + 1) * MAP_BLOCKSIZE - 1;
+	for (s16 z = pmin.Z; z <= pmax.Z; z++)
+	for (s16 x = pmin.X; x <= pmax.X; x++) {
+		const s16 height = 8 + 6 * std::sin(x / 13.0f) + 4 * std::cos(z / 9.0f);
+		const bool tree = !pr.range(0, 200);
+		for (s16 y = pmin.Y; y <= pmax.Y; y++) {
+			MapNode n(CONTENT_AIR);
+			if (y < height - 3)
+				n = MapNode(pr.range(0, 300) ? c.stone : c.ore);
+			else if (y < height)
+				n = MapNode(c.dirt);
+			else if (y == height)
+				n = MapNode(c.grass);
+			else if (tree && y <= height + 4)
+				n = MapNode(c.tree);
+			map.setNode(v3s16(x, y, z), n);
+		}
+	}
+}
+
+// What find_nodes_in_area did before, node by node
+std::vector<v3s16> findNodesNodeByNode(Map &map, v3s16 minp, v3s16 maxp,
+		const std::vector<content_t> &filter)
+{
+	std::vector<v3s16> found;
+	map.forEachNodeInArea(minp, maxp, [&](v3s16 p, MapNode n) -> bool {
+		if (CONTAINS(filter, n.getContent()))
+			found.push_back(p);
+		return true;
+	});
+	return found;
+}
+
+std::vector<v3s16> findNodesByBlock(Map &map, v3s16 minp, v3s16 maxp,
+		const std::vector<content_t> &filter)
+{
+	std::vector<v3s16> found;
+	forEachMatchingNode(map, minp, maxp, ContentFilter(filter),
+			[&](v3s16 p, int) { found.push_back(p); });
+	return found;
+}
+
+template <typename F>
+std::optional<v3s16> findNodeNear(v3s16 pos, int radius, F &&matches)
+{
+	for (int d = 0; d <= radius; d++)
+		for (const v3s16 &i : FacePositionCache::getFacePositions(d))
+			if (matches(pos + i))
+				return pos + i;
+	return std::nullopt;
+}
+
+template <typename F>
+size_t findUnderAir(v3s16 minp, v3s16 maxp, const ContentFilter &filter, F &&getContent)
+{
+	size_t found = 0;
+	v3s16 p;
+	for (p.X = minp.X; p.X <= maxp.X; p.X++)
+	for (p.Z = minp.Z; p.Z <= maxp.Z; p.Z++)
+	for (p.Y = minp.Y; p.Y <= maxp.Y; p.Y++) {
+		if (getContent(p + v3s16(0, 1, 0)) == CONTENT_AIR && filter.contains(getContent(p)))
+			found++;
+	}
+	return found;
+}
+
+}
+
+TEST_CASE("benchmark_map_search")
+{
+	DummyGameDef gamedef;
+	const Contents c = registerNodes(gamedef.getWritableNodeDefManager());
+
+	// 128x64x128 nodes
+	const v3s16 bpmin(-4, -1, -4), bpmax(3, 2, 3);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	generate(map, bpmin, bpmax, c);
+	const v3s16 minp = bpmin * MAP_BLOCKSIZE;
+	const v3s16 maxp = (bpmax + 1) * MAP_BLOCKSIZE - 1;
+
+	const std::vector<content_t> ores{c.ore};
+	const std::vector<content_t> trees{c.tree, c.grass};
+
+	SECTION("correctness") {
+		for (const auto *filter : {&ores, &trees}) {
+			const auto expected = findNodesNodeByNode(map, minp, maxp, *filter);
+			REQUIRE(!expected.empty());
+			REQUIRE(findNodesByBlock(map, minp, maxp, *filter) == expected);
+		}
+
+		const ContentFilter filter(trees);
+		MapNodeMatcher matcher(map, filter);
+		const auto near = findNodeNear(v3s16(0, 40, 0), 40, matcher);
+		const auto near_old = findNodeNear(v3s16(0, 40, 0), 40, [&](v3s16 p) {
+			return filter.contains(map.getNode(p).getContent());
+		});
+		REQUIRE(near);
+		REQUIRE(near == near_old);
+
+		const VoxelArea area(minp, maxp + v3s16(0, 1, 0));
+		std::vector<content_t> contents;
+		readContents(map, area, contents);
+		const v3s16 under_max = maxp - v3s16(0, 1, 0);
+		REQUIRE(findUnderAir(minp, under_max, filter, [&](v3s16 p) {
+			return contents[area.index(p)];
+		}) == findUnderAir(minp, under_max, filter, [&](v3s16 p) {
+			return map.getNode(p).getContent();
+		}));
+	}
+
+	// Ore is in every block below ground, trees only in some
+	BENCHMARK("find_nodes_in_area_ore_node_by_node") {
+		return findNodesNodeByNode(map, minp, maxp, ores);
+	};
+	BENCHMARK("find_nodes_in_area_ore_by_block") {
+		return findNodesByBlock(map, minp, maxp, ores);
+	};
+	BENCHMARK("find_nodes_in_area_trees_node_by_node") {
+		return findNodesNodeByNode(map, minp, maxp, trees);
+	};
+	BENCHMARK("find_nodes_in_area_trees_by_block") {
+		return findNodesByBlock(map, minp, maxp, trees);
+	};
+
+	// Nothing to find, every shell is searched
+	const std::vector<content_t> missing{c.ore, CONTENT_IGNORE};
+	const ContentFilter missing_filter(missing);
+	BENCHMARK("find_node_near_node_by_node") {
+		return findNodeNear(v3s16(0, 40, 0), 20, [&](v3s16 p) {
+			return missing_filter.contains(map.getNode(p).getContent());
+		});
+	};
+	BENCHMARK("find_node_near_by_block") {
+		MapNodeMatcher matcher(map, missing_filter);
+		return findNodeNear(v3s16(0, 40, 0), 20, matcher);
+	};
+
+	const ContentFilter surface(trees);
+	const v3s16 under_max = maxp - v3s16(0, 1, 0);
+	BENCHMARK("find_nodes_in_area_under_air_node_by_node") {
+		return findUnderAir(minp, under_max, surface, [&](v3s16 p) {
+			return map.getNode(p).getContent();
+		});
+	};
+	BENCHMARK("find_nodes_in_area_under_air_by_block") {
+		const VoxelArea area(minp, maxp);
+		std::vector<content_t> contents;
+		readContents(map, area, contents);
+		return findUnderAir(minp, under_max, surface, [&](v3s16 p) {
+			return contents[area.index(p)];
+		});
+	};
+}
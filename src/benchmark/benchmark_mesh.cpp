@@ -0,0 +1,122 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "nodedef.h"
+#include "settings.h"
+#include "client/content_mapblock.h"
+#include "client/mapblock_mesh.h"
+#include "client/meshgen/collector.h"
+
+namespace {
+
+constexpr int BLOCK_COUNT = 8;
+
+struct MeshStats {
+	u32 vertices = 0;
+	u32 indices = 0;
+};
+
+content_t addCube(NodeDefManager *ndef, const std::string &name, u32 texture)
+{
+	ContentFeatures f;
+	f.name = name;
+	f.drawtype = NDT_NORMAL;
+	f.solidness = 2;
+	f.alpha = ALPHAMODE_OPAQUE;
+	for (TileDef &tiledef : f.tiledef)
+		tiledef.name = name + ".png";
+	for (TileSpec &tile : f.tiles)
+		tile.layers[0].texture_id = texture;
+	return ndef->set(f.name, f);
+}
+
+// Terrain like the one of a typical mapgen: layers of stone, dirt and
+// grass under a hilly surface, with some walls standing on it
+void fillBlock(MeshMakeData &data, int variant, content_t stone,
+		content_t dirt, content_t grass)
+{
+	data.fillBlockDataBegin(v3s16(0, 0, 0));
+	const s16 min = -MAP_BLOCKSIZE, max = 2 * MAP_BLOCKSIZE - 1;
+	for (s16 z = min; z <= max; z++)
+	for (s16 x = min; x <= max; x++) {
+		s16 height = 6 + ((x >> 2) + (z >> 3) + variant) % 4;
+		bool wall = variant % 2 && (x & 7) == 3 && (z & 15) != 7;
+		for (s16 y = min; y <= max; y++) {
+			MapNode n(CONTENT_AIR, LIGHT_SUN, 0);
+			if (y < height - 3)
+				n = MapNode(stone);
+			else if (y < height)
+				n = MapNode(dirt);
+			else if (y == height || (wall && y < height + 4))
+				n = MapNode(wall ? stone : grass);
+			data.m_vmanip.setNode(v3s16(x, y, z), n);
+		}
+	}
+}
+
+MeshStats meshBlock(MeshMakeData &data)
+{
+	MeshCollector collector{v3f(0.5f * MAP_BLOCKSIZE * BS)};
+	MapblockMeshGenerator(&data, &collector, nullptr).generate();
+
+	MeshStats stats;
+	for (const auto &buffers : collector.prebuffers) {
+		for (const PreMeshBuffer &p : buffers) {
+			stats.vertices += p.vertices.size();
+			stats.indices += p.indices.size();
+		}
+	}
+	return stats;
+}
+
+void benchmarkMeshing(bool smooth_lighting)
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+	content_t stone = addCube(ndef, "stone", 1);
+	content_t dirt = addCube(ndef, "dirt", 2);
+	content_t grass = addCube(ndef, "grass", 3);
+
+	std::vector<std::unique_ptr<MeshMakeData>> blocks;
+	for (int i = 0; i < BLOCK_COUNT; i++) {
+		auto data = std::make_unique<MeshMakeData>(ndef, MAP_BLOCKSIZE, true);
+		data->setSmoothLighting(smooth_lighting);
+		fillBlock(*data, i, stone, dirt, grass);
+		blocks.push_back(std::move(data));
+	}
+
+	const bool greedy_meshing = g_settings->getBool("greedy_meshing");
+	const std::string name = smooth_lighting ? "_smooth" : "_flat";
+
+	for (bool greedy : {false, true}) {
+		g_settings->setBool("greedy_meshing", greedy);
+
+		MeshStats total;
+		for (auto &data : blocks) {
+			MeshStats stats = meshBlock(*data);
+			total.vertices += stats.vertices;
+			total.indices += stats.indices;
+		}
+		WARN((greedy ? "greedy" : "per face") << name << ": " <<
+				total.vertices / BLOCK_COUNT << " vertices, " <<
+				total.indices / BLOCK_COUNT << " indices per block");
+
+		// one iteration meshes one block
+		BENCHMARK((greedy ? "mesh_block_greedy" : "mesh_block") + name, i) {
+			return meshBlock(*blocks[i % BLOCK_COUNT]).indices;
+		};
+	}
+
+	g_settings->setBool("greedy_meshing", greedy_meshing);
+}
+
+}
+
+TEST_CASE("benchmark_mesh")
+{
+	benchmarkMeshing(false);
+	benchmarkMeshing(true);
+}
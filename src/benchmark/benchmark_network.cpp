@@ -0,0 +1,205 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "config.h"
+#include "network/connection.h"
+#include "network/networkpacket.h"
+#include "network/peerhandler.h"
+#include "porting.h"
+#include "settings.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+#if MINETEST_TRANSPORT
+#include "network/mtp/impl.h"
+#endif
+#if USE_ENET
+#include "network/enet/connection.h"
+#endif
+
+namespace {
+
+constexpr int CLIENTS = 8;
+constexpr int BLOCKS_PER_CLIENT = 200;
+constexpr int BLOCK_SIZE = 4000; // a typical compressed block
+constexpr u32 MAX_PACKET_SIZE = 1400;
+constexpr u64 RUN_TIMEOUT_MS = 60000;
+
+struct Scenario
+{
+	const char *name;
+	const char *impairment; // network_impairment setting
+};
+
+const Scenario scenarios[] = {
+	{"clean", ""},
+	{"lossy", "loss=0.05 duplicate=0.01 reorder=0.05 reorder_ms=30 "
+			"latency_ms=20 jitter_ms=10 seed=1"},
+	{"capped", "bandwidth=2000000 latency_ms=20 seed=1"},
+};
+
+using Factory = std::function<std::unique_ptr<con::IConnection>(con::PeerHandler *)>;
+
+struct Backend
+{
+	const char *name;
+	Factory create;
+	bool impaired; // whether its sockets take network_impairment
+};
+
+struct Handler : public con::PeerHandler
+{
+	void peerAdded(session_t peer_id) override { peers.insert(peer_id); }
+	void deletingPeer(session_t peer_id, bool timeout) override { peers.erase(peer_id); }
+
+	std::set<session_t> peers;
+};
+
+struct Result
+{
+	std::vector<u64> latencies_us;
+	u64 bytes = 0;
+	u64 time_us = 0;
+	bool connected = false;
+};
+
+void pump(con::IConnection &con)
+{
+	NetworkPacket pkt;
+	while (con.TryReceive(&pkt))
+		;
+}
+
+Result run(const Backend &backend, u16 port)
+{
+	Result result;
+	Handler server_handler;
+	auto server = backend.create(&server_handler);
+	server->Serve(Address(0, 0, 0, 0, port));
+
+	std::vector<std::unique_ptr<con::IConnection>> clients;
+	std::vector<Handler> client_handlers(CLIENTS);
+	for (auto &handler : client_handlers) {
+		clients.emplace_back(backend.create(&handler));
+		clients.back()->Connect(Address(127, 0, 0, 1, port));
+	}
+
+	const u64 start_ms = porting::getTimeMs();
+	auto all_connected = [&] {
+		for (auto &client : clients)
+			if (!client->Connected())
+				return false;
+		return server_handler.peers.size() == CLIENTS;
+	};
+	while (!all_connected()) {
+		if (porting::getTimeMs() - start_ms > RUN_TIMEOUT_MS)
+			return result;
+		pump(*server);
+		for (auto &client : clients)
+			pump(*client);
+		sleep_ms(1);
+	}
+	result.connected = true;
+
+	// Blocks go out like the server streams them, a few per client at once
+	const u64 send_start_us = porting::getTimeUs();
+	std::string filler(BLOCK_SIZE - 12, 'x');
+	for (int block = 0; block < BLOCKS_PER_CLIENT; block++) {
+		for (session_t peer_id : server_handler.peers) {
+			NetworkPacket pkt(0x20, BLOCK_SIZE);
+			pkt << (u32)block << (u64)porting::getTimeUs();
+			pkt.putRawString(filler);
+			server->Send(peer_id, 2, &pkt, true);
+		}
+		if (block % 10 == 9) {
+			pump(*server);
+			sleep_ms(1);
+		}
+	}
+
+	const size_t expected = (size_t)CLIENTS * BLOCKS_PER_CLIENT;
+	u64 last_us = send_start_us;
+	while (result.latencies_us.size() < expected &&
+			porting::getTimeMs() - start_ms < RUN_TIMEOUT_MS) {
+		pump(*server);
+		for (auto &client : clients) {
+			NetworkPacket pkt;
+			while (client->TryReceive(&pkt)) {
+				if (pkt.getCommand() != 0x20)
+					continue;
+				u32 block;
+				u64 sent_us;
+				pkt >> block >> sent_us;
+				last_us = porting::getTimeUs();
+				result.latencies_us.push_back(last_us - sent_us);
+				result.bytes += pkt.getSize();
+			}
+		}
+		sleep_ms(1);
+	}
+	result.time_us = std::max<u64>(last_us - send_start_us, 1);
+
+	for (auto &client : clients)
+		client->Disconnect();
+	return result;
+}
+
+u64 percentile(std::vector<u64> &values, int p)
+{
+	if (values.empty())
+		return 0;
+	size_t i = std::min(values.size() - 1, values.size() * p / 100);
+	std::nth_element(values.begin(), values.begin() + i, values.end());
+	return values[i];
+}
+
+}
+
+// Runs a server and CLIENTS clients over loopback for every connection
+// backend, with the network impaired in a few ways
+TEST_CASE("benchmark_network")
+{
+	std::vector<Backend> backends;
+#if MINETEST_TRANSPORT
+	backends.push_back({"mtp", [] (con::PeerHandler *handler) {
+		return std::make_unique<con::Connection>(MAX_PACKET_SIZE, 30.0f, false, handler);
+	}, true});
+#endif
+#if USE_ENET
+	backends.push_back({"enet", [] (con::PeerHandler *handler) {
+		return std::make_unique<con::ConnectionEnet>(MAX_PACKET_SIZE, 30.0f, false, handler);
+	}, false});
+#endif
+
+	const std::string impairment = g_settings->get("network_impairment");
+	u16 port = 30300;
+	for (const Scenario &scenario : scenarios) {
+		g_settings->set("network_impairment", scenario.impairment);
+		for (const Backend &backend : backends) {
+			if (scenario.impairment[0] && !backend.impaired) {
+				WARN(backend.name << " " << scenario.name << ": skipped, "
+						"its sockets can't be impaired");
+				continue;
+			}
+
+			Result result = run(backend, port++);
+			if (!result.connected) {
+				WARN(backend.name << " " << scenario.name << ": could not connect");
+				continue;
+			}
+			const size_t received = result.latencies_us.size();
+			WARN(backend.name << " " << scenario.name << ": "
+					<< received << "/" << CLIENTS * BLOCKS_PER_CLIENT << " blocks, latency"
+					<< " p50 " << percentile(result.latencies_us, 50) / 1000 << " ms"
+					<< " p95 " << percentile(result.latencies_us, 95) / 1000 << " ms"
+					<< " p99 " << percentile(result.latencies_us, 99) / 1000 << " ms"
+					<< ", goodput " << result.bytes * 1000000 / result.time_us / 1024
+					<< " KiB/s");
+		}
+	}
+	g_settings->set("network_impairment", impairment);
+}
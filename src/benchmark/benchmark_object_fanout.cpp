@@ -0,0 +1,130 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "config.h"
+#include "server/fm_object_fanout.h"
+#include "util/serialize.h"
+#include <random>
+#include <set>
+
+#if MINETEST_PROTO
+
+namespace {
+
+constexpr int CLIENTS = 100;
+constexpr int OBJECTS = 10000;
+constexpr int CLIENTS_PER_OBJECT = 8;
+
+struct Object
+{
+	u16 id;
+	std::vector<session_t> m_known_by;
+};
+
+struct World
+{
+	World()
+	{
+		std::mt19937 rng(42);
+		known.resize(CLIENTS + 1);
+		for (int i = 0; i < OBJECTS; i++) {
+			Object &object = objects.emplace_back(Object{(u16)(i + 1), {}});
+			// Objects are seen by the players around them
+			const u16 first = 1 + rng() % CLIENTS;
+			for (int c = 0; c < CLIENTS_PER_OBJECT; c++) {
+				const session_t peer_id = 1 + (first + c) % CLIENTS;
+				object.m_known_by.push_back(peer_id);
+				known[peer_id].insert(object.id);
+			}
+		}
+
+		std::string position(60, '\0');
+		position[0] = AO_CMD_UPDATE_POSITION;
+		std::string animation(20, '\0');
+		animation[0] = AO_CMD_SET_ANIMATION;
+		for (const Object &object : objects) {
+			messages.emplace_back(object.id, false, position, v3f(0, 0, 0));
+			if (object.id % 10 == 0)
+				messages.emplace_back(object.id, true, animation);
+		}
+	}
+
+	Object *get(u16 id) { return id && id <= objects.size() ? &objects[id - 1] : nullptr; }
+
+	std::vector<Object> objects;
+	std::vector<std::set<u16>> known; // by peer id, like m_known_objects
+	std::vector<ActiveObjectMessage> messages; // of one step, every object moves
+};
+
+// Every client checks every object with messages and encodes them itself
+size_t scanPerClient(World &world)
+{
+	std::unordered_map<u16, std::vector<ActiveObjectMessage> *> buffered_messages;
+	for (ActiveObjectMessage aom : world.messages) {
+		auto &list = buffered_messages[aom.id];
+		if (!list)
+			list = new std::vector<ActiveObjectMessage>;
+		list->push_back(std::move(aom));
+	}
+
+	size_t bytes = 0;
+	std::string reliable_data, unreliable_data;
+	for (session_t peer_id = 1; peer_id <= CLIENTS; peer_id++) {
+		reliable_data.clear();
+		unreliable_data.clear();
+		for (const auto &[id, list] : buffered_messages) {
+			if (!world.get(id) || world.known[peer_id].find(id) == world.known[peer_id].end())
+				continue;
+			for (const ActiveObjectMessage &aom : *list) {
+				std::string &buffer = aom.reliable ? reliable_data : unreliable_data;
+				char idbuf[2];
+				writeU16((u8 *)idbuf, aom.id);
+				buffer.append(idbuf, sizeof(idbuf));
+				buffer.append(serializeString16(aom.datastring));
+			}
+		}
+		bytes += reliable_data.size() + unreliable_data.size();
+	}
+
+	for (auto &buffered_message : buffered_messages)
+		delete buffered_message.second;
+	return bytes;
+}
+
+size_t fanout(World &world)
+{
+	ObjectMessageFanout fanout;
+	for (ActiveObjectMessage aom : world.messages)
+		fanout.add(std::move(aom));
+
+	fanout.route([&](u16 id) { return world.get(id); },
+			[](session_t peer_id, Object *object, const std::optional<v3f> &skip_by_pos) {
+				return false;
+			});
+
+	size_t bytes = 0;
+	for (const auto &[peer_id, outgoing] : fanout.getOutgoing())
+		bytes += outgoing.reliable.size() + outgoing.unreliable.size();
+	return bytes;
+}
+
+}
+
+TEST_CASE("benchmark_object_fanout")
+{
+	World world;
+	REQUIRE(scanPerClient(world) == fanout(world));
+
+	// one iteration routes the messages of one step of 10k moving objects
+	// to 100 clients
+	BENCHMARK("aom_scan_per_client") {
+		return scanPerClient(world);
+	};
+	BENCHMARK("aom_fanout") {
+		return fanout(world);
+	};
+}
+
+#endif
@@ -0,0 +1,132 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include <cmath>
+#include <memory>
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "light.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "util/numeric.h"
+#include "client/fm_particle_store.h"
+
+// Motion and light of particles without collisions like Particle::step
+// did them, one heap object each, against a ParticleStore
+
+namespace {
+
+constexpr size_t PARTICLE_COUNT = 100000;
+constexpr size_t SPAWNER_SIZE = 100;
+constexpr float DTIME = 0.016f;
+constexpr u32 DAYNIGHT_RATIO = 1000;
+
+struct ObjectParticle
+{
+	v3f pos, vel, acc, drag;
+	float time = 0, expiration;
+	u8 light = 0;
+
+	void step(float dtime, Map &map, const NodeDefManager *ndef)
+	{
+		time += dtime;
+
+		v3f av = vecAbsolute(vel);
+		av -= av * (drag * dtime);
+		vel = av * vecSign(vel) + v3f() * dtime;
+		pos += (vel + acc * 0.5f * dtime) * dtime;
+		vel += acc * dtime;
+
+		const v3s16 p(floor(pos.X + 0.5), floor(pos.Y + 0.5), floor(pos.Z + 0.5));
+		const MapNode n = map.getNodeTry(p);
+		if (n.getContent() != CONTENT_IGNORE)
+			light = n.getLightBlend(DAYNIGHT_RATIO, ndef->getLightingFlags(n));
+		else
+			light = blend_light(DAYNIGHT_RATIO, LIGHT_SUN, 0);
+	}
+};
+
+using Objects = std::vector<std::unique_ptr<ObjectParticle>>;
+
+// Spawners all over the map, falling particles spread around each
+void spawn(Objects &objects, ParticleStore &store, v3s16 pmin, v3s16 pmax)
+{
+	PseudoRandom pr(7);
+	const auto random = [&](float min, float max) {
+		return min + (max - min) * pr.next() / PseudoRandom::RANDOM_RANGE;
+	};
+	v3f center;
+	for (size_t i = 0; i < PARTICLE_COUNT; i++) {
+		if (i % SPAWNER_SIZE == 0)
+			center = v3f(random(pmin.X, pmax.X), random(pmin.Y, pmax.Y),
+					random(pmin.Z, pmax.Z));
+		auto p = std::make_unique<ObjectParticle>();
+		p->pos = center + v3f(random(-2, 2), random(-2, 2), random(-2, 2));
+		p->vel = v3f(random(-1, 1), random(0, 2), random(-1, 1));
+		p->acc = v3f(0, -1, 0);
+		p->drag = v3f(random(0, 0.5f), 0, random(0, 0.5f));
+		p->expiration = 1000;
+		store.add(p->pos, p->vel, p->acc, p->drag, p->expiration);
+		objects.push_back(std::move(p));
+	}
+}
+
+void stepObjects(Objects &objects, Map &map, const NodeDefManager *ndef)
+{
+	for (auto &p : objects)
+		p->step(DTIME, map, ndef);
+}
+
+void stepStore(ParticleStore &store, Map &map, const NodeDefManager *ndef)
+{
+	store.integrate(DTIME);
+	store.sampleLight(map, ndef, DAYNIGHT_RATIO);
+}
+
+}
+
+TEST_CASE("benchmark_particles")
+{
+	DummyGameDef gamedef;
+	const NodeDefManager *ndef = gamedef.ndef();
+
+	// 128x64x128 nodes of air with some light
+	const v3s16 bpmin(-4, -1, -4), bpmax(3, 2, 3);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	const v3s16 pmin = bpmin * MAP_BLOCKSIZE;
+	const v3s16 pmax = (bpmax + 1) * MAP_BLOCKSIZE - 1;
+	PseudoRandom pr(3);
+	for (s16 z = pmin.Z; z <= pmax.Z; z++)
+	for (s16 y = pmin.Y; y <= pmax.Y; y++)
+	for (s16 x = pmin.X; x <= pmax.X; x++)
+		map.setNode(v3s16(x, y, z), MapNode(CONTENT_AIR, pr.range(0, 255)));
+
+	Objects objects;
+	ParticleStore store;
+	spawn(objects, store, pmin, pmax);
+
+	SECTION("correctness") {
+		for (int step = 0; step < 10; step++) {
+			stepObjects(objects, map, ndef);
+			stepStore(store, map, ndef);
+		}
+		for (size_t i = 0; i < PARTICLE_COUNT; i++) {
+			REQUIRE(store.getPosition(i) == objects[i]->pos);
+			REQUIRE(store.getVelocity(i) == objects[i]->vel);
+			REQUIRE(store.getTime(i) == objects[i]->time);
+			REQUIRE(store.getLight(i) == objects[i]->light);
+		}
+	}
+
+	BENCHMARK("step_100k_objects") {
+		stepObjects(objects, map, ndef);
+	};
+	BENCHMARK("step_100k_store") {
+		stepStore(store, map, ndef);
+	};
+	BENCHMARK("integrate_100k_store") {
+		store.integrate(DTIME);
+	};
+}
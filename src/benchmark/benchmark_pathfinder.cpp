@@ -0,0 +1,85 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "pathfinder.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "nodedef.h"
+
+TEST_CASE("benchmark_pathfinder")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	v3s16 bpmin(-4, -1, -4);
+	v3s16 bpmax(3, 1, 3);
+	DummyMap map(&gamedef, bpmin, bpmax);
+
+	content_t content_wall;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		content_wall = ndef->set(f.name, f);
+	}
+
+	// Flat ground with walls too high to jump over, the gaps in the walls
+	// alternate between both ends so the path has to wind through them.
+	{
+		std::map<v3s16, MapBlock*> modified_blocks;
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		const VoxelArea &area = vm.m_area;
+		for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+		for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++)
+		for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+			bool wall = y <= 0;
+			if (y <= 4 && (x & 15) == 8) {
+				s16 gap_z = (x >> 4) & 1 ? area.MaxEdge.Z - 4 : area.MinEdge.Z + 4;
+				wall |= z != gap_z;
+			}
+			vm.m_data[area.index(x, y, z)] =
+					MapNode(wall ? content_wall : CONTENT_AIR);
+		}
+		vm.blitBackAll(&modified_blocks);
+	}
+
+	const v3s16 source(-60, 1, -60);
+	const v3s16 destination(60, 1, 60);
+	const unsigned int searchdistance = 8;
+
+	{
+		PathfinderStats stats_flat, stats_cached;
+		PathfinderCache cache;
+		std::vector<v3s16> path_flat = get_path(&map, ndef, source, destination,
+				searchdistance, 1, 2, PA_PLAIN, nullptr, &stats_flat);
+		std::vector<v3s16> path_cached = get_path(&map, ndef, source, destination,
+				searchdistance, 1, 2, PA_PLAIN, &cache, &stats_cached);
+		REQUIRE(!path_flat.empty());
+		REQUIRE(!path_cached.empty());
+		WARN("nodes expanded: flat " << stats_flat.nodes_expanded <<
+				", hierarchical " << stats_cached.nodes_expanded <<
+				" (" << stats_cached.blocks_expanded << " blocks)");
+	}
+
+	BENCHMARK("get_path_flat", i) {
+		return get_path(&map, ndef, source, destination + v3s16(0, 0, -(i % 2)),
+				searchdistance, 1, 2, PA_PLAIN).size();
+	};
+
+	PathfinderCache cache;
+	BENCHMARK("get_path_cached", i) {
+		return get_path(&map, ndef, source, destination + v3s16(0, 0, -(i % 2)),
+				searchdistance, 1, 2, PA_PLAIN, &cache).size();
+	};
+
+	BENCHMARK_ADVANCED("get_path_cached_after_change")(Catch::Benchmark::Chronometer meter) {
+		meter.measure([&] (int i) {
+			// every change invalidates the cached data of one block
+			map.setNode(v3s16(0, 1, 0), MapNode(i % 2 ? content_wall : CONTENT_AIR));
+			return get_path(&map, ndef, source, destination,
+					searchdistance, 1, 2, PA_PLAIN, &cache).size();
+		});
+	};
+}
@@ -0,0 +1,168 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include <cmath>
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "map.h"
+#include "mapgen/mg_schematic.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "util/numeric.h"
+
+// Trees of a dense forest placed into a map chunk like DecoSchematic does,
+// node by node against precompiled layouts
+
+namespace {
+
+struct Contents
+{
+	content_t dirt, tree, leaves;
+};
+
+Contents registerNodes(NodeDefManager *ndef)
+{
+	Contents c;
+	{
+		ContentFeatures f;
+		f.name = "default:dirt";
+		c.dirt = ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "default:tree";
+		f.param_type_2 = CPT2_FACEDIR;
+		c.tree = ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "default:leaves";
+		c.leaves = ndef->set(f.name, f);
+	}
+	ndef->setNodeRegistrationStatus(true);
+	return c;
+}
+
+s16 groundHeight(s16 x, s16 z)
+{
+	return 4 * std::sin(x / 9.0f) + 3 * std::cos(z / 7.0f);
+}
+
+// 5x8x5 tree with a forced trunk, a random top slice and sparse leaf edges
+void makeTree(Schematic &schem, const NodeDefManager *ndef)
+{
+	const v3s16 size(5, 8, 5);
+	schem.size = size;
+	schem.schemdata = new MapNode[size.X * size.Y * size.Z];
+	schem.slice_probs = new u8[size.Y];
+	for (s16 y = 0; y != size.Y; y++)
+		schem.slice_probs[y] = y == size.Y - 1 ? 0x40 : MTSCHEM_PROB_ALWAYS;
+
+	// Condensed ids of m_nodenames
+	schem.m_nodenames = {"air", "default:tree", "default:leaves"};
+	schem.m_nnlistsizes.push_back(schem.m_nodenames.size());
+
+	u32 i = 0;
+	for (s16 z = 0; z != size.Z; z++)
+	for (s16 y = 0; y != size.Y; y++)
+	for (s16 x = 0; x != size.X; x++, i++) {
+		const int dx = std::abs(x - 2), dz = std::abs(z - 2);
+		MapNode n(0, MTSCHEM_PROB_NEVER, 0);
+		if (dx == 0 && dz == 0 && y < 6)
+			n = MapNode(1, MTSCHEM_PROB_ALWAYS | MTSCHEM_FORCE_PLACE, x % 4 * 4);
+		else if (y >= 3 && dx + dz < 3)
+			n = MapNode(2, MTSCHEM_PROB_ALWAYS, 0);
+		else if (y >= 3 && y < 7)
+			n = MapNode(2, 0x30, 0);
+		schem.schemdata[i] = n;
+	}
+
+	ndef->pendNodeResolve(&schem);
+}
+
+struct Tree
+{
+	v3s16 pos;
+	Rotation rot;
+	bool force_place;
+};
+
+// A tree on every third node, some reaching out of the chunk
+std::vector<Tree> plantForest(v3s16 pmin, v3s16 pmax)
+{
+	PseudoRandom pr(13);
+	std::vector<Tree> trees;
+	for (s16 z = pmin.Z; z <= pmax.Z; z += 3)
+	for (s16 x = pmin.X; x <= pmax.X; x += 3) {
+		const s16 tx = x + pr.range(0, 2), tz = z + pr.range(0, 2);
+		trees.push_back({v3s16(tx, groundHeight(tx, tz) + 1, tz),
+				(Rotation)pr.range(ROTATE_0, ROTATE_270), pr.range(0, 9) == 0});
+	}
+	return trees;
+}
+
+void generate(MMVManip &vm, Schematic &schem, const std::vector<MapNode> &ground,
+		const std::vector<Tree> &trees)
+{
+	std::copy(ground.begin(), ground.end(), vm.m_data);
+	mysrand(42);
+	for (const Tree &t : trees)
+		schem.placeOnVManip(&vm, t.pos, DECO_PLACE_CENTER_X | DECO_PLACE_CENTER_Z,
+				t.rot, t.force_place);
+}
+
+}
+
+TEST_CASE("benchmark_schematic")
+{
+	DummyGameDef gamedef;
+	const Contents c = registerNodes(gamedef.getWritableNodeDefManager());
+	const NodeDefManager *ndef = gamedef.ndef();
+
+	// One map chunk of 80x80x80 nodes
+	const v3s16 bpmin(-2, -2, -2), bpmax(2, 2, 2);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	MMVManip vm(&map);
+	vm.initialEmerge(bpmin, bpmax, false);
+	const VoxelArea &area = vm.m_area;
+
+	std::vector<MapNode> ground(area.getVolume());
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++)
+	for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++)
+		ground[area.index(x, y, z)] = MapNode(y <= groundHeight(x, z) ? c.dirt : CONTENT_AIR);
+
+	Schematic schem;
+	makeTree(schem, ndef);
+	REQUIRE(schem.isResolveDone());
+	const std::vector<Tree> trees = plantForest(area.MinEdge, area.MaxEdge);
+
+	SECTION("correctness") {
+		schem.setUseLayouts(false);
+		generate(vm, schem, ground, trees);
+		std::vector<MapNode> by_node(vm.m_data, vm.m_data + area.getVolume());
+
+		schem.setUseLayouts(true);
+		generate(vm, schem, ground, trees);
+		size_t trunks = 0, leaves = 0;
+		for (s32 i = 0; i < area.getVolume(); i++) {
+			REQUIRE(vm.m_data[i] == by_node[i]);
+			trunks += vm.m_data[i].getContent() == c.tree;
+			leaves += vm.m_data[i].getContent() == c.leaves;
+		}
+		REQUIRE(trunks > 0);
+		REQUIRE(leaves > 0);
+	}
+
+	schem.setUseLayouts(false);
+	BENCHMARK("generate_forest_node_by_node") {
+		generate(vm, schem, ground, trees);
+	};
+
+	schem.setUseLayouts(true);
+	BENCHMARK("generate_forest_layouts") {
+		generate(vm, schem, ground, trees);
+	};
+}
@@ -0,0 +1,105 @@
+// Luanti
+// SPDX-License-Identifier: LGPL-2.1-or-later
+// Copyright (C) 2024 Minetest Authors
+
+#include "catch.h"
+#include "network/socket.h"
+#include "porting.h"
+#include "util/basic_macros.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int PORT = 60003 + 1000;
+constexpr int PACKET_SIZE = 512; // a typical MTP packet
+constexpr int ROUND_PACKETS = UDP_BATCH_MAX;
+constexpr int ROUNDS = 2000;
+
+struct Loopback
+{
+	Loopback() : socket(false)
+	{
+		socket.Bind(address);
+		socket.setTimeoutMs(100);
+
+		data.resize(ROUND_PACKETS * PACKET_SIZE);
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = i;
+	}
+
+	// Sends a round of packets to itself and reads them back,
+	// returns the number received
+	int roundSingle()
+	{
+		for (int i = 0; i < ROUND_PACKETS; i++)
+			socket.Send(address, &data[i * PACKET_SIZE], PACKET_SIZE);
+
+		Address sender;
+		int received = 0;
+		while (received < ROUND_PACKETS &&
+				socket.Receive(sender, &buffer[received * PACKET_SIZE],
+				PACKET_SIZE) >= 0)
+			received++;
+		return received;
+	}
+
+	int roundBatch()
+	{
+		UDPSocket::Datagram datagrams[ROUND_PACKETS];
+		for (int i = 0; i < ROUND_PACKETS; i++)
+			datagrams[i] = {address, &data[i * PACKET_SIZE], PACKET_SIZE};
+		socket.SendBatch(datagrams, ROUND_PACKETS);
+
+		int received = 0;
+		while (received < ROUND_PACKETS) {
+			for (int i = 0; i < ROUND_PACKETS - received; i++) {
+				datagrams[i].data = &buffer[(received + i) * PACKET_SIZE];
+				datagrams[i].size = PACKET_SIZE;
+			}
+			int n = socket.ReceiveBatch(datagrams, ROUND_PACKETS - received);
+			if (n == 0)
+				break;
+			received += n;
+		}
+		return received;
+	}
+
+	const Address address{127, 0, 0, 1, PORT};
+	UDPSocket socket;
+	std::vector<u8> data;
+	u8 buffer[ROUND_PACKETS * PACKET_SIZE];
+};
+
+template <class F>
+void reportThroughput(const char *name, Loopback &loopback, F round)
+{
+	const u64 syscalls = loopback.socket.getSyscallCount();
+	const u64 start = porting::getTimeUs();
+	u64 packets = 0;
+	for (int i = 0; i < ROUNDS; i++)
+		packets += round();
+	const u64 time_us = MYMAX(porting::getTimeUs() - start, 1);
+
+	WARN(name << ": " << packets * 1000000 / time_us << " packets/s, "
+			<< (float)(loopback.socket.getSyscallCount() - syscalls) / packets
+			<< " syscalls/packet");
+}
+
+}
+
+TEST_CASE("benchmark_socket")
+{
+	Loopback loopback;
+
+	reportThroughput("udp_single", loopback, [&] { return loopback.roundSingle(); });
+	reportThroughput("udp_batch", loopback, [&] { return loopback.roundBatch(); });
+
+	// one iteration sends and receives ROUND_PACKETS packets
+	BENCHMARK("udp_single") {
+		return loopback.roundSingle();
+	};
+	BENCHMARK("udp_batch") {
+		return loopback.roundBatch();
+	};
+}
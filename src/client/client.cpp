@@ -81,7 +81,9 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "database/database.h"
 #include "server.h"
 #include "emerge.h"
+#include "fm_block_dictionary.h"
 #include "fm_world_merge.h"
+#include "client/fm_mesh_cache.h"
 
 #if !MINETEST_PROTO
 #include "network/fm_clientpacketsender.cpp"
@@ -140,7 +142,7 @@ Client::Client(
 		ELoginRegister allow_login_or_register
 ):
 	far_container{this},
-	mesh_thread_pool(rangelim(rangelim(g_settings->getS32("mesh_generation_threads"), 0, 8) ?: Thread::getNumberOfProcessors()/2, 2,8)),
+	mesh_thread_pool("mesh", TaskPriority::Normal, rangelim(rangelim(g_settings->getS32("mesh_generation_threads"), 0, 8) ?: Thread::getNumberOfProcessors()/2, 2,8)),
 
 	m_simple_singleplayer_mode(is_simple_singleplayer_game),
 	m_tsrc(tsrc),
@@ -362,6 +364,10 @@ void Client::Stop()
 	}
 
 	// TODO: correct order:
+	m_block_decode.wait_until_empty();
+	applyDecodedBlocksFm();
+	storeChangedBlocksFm();
+	m_block_store.wait_until_empty();
 	mesh_thread_pool.wait_until_empty();
 	farmesh_async.wait();
 	mesh_thread_pool.wait_until_empty();
@@ -395,6 +401,8 @@ Client::~Client()
 			std::this_thread::sleep_for(std::chrono::milliseconds(100));
 		}
 	}
+	m_block_decode.wait_until_empty();
+	m_block_store.wait_until_empty();
 	mesh_thread_pool.wait_until_empty(); // before ~ClientMap()
 
 	deleteAuthData();
@@ -481,6 +489,9 @@ void Client::step(float dtime)
 
 	ReceiveAll();
 
+	applyDecodedBlocksFm();
+	storeChangedBlocksFm();
+
 	/*
 		Packet counter
 	*/
@@ -977,6 +988,18 @@ bool Client::loadMedia(const std::string &data, const std::string &filename,
 		return true;
 	}
 
+	if (filename == BLOCK_DICTIONARY_FILE && !from_media_push) {
+		// Known from now on, blocks from the server come with its id
+		const auto dictionary = BlockDictionary::create(data);
+		if (!dictionary) {
+			errorstream << "Client: Bad block dictionary" << std::endl;
+			return false;
+		}
+		verbosestream << "Client: Loaded block dictionary " << dictionary->getId()
+				<< std::endl;
+		return true;
+	}
+
 	errorstream << "Client: Don't know how to load file \""
 		<< filename << "\"" << std::endl;
 	return false;
@@ -2192,6 +2215,14 @@ void Client::afterContentReceived()
    }
 
    if (!headless_optimize) {
+	// Textures and shaders are known now, tiles of cached meshes refer to them
+	if (g_settings->getBool("mesh_disk_cache")) {
+		m_mesh_disk_cache = std::make_unique<MeshDiskCache>(m_nodedef,
+				g_settings->getBool("greedy_meshing"),
+				porting::path_cache + DIR_DELIM + "meshes",
+				(u64)g_settings->getU32("mesh_disk_cache_size") << 20);
+	}
+
 	// Start mesh update thread after setting up content definitions
 	infostream<<"- Starting mesh update thread"<<std::endl;
 	m_mesh_update_manager->start();
@@ -10,7 +10,7 @@
 #include "map_settings_manager.h"
 #include "mapgen/mapgen.h"
 #include "msgpack_fix.h"
-#include "threading/ThreadPool.h"
+#include "threading/task_scheduler.h"
 #include "threading/async.h"
 constexpr const auto FARMESH_DEFAULT_MAPGEN = MAPGEN_FLAT;
 // ==
@@ -18,6 +18,7 @@ constexpr const auto FARMESH_DEFAULT_MAPGEN = MAPGEN_FLAT;
 #include "clientenvironment.h"
 #include "irrlichttypes.h"
 #include <ostream>
+#include <deque>
 #include <map>
 #include <memory>
 #include <set>
@@ -116,6 +117,7 @@ class ClientScripting;
 class GameUI;
 class WorldMerger;
 class FarMesh;
+class MeshDiskCache;
 
 class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 {
@@ -132,6 +134,13 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 
 	void handleCommand_FreeminerInit(NetworkPacket *pkt);
 	void handleCommand_BlockDataFm(NetworkPacket *pkt);
+	void handleCommand_BlockDelta(NetworkPacket *pkt);
+	void decodeBlockDataFmLater(u64 seq, std::shared_ptr<NetworkPacket> pkt);
+	MapBlockPtr decodeBlockDataFm(NetworkPacket &pkt);
+	MapBlockPtr decodeBlockDataFmUnsafe(NetworkPacket &pkt);
+	void applyDecodedBlocksFm();
+	void storeChangedBlocksFm();
+	void applyBlockDataFm(MapBlockPtr block);
 	void sendInitFm();
 	void sendDrawControl();
 	void sendGetBlocks();
@@ -152,10 +161,26 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	FarContainer far_container;
 	ServerMap::far_dbases_t far_dbases;
 	std::unique_ptr<WorldMerger> merger;
-	progschj::ThreadPool mesh_thread_pool;
+	TaskGroup mesh_thread_pool;
+
+	// Far blocks are decoded in parallel and applied in the order they were
+	// received, then stored to the local database one by one. Blocks of the
+	// map itself are applied when received.
+	TaskGroup m_block_decode{"block_decode", TaskPriority::Normal};
+	TaskGroup m_block_store{"block_store", TaskPriority::Low, 1};
+	std::mutex m_decoded_blocks_mutex;
+	std::map<u64, MapBlockPtr> m_decoded_blocks;
+	u64 m_block_decode_seq{};
+	u64 m_block_apply_seq{};
+	// Received and not applied yet, the deferred ones included
+	std::atomic_size_t m_block_decode_queued{};
+	// Received above the decode limit, decoded when there is room again
+	std::deque<std::pair<u64, std::shared_ptr<NetworkPacket>>> m_block_decode_deferred;
+	// Map blocks changed by deltas, stored once per step
+	std::unordered_set<v3bpos_t> m_block_store_changed;
 
 	std::unique_ptr<FarMesh> farmesh;
-    async_step_runner farmesh_async;
+    async_step_runner farmesh_async{"farmesh", TaskPriority::Normal};
 
 	// ==
 
@@ -417,6 +442,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	}
 
 	Minimap* getMinimap() { return m_minimap; }
+	// nullptr if meshes are not cached on disk
+	MeshDiskCache *getMeshDiskCache() { return m_mesh_disk_cache.get(); }
 	void setCamera(Camera* camera) { m_camera = camera; }
 
 	Camera* getCamera () { return m_camera; }
@@ -540,6 +567,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 
 
 	std::unique_ptr<MeshUpdateManager> m_mesh_update_manager;
+	std::unique_ptr<MeshDiskCache> m_mesh_disk_cache;
 public:
 	ClientEnvironment m_env;
 private:
@@ -310,7 +310,7 @@ void ClientEnvironment::step(f32 dtime, double uptime, unsigned int max_cycle_ms
 		if (update_lighting)
 			cao->updateLight(day_night_ratio);
 	};
-	static thread_local async_step_runner m_ao_manager_async;
+	static thread_local async_step_runner m_ao_manager_async{"active_objects"};
 	m_ao_manager_async.step([this, dtime = dtime, cb_state=cb_state]{
 
 	m_ao_manager.step(dtime, cb_state);
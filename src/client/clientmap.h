@@ -214,8 +214,8 @@ class ClientMap : public Map, public scene::ISceneNode
 	drawlist_shadow_map m_drawlist_shadow_0, m_drawlist_shadow_1;
 	std::atomic_bool m_drawlist_shadow_current = false;
 public:
-    async_step_runner update_drawlist_async;
-    async_step_runner update_shadows_async;
+    async_step_runner update_drawlist_async{"drawlist"};
+    async_step_runner update_shadows_async{"shadows"};
 	std::map<v3pos_t, MapBlock*> m_block_boundary;
 private:
 
@@ -2,7 +2,9 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 // Copyright (C) 2010-2013 celeron55, Perttu Ahola <celeron55@gmail.com>
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
 #include "content_mapblock.h"
 #include "util/basic_macros.h"
 #include "util/numeric.h"
@@ -69,6 +71,9 @@ MapblockMeshGenerator::MapblockMeshGenerator(MeshMakeData *input, MeshCollector
 	blockpos_nodes(data->m_blockpos * MAP_BLOCKSIZE),
 	enable_mesh_cache(g_settings->getBool("enable_mesh_cache") &&
 			!data->m_smooth_lighting), // Mesh cache is not supported with smooth lighting
+	// Merged faces would span nodes of different size in far meshes
+	enable_greedy_meshing(g_settings->getBool("greedy_meshing") &&
+			data->fscale <= 1 && !data->lod_step && !data->far_step),
 	smooth_liquids(g_settings->getBool("enable_water_reflections"))
 {
 }
@@ -447,6 +452,15 @@ void MapblockMeshGenerator::drawSolidNode()
 	if (!faces)
 		return;
 	u8 mask = faces ^ 0b0011'1111; // k-th bit is set if k-th face is to be *omitted*, as expected by cuboid drawing functions.
+	// Whole faces of plain cubes may be drawn merged later
+	bool merge_faces = !greedy_faces.empty() && cur_node.f->drawtype == NDT_NORMAL;
+	auto face_color = [&] (int face, u16 light) {
+		video::SColor color = encode_light(light, cur_node.f->light_source);
+		if (!cur_node.f->light_source)
+			applyFacesShading(color, v3f(tile_dirs[face].X, tile_dirs[face].Y,
+					tile_dirs[face].Z));
+		return color;
+	};
 	cur_node.origin = intToFloat(cur_node.p, BS);
 	auto box = aabb3f(v3f(-0.5 * BS ), v3f(0.5 * BS));
 	if (data->fscale > 1) {
@@ -473,7 +487,15 @@ void MapblockMeshGenerator::drawSolidNode()
 				lights[face][k] = LightPair(getSmoothLightSolid(
 						blockpos_nodes + cur_node.p, tile_dirs[face], corner, data));
 			}
+			// only faces without a light gradient can be merged
+			if (merge_faces && lights[face][0] == lights[face][1] &&
+					lights[face][0] == lights[face][2] &&
+					lights[face][0] == lights[face][3] &&
+					addGreedyFace(face, tiles[face], face_color(face, lights[face][0])))
+				mask |= 1 << face;
 		}
+		if (mask == 0b0011'1111)
+			return;
 
 		drawCuboid(box, tiles, 6, texture_coord_buf, mask, [&] (int face, video::S3DVertex vertices[4]) {
 			auto final_lights = lights[face];
@@ -488,6 +510,15 @@ void MapblockMeshGenerator::drawSolidNode()
 			return QuadDiagonal::Diag02;
 		});
 	} else {
+		if (merge_faces) {
+			for (int face = 0; face < 6; ++face) {
+				if (!(mask & (1 << face)) &&
+						addGreedyFace(face, tiles[face], face_color(face, lights[face])))
+					mask |= 1 << face;
+			}
+			if (mask == 0b0011'1111)
+				return;
+		}
 		drawCuboid(box, tiles, 6, texture_coord_buf, mask, [&] (int face, video::S3DVertex vertices[4]) {
 			video::SColor color = encode_light(lights[face], cur_node.f->light_source);
 			if (!cur_node.f->light_source)
@@ -1784,6 +1815,11 @@ void MapblockMeshGenerator::generate()
 {
 	ZoneScoped;
 
+	if (enable_greedy_meshing) {
+		const u32 side = data->side_length_data;
+		greedy_faces.assign(6 * side * side * side, GreedyFace{0, {}});
+	}
+
 	const auto lstep = 1 << data->lod_step;
 	const auto fstep = 1 << data->far_step;
 	for (cur_node.pf.Z = cur_node.pr.Z = 0; cur_node.pr.Z < data->side_length_data; cur_node.pr.Z+=lstep, cur_node.pf.Z+=fstep)
@@ -1794,6 +1830,108 @@ void MapblockMeshGenerator::generate()
 		cur_node.f = &nodedef->get(cur_node.n);
 		drawNode();
 	}
+
+	if (!greedy_faces.empty())
+		drawGreedyFaces();
+}
+
+bool MapblockMeshGenerator::addGreedyFace(int face, const TileSpec &tile,
+		video::SColor color)
+{
+	// Transparent faces are sorted per triangle, keep them apart
+	for (const TileLayer &layer : tile.layers) {
+		if (layer.texture_id != 0 && layer.isTransparent())
+			return false;
+	}
+
+	size_t tile_index = 0;
+	for (; tile_index < greedy_tiles.size(); tile_index++) {
+		const TileSpec &other = greedy_tiles[tile_index];
+		if (other.world_aligned == tile.world_aligned &&
+				other.rotation == tile.rotation &&
+				other.emissive_light == tile.emissive_light &&
+				std::equal(std::begin(other.layers), std::end(other.layers),
+						std::begin(tile.layers)))
+			break;
+	}
+	if (tile_index == greedy_tiles.size()) {
+		if (tile_index >= U16_MAX - 1)
+			return false;
+		greedy_tiles.push_back(tile);
+	}
+
+	const u32 side = data->side_length_data;
+	const v3s16 &p = cur_node.p;
+	greedy_faces[((face * side + p.Z) * side + p.Y) * side + p.X] =
+			GreedyFace{(u16)(tile_index + 1), color};
+	return true;
+}
+
+void MapblockMeshGenerator::drawGreedyFaces()
+{
+	// Axes of each face as in drawSolidNode: normal, then the two
+	// axes the face extends along
+	static const u8 face_axes[6][3] = {
+		{1, 0, 2}, {1, 0, 2},
+		{0, 2, 1}, {0, 2, 1},
+		{2, 0, 1}, {2, 0, 1},
+	};
+	const s16 side = data->side_length_data;
+	auto at = [&] (int face, v3s16 p) -> GreedyFace & {
+		return greedy_faces[((face * side + p.Z) * side + p.Y) * side + p.X];
+	};
+	auto same = [] (const GreedyFace &a, const GreedyFace &b) {
+		return a.tile == b.tile && a.color == b.color;
+	};
+
+	for (int face = 0; face < 6; face++) {
+		const u8 n = face_axes[face][0];
+		const u8 u = face_axes[face][1];
+		const u8 v = face_axes[face][2];
+		v3s16 p;
+		for (p[n] = 0; p[n] < side; p[n]++)
+		for (p[v] = 0; p[v] < side; p[v]++)
+		for (p[u] = 0; p[u] < side; p[u]++) {
+			const GreedyFace start = at(face, p);
+			if (!start.tile)
+				continue;
+
+			// Grow along u, then along v as long as whole rows match
+			s16 width = 1;
+			v3s16 q = p;
+			for (q[u] = p[u] + 1; q[u] < side && same(at(face, q), start); q[u]++)
+				width++;
+			s16 height = 1;
+			for (q[v] = p[v] + 1; q[v] < side; q[v]++) {
+				bool row_matches = true;
+				for (q[u] = p[u]; q[u] < p[u] + width; q[u]++) {
+					if (!same(at(face, q), start)) {
+						row_matches = false;
+						break;
+					}
+				}
+				if (!row_matches)
+					break;
+				height++;
+			}
+			for (q[v] = p[v]; q[v] < p[v] + height; q[v]++)
+			for (q[u] = p[u]; q[u] < p[u] + width; q[u]++)
+				at(face, q).tile = 0;
+
+			v3s16 last = p;
+			last[u] += width - 1;
+			last[v] += height - 1;
+			aabb3f box(intToFloat(p, BS) - v3f(0.5 * BS),
+					intToFloat(last, BS) + v3f(0.5 * BS));
+			f32 texture_coord_buf[24];
+			generateCuboidTextureCoords(box, texture_coord_buf);
+			TileSpec &tile = greedy_tiles[start.tile - 1];
+			auto vertices = setupCuboidVertices(box, texture_coord_buf, &tile, 1);
+			for (int j = 0; j < 4; j++)
+				vertices[4 * face + j].Color = start.color;
+			collector->append(tile, &vertices[4 * face], 4, quad_indices, 6);
+		}
+	}
 }
 
 void MapblockMeshGenerator::renderSingle(content_t node, u8 param2)
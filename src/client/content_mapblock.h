@@ -62,6 +62,7 @@ class MapblockMeshGenerator
 
 // options
 	const bool enable_mesh_cache;
+	const bool enable_greedy_meshing;
 
 // current node
 	struct {
@@ -176,6 +177,19 @@ class MapblockMeshGenerator
 	void drawNodeboxNode();
 	void drawMeshNode();
 
+// greedy meshing of solid faces
+	// A face waiting to be merged with neighbouring faces of the same look
+	struct GreedyFace {
+		u16 tile; // index into greedy_tiles + 1, 0 if there is no face
+		video::SColor color;
+	};
+	std::vector<TileSpec> greedy_tiles;
+	// Faces by direction and node position, empty if greedy meshing is off
+	std::vector<GreedyFace> greedy_faces;
+
+	bool addGreedyFace(int face, const TileSpec &tile, video::SColor color);
+	void drawGreedyFaces();
+
 // common
 	void errorUnknownDrawtype();
 	void drawNode();
@@ -0,0 +1,123 @@
+/*
+fm_cache_dir_limit.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_cache_dir_limit.h"
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+#include "log.h"
+#include "threading/task_scheduler.h"
+
+namespace stdfs = std::filesystem;
+
+CacheDirLimit::CacheDirLimit(const std::string &dir, u64 max_bytes) :
+		m_state(std::make_shared<State>())
+{
+	m_state->dir = dir;
+	m_state->max_bytes = max_bytes;
+	m_state->trimming = true;
+	startTrim(m_state);
+}
+
+void CacheDirLimit::added(u64 bytes)
+{
+	if (m_state->bytes.fetch_add(bytes) + bytes <= m_state->max_bytes)
+		return;
+	if (!m_state->trimming.exchange(true))
+		startTrim(m_state);
+}
+
+void CacheDirLimit::used(const std::string &path)
+{
+	std::error_code ec;
+	stdfs::last_write_time(path, stdfs::file_time_type::clock::now(), ec);
+}
+
+void CacheDirLimit::startTrim(const std::shared_ptr<State> &state)
+{
+	TaskScheduler::get().submit("cache_trim", TaskPriority::Low, [state] {
+		const u64 before = state->bytes;
+		const u64 left = trim(state->dir, state->max_bytes);
+		// Keep what added() counted meanwhile, only this task lowers the
+		// total. Files written meanwhile may be counted twice until the
+		// next trim.
+		u64 bytes = state->bytes;
+		while (!state->bytes.compare_exchange_weak(bytes, left + (bytes - before)))
+			;
+		state->trimming = false;
+	});
+}
+
+u64 CacheDirLimit::trim(const std::string &dir, u64 max_bytes)
+{
+	struct File
+	{
+		stdfs::file_time_type time;
+		u64 size;
+		stdfs::path path;
+	};
+	std::vector<File> files;
+	u64 total = 0;
+
+	std::error_code ec;
+	for (stdfs::recursive_directory_iterator it(dir, ec), end;
+			!ec && it != end; it.increment(ec)) {
+		std::error_code file_ec;
+		if (!it->is_regular_file(file_ec))
+			continue;
+		const u64 size = it->file_size(file_ec);
+		const auto time = it->last_write_time(file_ec);
+		if (file_ec)
+			continue;
+		files.push_back({time, size, it->path()});
+		total += size;
+	}
+	if (total <= max_bytes)
+		return total;
+
+	std::sort(files.begin(), files.end(), [](const File &a, const File &b) {
+		return a.time < b.time;
+	});
+	const u64 target = max_bytes / 4 * 3;
+	size_t removed = 0;
+	for (const File &file : files) {
+		if (total <= target)
+			break;
+		if (stdfs::remove(file.path, ec)) {
+			total -= file.size;
+			removed++;
+		}
+	}
+
+	// Directories of other settings or servers emptied by this
+	std::vector<stdfs::path> empty_dirs;
+	for (stdfs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+		std::error_code dir_ec;
+		if (it->is_directory(dir_ec) && stdfs::is_empty(it->path(), dir_ec))
+			empty_dirs.push_back(it->path());
+	}
+	for (const stdfs::path &path : empty_dirs)
+		stdfs::remove(path, ec);
+
+	infostream << "CacheDirLimit: removed " << removed << " files from "
+			<< dir << ", " << total << " bytes left" << std::endl;
+	return total;
+}
@@ -0,0 +1,64 @@
+/*
+fm_cache_dir_limit.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "irrlichttypes.h"
+
+/*
+	Keeps the files below a cache directory within a total size. Once they
+	take more, the least recently used files are removed by a background
+	task. Files count as used when written and when passed to used().
+*/
+class CacheDirLimit
+{
+public:
+	// Counts what is there already in the background
+	CacheDirLimit(const std::string &dir, u64 max_bytes);
+
+	// After writing a file of size bytes
+	void added(u64 bytes);
+
+	// After reading a file, it is removed last then
+	static void used(const std::string &path);
+
+	// When the files take more than max_bytes, removes the least recently
+	// used ones down to 3/4 of it and then empty directories.
+	// @return bytes left
+	static u64 trim(const std::string &dir, u64 max_bytes);
+
+private:
+	struct State
+	{
+		std::string dir;
+		u64 max_bytes;
+		std::atomic<u64> bytes{0};
+		std::atomic_bool trimming{false};
+	};
+
+	// The task keeps the state, the owner may be gone before it ends
+	static void startTrim(const std::shared_ptr<State> &state);
+
+	std::shared_ptr<State> m_state;
+};
@@ -2,6 +2,7 @@
 #include <exception>
 #include <future>
 #include <memory>
+#include <thread>
 #include "client.h"
 #include "fm_far_calc.h"
 #include "client/mapblock_mesh.h"
@@ -16,10 +17,17 @@
 #include "filesys.h"
 #include "map.h"
 #include "mapgen/mapgen.h"
+#include "nodemetadata.h"
 #include "network/networkpacket.h"
+#include "serialization.h"
 #include "threading/lock.h"
 #include "util/directiontables.h"
 
+// Received far blocks being decoded, more are kept as received until these
+// are applied, and asking for more far blocks stops at half of it. Blocks
+// of the map (step 0) are not queued.
+#define BLOCK_DECODE_QUEUE_MAX 2000
+
 void Client::updateMeshTimestampWithEdge(const v3bpos_t &blockpos)
 {
 	for (const auto &dir : g_7dirs) {
@@ -43,7 +51,7 @@ void Client::sendInitFm()
 {
 	MSGPACK_PACKET_INIT((int)TOSERVER_INIT_FM, 1);
 
-	PACK(TOSERVER_INIT_FM_VERSION, 1);
+	PACK(TOSERVER_INIT_FM_VERSION, CLIENT_PROTOCOL_VERSION_FM);
 
 	NetworkPacket pkt(TOSERVER_INIT_FM, buffer.size());
 	pkt.putLongString({buffer.data(), buffer.size()});
@@ -57,6 +65,10 @@ void Client::sendGetBlocks()
 	if (!farmesh_server)
 		return;
 
+	// Wait for received blocks to be decoded, the requests stay queued
+	if (m_block_decode_queued >= BLOCK_DECODE_QUEUE_MAX / 2)
+		return;
+
 	auto &far_blocks = m_env.getClientMap().m_far_blocks_ask;
 	const auto lock = far_blocks.lock_unique_rec();
 
@@ -190,26 +202,73 @@ void Client::createFarMesh(MapBlockPtr &block)
 
 void Client::handleCommand_BlockDataFm(NetworkPacket *pkt)
 {
-	const auto str = std::string{pkt->getString(0), pkt->getSize()};
-	if (!pkt->packet_unpack()) {
+	if (!pkt->packet && !pkt->packet_unpack())
+		return;
+
+	// Map blocks are applied right away, in order with the node changes of
+	// the other packets, far blocks are decoded on task workers
+	block_step_t step = 0;
+	try {
+		pkt->packet->convert_safe(TOCLIENT_BLOCKDATA_STEP, step);
+	} catch (const std::exception &ex) {
+		errorstream << "fm block step fail: " << ex.what() << "\n";
 		return;
 	}
-	auto &packet = *(pkt->packet);
+	if (!step) {
+		if (auto block = decodeBlockDataFm(*pkt))
+			applyBlockDataFm(std::move(block));
+		return;
+	}
+
+	const auto seq = m_block_decode_seq++;
+	auto packet = std::make_shared<NetworkPacket>(*pkt);
+	const size_t decoding = m_block_decode_queued++ - m_block_decode_deferred.size();
+	if (decoding >= BLOCK_DECODE_QUEUE_MAX || !m_block_decode_deferred.empty())
+		m_block_decode_deferred.emplace_back(seq, std::move(packet));
+	else
+		decodeBlockDataFmLater(seq, std::move(packet));
+}
+
+void Client::decodeBlockDataFmLater(u64 seq, std::shared_ptr<NetworkPacket> pkt)
+{
+	m_block_decode.enqueue([this, seq, packet = std::move(pkt)]() {
+		// Blocks are applied in order, a failed one leaves nullptr so the
+		// later ones do not wait for it
+		MapBlockPtr block;
+		try {
+			block = decodeBlockDataFm(*packet);
+		} catch (...) {
+		}
+		const std::lock_guard<std::mutex> lock(m_decoded_blocks_mutex);
+		m_decoded_blocks.emplace(seq, std::move(block));
+	});
+}
+
+// Runs on a task worker for far blocks, the block is not in the map yet.
+// nullptr for a broken packet.
+MapBlockPtr Client::decodeBlockDataFm(NetworkPacket &pkt)
+{
+	try {
+		return decodeBlockDataFmUnsafe(pkt);
+	} catch (const std::exception &ex) {
+		errorstream << "fm block decode fail: " << ex.what() << "\n";
+		return {};
+	}
+}
+
+MapBlockPtr Client::decodeBlockDataFmUnsafe(NetworkPacket &pkt)
+{
+	if (!pkt.packet && !pkt.packet_unpack()) {
+		return {};
+	}
+	auto &packet = *(pkt.packet);
 	v3bpos_t bpos = packet[TOCLIENT_BLOCKDATA_POS].as<v3bpos_t>();
 	block_step_t step = 0;
 	packet[TOCLIENT_BLOCKDATA_STEP].convert(step);
 	std::istringstream istr(
 			packet[TOCLIENT_BLOCKDATA_DATA].as<std::string>(), std::ios_base::binary);
 
-	MapBlockPtr block{};
-	if (step) {
-		block = m_env.getMap().createBlankBlockNoInsert(bpos);
-	} else {
-		block = m_env.getMap().getBlock(bpos);
-		if (!block)
-			block = m_env.getMap().createBlankBlock(bpos);
-	}
-	const auto lock = block->lock_unique_rec();
+	MapBlockPtr block = m_env.getMap().createBlankBlockNoInsert(bpos);
 	block->far_step = step;
 	content_t content_only{};
 	packet.convert_safe(TOCLIENT_BLOCKDATA_CONTENT_ONLY, content_only);
@@ -224,13 +283,13 @@ void Client::handleCommand_BlockDataFm(NetworkPacket *pkt)
 			block->deSerialize(istr, m_server_ser_ver, false);
 		} catch (const std::exception &ex) {
 			errorstream << "fm block deSerialize fail " << bpos << " " << block->far_step
-						<< " : " << ex.what() << " : " << pkt->getSize() << " "
+						<< " : " << ex.what() << " : " << pkt.getSize() << " "
 						<< packet.size() << " v=" << (short)m_server_ser_ver << "\n";
 #if !NDEBUG
 			errorstream << "bad data " << istr.str().size() << " : " << istr.str()
 						<< "\n";
 #endif
-			return;
+			return {};
 		}
 	} else {
 		block->fill({block->content_only, block->content_only_param1,
@@ -242,14 +301,83 @@ void Client::handleCommand_BlockDataFm(NetworkPacket *pkt)
 	h = 0;
 	packet[TOCLIENT_BLOCKDATA_HUMIDITY].convert(h);
 	block->humidity = h;
+	return block;
+}
 
-	if (m_localdb && !is_simple_singleplayer_game) {
-		if (const auto db = GetFarDatabase({}, far_dbases, m_world_path, step); db) {
-			ServerMap::saveBlock(block.get(), db);
+void Client::applyDecodedBlocksFm()
+{
+	std::vector<MapBlockPtr> blocks;
+	{
+		const std::lock_guard<std::mutex> lock(m_decoded_blocks_mutex);
+		for (auto it = m_decoded_blocks.begin();
+				it != m_decoded_blocks.end() && it->first == m_block_apply_seq;
+				it = m_decoded_blocks.erase(it), ++m_block_apply_seq) {
+			blocks.emplace_back(std::move(it->second));
+		}
+	}
+	m_block_decode_queued -= blocks.size();
+
+	while (!m_block_decode_deferred.empty() &&
+			m_block_decode_queued - m_block_decode_deferred.size() <
+					BLOCK_DECODE_QUEUE_MAX) {
+		auto &[seq, packet] = m_block_decode_deferred.front();
+		decodeBlockDataFmLater(seq, std::move(packet));
+		m_block_decode_deferred.pop_front();
+	}
+
+	for (auto &block : blocks) {
+		if (block) {
+			applyBlockDataFm(std::move(block));
+		}
+	}
+}
 
-			if (!step && !far_container.have_params) {
+void Client::storeChangedBlocksFm()
+{
+	for (const auto &bpos : m_block_store_changed) {
+		const auto block = m_env.getMap().getBlock(bpos);
+		if (!block)
+			continue;
+		m_block_store.enqueue([this, block, bpos]() {
+			{
+				const auto lock = block->lock_shared_rec();
+				ServerMap::saveBlock(block.get(), m_localdb);
+			}
+			if (!far_container.have_params) {
 				merger->add_changed(bpos);
 			}
+		});
+	}
+	m_block_store_changed.clear();
+}
+
+void Client::applyBlockDataFm(MapBlockPtr decoded)
+{
+	const auto bpos = decoded->getPos();
+	const auto step = decoded->far_step;
+
+	if (m_localdb && !is_simple_singleplayer_game) {
+		// The decoded block is not changed anymore
+		m_block_store.enqueue([this, decoded, bpos, step]() {
+			if (const auto db = GetFarDatabase({}, far_dbases, m_world_path, step); db) {
+				ServerMap::saveBlock(decoded.get(), db);
+
+				if (!step && !far_container.have_params) {
+					merger->add_changed(bpos);
+				}
+			}
+		});
+	}
+
+	MapBlockPtr block = decoded;
+	if (!step) {
+		auto &map = m_env.getMap();
+		if (!map.insertBlock(decoded)) {
+			// Keep the existing block with its meshes
+			block = map.getBlock(bpos);
+			if (!block)
+				return;
+			block->copyNetworkDataFrom(*decoded);
 		}
 	}
 
@@ -352,6 +480,59 @@ void Client::handleCommand_BlockDataFm(NetworkPacket *pkt)
 	}
 }
 
+void Client::handleCommand_BlockDelta(NetworkPacket *pkt)
+{
+	v3bpos_t bpos;
+	u16 count = 0;
+	*pkt >> bpos >> count;
+
+	// Deleted here, the server knows it soon
+	const auto block = m_env.getMap().getBlock(bpos);
+	if (!block)
+		return;
+
+	std::vector<u16> changes;
+	changes.reserve(count);
+	{
+		const auto lock = block->lock_unique_rec();
+		for (u16 i = 0; i < count; ++i) {
+			u16 index;
+			MapNode n;
+			*pkt >> index >> n.param0 >> n.param1 >> n.param2;
+			if (index >= MapBlock::nodecount)
+				continue;
+			// With the light of the server
+			block->setNodeNoLock(MapBlock::indexToPos(index), n);
+			changes.emplace_back(index);
+		}
+
+		for (const u16 index : changes)
+			block->m_node_metadata.remove(MapBlock::indexToPos(index));
+
+		const std::string meta_data = pkt->readLongString();
+		if (!meta_data.empty()) {
+			std::istringstream is(meta_data, std::ios::binary);
+			std::stringstream sstr(std::ios::binary | std::ios::in | std::ios::out);
+			decompressZlib(is, sstr);
+			NodeMetadataList meta_list(false);
+			meta_list.deSerialize(sstr, m_itemdef);
+			for (const auto &[p, meta] : meta_list)
+				block->m_node_metadata.set(p, meta);
+		}
+	}
+
+	// Stored with the received blocks, not while handling packets
+	block->raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
+	if (m_localdb && !is_simple_singleplayer_game)
+		m_block_store_changed.insert(bpos);
+
+	updateMeshTimestampWithEdge(bpos);
+	if (!overload &&
+			getNodeBlockPos(floatToInt(m_env.getLocalPlayer()->getPosition(), BS))
+							.getDistanceFrom(bpos) <= 1)
+		addUpdateMeshTaskWithEdge(bpos);
+}
+
 void Client::sendDrawControl()
 {
 	MSGPACK_PACKET_INIT((int)TOSERVER_DRAWCONTROL, 4);
@@ -119,5 +119,12 @@ class FarMesh
 	uint8_t planes_processed_last{};
 	concurrent_shared_unordered_map<uint16_t, concurrent_unordered_set<v3bpos_t>>
 			far_blocks_list;
-	std::array<async_step_runner, 6> async;
+	std::array<async_step_runner, 6> async{
+			async_step_runner{"farmesh_direction", TaskPriority::Normal},
+			async_step_runner{"farmesh_direction", TaskPriority::Normal},
+			async_step_runner{"farmesh_direction", TaskPriority::Normal},
+			async_step_runner{"farmesh_direction", TaskPriority::Normal},
+			async_step_runner{"farmesh_direction", TaskPriority::Normal},
+			async_step_runner{"farmesh_direction", TaskPriority::Normal},
+	};
 };
@@ -0,0 +1,159 @@
+/*
+fm_image_cache.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_image_cache.h"
+#include <IImage.h>
+#include <IVideoDriver.h>
+#include <cstring>
+#include <sstream>
+#include "client/filecache.h"
+#include "client/fm_cache_dir_limit.h"
+#include "client/imagesource.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "serialization.h"
+#include "settings.h"
+#include "util/hex.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+
+// Bump when the file format or the output of the texture modifiers changes
+#define IMAGE_CACHE_VERSION 1
+#define IMAGE_CACHE_MAGIC 0x464d4943 // "FMIC"
+
+// Larger images are made on the fly
+#define IMAGE_CACHE_MAX_PIXELS (4096 * 4096)
+
+static std::string keyToName(u64 key)
+{
+	return hex_encode(reinterpret_cast<const char *>(&key), sizeof(key));
+}
+
+ImageDiskCache::ImageDiskCache(ImageSource &source, video::IVideoDriver *driver,
+		const std::string &dir, u64 max_bytes) :
+		m_source(source), m_driver(driver)
+{
+	std::ostringstream os(std::ios::binary);
+	for (const char *name : {"mip_map", "trilinear_filter", "bilinear_filter",
+			"anisotropic_filter", "texture_min_size"})
+		os << g_settings->get(name) << '\n';
+	os << IMAGE_CACHE_VERSION;
+	const std::string identity = os.str();
+	m_identity = murmur_hash_64_ua(identity.data(), identity.size(), IMAGE_CACHE_MAGIC);
+
+	m_dir = dir + DIR_DELIM + keyToName(m_identity);
+	m_files = std::make_unique<FileCache>(m_dir);
+	m_limit = std::make_unique<CacheDirLimit>(dir, max_bytes);
+}
+
+ImageDiskCache::~ImageDiskCache() = default;
+
+bool ImageDiskCache::isWorthCaching(std::string_view name)
+{
+	return name.find_first_of("^[") != std::string_view::npos;
+}
+
+std::string ImageDiskCache::getFileName(const std::string &name) const
+{
+	return keyToName(murmur_hash_64_ua(name.data(), name.size(), m_identity));
+}
+
+video::IImage *ImageDiskCache::load(const std::string &name,
+		std::set<std::string> &source_image_names)
+{
+	const std::string file_name = getFileName(name);
+	std::ostringstream os(std::ios::binary);
+	if (!m_files->load(file_name, os))
+		return nullptr;
+	CacheDirLimit::used(m_dir + DIR_DELIM + file_name);
+
+	std::istringstream is(os.str(), std::ios::binary);
+	std::set<std::string> sources;
+	std::string pixels;
+	u32 width, height;
+	try {
+		// Other texture strings may have the same key
+		if (readU32(is) != IMAGE_CACHE_MAGIC || readU8(is) != IMAGE_CACHE_VERSION ||
+				deSerializeString32(is) != name)
+			return nullptr;
+		for (u16 count = readU16(is); count > 0; count--) {
+			std::string source = deSerializeString16(is);
+			if (readU64(is) != m_source.getSourceImageHash(source))
+				return nullptr;
+			sources.emplace(std::move(source));
+		}
+		width = readU32(is);
+		height = readU32(is);
+		if (!width || !height || (u64)width * height > IMAGE_CACHE_MAX_PIXELS)
+			return nullptr;
+		std::ostringstream decompressed(std::ios::binary);
+		decompressZstd(is, decompressed);
+		pixels = decompressed.str();
+		if (pixels.size() != (size_t)width * height * 4)
+			return nullptr;
+	} catch (SerializationError &e) {
+		warningstream << "ImageDiskCache: broken entry for \"" << name
+				<< "\": " << e.what() << std::endl;
+		return nullptr;
+	}
+
+	video::IImage *img = m_driver->createImage(
+			video::ECF_A8R8G8B8, {width, height});
+	memcpy(img->getData(), pixels.data(), pixels.size());
+	source_image_names.insert(sources.begin(), sources.end());
+	return img;
+}
+
+void ImageDiskCache::store(const std::string &name, video::IImage *img,
+		const std::set<std::string> &source_image_names)
+{
+	const auto dim = img->getDimension();
+	if (img->getColorFormat() != video::ECF_A8R8G8B8 ||
+			dim.getArea() > IMAGE_CACHE_MAX_PIXELS ||
+			source_image_names.size() > U16_MAX)
+		return;
+
+	std::ostringstream os(std::ios::binary);
+	writeU32(os, IMAGE_CACHE_MAGIC);
+	writeU8(os, IMAGE_CACHE_VERSION);
+	os << serializeString32(name);
+	writeU16(os, source_image_names.size());
+	for (const std::string &source : source_image_names) {
+		// Missing images were replaced by random dummies
+		const u64 hash = m_source.getSourceImageHash(source);
+		if (!hash)
+			return;
+		os << serializeString16(source);
+		writeU64(os, hash);
+	}
+	writeU32(os, dim.Width);
+	writeU32(os, dim.Height);
+	compressZstd(reinterpret_cast<const u8 *>(img->getData()), dim.getArea() * 4, os);
+
+	const std::string data = os.str();
+	if (!m_files->update(getFileName(name), data)) {
+		warningstream << "ImageDiskCache: could not store \"" << name << "\""
+				<< std::endl;
+		return;
+	}
+	m_limit->added(data.size());
+}
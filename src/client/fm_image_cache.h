@@ -0,0 +1,79 @@
+/*
+fm_image_cache.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include "irrlichttypes.h"
+
+namespace irr::video
+{
+class IImage;
+class IVideoDriver;
+}
+
+class CacheDirLimit;
+class FileCache;
+struct ImageSource;
+
+/*
+	Keeps images generated from texture strings on disk, so the textures
+	of a server don't have to be generated again on the next connect.
+
+	Entries are found by the texture string and hold the hashes of the
+	source images they were made from, an entry is only used while all of
+	them are still the same. Images of other settings affecting the
+	generation live in another directory below dir. The least recently
+	used files are removed once all of them take more than max_bytes.
+*/
+class ImageDiskCache
+{
+public:
+	// Images are made with driver
+	ImageDiskCache(ImageSource &source, video::IVideoDriver *driver,
+			const std::string &dir, u64 max_bytes);
+	~ImageDiskCache();
+
+	// Plain source images are not worth it
+	static bool isWorthCaching(std::string_view name);
+
+	// The cached image or nullptr, adds to source_image_names like
+	// ImageSource::generateImage. Can be called from any thread.
+	video::IImage *load(const std::string &name,
+			std::set<std::string> &source_image_names);
+
+	// Can be called from any thread
+	void store(const std::string &name, video::IImage *img,
+			const std::set<std::string> &source_image_names);
+
+private:
+	std::string getFileName(const std::string &name) const;
+
+	ImageSource &m_source;
+	video::IVideoDriver *m_driver;
+	u64 m_identity;
+	std::string m_dir;
+	std::unique_ptr<FileCache> m_files;
+	std::unique_ptr<CacheDirLimit> m_limit;
+};
@@ -0,0 +1,154 @@
+/*
+fm_image_kernels.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_image_kernels.h"
+
+// The dynamic linker picks the clone for the CPU once, through an ifunc
+#if defined(__x86_64__) && defined(__ELF__) && !defined(__ANDROID__) && \
+		defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define IMAGE_KERNEL __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#ifndef IMAGE_KERNEL
+#define IMAGE_KERNEL
+#endif
+
+namespace image_kernels
+{
+
+namespace
+{
+
+inline u32 alpha(u32 c) { return c >> 24; }
+inline u32 red(u32 c) { return (c >> 16) & 0xff; }
+inline u32 green(u32 c) { return (c >> 8) & 0xff; }
+inline u32 blue(u32 c) { return c & 0xff; }
+inline u32 argb(u32 a, u32 r, u32 g, u32 b) { return a << 24 | r << 16 | g << 8 | b; }
+
+// Not alpha blending if both src and dst are semi-transparent, an old
+// implementation did it wrong and fixing it would break backwards
+// compatibility (see #14847).
+// Without branches: the lerp gives the right result for an opaque src or
+// dst too, only an empty src or dst needs another one.
+template <bool only_opaque>
+inline u32 blitPixel(u32 s, u32 d)
+{
+	const u32 sa = alpha(s), da = alpha(d);
+	const u32 r = (red(d) * (255 - sa) + red(s) * sa) / 255;
+	const u32 g = (green(d) * (255 - sa) + green(s) * sa) / 255;
+	const u32 b = (blue(d) * (255 - sa) + blue(s) * sa) / 255;
+	const u32 a = da + (255 - da) * sa * sa / (255 * 255);
+	u32 res = argb(a, r, g, b);
+	res = da == 0 ? s : res;
+	res = sa == 0 ? d : res;
+	if constexpr (only_opaque)
+		res = da != 255 ? d : res;
+	return res;
+}
+
+inline u32 overlayChannel(u32 blend, u32 base)
+{
+	const double blend_f = blend / 255.0;
+	const double base_f = base / 255.0;
+	return (u32)((base_f < 0.5 ? 2 * base_f * blend_f
+			: 1 - 2 * (1 - base_f) * (1 - blend_f)) * 255) & 0xff;
+}
+
+}
+
+IMAGE_KERNEL void blit(const u32 *src, u32 *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = blitPixel<false>(src[i], dst[i]);
+}
+
+IMAGE_KERNEL void blitOverlay(const u32 *src, u32 *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = blitPixel<true>(src[i], dst[i]);
+}
+
+IMAGE_KERNEL void replaceColor(u32 *dst, size_t count, u32 color, bool keep_alpha)
+{
+	const u32 rgb = color & 0xffffff;
+	const u32 color_a = alpha(color);
+	if (keep_alpha) {
+		for (size_t i = 0; i < count; i++) {
+			const u32 a = alpha(dst[i]);
+			dst[i] = a ? (a * color_a / 255) << 24 | rgb : dst[i];
+		}
+	} else {
+		for (size_t i = 0; i < count; i++)
+			dst[i] = alpha(dst[i]) ? color : dst[i];
+	}
+}
+
+IMAGE_KERNEL void multiply(u32 *dst, size_t count, u32 color)
+{
+	const u32 cr = red(color), cg = green(color), cb = blue(color);
+	for (size_t i = 0; i < count; i++) {
+		const u32 d = dst[i];
+		dst[i] = argb(alpha(d), red(d) * cr / 255, green(d) * cg / 255,
+				blue(d) * cb / 255);
+	}
+}
+
+IMAGE_KERNEL void screen(u32 *dst, size_t count, u32 color)
+{
+	const u32 cr = 255 - red(color), cg = 255 - green(color), cb = 255 - blue(color);
+	for (size_t i = 0; i < count; i++) {
+		const u32 d = dst[i];
+		dst[i] = argb(alpha(d), 255 - (255 - red(d)) * cr / 255,
+				255 - (255 - green(d)) * cg / 255,
+				255 - (255 - blue(d)) * cb / 255);
+	}
+}
+
+IMAGE_KERNEL void overlay(const u32 *blend, const u32 *base, u32 *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		const u32 bl = blend[i], ba = base[i];
+		dst[i] = argb(alpha(ba), overlayChannel(red(bl), red(ba)),
+				overlayChannel(green(bl), green(ba)),
+				overlayChannel(blue(bl), blue(ba)));
+	}
+}
+
+IMAGE_KERNEL void mask(const u32 *mask, u32 *dst, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] &= mask[i];
+}
+
+// Table lookups don't vectorize, there is no clone of this one
+void lookup(u32 *dst, size_t count, const ChannelTables &tables, bool skip_transparent)
+{
+	for (size_t i = 0; i < count; i++) {
+		const u32 d = dst[i];
+		if (skip_transparent && !alpha(d))
+			continue;
+		dst[i] = argb(tables.a[alpha(d)], tables.r[red(d)], tables.g[green(d)],
+				tables.b[blue(d)]);
+	}
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+fm_image_kernels.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include "irrlichttypes.h"
+
+/*
+	Texture modifiers on rows of pixels, ARGB in a u32 like video::SColor.
+
+	The results are exactly those of the per-pixel SColor code they
+	replace. The loops are written for the compiler to vectorize, on x86-64
+	they are also built for AVX2 and picked at runtime by the CPU.
+	dst may be the same row as a source row.
+*/
+namespace image_kernels
+{
+
+// The `^` modifier, overlay: only where dst is opaque
+void blit(const u32 *src, u32 *dst, size_t count);
+void blitOverlay(const u32 *src, u32 *dst, size_t count);
+
+// Replace the color of pixels that are not fully transparent, with
+// keep_alpha the alpha is multiplied with theirs
+void replaceColor(u32 *dst, size_t count, u32 color, bool keep_alpha);
+
+void multiply(u32 *dst, size_t count, u32 color);
+void screen(u32 *dst, size_t count, u32 color);
+
+// Overlay blend of base with blend, the alpha of base is kept
+void overlay(const u32 *blend, const u32 *base, u32 *dst, size_t count);
+
+void mask(const u32 *mask, u32 *dst, size_t count);
+
+// A table for each channel, for the modifiers where a channel of the
+// result only depends on the same channel of the pixel
+struct ChannelTables
+{
+	u8 a[256], r[256], g[256], b[256];
+};
+
+// skip_transparent: leave pixels with alpha 0 as they are
+void lookup(u32 *dst, size_t count, const ChannelTables &tables, bool skip_transparent);
+
+}
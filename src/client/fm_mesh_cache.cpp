@@ -0,0 +1,259 @@
+/*
+fm_mesh_cache.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_mesh_cache.h"
+#include <sstream>
+#include <type_traits>
+#include "client/filecache.h"
+#include "client/fm_cache_dir_limit.h"
+#include "client/mapblock_mesh.h"
+#include "client/meshgen/collector.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "network/networkprotocol.h"
+#include "nodedef.h"
+#include "settings.h"
+#include "util/hex.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+
+// Bump when the file format or the mesh generator output changes
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_MAGIC 0x464d4d43 // "FMMC"
+
+// Read by MapblockMeshGenerator, MapBlockMesh and the tiles of the node
+// definitions, the options of MeshMakeData are part of the keys
+static const char *const mesh_settings[] = {
+	"texture_path",
+	"enable_water_reflections",
+	"ambient_occlusion_gamma",
+	"enable_mesh_cache",
+	"connected_glass",
+	"translucent_liquids",
+	"leaves_style",
+	"world_aligned_mode",
+	"autoscale_mode",
+	"texture_min_size",
+};
+
+// Nodes are drawn depending on their neighbours, liquids and smooth
+// lighting look up to two nodes away
+#define MESH_CACHE_BORDER 2
+
+static_assert(std::is_trivially_copyable_v<video::S3DVertex>);
+
+static std::string keyToName(u64 key)
+{
+	return hex_encode(reinterpret_cast<const char *>(&key), sizeof(key));
+}
+
+MeshDiskCache::MeshDiskCache(const NodeDefManager *ndef, bool greedy_meshing,
+		const std::string &dir, u64 max_bytes) :
+		m_ndef(ndef), m_greedy_meshing(greedy_meshing)
+{
+	// Tile layers are stored by reference, they point to textures and
+	// shaders of this session
+	for (u32 c = 0; c <= CONTENT_MAX; c++) {
+		const ContentFeatures &f = ndef->get(c);
+		for (u8 special = 0; special < 2; special++)
+		for (u8 tile = 0; tile < 6; tile++)
+		for (u8 layer = 0; layer < MAX_TILE_LAYERS; layer++) {
+			const TileLayer &l = (special ? f.special_tiles : f.tiles)[tile].layers[layer];
+			if (l.texture_id == 0)
+				continue;
+			m_tile_refs.emplace(getLayerId(l.texture_id, l.shader_id),
+					TileRef{(content_t)c, special, tile, layer});
+		}
+	}
+
+	std::ostringstream os(std::ios::binary);
+	ndef->serialize(os, LATEST_PROTOCOL_VERSION);
+	for (const char *name : mesh_settings)
+		os << g_settings->get(name) << '\n';
+	os << MESH_CACHE_VERSION;
+	const std::string identity = os.str();
+	m_identity = murmur_hash_64_ua(identity.data(), identity.size(), MESH_CACHE_MAGIC);
+
+	m_dir = dir + DIR_DELIM + keyToName(m_identity);
+	m_files = std::make_unique<FileCache>(m_dir);
+	m_limit = std::make_unique<CacheDirLimit>(dir, max_bytes);
+}
+
+MeshDiskCache::~MeshDiskCache() = default;
+
+u64 MeshDiskCache::getKey(const MeshMakeData *data) const
+{
+	if (data->lod_step || data->far_step)
+		return 0;
+
+	// The crack is drawn into the mesh
+	const v3s16 &crack = data->m_crack_pos_relative;
+	if (crack.X >= 0 && crack.Y >= 0 && crack.Z >= 0 &&
+			crack.X < data->side_length_data &&
+			crack.Y < data->side_length_data &&
+			crack.Z < data->side_length_data)
+		return 0;
+
+	const v3s16 pmin = data->m_blockpos * MAP_BLOCKSIZE - MESH_CACHE_BORDER;
+	const v3s16 pmax = data->m_blockpos * MAP_BLOCKSIZE +
+			(data->side_length_data + MESH_CACHE_BORDER - 1);
+	const v3s16 size = pmax - pmin + 1;
+
+	std::string buf;
+	buf.reserve(32 + size.X * size.Y * size.Z * 4);
+	auto put = [&buf] (const auto &value) {
+		buf.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	};
+	put(m_identity);
+	put(data->m_blockpos);
+	put(data->side_length_data);
+	put(data->m_smooth_lighting);
+	put(data->m_use_shaders);
+	put(m_greedy_meshing);
+
+	v3s16 p;
+	for (p.Z = pmin.Z; p.Z <= pmax.Z; p.Z++)
+	for (p.Y = pmin.Y; p.Y <= pmax.Y; p.Y++)
+	for (p.X = pmin.X; p.X <= pmax.X; p.X++) {
+		MapNode n = data->m_vmanip.getNodeNoEx(p);
+		// Models come from media files which are not part of the key
+		if (m_ndef->get(n).drawtype == NDT_MESH)
+			return 0;
+		put(n.param0);
+		put(n.param1);
+		put(n.param2);
+	}
+
+	u64 key = murmur_hash_64_ua(buf.data(), buf.size(), MESH_CACHE_MAGIC);
+	return key ? key : 1;
+}
+
+bool MeshDiskCache::load(u64 key, MeshCollector &collector) const
+{
+	std::ostringstream os(std::ios::binary);
+	if (!m_files->load(keyToName(key), os))
+		return false;
+
+	CacheDirLimit::used(m_dir + DIR_DELIM + keyToName(key));
+
+	std::istringstream is(os.str(), std::ios::binary);
+	decltype(collector.prebuffers) prebuffers;
+	f32 bounding_radius_sq;
+	try {
+		if (readU32(is) != MESH_CACHE_MAGIC || readU8(is) != MESH_CACHE_VERSION ||
+				readU64(is) != key)
+			return false;
+		bounding_radius_sq = readF32(is);
+
+		for (auto &buffers : prebuffers) {
+			const u32 count = readU32(is);
+			for (u32 i = 0; i < count; i++) {
+				TileRef ref;
+				ref.content = readU16(is);
+				ref.special = readU8(is);
+				ref.tile = readU8(is);
+				ref.layer = readU8(is);
+				if (ref.tile >= 6 || ref.layer >= MAX_TILE_LAYERS)
+					return false;
+				const ContentFeatures &f = m_ndef->get(ref.content);
+				PreMeshBuffer p((ref.special ? f.special_tiles : f.tiles)
+						[ref.tile].layers[ref.layer]);
+				if (p.layer.texture_id == 0)
+					return false;
+				p.layer.material_type = readU8(is);
+				p.layer.material_flags = readU8(is);
+				p.layer.has_color = readU8(is);
+				p.layer.color = readARGB8(is);
+				p.layer.scale = readU8(is);
+
+				const u32 vertex_count = readU32(is);
+				if (vertex_count > U16_MAX)
+					return false;
+				p.vertices.resize(vertex_count);
+				is.read(reinterpret_cast<char *>(p.vertices.data()),
+						vertex_count * sizeof(video::S3DVertex));
+				const u32 index_count = readU32(is);
+				if (index_count > 3 * U16_MAX)
+					return false;
+				p.indices.resize(index_count);
+				is.read(reinterpret_cast<char *>(p.indices.data()),
+						index_count * sizeof(u16));
+				if (!is.good())
+					return false;
+				buffers.push_back(std::move(p));
+			}
+		}
+	} catch (SerializationError &e) {
+		warningstream << "MeshDiskCache: broken entry " << keyToName(key)
+				<< ": " << e.what() << std::endl;
+		return false;
+	}
+
+	collector.prebuffers = std::move(prebuffers);
+	collector.m_bounding_radius_sq = bounding_radius_sq;
+	return true;
+}
+
+void MeshDiskCache::store(u64 key, const MeshCollector &collector) const
+{
+	std::ostringstream os(std::ios::binary);
+	writeU32(os, MESH_CACHE_MAGIC);
+	writeU8(os, MESH_CACHE_VERSION);
+	writeU64(os, key);
+	writeF32(os, collector.m_bounding_radius_sq);
+
+	for (const auto &buffers : collector.prebuffers) {
+		writeU32(os, buffers.size());
+		for (const PreMeshBuffer &p : buffers) {
+			auto it = m_tile_refs.find(
+					getLayerId(p.layer.texture_id, p.layer.shader_id));
+			// Not a texture of the node definitions, can't be restored
+			if (it == m_tile_refs.end())
+				return;
+			const TileRef &ref = it->second;
+			writeU16(os, ref.content);
+			writeU8(os, ref.special);
+			writeU8(os, ref.tile);
+			writeU8(os, ref.layer);
+			writeU8(os, p.layer.material_type);
+			writeU8(os, p.layer.material_flags);
+			writeU8(os, p.layer.has_color);
+			writeARGB8(os, p.layer.color);
+			writeU8(os, p.layer.scale);
+
+			writeU32(os, p.vertices.size());
+			os.write(reinterpret_cast<const char *>(p.vertices.data()),
+					p.vertices.size() * sizeof(video::S3DVertex));
+			writeU32(os, p.indices.size());
+			os.write(reinterpret_cast<const char *>(p.indices.data()),
+					p.indices.size() * sizeof(u16));
+		}
+	}
+
+	const std::string data = os.str();
+	if (!m_files->update(keyToName(key), data)) {
+		warningstream << "MeshDiskCache: could not store " << keyToName(key)
+				<< std::endl;
+		return;
+	}
+	m_limit->added(data.size());
+}
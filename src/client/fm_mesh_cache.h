@@ -0,0 +1,83 @@
+/*
+fm_mesh_cache.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "irrlichttypes.h"
+#include "mapnode.h"
+
+class NodeDefManager;
+class FileCache;
+class CacheDirLimit;
+struct MeshMakeData;
+struct MeshCollector;
+
+/*
+	Keeps finished mesh data of blocks on disk, so areas seen before don't
+	have to be meshed again when they are received once more.
+
+	Meshes are keyed by the nodes they are made from, including a border
+	around the block, and by the mesh options. Cache files of a different
+	set of node definitions, textures or mesh settings live in another
+	directory below dir. The least recently used files are removed once
+	all of them take more than max_bytes.
+*/
+class MeshDiskCache
+{
+public:
+	// ndef must have its textures and shaders updated already
+	MeshDiskCache(const NodeDefManager *ndef, bool greedy_meshing,
+			const std::string &dir, u64 max_bytes);
+	~MeshDiskCache();
+
+	// Key of the mesh made from data, 0 if it must not be cached
+	u64 getKey(const MeshMakeData *data) const;
+
+	// Fill an empty collector from the cache
+	bool load(u64 key, MeshCollector &collector) const;
+
+	void store(u64 key, const MeshCollector &collector) const;
+
+private:
+	// Where a tile layer can be found in the node definitions
+	struct TileRef {
+		content_t content;
+		u8 special; // 1 for special_tiles
+		u8 tile;
+		u8 layer;
+	};
+
+	static u64 getLayerId(u32 texture_id, u32 shader_id)
+	{
+		return (u64)texture_id << 32 | shader_id;
+	}
+
+	const NodeDefManager *m_ndef;
+	const bool m_greedy_meshing;
+	u64 m_identity;
+	std::string m_dir;
+	std::unique_ptr<FileCache> m_files;
+	std::unique_ptr<CacheDirLimit> m_limit;
+	std::unordered_map<u64, TileRef> m_tile_refs;
+};
@@ -0,0 +1,76 @@
+/*
+fm_particle_store.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "irr_v3d.h"
+
+class Map;
+class MapBlock;
+class NodeDefManager;
+
+/*
+	Motion of particles which neither collide nor jitter, kept as a
+	structure of arrays so all of them are moved by one vectorized loop.
+	Particles are found by index, removing one moves the last one into
+	its place like the owners of the particles do.
+*/
+class ParticleStore
+{
+public:
+	size_t size() const { return m_time.size(); }
+	bool empty() const { return m_time.empty(); }
+
+	void reserve(size_t count);
+	void clear();
+
+	// @return index of the particle
+	size_t add(v3f pos, v3f velocity, v3f acceleration, v3f drag, float expiration);
+	void remove(size_t i);
+
+	// Applies drag, velocity and acceleration like Particle::step
+	void integrate(float dtime);
+
+	// Light of the node each particle is in, like Particle::updateLight,
+	// looking up each map block only once
+	void sampleLight(Map &map, const NodeDefManager *ndef, u32 daynight_ratio);
+
+	v3f getPosition(size_t i) const { return {m_pos_x[i], m_pos_y[i], m_pos_z[i]}; }
+	v3f getVelocity(size_t i) const { return {m_vel_x[i], m_vel_y[i], m_vel_z[i]}; }
+	float getTime(size_t i) const { return m_time[i]; }
+	bool isExpired(size_t i) const { return m_expiration[i] < m_time[i]; }
+	// Valid after sampleLight
+	u8 getLight(size_t i) const { return m_light[i]; }
+
+private:
+	std::vector<float> m_pos_x, m_pos_y, m_pos_z;
+	std::vector<float> m_vel_x, m_vel_y, m_vel_z;
+	std::vector<float> m_acc_x, m_acc_y, m_acc_z;
+	std::vector<float> m_drag_x, m_drag_y, m_drag_z;
+	std::vector<float> m_time, m_expiration;
+	std::vector<u8> m_light;
+
+	// Kept between calls of sampleLight for the allocation only
+	std::unordered_map<v3bpos_t, std::shared_ptr<MapBlock>> m_blocks;
+};
@@ -5,6 +5,8 @@
 #include "imagesource.h"
 
 #include <IFileSystem.h>
+#include "filesys.h"
+#include "fm_image_kernels.h"
 #include "imagefilters.h"
 #include "mesh.h"
 #include "renderingengine.h"
@@ -30,6 +32,8 @@ SourceImageCache::~SourceImageCache() {
 void SourceImageCache::insert(const std::string &name, video::IImage *img, bool prefer_local)
 {
 	assert(img); // Pre-condition
+	assert(!m_shared);
+	std::lock_guard<std::mutex> lock(m_mutex);
 	// Remove old image
 	std::map<std::string, video::IImage*>::iterator n;
 	n = m_images.find(name);
@@ -59,10 +63,16 @@ void SourceImageCache::insert(const std::string &name, video::IImage *img, bool
 	if (need_to_grab)
 		toadd->grab();
 	m_images[name] = toadd;
+
+	const auto dim = toadd->getDimension();
+	u64 hash = murmur_hash_64_ua(toadd->getData(), toadd->getImageDataSizeInBytes(),
+			dim.Width ^ dim.Height << 16 ^ (u32)toadd->getColorFormat() << 28);
+	m_hashes[name] = hash ? hash : 1;
 }
 
 video::IImage* SourceImageCache::get(const std::string &name)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	std::map<std::string, video::IImage*>::iterator n;
 	n = m_images.find(name);
 	if (n != m_images.end())
@@ -73,13 +83,24 @@ video::IImage* SourceImageCache::get(const std::string &name)
 // Primarily fetches from cache, secondarily tries to read from filesystem
 video::IImage* SourceImageCache::getOrLoad(const std::string &name)
 {
+	// Loading under the lock too, the file system is not thread-safe
+	std::lock_guard<std::mutex> lock(m_mutex);
+	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+	const auto for_caller = [&](video::IImage *img) {
+		if (!m_shared) {
+			img->grab(); // Grab for caller
+			return img;
+		}
+		video::IImage *copy = driver->createImage(img->getColorFormat(),
+				img->getDimension());
+		img->copyTo(copy);
+		return copy;
+	};
+
 	std::map<std::string, video::IImage*>::iterator n;
 	n = m_images.find(name);
-	if (n != m_images.end()){
-		n->second->grab(); // Grab for caller
-		return n->second;
-	}
-	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+	if (n != m_images.end())
+		return for_caller(n->second);
 	std::string path = getTexturePath(name);
 	if (path.empty()) {
 		infostream << "SourceImageCache::getOrLoad(): No path found for \""
@@ -92,11 +113,33 @@ video::IImage* SourceImageCache::getOrLoad(const std::string &name)
 
 	if (img){
 		m_images[name] = img;
-		img->grab(); // Grab for caller
+		img = for_caller(img);
 	}
 	return img;
 }
 
+u64 SourceImageCache::getHash(const std::string &name)
+{
+	// Nothing to depend on
+	if (name.empty())
+		return 1;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_hashes.find(name);
+	if (it != m_hashes.end())
+		return it->second;
+
+	// Not received from the server, hash the file without decoding it
+	u64 hash = 0;
+	std::string path = getTexturePath(name), data;
+	if (!path.empty() && fs::ReadFile(path, data)) {
+		hash = murmur_hash_64_ua(data.data(), data.size(), 0);
+		hash = hash ? hash : 1;
+	}
+	m_hashes[name] = hash;
+	return hash;
+}
+
 
 ////////////////////////////
 // Image Helper Functions //
@@ -109,7 +152,7 @@ video::IImage* SourceImageCache::getOrLoad(const std::string &name)
  *
  * \tparam overlay If enabled, only modify pixels in dst which are fully opaque.
  *   Defaults to false.
- * \param src Top image. This image must have the ECF_A8R8G8B8 color format.
+ * \param src Top image
  * \param dst Bottom image.
  *   The top image is drawn onto this base image in-place.
  * \param dst_pos An offset vector to move src before drawing it onto dst
@@ -356,105 +399,78 @@ void blitBaseImage(video::IImage* &src, video::IImage* &dst)
 
 namespace {
 
-/** Calculate the result of the overlay texture modifier (`^`) for a single
- * pixel
+/* The pixels of an image as the ARGB values the image kernels work on
  *
- * This is not alpha blending if both src and dst are semi-transparent. The
- * reason this is that an old implementation did it wrong, and fixing it would
- * break backwards compatibility (see #14847).
- *
- * \tparam overlay If enabled, only modify dst_col if it is fully opaque
- * \param src_col Color of the top pixel
- * \param dst_col Color of the bottom pixel. This color is modified in-place to
- *   store the result.
+ * Images here are ECF_A8R8G8B8 but for rare ones, those are converted into
+ * a copy which is written back when done if the pixels are for writing.
 */
-template <bool overlay>
-void blit_pixel(video::SColor src_col, video::SColor &dst_col)
+class ArgbPixels
 {
-	u8 dst_a = (u8)dst_col.getAlpha();
-	if constexpr (overlay) {
-		if (dst_a != 255)
-			// The bottom pixel has transparency -> do nothing
-			return;
-	}
-	u8 src_a = (u8)src_col.getAlpha();
-	if (src_a == 0) {
-		// A fully transparent pixel is on top -> do nothing
-		return;
-	}
-	if (src_a == 255 || dst_a == 0) {
-		// The top pixel is fully opaque or the bottom pixel is
-		// fully transparent -> replace the color
-		dst_col = src_col;
-		return;
+public:
+	ArgbPixels(video::IImage *image, bool write) : m_image(image), m_write(write)
+	{
+		video::IImage *argb = image;
+		if (image->getColorFormat() != video::ECF_A8R8G8B8) {
+			m_copy = RenderingEngine::get_video_driver()->createImage(
+					video::ECF_A8R8G8B8, image->getDimension());
+			if (!m_copy)
+				throw BaseException("ArgbPixels: failed to convert an image "
+					"to ECF_A8R8G8B8.");
+			image->copyTo(m_copy);
+			argb = m_copy;
+		}
+		m_data = reinterpret_cast<u32 *>(argb->getData());
+		m_width = argb->getDimension().Width;
 	}
-	struct Color { u8 r, g, b; };
-	Color src{(u8)src_col.getRed(), (u8)src_col.getGreen(),
-		(u8)src_col.getBlue()};
-	Color dst{(u8)dst_col.getRed(), (u8)dst_col.getGreen(),
-		(u8)dst_col.getBlue()};
-	if (dst_a == 255) {
-		// A semi-transparent pixel is on top and an opaque one in
-		// the bottom -> lerp r, g, and b
-		dst.r = (dst.r * (255 - src_a) + src.r * src_a) / 255;
-		dst.g = (dst.g * (255 - src_a) + src.g * src_a) / 255;
-		dst.b = (dst.b * (255 - src_a) + src.b * src_a) / 255;
-		dst_col.set(255, dst.r, dst.g, dst.b);
-		return;
+
+	~ArgbPixels()
+	{
+		if (!m_copy)
+			return;
+		if (m_write)
+			m_copy->copyTo(m_image);
+		m_copy->drop();
 	}
-	// A semi-transparent pixel is on top of a
-	// semi-transparent pixel -> weird overlaying
-	dst.r = (dst.r * (255 - src_a) + src.r * src_a) / 255;
-	dst.g = (dst.g * (255 - src_a) + src.g * src_a) / 255;
-	dst.b = (dst.b * (255 - src_a) + src.b * src_a) / 255;
-	dst_a = dst_a + (255 - dst_a) * src_a * src_a / (255 * 255);
-	dst_col.set(dst_a, dst.r, dst.g, dst.b);
-}
+
+	DISABLE_CLASS_COPY(ArgbPixels)
+
+	u32 *row(u32 x, u32 y) { return m_data + (size_t)y * m_width + x; }
+
+private:
+	video::IImage *m_image;
+	video::IImage *m_copy = nullptr;
+	bool m_write;
+	u32 *m_data;
+	u32 m_width;
+};
 
 }  // namespace
+
 template<bool overlay>
 void blit_with_alpha(video::IImage *src, video::IImage *dst, v2s32 dst_pos,
 	v2u32 size)
 {
-	if (dst->getColorFormat() != video::ECF_A8R8G8B8)
-		throw BaseException("blit_with_alpha() supports only ECF_A8R8G8B8 "
-			"destination images.");
-
 	core::dimension2d<u32> src_dim = src->getDimension();
 	core::dimension2d<u32> dst_dim = dst->getDimension();
-	bool drop_src = false;
-	if (src->getColorFormat() != video::ECF_A8R8G8B8) {
-		video::IVideoDriver *driver = RenderingEngine::get_video_driver();
-		video::IImage *src_converted = driver->createImage(video::ECF_A8R8G8B8,
-			src_dim);
-		if (!src_converted)
-			throw BaseException("blit_with_alpha() failed to convert the "
-				"source image to ECF_A8R8G8B8.");
-		src->copyTo(src_converted);
-		src = src_converted;
-		drop_src = true;
-	}
-	video::SColor *pixels_src =
-		reinterpret_cast<video::SColor *>(src->getData());
-	video::SColor *pixels_dst =
-		reinterpret_cast<video::SColor *>(dst->getData());
 	// Limit y and x to the overlapping ranges
 	// s.t. the positions are all in bounds after offsetting.
-	u32 x_start = (u32)std::max(0, -dst_pos.X);
-	u32 y_start = (u32)std::max(0, -dst_pos.Y);
-	u32 x_end = (u32)std::min<s64>({size.X, src_dim.Width,
+	s64 x_start = std::max(0, -dst_pos.X);
+	s64 y_start = std::max(0, -dst_pos.Y);
+	s64 x_end = std::min<s64>({size.X, src_dim.Width,
 		dst_dim.Width - (s64)dst_pos.X});
-	u32 y_end = (u32)std::min<s64>({size.Y, src_dim.Height,
+	s64 y_end = std::min<s64>({size.Y, src_dim.Height,
 		dst_dim.Height - (s64)dst_pos.Y});
-	for (u32 y0 = y_start; y0 < y_end; ++y0) {
-		size_t i_src = y0 * src_dim.Width + x_start;
-		size_t i_dst = (dst_pos.Y + y0) * dst_dim.Width + dst_pos.X + x_start;
-		for (u32 x0 = x_start; x0 < x_end; ++x0) {
-			blit_pixel<overlay>(pixels_src[i_src++], pixels_dst[i_dst++]);
-		}
+	if (x_end <= x_start || y_end <= y_start)
+		return;
+
+	ArgbPixels pixels_src(src, false);
+	ArgbPixels pixels_dst(dst, true);
+	auto blit = overlay ? image_kernels::blitOverlay : image_kernels::blit;
+	for (s64 y0 = y_start; y0 < y_end; ++y0) {
+		blit(pixels_src.row(x_start, y0),
+			pixels_dst.row(dst_pos.X + x_start, dst_pos.Y + y0),
+			x_end - x_start);
 	}
-	if (drop_src)
-		src->drop();
 }
 
 /*
@@ -464,34 +480,26 @@ static void apply_colorize(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 		const video::SColor color, int ratio, bool keep_alpha)
 {
 	u32 alpha = color.getAlpha();
-	video::SColor dst_c;
+	ArgbPixels pixels(dst, true);
 	if ((ratio == -1 && alpha == 255) || ratio == 255) { // full replacement of color
-		if (keep_alpha) { // replace the color with alpha = dest alpha * color alpha
-			dst_c = color;
-			for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-			for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++) {
-				u32 dst_alpha = dst->getPixel(x, y).getAlpha();
-				if (dst_alpha > 0) {
-					dst_c.setAlpha(dst_alpha * alpha / 255);
-					dst->setPixel(x, y, dst_c);
-				}
-			}
-		} else { // replace the color including the alpha
-			for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-			for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++)
-				if (dst->getPixel(x, y).getAlpha() > 0)
-					dst->setPixel(x, y, color);
-		}
+		// with keep_alpha, replace the color with alpha = dest alpha * color alpha
+		// else replace the color including the alpha
+		for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
+			image_kernels::replaceColor(pixels.row(dst_pos.X, y), size.X,
+					color.color, keep_alpha);
 	} else {  // interpolate between the color and destination
 		float interp = (ratio == -1 ? color.getAlpha() / 255.0f : ratio / 255.0f);
-		for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-		for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++) {
-			dst_c = dst->getPixel(x, y);
-			if (dst_c.getAlpha() > 0) {
-				dst_c = color.getInterpolated(dst_c, interp);
-				dst->setPixel(x, y, dst_c);
-			}
+		// Each channel of the result only depends on the same one of dst
+		image_kernels::ChannelTables tables;
+		for (u32 v = 0; v < 256; v++) {
+			video::SColor c = color.getInterpolated(video::SColor(v, v, v, v), interp);
+			tables.a[v] = c.getAlpha();
+			tables.r[v] = c.getRed();
+			tables.g[v] = c.getGreen();
+			tables.b[v] = c.getBlue();
 		}
+		for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
+			image_kernels::lookup(pixels.row(dst_pos.X, y), size.X, tables, true);
 	}
 }
 
@@ -501,19 +509,9 @@ static void apply_colorize(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 static void apply_multiplication(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 		const video::SColor color)
 {
-	video::SColor dst_c;
-
+	ArgbPixels pixels(dst, true);
 	for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-	for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++) {
-		dst_c = dst->getPixel(x, y);
-		dst_c.set(
-				dst_c.getAlpha(),
-				(dst_c.getRed() * color.getRed()) / 255,
-				(dst_c.getGreen() * color.getGreen()) / 255,
-				(dst_c.getBlue() * color.getBlue()) / 255
-				);
-		dst->setPixel(x, y, dst_c);
-	}
+		image_kernels::multiply(pixels.row(dst_pos.X, y), size.X, color.color);
 }
 
 /*
@@ -522,19 +520,9 @@ static void apply_multiplication(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 static void apply_screen(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 		const video::SColor color)
 {
-	video::SColor dst_c;
-
+	ArgbPixels pixels(dst, true);
 	for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-	for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++) {
-		dst_c = dst->getPixel(x, y);
-		dst_c.set(
-			dst_c.getAlpha(),
-			255 - ((255 - dst_c.getRed())   * (255 - color.getRed()))   / 255,
-			255 - ((255 - dst_c.getGreen()) * (255 - color.getGreen())) / 255,
-			255 - ((255 - dst_c.getBlue())  * (255 - color.getBlue()))  / 255
-		);
-		dst->setPixel(x, y, dst_c);
-	}
+		image_kernels::screen(pixels.row(dst_pos.X, y), size.X, color.color);
 }
 
 /*
@@ -562,11 +550,22 @@ static void apply_hue_saturation(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 		hsl.Saturation = core::clamp((f32)saturation, 0.0f, 100.0f);
 	}
 
-	for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-		for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++) {
+	// Textures repeat colors a lot, the result of the last one is kept
+	ArgbPixels pixels(dst, true);
+	bool have_last = false;
+	u32 last_in = 0, last_out = 0;
+
+	for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++) {
+		u32 *row = pixels.row(dst_pos.X, y);
+		for (u32 x = 0; x < size.X; x++) {
+			const video::SColor dst_c(row[x]);
+			if (have_last && dst_c.color == last_in) {
+				row[x] = last_out;
+				continue;
+			}
 
 			if (colorize) {
-				f32 lum = dst->getPixel(x, y).getLuminance() / 255.0f;
+				f32 lum = dst_c.getLuminance() / 255.0f;
 
 				if (norm_l < 0) {
 					lum *= norm_l + 1.0f;
@@ -578,7 +577,7 @@ static void apply_hue_saturation(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 
 			} else {
 				// convert the RGB to HSL
-				colorf = video::SColorf(dst->getPixel(x, y));
+				colorf = video::SColorf(dst_c);
 				hsl.fromRGB(colorf);
 
 				if (norm_l < 0) {
@@ -608,8 +607,13 @@ static void apply_hue_saturation(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 
 			// Convert back to RGB
 			hsl.toRGB(colorf);
-			dst->setPixel(x, y, colorf.toSColor());
+			row[x] = colorf.toSColor().color;
+
+			have_last = true;
+			last_in = dst_c.color;
+			last_out = row[x];
 		}
+	}
 }
 
 
@@ -620,47 +624,32 @@ static void apply_hue_saturation(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 static void apply_overlay(video::IImage *blend, video::IImage *dst,
 	v2s32 blend_pos, v2s32 dst_pos, v2u32 size, bool hardlight)
 {
-	video::IImage *blend_layer = hardlight ? dst : blend;
-	video::IImage *base_layer  = hardlight ? blend : dst;
+	ArgbPixels dst_pixels(dst, true);
+	ArgbPixels blend_pixels(blend, false);
+	ArgbPixels &blend_layer = hardlight ? dst_pixels : blend_pixels;
+	ArgbPixels &base_layer  = hardlight ? blend_pixels : dst_pixels;
 	v2s32 blend_layer_pos = hardlight ? dst_pos : blend_pos;
 	v2s32 base_layer_pos  = hardlight ? blend_pos : dst_pos;
 
-	for (u32 y = 0; y < size.Y; y++)
-	for (u32 x = 0; x < size.X; x++) {
-		s32 base_x = x + base_layer_pos.X;
-		s32 base_y = y + base_layer_pos.Y;
-
-		video::SColor blend_c =
-			blend_layer->getPixel(x + blend_layer_pos.X, y + blend_layer_pos.Y);
-		video::SColor base_c = base_layer->getPixel(base_x, base_y);
-		double blend_r = blend_c.getRed()   / 255.0;
-		double blend_g = blend_c.getGreen() / 255.0;
-		double blend_b = blend_c.getBlue()  / 255.0;
-		double base_r = base_c.getRed()   / 255.0;
-		double base_g = base_c.getGreen() / 255.0;
-		double base_b = base_c.getBlue()  / 255.0;
-
-		base_c.set(
-			base_c.getAlpha(),
-			// Do a Multiply blend if less that 0.5, otherwise do a Screen blend
-			(u32)((base_r < 0.5 ? 2 * base_r * blend_r : 1 - 2 * (1 - base_r) * (1 - blend_r)) * 255),
-			(u32)((base_g < 0.5 ? 2 * base_g * blend_g : 1 - 2 * (1 - base_g) * (1 - blend_g)) * 255),
-			(u32)((base_b < 0.5 ? 2 * base_b * blend_b : 1 - 2 * (1 - base_b) * (1 - blend_b)) * 255)
-		);
-		dst->setPixel(base_x, base_y, base_c);
+	// Do a Multiply blend where the base is darker than 0.5, otherwise do
+	// a Screen blend
+	for (u32 y = 0; y < size.Y; y++) {
+		image_kernels::overlay(
+			blend_layer.row(blend_layer_pos.X, blend_layer_pos.Y + y),
+			base_layer.row(base_layer_pos.X, base_layer_pos.Y + y),
+			dst_pixels.row(base_layer_pos.X, base_layer_pos.Y + y), size.X);
 	}
 }
 
 /*
 	Adjust the brightness and contrast of the base image.
 
-	Conceptually like GIMP's "Brightness-Contrast" feature but allows brightness to be
-	wound all the way up to white or down to black.
+	Conceptually like GIMP's "Brightness-Contrast" feature but allows brightness to
+	be wound all the way up to white or down to black.
 */
 static void apply_brightness_contrast(video::IImage *dst, v2u32 dst_pos, v2u32 size,
 	s32 brightness, s32 contrast)
 {
-	video::SColor dst_c;
 	// Only allow normalized contrast to get as high as 127/128 to avoid infinite slope.
 	// (we could technically allow -128/128 here as that would just result in 0 slope)
 	double norm_c = core::clamp(contrast,   -127, 127) / 128.0;
@@ -692,18 +681,16 @@ static void apply_brightness_contrast(video::IImage *dst, v2u32 dst_pos, v2u32 s
 	// rounded rather than trunc'd.
 	c += 0.5;
 
-	for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
-	for (u32 x = dst_pos.X; x < dst_pos.X + size.X; x++) {
-		dst_c = dst->getPixel(x, y);
-
-		dst_c.set(
-			dst_c.getAlpha(),
-			core::clamp((int)(slope * dst_c.getRed()   + c), 0, 255),
-			core::clamp((int)(slope * dst_c.getGreen() + c), 0, 255),
-			core::clamp((int)(slope * dst_c.getBlue()  + c), 0, 255)
-		);
-		dst->setPixel(x, y, dst_c);
+	image_kernels::ChannelTables tables;
+	for (u32 v = 0; v < 256; v++) {
+		tables.a[v] = v;
+		tables.r[v] = tables.g[v] = tables.b[v] =
+			core::clamp((int)(slope * v + c), 0, 255);
 	}
+
+	ArgbPixels pixels(dst, true);
+	for (u32 y = dst_pos.Y; y < dst_pos.Y + size.Y; y++)
+		image_kernels::lookup(pixels.row(dst_pos.X, y), size.X, tables, false);
 }
 
 /*
@@ -712,17 +699,11 @@ static void apply_brightness_contrast(video::IImage *dst, v2u32 dst_pos, v2u32 s
 static void apply_mask(video::IImage *mask, video::IImage *dst,
 		v2s32 mask_pos, v2s32 dst_pos, v2u32 size)
 {
+	ArgbPixels pixels_mask(mask, false);
+	ArgbPixels pixels_dst(dst, true);
 	for (u32 y0 = 0; y0 < size.Y; y0++) {
-		for (u32 x0 = 0; x0 < size.X; x0++) {
-			s32 mask_x = x0 + mask_pos.X;
-			s32 mask_y = y0 + mask_pos.Y;
-			s32 dst_x = x0 + dst_pos.X;
-			s32 dst_y = y0 + dst_pos.Y;
-			video::SColor mask_c = mask->getPixel(mask_x, mask_y);
-			video::SColor dst_c = dst->getPixel(dst_x, dst_y);
-			dst_c.color &= mask_c.color;
-			dst->setPixel(dst_x, dst_y, dst_c);
-		}
+		image_kernels::mask(pixels_mask.row(mask_pos.X, mask_pos.Y + y0),
+			pixels_dst.row(dst_pos.X, dst_pos.Y + y0), size.X);
 	}
 }
 
@@ -1099,6 +1080,7 @@ bool ImageSource::generateImagePart(std::string_view part_of_name,
 					It is an image with a number of cracking stages
 					horizontally tiled.
 				*/
+				source_image_names.insert("crack_anylength.png");
 				video::IImage *img_crack = m_sourcecache.getOrLoad(
 					"crack_anylength.png");
 
@@ -6,8 +6,10 @@
 
 #include <IImage.h>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include "irrlichttypes.h"
 
 using namespace irr;
 
@@ -27,8 +29,20 @@ class SourceImageCache {
 
 	// Primarily fetches from cache, secondarily tries to read from filesystem.
 	video::IImage *getOrLoad(const std::string &name);
+
+	// Identifies the current content of a source image, 0 if there is none.
+	// Can be called from several threads at once.
+	u64 getHash(const std::string &name);
+
+	// While shared, getOrLoad may be called from several threads at once
+	// and returns copies, as reference counts are not thread-safe.
+	// insert must not be called then.
+	void setShared(bool shared) { m_shared = shared; }
 private:
 	std::map<std::string, video::IImage*> m_images;
+	std::map<std::string, u64> m_hashes;
+	std::mutex m_mutex;
+	bool m_shared = false;
 };
 
 // Generates images using texture modifiers, and caches source images.
@@ -45,6 +59,12 @@ struct ImageSource {
 	// Insert a source image into the cache without touching the filesystem.
 	void insertSourceImage(const std::string &name, video::IImage *img, bool prefer_local);
 
+	// See SourceImageCache::getHash
+	u64 getSourceImageHash(const std::string &name) { return m_sourcecache.getHash(name); }
+
+	// While on, generateImage may be called from several threads at once
+	void setConcurrent(bool concurrent) { m_sourcecache.setShared(concurrent); }
+
 	// TODO should probably be moved elsewhere
 	static video::SColor getImageAverageColor(const video::IImage &image);
 
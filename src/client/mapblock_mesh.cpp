@@ -16,6 +16,7 @@
 #include "util/directiontables.h"
 #include "util/tracy_wrapper.h"
 #include "client/meshgen/collector.h"
+#include "client/fm_mesh_cache.h"
 #include "client/renderingengine.h"
 #include <array>
 #include <algorithm>
@@ -661,9 +662,13 @@ MapBlockMesh::MapBlockMesh(Client *client, MeshMakeData *data, v3s16 camera_offs
 		- whatever
 	*/
 
-	{
+	MeshDiskCache *disk_cache = client->getMeshDiskCache();
+	const u64 cache_key = disk_cache ? disk_cache->getKey(data) : 0;
+	if (!cache_key || !disk_cache->load(cache_key, collector)) {
 		MapblockMeshGenerator(data, &collector,
 			client->getSceneManager()->getMeshManipulator()).generate();
+		if (cache_key)
+			disk_cache->store(cache_key, collector);
 	}
 
 	/*
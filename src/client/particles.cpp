@@ -128,6 +128,30 @@ void Particle::step(float dtime, ClientEnvironment *env)
 		m_velocity += m_acceleration * dtime;
 	}
 
+	stepAppearance(dtime, env, getLight(env));
+}
+
+bool Particle::hasSimpleMotion() const
+{
+	return !m_p.collisiondetection &&
+			m_p.jitter.min.val == v3f() && m_p.jitter.max.val == v3f();
+}
+
+void Particle::addToStore(ParticleStore &store) const
+{
+	store.add(m_pos, m_velocity, m_acceleration, m_p.drag, m_expiration);
+}
+
+void Particle::stepMoved(float dtime, ClientEnvironment *env, v3f pos, float time,
+		u8 light)
+{
+	m_pos = pos;
+	m_time = time;
+	stepAppearance(dtime, env, light);
+}
+
+void Particle::stepAppearance(float dtime, ClientEnvironment *env, u8 light)
+{
 	if (m_p.animation.type != TAT_NONE) {
 		m_animation_time += dtime;
 		int frame_length_i = 0;
@@ -147,17 +171,15 @@ void Particle::step(float dtime, ClientEnvironment *env)
 		alpha = m_texture.tex -> alpha.blend(m_time / (m_expiration+0.1f));
 
 	// Update lighting
-	auto col = updateLight(env);
+	auto col = getLightColor(light);
 	col.setAlpha(255 * alpha);
 
 	// Update model
 	updateVertices(env, col);
 }
 
-video::SColor Particle::updateLight(ClientEnvironment *env)
+u8 Particle::getLight(ClientEnvironment *env) const
 {
-	u8 light = 0;
-
 	v3s16 p = v3s16(
 		floor(m_pos.X+0.5),
 		floor(m_pos.Y+0.5),
@@ -165,11 +187,13 @@ video::SColor Particle::updateLight(ClientEnvironment *env)
 	);
 	MapNode n = env->getClientMap().getNodeTry(p);
 	if (n.getContent() != CONTENT_IGNORE)
-		light = n.getLightBlend(env->getDayNightRatio(),
+		return n.getLightBlend(env->getDayNightRatio(),
 				env->getGameDef()->ndef()->getLightingFlags(n));
-	else
-		light = blend_light(env->getDayNightRatio(), LIGHT_SUN, 0);
+	return blend_light(env->getDayNightRatio(), LIGHT_SUN, 0);
+}
 
+video::SColor Particle::getLightColor(u8 light) const
+{
 	u8 m_light = decode_light(light + m_p.glow);
 	return video::SColor(255,
 		m_light * m_base_color.getRed() / 255,
@@ -689,6 +713,15 @@ void ParticleManager::stepSpawners(float dtime)
 	}
 }
 
+static void releaseParticle(Particle &p)
+{
+	ParticleSpawner *parent = p.getParent();
+	if (parent) {
+		assert(parent->hasActive());
+		parent->decrActive();
+	}
+}
+
 void ParticleManager::stepParticles(float dtime)
 {
 	MutexAutoLock lock(m_particle_list_lock);
@@ -696,11 +729,7 @@ void ParticleManager::stepParticles(float dtime)
 	for (size_t i = 0; i < m_particles.size();) {
 		Particle &p = *m_particles[i];
 		if (p.isExpired()) {
-			ParticleSpawner *parent = p.getParent();
-			if (parent) {
-				assert(parent->hasActive());
-				parent->decrActive();
-			}
+			releaseParticle(p);
 			// delete
 			m_particles[i] = std::move(m_particles.back());
 			m_particles.pop_back();
@@ -709,6 +738,28 @@ void ParticleManager::stepParticles(float dtime)
 			++i;
 		}
 	}
+
+	for (size_t i = 0; i < m_simple_particles.size();) {
+		if (m_simple_motion.isExpired(i)) {
+			releaseParticle(*m_simple_particles[i]);
+			m_simple_particles[i] = std::move(m_simple_particles.back());
+			m_simple_particles.pop_back();
+			m_simple_motion.remove(i);
+		} else {
+			++i;
+		}
+	}
+	if (m_simple_particles.empty())
+		return;
+
+	m_simple_motion.integrate(dtime);
+	m_simple_motion.sampleLight(m_env->getClientMap(), m_env->getGameDef()->ndef(),
+			m_env->getDayNightRatio());
+	for (size_t i = 0; i < m_simple_particles.size(); ++i) {
+		m_simple_particles[i]->stepMoved(dtime, m_env, m_simple_motion.getPosition(i),
+				m_simple_motion.getTime(i), m_simple_motion.getLight(i));
+	}
+	g_profiler->avg("ParticleManager: simple particles [#]", m_simple_particles.size());
 }
 
 void ParticleManager::stepBuffers(float dtime)
@@ -753,6 +804,8 @@ void ParticleManager::clearAll()
 	MutexAutoLock lock2(m_particle_list_lock);
 
 	m_particles.clear();
+	m_simple_particles.clear();
+	m_simple_motion.clear();
 }
 
 	// have to remove from scene first because it keeps a reference
@@ -942,6 +995,8 @@ void ParticleManager::reserveParticleSpace(size_t max_estimate)
 	MutexAutoLock lock(m_particle_list_lock);
 
 	m_particles.reserve(m_particles.size() + max_estimate);
+	m_simple_particles.reserve(m_simple_particles.size() + max_estimate);
+	m_simple_motion.reserve(m_simple_particles.size() + max_estimate);
 }
 
 video::SMaterial ParticleManager::getMaterialForParticle(const ClientParticleTexRef &texture)
@@ -1010,10 +1065,13 @@ bool ParticleManager::addParticle(std::unique_ptr<Particle> toadd)
 
 	auto material = getMaterialForParticle(toadd->getTextureRef());
 
+	const bool simple = toadd->hasSimpleMotion();
+	auto &particles = simple ? m_simple_particles : m_particles;
+
 	ParticleBuffer *found = nullptr;
 	// simple shortcut when multiple particles of the same type get added
-	if (!m_particles.empty()) {
-		auto &last = m_particles.back();
+	if (!particles.empty()) {
+		auto &last = particles.back();
 		if (last->getBuffer() && last->getBuffer()->getMaterial(0) == material)
 			found = last->getBuffer();
 	}
@@ -1037,7 +1095,9 @@ bool ParticleManager::addParticle(std::unique_ptr<Particle> toadd)
 		infostream << "ParticleManager: buffer full, dropping particle" << std::endl;
 		return false;
 	}
-	m_particles.push_back(std::move(toadd));
+	if (simple)
+		toadd->addToStore(m_simple_motion);
+	particles.push_back(std::move(toadd));
 	return true;
 }
 
@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include "irrlichttypes_extrabloated.h"
 #include "irr_ptr.h"
+#include "fm_particle_store.h"
 #include "../particles.h"
 
 struct ClientEvent;
@@ -70,6 +71,14 @@ class Particle
 
 	void step(float dtime, ClientEnvironment *env);
 
+	// Particles which neither collide nor jitter can be moved by a
+	// ParticleStore, see stepMoved
+	bool hasSimpleMotion() const;
+	void addToStore(ParticleStore &store) const;
+
+	// The rest of step after the store moved the particle
+	void stepMoved(float dtime, ClientEnvironment *env, v3f pos, float time, u8 light);
+
 	bool isExpired () const
 	{ return m_expiration < m_time; }
 
@@ -81,7 +90,9 @@ class Particle
 	bool attachToBuffer(ParticleBuffer *buffer);
 
 private:
-	video::SColor updateLight(ClientEnvironment *env);
+	void stepAppearance(float dtime, ClientEnvironment *env, u8 light);
+	u8 getLight(ClientEnvironment *env) const;
+	video::SColor getLightColor(u8 light) const;
 	void updateVertices(ClientEnvironment *env, video::SColor color);
 
 	ParticleBuffer *m_buffer = nullptr;
@@ -246,6 +257,9 @@ class ParticleManager
 	void clearAll();
 
 	std::vector<std::unique_ptr<Particle>> m_particles;
+	// Particles with simple motion, their motion has the same index
+	std::vector<std::unique_ptr<Particle>> m_simple_particles;
+	ParticleStore m_simple_motion;
 	std::unordered_map<u64, std::unique_ptr<ParticleSpawner>> m_particle_spawners;
 	std::vector<std::unique_ptr<ParticleSpawner>> m_dying_particle_spawners;
 	std::vector<irr_ptr<ParticleBuffer>> m_particle_buffers;
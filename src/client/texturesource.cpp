@@ -5,12 +5,19 @@
 #include "texturesource.h"
 
 #include <IVideoDriver.h>
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include "filesys.h"
+#include "fm_image_cache.h"
 #include "guiscalingfilter.h"
 #include "imagefilters.h"
 #include "imagesource.h"
+#include "porting.h"
 #include "renderingengine.h"
 #include "settings.h"
 #include "texturepaths.h"
+#include "threading/task_scheduler.h"
 #include "util/thread.h"
 
 
@@ -100,6 +107,8 @@ class TextureSource final : public IWritableTextureSource
 	*/
 	video::ITexture* getTextureForMesh(const std::string &name, u32 *id);
 
+	void prepareTexturesForMesh(const std::vector<std::string> &names);
+
 	virtual Palette* getPalette(const std::string &name);
 
 	bool isKnownSourceImage(const std::string &name)
@@ -138,6 +147,14 @@ class TextureSource final : public IWritableTextureSource
 	// This should be only accessed from the main thread
 	ImageSource m_imagesource;
 
+	// Generated images of previous sessions, may be null
+	std::unique_ptr<ImageDiskCache> m_image_disk_cache;
+
+	// Like ImageSource::generateImage, but goes through the disk cache.
+	// Can be called from several threads while the image source is concurrent.
+	video::IImage *generateImage(const std::string &name,
+			std::set<std::string> &source_image_names);
+
 	// Rebuild images and textures from the current set of source images
 	// Shall be called from the main thread.
 	// You ARE expected to be holding m_textureinfo_cache_mutex
@@ -146,6 +163,10 @@ class TextureSource final : public IWritableTextureSource
 	// Generate a texture
 	u32 generateTexture(const std::string &name);
 
+	// Add a generated image to the caches as a texture, drops img
+	u32 addTexture(const std::string &name, video::IImage *img,
+			std::set<std::string> &&source_image_names);
+
 	// Thread-safe cache of what source images are known (true = known)
 	MutexedMap<std::string, bool> m_source_image_existence;
 
@@ -192,6 +213,12 @@ TextureSource::TextureSource()
 			g_settings->getBool("trilinear_filter") ||
 			g_settings->getBool("bilinear_filter") ||
 			g_settings->getBool("anisotropic_filter");
+
+	if (g_settings->getBool("texture_disk_cache"))
+		m_image_disk_cache = std::make_unique<ImageDiskCache>(m_imagesource,
+				RenderingEngine::get_video_driver(),
+				porting::path_cache + DIR_DELIM + "textures",
+				(u64)g_settings->getU32("texture_disk_cache_size") << 20);
 }
 
 TextureSource::~TextureSource()
@@ -282,12 +309,32 @@ u32 TextureSource::generateTexture(const std::string &name)
 		return 0;
 	}
 
-	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
-	sanity_check(driver);
-
 	// passed into texture info for dynamic media tracking
 	std::set<std::string> source_image_names;
+	video::IImage *img = generateImage(name, source_image_names);
+
+	return addTexture(name, img, std::move(source_image_names));
+}
+
+video::IImage *TextureSource::generateImage(const std::string &name,
+		std::set<std::string> &source_image_names)
+{
+	if (!m_image_disk_cache || !ImageDiskCache::isWorthCaching(name))
+		return m_imagesource.generateImage(name, source_image_names);
+
+	if (video::IImage *img = m_image_disk_cache->load(name, source_image_names))
+		return img;
 	video::IImage *img = m_imagesource.generateImage(name, source_image_names);
+	if (img)
+		m_image_disk_cache->store(name, img, source_image_names);
+	return img;
+}
+
+u32 TextureSource::addTexture(const std::string &name, video::IImage *img,
+		std::set<std::string> &&source_image_names)
+{
+	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+	sanity_check(driver);
 
 	video::ITexture *tex = nullptr;
 
@@ -352,6 +399,66 @@ video::ITexture* TextureSource::getTextureForMesh(const std::string &name, u32 *
 	return getTexture(name, id);
 }
 
+void TextureSource::prepareTexturesForMesh(const std::vector<std::string> &names)
+{
+	sanity_check(std::this_thread::get_id() == m_main_thread);
+
+	std::vector<std::string> todo;
+	{
+		MutexAutoLock lock(m_textureinfo_cache_mutex);
+		std::unordered_set<std::string> seen;
+		for (const std::string &name : names) {
+			if (name.empty())
+				continue;
+			std::string full_name = mesh_filter_needed ?
+					name + "^[applyfiltersformesh" : name;
+			if (m_name_to_id.count(full_name) || !seen.insert(full_name).second)
+				continue;
+			todo.emplace_back(std::move(full_name));
+		}
+	}
+	if (todo.size() < 2)
+		return;
+
+	struct Generated
+	{
+		video::IImage *img = nullptr;
+		std::set<std::string> source_image_names;
+		bool failed = false;
+	};
+	std::vector<Generated> generated(todo.size());
+	std::atomic_size_t next{0};
+	const auto generate = [&] {
+		for (size_t i; (i = next++) < todo.size();) {
+			try {
+				generated[i].img = generateImage(todo[i],
+						generated[i].source_image_names);
+			} catch (std::exception &) {
+				// Left for generateTexture to fail the usual way
+				generated[i].failed = true;
+			}
+		}
+	};
+
+	const u64 start_ms = porting::getTimeMs();
+	TaskScheduler &scheduler = TaskScheduler::get();
+	m_imagesource.setConcurrent(true);
+	const size_t helper_count = std::min(scheduler.getThreadCount(), todo.size() - 1);
+	scheduler.runWithHelpers("texture generation", TaskPriority::High, helper_count,
+			generate, generate);
+	m_imagesource.setConcurrent(false);
+
+	// Textures are made on the main thread only
+	for (size_t i = 0; i < todo.size(); ++i) {
+		if (!generated[i].failed)
+			addTexture(todo[i], generated[i].img,
+					std::move(generated[i].source_image_names));
+	}
+	infostream << "TextureSource: generated " << todo.size() << " textures with "
+			<< helper_count << " helper threads in "
+			<< porting::getTimeMs() - start_ms << "ms" << std::endl;
+}
+
 Palette* TextureSource::getPalette(const std::string &name)
 {
 	// Only the main thread may load images
@@ -475,7 +582,7 @@ void TextureSource::rebuildTexture(video::IVideoDriver *driver, TextureInfo &ti)
 	// Replaces the previous sourceImages.
 	// Shouldn't really need to be done, but can't hurt.
 	std::set<std::string> source_image_names;
-	video::IImage *img = m_imagesource.generateImage(ti.name, source_image_names);
+	video::IImage *img = generateImage(ti.name, source_image_names);
 	img = Align2Npot2(img, driver);
 	// Create texture from resulting image
 	video::ITexture *t = nullptr;
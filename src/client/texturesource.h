@@ -46,6 +46,12 @@ class ITextureSource : public ISimpleTextureSource
 			const std::string &name, u32 *id = nullptr)=0;
 	virtual video::ITexture* getTextureForMesh(
 			const std::string &name, u32 *id = nullptr) = 0;
+	/*!
+	 * Generates the textures getTextureForMesh would for the names which
+	 * are not cached yet, several at once on the task workers.
+	 * Should be called from the main thread.
+	 */
+	virtual void prepareTexturesForMesh(const std::vector<std::string> &names) = 0;
 	/*!
 	 * Returns a palette from the given texture name.
 	 * The pointer is valid until the texture source is
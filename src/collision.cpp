@@ -8,6 +8,7 @@
 #include "map.h"
 #include "nodedef.h"
 #include "gamedef.h"
+#include "itemgroup.h"
 #if CHECK_CLIENT_BUILD()
 #include "client/clientenvironment.h"
 #include "client/localplayer.h"
@@ -212,44 +213,87 @@ static bool add_area_node_boxes(const v3s16 min, const v3s16 max, IGameDef *game
 
 	thread_local std::vector<aabb3f> nodeboxes;
 	Map *map = &env->getMap();
+	CollisionBoxCache &cache = map->collision_box_cache;
+	const bool use_cache = cache.isEnabled();
+
+	// Blocks of the area, looked up once per move
+	thread_local std::vector<std::pair<v3bpos_t,
+			std::shared_ptr<const CollisionBlock>>> cblocks;
+	cblocks.clear();
+	const auto get_cblock = [&](v3bpos_t bp) {
+		for (const auto &it : cblocks)
+			if (it.first == bp)
+				return it.second.get();
+		return cblocks.emplace_back(bp, cache.getBlock(map, nodedef, bp))
+				.second.get();
+	};
 
-	v3s16 p;
-	for (p.Z = min.Z; p.Z <= max.Z; p.Z++)
-	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
-	for (p.X = min.X; p.X <= max.X; p.X++) {
-		bool is_position_valid;
-		MapNode n = map->getNode(p, &is_position_valid);
+	// Boxes of nodes read from the map, walkable or not
+	const auto add_node = [&](v3s16 p, MapNode n) {
+		const ContentFeatures &f = nodedef->get(n);
 
-		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
-			// Object collides into walkable nodes
+		if (!f.walkable)
+			return;
 
-			any_position_valid = true;
-			const ContentFeatures &f = nodedef->get(n);
+		// Negative bouncy may have a meaning, but we need +value here.
+		int n_bouncy_value = abs(itemgroup_get(f.groups, "bouncy"));
 
-			if (!f.walkable)
-				continue;
+		u8 neighbors = n.getNeighbors(p, map);
 
-			// Negative bouncy may have a meaning, but we need +value here.
-			int n_bouncy_value = abs(itemgroup_get(f.groups, "bouncy"));
+		nodeboxes.clear();
+		n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
 
-			u8 neighbors = n.getNeighbors(p, map);
-
-			nodeboxes.clear();
-			n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
+		// Calculate float position only once
+		v3f posf = intToFloat(p, BS);
+		for (auto box : nodeboxes) {
+			box.MinEdge += posf;
+			box.MaxEdge += posf;
+			cinfo.emplace_back(false, n_bouncy_value, p, box);
+		}
+	};
 
-			// Calculate float position only once
-			v3f posf = intToFloat(p, BS);
-			for (auto box : nodeboxes) {
-				box.MinEdge += posf;
-				box.MaxEdge += posf;
-				cinfo.emplace_back(false, n_bouncy_value, p, box);
+	v3s16 p;
+	for (p.Z = min.Z; p.Z <= max.Z; p.Z++)
+	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
+	for (p.X = min.X; p.X <= max.X; p.X++) {
+		if (use_cache) {
+			const v3bpos_t bp = getNodeBlockPos(p);
+			const CollisionBlock *cblock = get_cblock(bp);
+			const v3s16 rel = p - bp * MAP_BLOCKSIZE;
+			const u16 shape_id = cblock ? cblock->node_shape[rel.Z * MapBlock::zstride +
+					rel.Y * MapBlock::ystride + rel.X] : CollisionBlock::SHAPE_IGNORE;
+			if (shape_id != CollisionBlock::SHAPE_IGNORE) {
+				any_position_valid = true;
+				if (shape_id == CollisionBlock::SHAPE_CONNECTED) {
+					add_node(p, map->getNode(p));
+				} else if (shape_id != CollisionBlock::SHAPE_OPEN) {
+					const auto &shape = cblock->shapes[shape_id];
+					const v3f posf = intToFloat(p, BS);
+					for (u32 i = shape.first; i < shape.first + shape.count; i++) {
+						aabb3f box = cblock->boxes[i];
+						box.MinEdge += posf;
+						box.MaxEdge += posf;
+						cinfo.emplace_back(false, shape.bouncy, p, box);
+					}
+				}
+				continue;
 			}
 		} else {
-			// Collide with unloaded nodes (position invalid) and loaded
-			// CONTENT_IGNORE nodes (position valid)
-			aabb3f box = getNodeBox(p, BS);
-			cinfo.emplace_back(true, 0, p, box);
+			bool is_position_valid;
+			MapNode n = map->getNode(p, &is_position_valid);
+
+			if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
+				// Object collides into walkable nodes
+				any_position_valid = true;
+				add_node(p, n);
+				continue;
+			}
 		}
+
+		// Collide with unloaded nodes (position invalid) and loaded
+		// CONTENT_IGNORE nodes (position valid)
+		aabb3f box = getNodeBox(p, BS);
+		cinfo.emplace_back(true, 0, p, box);
 	}
 	return any_position_valid;
 }
@@ -274,7 +318,9 @@ static void add_object_boxes(Environment *env,
 #if CHECK_CLIENT_BUILD()
 	ClientEnvironment *c_env = dynamic_cast<ClientEnvironment*>(env);
 	if (c_env) {
-		std::vector<DistanceSortedActiveObject> clientobjects;
+		// cached allocation
+		thread_local std::vector<DistanceSortedActiveObject> clientobjects;
+		clientobjects.clear();
 		c_env->getActiveObjects(pos_f, distance, clientobjects);
 
 		for (auto &clientobject : clientobjects) {
@@ -284,6 +330,8 @@ static void add_object_boxes(Environment *env,
 				process_object(clientobject.obj.get());
 			}
 		}
+		// don't keep the objects alive
+		clientobjects.clear();
 
 		// add collision with local player
 		LocalPlayer *lplayer = c_env->getLocalPlayer();
@@ -313,7 +361,7 @@ static void add_object_boxes(Environment *env,
 			};
 
 			// nothing is put into this vector
-			std::vector<ServerActiveObjectPtr> s_objects;
+			thread_local std::vector<ServerActiveObjectPtr> s_objects;
 			s_env->getObjectsInsideRadius(s_objects, pos_f, distance, include_obj_cb);
 		}
 	}
@@ -590,7 +638,9 @@ bool collision_check_intersection(Environment *env, IGameDef *gamedef,
 {
 	ScopeProfiler sp(g_profiler, PROFILER_NAME("collision_check_intersection()"), SPT_AVG, PRECISION_MICRO);
 
-	std::vector<NearbyCollisionInfo> cinfo;
+	// cached allocation
+	thread_local std::vector<NearbyCollisionInfo> cinfo;
+	cinfo.clear();
 	{
 		v3s16 min = floatToInt(pos_f + box_0.MinEdge, BS) - v3s16(1, 1, 1);
 		v3s16 max = floatToInt(pos_f + box_0.MaxEdge, BS) + v3s16(1, 1, 1);
@@ -492,6 +492,11 @@ void set_default_settings()
 	settings->setDefault("enable_mesh_cache", "false");
 	settings->setDefault("mesh_generation_interval", "0");
 	settings->setDefault("mesh_generation_threads", "0");
+	settings->setDefault("greedy_meshing", "false");
+	settings->setDefault("mesh_disk_cache", "false");
+	settings->setDefault("mesh_disk_cache_size", "1024");
+	settings->setDefault("texture_disk_cache", "true");
+	settings->setDefault("texture_disk_cache_size", "256");
 	settings->setDefault("free_move", "false");
 	settings->setDefault("pitch_move", "false");
 	settings->setDefault("fast_move", "false");
@@ -816,11 +821,13 @@ void set_default_settings()
 	settings->setDefault("enable_ipv6", "true");
 	settings->setDefault("ipv6_server", "false");
 	settings->setDefault("max_packets_per_iteration", "1024");
+	settings->setDefault("network_impairment", "");
 	settings->setDefault("port", "30000");
 	settings->setDefault("strict_protocol_version_checking", "false");
 	settings->setDefault("protocol_version_min", "1");
 	settings->setDefault("player_transfer_distance", "0");
 	settings->setDefault("max_simultaneous_block_sends_per_client", "40");
+	settings->setDefault("block_send_queue_delay", "0.1");
 	settings->setDefault("time_send_interval", "5");
 
 	settings->setDefault("motd", "");
@@ -865,6 +872,7 @@ void set_default_settings()
 	settings->setDefault("chat_message_limit_trigger_kick", "50");
 	settings->setDefault("sqlite_synchronous", "2");
 	settings->setDefault("map_compression_level_disk", "-1");
+	settings->setDefault("map_content_id_table", "false");
 	settings->setDefault("map_compression_level_net", "-1");
 	settings->setDefault("full_block_send_enable_min_time_from_building", "2.0");
 	settings->setDefault("dedicated_server_step", "0.09");
@@ -0,0 +1,148 @@
+/*
+fm_block_dictionary.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_block_dictionary.h"
+#include <zdict.h>
+#include <zstd.h>
+#include "filesys.h"
+#include "log.h"
+#include "util/string.h"
+
+namespace
+{
+std::mutex s_dictionaries_mutex;
+// Never forgotten, blocks written with them may be read any time
+std::map<u32, std::shared_ptr<BlockDictionary>> s_dictionaries;
+}
+
+BlockDictionary::BlockDictionary(std::string data, u32 id) :
+		m_data(std::move(data)), m_id(id)
+{
+	m_ddict = ZSTD_createDDict(m_data.data(), m_data.size());
+}
+
+BlockDictionary::~BlockDictionary()
+{
+	for (const auto &[level, cdict] : m_cdicts)
+		ZSTD_freeCDict(cdict);
+	ZSTD_freeDDict(m_ddict);
+}
+
+std::shared_ptr<BlockDictionary> BlockDictionary::create(std::string data)
+{
+	const u32 id = ZDICT_getDictID(data.data(), data.size());
+	if (!id)
+		return {};
+
+	const std::lock_guard<std::mutex> lock(s_dictionaries_mutex);
+	auto &dictionary = s_dictionaries[id];
+	if (!dictionary) {
+		dictionary.reset(new BlockDictionary(std::move(data), id));
+		if (!dictionary->m_ddict) {
+			s_dictionaries.erase(id);
+			return {};
+		}
+	}
+	return dictionary;
+}
+
+std::shared_ptr<BlockDictionary> BlockDictionary::find(u32 id)
+{
+	const std::lock_guard<std::mutex> lock(s_dictionaries_mutex);
+	const auto it = s_dictionaries.find(id);
+	if (it == s_dictionaries.end())
+		return {};
+	return it->second;
+}
+
+const ZSTD_CDict_s *BlockDictionary::getCDict(int level) const
+{
+	const std::lock_guard<std::mutex> lock(m_cdicts_mutex);
+	auto &cdict = m_cdicts[level];
+	if (!cdict)
+		cdict = ZSTD_createCDict(m_data.data(), m_data.size(), level);
+	return cdict;
+}
+
+std::shared_ptr<BlockDictionary> BlockDictionary::load(const std::string &world_path)
+{
+	std::shared_ptr<BlockDictionary> current;
+	for (const auto &file : fs::GetDirListing(world_path)) {
+		if (file.dir || !str_starts_with(file.name, std::string("block_dictionary.")) ||
+				!str_ends_with(file.name, ".zdict"))
+			continue;
+
+		std::string data;
+		if (!fs::ReadFile(world_path + DIR_DELIM + file.name, data, true))
+			continue;
+		auto dictionary = create(std::move(data));
+		if (!dictionary) {
+			errorstream << "Not a block dictionary: " << file.name << std::endl;
+			continue;
+		}
+		if (file.name == BLOCK_DICTIONARY_FILE)
+			current = dictionary;
+	}
+
+	if (current)
+		actionstream << "Using block dictionary " << current->getId() << " of "
+					 << current->getData().size() << " bytes" << std::endl;
+	return current;
+}
+
+std::string BlockDictionary::train(
+		const std::vector<std::string> &samples, size_t dict_size)
+{
+	std::string samples_data;
+	std::vector<size_t> sizes;
+	sizes.reserve(samples.size());
+	for (const auto &sample : samples) {
+		samples_data.append(sample);
+		sizes.emplace_back(sample.size());
+	}
+
+	std::string dictionary(dict_size, '\0');
+	const size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(),
+			samples_data.data(), sizes.data(), sizes.size());
+	if (ZDICT_isError(size)) {
+		errorstream << "Block dictionary training failed: " << ZDICT_getErrorName(size)
+					<< std::endl;
+		return {};
+	}
+	dictionary.resize(size);
+	return dictionary;
+}
+
+bool BlockDictionary::save(const std::string &world_path, const std::string &data)
+{
+	const std::string path = world_path + DIR_DELIM + BLOCK_DICTIONARY_FILE;
+	std::string old;
+	if (fs::ReadFile(path, old)) {
+		// Blocks written with it are read with the kept one
+		if (const u32 id = ZDICT_getDictID(old.data(), old.size()); id) {
+			const std::string old_path = world_path + DIR_DELIM + "block_dictionary." +
+										 std::to_string(id) + ".zdict";
+			if (!fs::Rename(path, old_path))
+				return false;
+		}
+	}
+	return fs::safeWriteToFile(path, data);
+}
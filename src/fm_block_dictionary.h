@@ -0,0 +1,83 @@
+/*
+fm_block_dictionary.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+// The dictionary of a world, in the world directory and in the media
+#define BLOCK_DICTIONARY_FILE "block_dictionary.zdict"
+
+/*
+	A zstd dictionary trained on the map blocks of a world.
+
+	Blocks are small and repeat the same node names and layout, with the
+	dictionary they compress much better. Blocks written with it can only
+	be read with it: every dictionary made stays known by its id, and
+	decompressZstd() picks it from the id in the data.
+*/
+class BlockDictionary
+{
+public:
+	~BlockDictionary();
+
+	// nullptr if data is not a trained dictionary
+	static std::shared_ptr<BlockDictionary> create(std::string data);
+	static std::shared_ptr<BlockDictionary> find(u32 id);
+
+	/*
+		Reads BLOCK_DICTIONARY_FILE of the world and the replaced ones kept
+		for reading older blocks (block_dictionary.<id>.zdict). Returns the
+		one to write with, nullptr if the world has none.
+	*/
+	static std::shared_ptr<BlockDictionary> load(const std::string &world_path);
+
+	// Trains a new dictionary of about dict_size bytes on raw block data,
+	// empty on failure
+	static std::string train(const std::vector<std::string> &samples, size_t dict_size);
+
+	// Writes data as the dictionary of the world, keeping the replaced one
+	static bool save(const std::string &world_path, const std::string &data);
+
+	u32 getId() const { return m_id; }
+	const std::string &getData() const { return m_data; }
+
+	// For a zstd compression level
+	const ZSTD_CDict_s *getCDict(int level) const;
+	const ZSTD_DDict_s *getDDict() const { return m_ddict; }
+
+private:
+	BlockDictionary(std::string data, u32 id);
+
+	std::string m_data;
+	u32 m_id;
+	ZSTD_DDict_s *m_ddict = nullptr;
+	mutable std::mutex m_cdicts_mutex;
+	mutable std::map<int, ZSTD_CDict_s *> m_cdicts;
+};
@@ -225,6 +225,9 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 	//const auto *nodemgr = env->getGameDef()->getNodeDefManager();
 
 	unordered_map_v3pos<bool> occlude_cache;
+	// What the connection to the client takes this step
+	const u32 budget_blocks = m_send_budget.blocksLeft();
+	bool budget_full = false;
 	s16 d;
 	size_t block_skip_retry = 0;
 	s16 first_skipped_d = 0;
@@ -306,6 +309,11 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 				// queue_is_full = true;
 				goto queue_full_break;
 			}
+			if (d > BLOCK_SEND_DISABLE_LIMITS_MAX_D &&
+					num_blocks_selected >= budget_blocks) {
+				budget_full = true;
+				goto queue_full_break;
+			}
 
 			/*
 				Do not go over-limit
@@ -503,7 +511,14 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 				Add block to send queue
 			*/
 
-			PrioritySortedBlockTransfer q((float)d, p, peer_id);
+			// Blocks out of view wait for the ones the player looks at
+			float priority = d;
+			if (d > BLOCK_SEND_DISABLE_LIMITS_MAX_D &&
+					!isBlockInSight(p, camera_pos, camera_dir, camera_fov,
+							d_blocks_in_sight))
+				priority *= 2;
+
+			PrioritySortedBlockTransfer q(priority, p, peer_id);
 
 			dest.push_back(q);
 
@@ -534,7 +549,7 @@ int RemoteClient::GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge,
 			m_nothing_to_send_pause_timer = 1;
 		}
 	} else {
-		if (!num_blocks_selected && !num_blocks_air && d_start <= d) {
+		if (!num_blocks_selected && !num_blocks_air && d_start <= d && !budget_full) {
 			// new_nearest_unsent_d = 0;
 			m_nothing_to_send_pause_timer = 1.0;
 		}
@@ -571,7 +586,9 @@ uint32_t RemoteClient::SendFarBlocks()
 	TRY_UNIQUE_LOCK(far_blocks_requested_mutex)
 	{
 		std::multimap<int32_t, MapBlockPtr> ordered;
-		constexpr uint16_t send_max{50};
+		const uint16_t send_max = std::min<u32>(50, m_send_budget.blocksLeft());
+		if (!send_max)
+			return 0;
 		for (auto &far_blocks : far_blocks_requested) {
 			for (auto &[bpos, step_sent] : far_blocks) {
 				auto &[step, sent_ts] = step_sent;
@@ -674,8 +691,13 @@ uint32_t RemoteClient::SendFarBlocks()
 
 		for (auto it = ordered.rbegin(); it != ordered.rend(); ++it) {
 			//	for (const auto &[key, block] : std::views::reverse(ordered)) {
-			m_env->m_server->SendBlockFm(
-					peer_id, it->second, serialization_version, net_proto_version);
+			if (!it->second->far_step) {
+				// Replaces the client's block, changes can't be sent on top of it
+				m_blocks_sent_version.erase(it->second->getPos());
+			}
+			m_send_budget.sent(m_env->m_server->SendBlockFm(peer_id, it->second,
+					serialization_version, net_proto_version, nullptr,
+					m_env->m_server->getBlockDictionary(this)));
 		}
 	}
 
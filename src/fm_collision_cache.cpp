@@ -0,0 +1,130 @@
+/*
+fm_collision_cache.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_collision_cache.h"
+#include <cstdlib>
+#include "itemgroup.h"
+#include "map.h"
+#include "mapblock.h"
+#include "nodedef.h"
+
+// About 10 MB
+#define COLLISION_CACHE_MAX_BLOCKS 1024
+
+static_assert(sizeof(CollisionBlock::node_shape) / sizeof(u16) == MapBlock::nodecount);
+
+std::shared_ptr<const CollisionBlock> CollisionBoxCache::getBlock(Map *map,
+		const NodeDefManager *ndef, v3bpos_t blockpos)
+{
+	MapBlockPtr block = map->getBlock(blockpos);
+	if (!block)
+		return nullptr;
+
+	// Read the version first, a change while copying makes the entry stale
+	const u32 version = block->m_node_data_version;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_blocks.find(blockpos);
+		if (it != m_blocks.end()) {
+			const auto &cached = it->second.second;
+			if (cached->version == version && cached->block.lock() == block) {
+				m_lru.splice(m_lru.begin(), m_lru, it->second.first);
+				return cached;
+			}
+		}
+	}
+
+	auto cblock = std::make_shared<CollisionBlock>();
+	cblock->block = block;
+	cblock->version = version;
+	cblock->shapes.resize(CollisionBlock::SHAPE_CONNECTED + 1);
+	{
+		thread_local std::vector<aabb3f> nodeboxes;
+		// Shape of content << 8 | param2
+		std::unordered_map<u32, u16> shape_ids;
+		u32 last_key = U32_MAX;
+		u16 last_shape = 0;
+
+		const auto lock = block->lock_shared_rec();
+		const MapNode *data = block->getData();
+		for (u32 i = 0; i < MapBlock::nodecount; i++) {
+			const MapNode n = data[i];
+			const u32 key = (u32)n.getContent() << 8 | n.getParam2();
+			if (key == last_key) {
+				cblock->node_shape[i] = last_shape;
+				continue;
+			}
+
+			u16 shape;
+			const ContentFeatures &f = ndef->get(n);
+			if (n.getContent() == CONTENT_IGNORE) {
+				shape = CollisionBlock::SHAPE_IGNORE;
+			} else if (!f.walkable) {
+				shape = CollisionBlock::SHAPE_OPEN;
+			} else if (f.drawtype == NDT_NODEBOX &&
+					f.node_box.type == NODEBOX_CONNECTED) {
+				shape = CollisionBlock::SHAPE_CONNECTED;
+			} else if (auto it = shape_ids.find(key); it != shape_ids.end()) {
+				shape = it->second;
+			} else {
+				nodeboxes.clear();
+				n.getCollisionBoxes(ndef, &nodeboxes, 0);
+				CollisionBlock::Shape s;
+				s.first = cblock->boxes.size();
+				s.count = nodeboxes.size();
+				// Negative bouncy may have a meaning, but we need +value here.
+				s.bouncy = abs(itemgroup_get(f.groups, "bouncy"));
+				cblock->boxes.insert(cblock->boxes.end(), nodeboxes.begin(),
+						nodeboxes.end());
+				shape = cblock->shapes.size();
+				cblock->shapes.push_back(s);
+				shape_ids.emplace(key, shape);
+			}
+			cblock->node_shape[i] = shape;
+			last_key = key;
+			last_shape = shape;
+		}
+	}
+
+	// Blocks not generated yet are kept too, with their CONTENT_IGNORE
+	// nodes, generating them changes the version
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto [it, inserted] = m_blocks.try_emplace(blockpos);
+	if (inserted) {
+		m_lru.push_front(blockpos);
+		it->second.first = m_lru.begin();
+		while (m_blocks.size() > COLLISION_CACHE_MAX_BLOCKS) {
+			m_blocks.erase(m_lru.back());
+			m_lru.pop_back();
+		}
+	} else {
+		m_lru.splice(m_lru.begin(), m_lru, it->second.first);
+	}
+	it->second.second = cblock;
+	return cblock;
+}
+
+void CollisionBoxCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_blocks.clear();
+	m_lru.clear();
+}
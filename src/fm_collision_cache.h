@@ -0,0 +1,94 @@
+/*
+fm_collision_cache.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "constants.h"
+#include "irr_aabb3d.h"
+#include "irr_v3d.h"
+#include "util/basic_macros.h"
+
+class Map;
+class MapBlock;
+class NodeDefManager;
+
+/*
+	Collision boxes of the nodes of a map block. Nodes of the same content
+	and param2 share one shape, so a block of stone has a single box.
+*/
+struct CollisionBlock
+{
+	// Not walkable, no boxes
+	static constexpr u16 SHAPE_OPEN = 0;
+	// CONTENT_IGNORE, collided with as a full unloaded node
+	static constexpr u16 SHAPE_IGNORE = 1;
+	// Connected node boxes depend on the neighbours, made from the map
+	static constexpr u16 SHAPE_CONNECTED = 2;
+
+	struct Shape
+	{
+		u32 first = 0; // in boxes
+		u32 count = 0;
+		int bouncy = 0;
+	};
+
+	std::weak_ptr<MapBlock> block;
+	u32 version = 0; // MapBlock::m_node_data_version it was made from
+	std::vector<Shape> shapes;
+	std::vector<aabb3f> boxes; // relative to the node position, in BS units
+	u16 node_shape[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+};
+
+/*
+	Collision blocks kept between moves of objects, a block is made again
+	once its node data has changed. The least recently used ones are
+	dropped when there are too many.
+*/
+class CollisionBoxCache
+{
+public:
+	CollisionBoxCache() = default;
+	DISABLE_CLASS_COPY(CollisionBoxCache);
+
+	// nullptr if the block is not loaded
+	std::shared_ptr<const CollisionBlock> getBlock(Map *map,
+			const NodeDefManager *ndef, v3bpos_t blockpos);
+
+	void clear();
+
+	// When off, collisions read the nodes from the map one by one
+	bool isEnabled() const { return m_enabled; }
+	void setEnabled(bool enabled) { m_enabled = enabled; }
+
+private:
+	std::atomic_bool m_enabled{true};
+	std::mutex m_mutex;
+	// Most recently used first
+	std::list<v3bpos_t> m_lru;
+	std::unordered_map<v3bpos_t, std::pair<std::list<v3bpos_t>::iterator,
+			std::shared_ptr<const CollisionBlock>>> m_blocks;
+};
@@ -0,0 +1,208 @@
+/*
+fm_content_id_table.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_content_id_table.h"
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include "exceptions.h"
+#include "filesys.h"
+#include "gamedef.h"
+#include "log.h"
+#include "nameidmapping.h"
+#include "nodedef.h"
+#include "settings.h"
+
+namespace
+{
+constexpr content_t UNRESOLVED = 0xFFFF;
+}
+
+ContentIdTable::ContentIdTable(const std::string &path, IGameDef *gamedef) :
+		m_path(path + DIR_DELIM + CONTENT_ID_TABLE_FILE), m_gamedef(gamedef),
+		m_to_stored(CONTENT_MAX + 1, UNRESOLVED)
+{
+	std::string data;
+	if (!fs::ReadFile(m_path, data)) {
+		// Written with the first name
+		std::random_device random;
+		while (!m_id)
+			m_id = random();
+		return;
+	}
+
+	// Blocks saved with it can not be read without it, starting another
+	// one would lose them
+	std::istringstream is(data);
+	std::string line;
+	if (std::getline(is, line))
+		m_id = std::strtoul(line.c_str(), nullptr, 10);
+	if (!m_id)
+		throw SerializationError("Invalid content id table " + m_path);
+	while (std::getline(is, line)) {
+		if (m_names.size() >= UNRESOLVED)
+			throw SerializationError("Too many names in " + m_path);
+		m_name_to_stored.emplace(line, m_names.size());
+		m_names.emplace_back(std::move(line));
+	}
+	m_saved = m_names.size();
+	m_to_runtime.assign(m_names.size(), UNRESOLVED);
+
+	infostream << "Content id table " << m_id << " with " << m_saved << " names"
+			   << std::endl;
+}
+
+bool ContentIdTable::isEnabled(const Settings &world_mt)
+{
+	bool enabled = false;
+	if (!world_mt.getBoolNoEx("map_content_id_table", enabled))
+		enabled = g_settings->getBool("map_content_id_table");
+	return enabled;
+}
+
+u16 ContentIdTable::size() const
+{
+	const std::shared_lock lock(m_mutex);
+	return m_saved;
+}
+
+u16 ContentIdTable::toStored(MapNode *nodes, u32 count, NameIdMapping &extra)
+{
+	// Nodes with ids not resolved yet or not in the file
+	std::vector<u32> missing;
+	{
+		const std::shared_lock lock(m_mutex);
+		for (u32 i = 0; i < count; ++i) {
+			const content_t id = m_to_stored[nodes[i].getContent()];
+			if (id >= m_saved)
+				missing.emplace_back(i);
+			else
+				nodes[i].setContent(id);
+		}
+		if (missing.empty())
+			return m_saved;
+	}
+
+	const std::unique_lock lock(m_mutex);
+	for (const u32 i : missing)
+		if (m_to_stored[nodes[i].getContent()] == UNRESOLVED)
+			resolveStored(nodes[i].getContent());
+	if (m_names.size() > m_saved && !m_save_failed)
+		save();
+	for (const u32 i : missing) {
+		const content_t id = m_to_stored[nodes[i].getContent()];
+		nodes[i].setContent(id);
+		if (id >= m_saved)
+			extra.set(id, m_names[id]);
+	}
+	return m_saved;
+}
+
+void ContentIdTable::toRuntime(
+		MapNode *nodes, u32 count, u16 table_size, const NameIdMapping &extra)
+{
+	std::vector<u32> missing;
+	{
+		const std::shared_lock lock(m_mutex);
+		if (table_size > m_names.size())
+			throw SerializationError("Block refers to content ids missing in " + m_path);
+		for (u32 i = 0; i < count; ++i) {
+			const content_t stored = nodes[i].getContent();
+			const content_t id = stored < table_size ? m_to_runtime[stored] : UNRESOLVED;
+			if (id == UNRESOLVED)
+				missing.emplace_back(i);
+			else
+				nodes[i].setContent(id);
+		}
+		if (missing.empty())
+			return;
+	}
+
+	const std::unique_lock lock(m_mutex);
+	// Ids of the extra names are only valid in this block
+	std::unordered_map<content_t, content_t> extra_ids;
+	for (const u32 i : missing) {
+		const content_t stored = nodes[i].getContent();
+		if (stored < table_size) {
+			auto &id = m_to_runtime[stored];
+			if (id == UNRESOLVED) {
+				id = resolveRuntime(m_names[stored]);
+				// Not for aliases, a node is saved with its own name
+				if (id != CONTENT_IGNORE &&
+						m_gamedef->ndef()->get(id).name == m_names[stored])
+					m_to_stored[id] = stored;
+			}
+			nodes[i].setContent(id);
+			continue;
+		}
+
+		auto [it, inserted] = extra_ids.emplace(stored, CONTENT_IGNORE);
+		if (inserted) {
+			std::string name;
+			if (extra.getName(stored, name))
+				it->second = resolveRuntime(name);
+			else
+				errorstream << "ContentIdTable: IGNORING ERROR: Block contains id "
+							<< stored << " with no name mapping" << std::endl;
+		}
+		nodes[i].setContent(it->second);
+	}
+}
+
+content_t ContentIdTable::resolveStored(content_t id)
+{
+	const auto &name = m_gamedef->ndef()->get(id).name;
+	const auto [it, inserted] = m_name_to_stored.emplace(name, m_names.size());
+	if (inserted) {
+		m_names.emplace_back(name);
+		m_to_runtime.emplace_back(id);
+	}
+	m_to_stored[id] = it->second;
+	return it->second;
+}
+
+content_t ContentIdTable::resolveRuntime(const std::string &name)
+{
+	content_t id;
+	if (m_gamedef->ndef()->getId(name, id))
+		return id;
+	id = m_gamedef->allocateUnknownNodeId(name);
+	if (id == CONTENT_IGNORE)
+		errorstream << "ContentIdTable: IGNORING ERROR: Could not allocate global id "
+					<< "for node name \"" << name << "\"" << std::endl;
+	return id;
+}
+
+bool ContentIdTable::save()
+{
+	std::ostringstream os;
+	os << m_id << '\n';
+	for (const auto &name : m_names)
+		os << name << '\n';
+	if (!fs::safeWriteToFile(m_path, os.str())) {
+		errorstream << "ContentIdTable: Failed to save " << m_path
+					<< ", new names are saved in the blocks" << std::endl;
+		m_save_failed = true;
+		return false;
+	}
+	m_saved = m_names.size();
+	return true;
+}
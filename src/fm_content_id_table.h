@@ -0,0 +1,93 @@
+/*
+fm_content_id_table.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "irrlichttypes.h"
+#include "mapnode.h"
+
+class IGameDef;
+class NameIdMapping;
+class Settings;
+
+// In the world directory: the table id, then one node name per line,
+// the line number is the stored id
+#define CONTENT_ID_TABLE_FILE "content_ids.txt"
+
+/*
+	Node names of a world with the content ids blocks are saved with.
+
+	Blocks saved with the table only keep its id and size instead of a
+	NameIdMapping, no names are written, hashed or looked up for them.
+	Names are only ever added, a block may use all ids below the size it
+	was saved with. Ids of names which could not be saved to the table
+	yet go to a NameIdMapping in the block as before.
+*/
+class ContentIdTable
+{
+public:
+	// Written by blocks in place of the NameIdMapping version
+	static constexpr u8 BLOCK_MAPPING_VERSION = 1;
+
+	// The table of the world in path, an empty one if it has none yet
+	ContentIdTable(const std::string &path, IGameDef *gamedef);
+
+	// Whether blocks of the world are saved with the table, off unless
+	// enabled in its world.mt or by the global setting
+	static bool isEnabled(const Settings &world_mt);
+
+	u32 getId() const { return m_id; }
+	u16 size() const;
+
+	/*
+		Replaces the content ids of nodes with the stored ones. Returns
+		the table size they refer to, ids above it are set in extra.
+	*/
+	u16 toStored(MapNode *nodes, u32 count, NameIdMapping &extra);
+	// The reverse, with what toStored() gave
+	void toRuntime(MapNode *nodes, u32 count, u16 table_size,
+			const NameIdMapping &extra);
+
+private:
+	content_t resolveStored(content_t id);
+	content_t resolveRuntime(const std::string &name);
+	bool save();
+
+	const std::string m_path;
+	IGameDef *m_gamedef;
+	u32 m_id = 0;
+
+	mutable std::shared_mutex m_mutex;
+	std::vector<std::string> m_names;
+	std::unordered_map<std::string, content_t> m_name_to_stored;
+	// Names in the file, blocks may refer to these
+	u16 m_saved = 0;
+	// Not retried, names not saved go to the blocks
+	bool m_save_failed = false;
+
+	// Resolved ids, 0xFFFF until first used
+	std::vector<content_t> m_to_stored;
+	std::vector<content_t> m_to_runtime;
+};
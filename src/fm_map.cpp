@@ -201,7 +201,7 @@ MapNode Map::getNodeTry(const v3pos_t &p)
 	return block->getNodeRef(relpos);
 }
 
-MapNode &Map::getNodeRef(const v3pos_t &p)
+const MapNode &Map::getNodeRef(const v3pos_t &p)
 {
 #ifndef NDEBUG
 	ScopeProfiler sp(g_profiler, "Map: getNodeTry");
@@ -1469,7 +1469,7 @@ MapBlockPtr ServerMap::loadBlockPtr(v3bpos_t p3d)
 		}
 
 		// Read basic data
-		if (!block->deSerialize(is, version, true)) {
+		if (!block->deSerialize(is, version, true, m_content_id_table.get())) {
 			if (created_new && block)
 				//delete block;
 				return nullptr;
@@ -0,0 +1,75 @@
+/*
+fm_map_search.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_map_search.h"
+
+bool ContentFilter::mayMatch(MapBlock &block) const
+{
+	// Not MapBlock::contents, the ABM thread fills it without a lock
+	return block.hasContent([this](content_t c) { return contains(c); });
+}
+
+void readContents(Map &map, const VoxelArea &area, std::vector<content_t> &contents)
+{
+	contents.assign(area.getVolume(), CONTENT_IGNORE);
+	const v3bpos_t bpmin = getNodeBlockPos(area.MinEdge);
+	const v3bpos_t bpmax = getNodeBlockPos(area.MaxEdge);
+	for (bpos_t bz = bpmin.Z; bz <= bpmax.Z; bz++)
+	for (bpos_t by = bpmin.Y; by <= bpmax.Y; by++)
+	for (bpos_t bx = bpmin.X; bx <= bpmax.X; bx++) {
+		const v3bpos_t bp(bx, by, bz);
+		const MapBlockPtr block = map.getBlock(bp);
+		if (!block)
+			continue;
+
+		const v3pos_t basep = bp * MAP_BLOCKSIZE;
+		const VoxelArea part = area.intersect(
+				VoxelArea(basep, basep + v3pos_t(MAP_BLOCKSIZE - 1)));
+		const auto lock = block->lock_shared_rec();
+		const MapNode *data = block->getData();
+		for (pos_t z = part.MinEdge.Z; z <= part.MaxEdge.Z; z++)
+		for (pos_t y = part.MinEdge.Y; y <= part.MaxEdge.Y; y++) {
+			const MapNode *row = data + (z - basep.Z) * MapBlock::zstride +
+					(y - basep.Y) * MapBlock::ystride - basep.X;
+			content_t *out = &contents[area.index(part.MinEdge.X, y, z)];
+			for (pos_t x = part.MinEdge.X; x <= part.MaxEdge.X; x++)
+				*out++ = row[x].getContent();
+		}
+	}
+}
+
+bool MapNodeMatcher::operator()(v3pos_t p)
+{
+	const v3bpos_t bp = getNodeBlockPos(p);
+	if (!m_have_block || bp != m_block_pos) {
+		m_have_block = true;
+		m_block_pos = bp;
+		m_block = m_map.getBlock(bp);
+		m_may_match = m_block ? m_filter.mayMatch(*m_block)
+							  : m_filter.contains(CONTENT_IGNORE);
+	}
+	if (!m_may_match)
+		return false;
+	if (!m_block)
+		return true;
+	return m_filter.contains(
+			m_block->getNodeNoCheck(p - m_block->getPosRelative()).getContent());
+}
@@ -0,0 +1,128 @@
+/*
+fm_map_search.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include "irr_v3d.h"
+#include "map.h"
+#include "mapblock.h"
+#include "voxel.h"
+
+/*
+	Searching the map for nodes of some contents a block at a time: each
+	block is locked once and its data read directly, blocks which can
+	not have any of the contents are skipped without reading them.
+*/
+
+// Contents searched for, with their index in the list given
+class ContentFilter
+{
+public:
+	explicit ContentFilter(const std::vector<content_t> &ids)
+	{
+		// The first one of duplicates wins, like a linear search
+		for (size_t i = ids.size(); i-- > 0;) {
+			if (ids[i] >= m_index.size())
+				m_index.resize(ids[i] + 1, -1);
+			m_index[ids[i]] = i;
+		}
+	}
+
+	// Index in the list, -1 if not searched for
+	int find(content_t c) const { return c < m_index.size() ? m_index[c] : -1; }
+	bool contains(content_t c) const { return find(c) >= 0; }
+
+	// False if none of the nodes of the block can match
+	bool mayMatch(MapBlock &block) const;
+
+private:
+	std::vector<int> m_index;
+};
+
+// Calls func(p, filter index) for each node in the area matching the filter,
+// in the order of Map::forEachNodeInArea
+template <typename F>
+void forEachMatchingNode(Map &map, v3pos_t minp, v3pos_t maxp, const ContentFilter &filter,
+		F &&func)
+{
+	const int ignore_index = filter.find(CONTENT_IGNORE);
+	const v3bpos_t bpmin = getNodeBlockPos(minp);
+	const v3bpos_t bpmax = getNodeBlockPos(maxp);
+	for (bpos_t bz = bpmin.Z; bz <= bpmax.Z; bz++)
+	for (bpos_t bx = bpmin.X; bx <= bpmax.X; bx++)
+	for (bpos_t by = bpmin.Y; by <= bpmax.Y; by++) {
+		const v3bpos_t bp(bx, by, bz);
+		const v3pos_t basep = bp * MAP_BLOCKSIZE;
+		const v3pos_t rmin(rangelim(minp.X - basep.X, 0, MAP_BLOCKSIZE - 1),
+				rangelim(minp.Y - basep.Y, 0, MAP_BLOCKSIZE - 1),
+				rangelim(minp.Z - basep.Z, 0, MAP_BLOCKSIZE - 1));
+		const v3pos_t rmax(rangelim(maxp.X - basep.X, 0, MAP_BLOCKSIZE - 1),
+				rangelim(maxp.Y - basep.Y, 0, MAP_BLOCKSIZE - 1),
+				rangelim(maxp.Z - basep.Z, 0, MAP_BLOCKSIZE - 1));
+
+		const MapBlockPtr block = map.getBlock(bp);
+		if (!block ? ignore_index < 0 : !filter.mayMatch(*block))
+			continue;
+
+		v3pos_t rp;
+		if (!block) {
+			for (rp.Z = rmin.Z; rp.Z <= rmax.Z; rp.Z++)
+			for (rp.Y = rmin.Y; rp.Y <= rmax.Y; rp.Y++)
+			for (rp.X = rmin.X; rp.X <= rmax.X; rp.X++)
+				func(basep + rp, ignore_index);
+			continue;
+		}
+
+		const auto lock = block->lock_shared_rec();
+		const MapNode *data = block->getData();
+		for (rp.Z = rmin.Z; rp.Z <= rmax.Z; rp.Z++)
+		for (rp.Y = rmin.Y; rp.Y <= rmax.Y; rp.Y++) {
+			const MapNode *row = data + rp.Z * MapBlock::zstride + rp.Y * MapBlock::ystride;
+			for (rp.X = rmin.X; rp.X <= rmax.X; rp.X++) {
+				const int index = filter.find(row[rp.X].getContent());
+				if (index >= 0)
+					func(basep + rp, index);
+			}
+		}
+	}
+}
+
+// Contents of the area indexed like a VoxelManipulator's, CONTENT_IGNORE
+// where blocks are missing
+void readContents(Map &map, const VoxelArea &area, std::vector<content_t> &contents);
+
+// Whether single nodes match, keeping the block of the last one
+class MapNodeMatcher
+{
+public:
+	MapNodeMatcher(Map &map, const ContentFilter &filter) : m_map(map), m_filter(filter) {}
+
+	bool operator()(v3pos_t p);
+
+private:
+	Map &m_map;
+	const ContentFilter &m_filter;
+	bool m_have_block = false;
+	v3bpos_t m_block_pos;
+	MapBlockPtr m_block;
+	bool m_may_match = false;
+};
@@ -39,6 +39,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "map.h"
 #include "mapblock.h"
 #include "mapnode.h"
+#include "nodemetadata.h"
 #include "network/fm_networkprotocol.h"
 #include "profiler.h"
 #include "server.h"
@@ -671,7 +672,7 @@ MapBlockPtr loadBlockNoStore(Map *smap, MapDatabase *dbase, const v3bpos_t &bpos
 		}
 
 		// Read basic data
-		if (!block->deSerialize(is, version, true)) {
+		if (!block->deSerialize(is, version, true, smap->getContentIdTable())) {
 			return {};
 		}
 		return block;
@@ -681,8 +682,8 @@ MapBlockPtr loadBlockNoStore(Map *smap, MapDatabase *dbase, const v3bpos_t &bpos
 	return {};
 }
 
-void Server::SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache)
+size_t Server::SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver,
+		u16 net_proto_version, SerializedBlockCache *cache, const BlockDictionary *dict)
 {
 	thread_local const int net_compression_level =
 			rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
@@ -693,7 +694,7 @@ void Server::SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver,
 	PACK(TOCLIENT_BLOCKDATA_POS, block->getPos());
 
 	std::ostringstream os(std::ios_base::binary);
-	block->serialize(os, ver, false, net_compression_level, net_proto_version >= 1);
+	block->serialize(os, ver, false, net_compression_level, net_proto_version >= 1, dict);
 	block->serializeNetworkSpecific(os);
 
 	PACK(TOCLIENT_BLOCKDATA_DATA, os.str());
@@ -710,8 +711,86 @@ void Server::SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver,
 	pkt.putLongString({buffer.data(), buffer.size()});
 	auto s = std::string{pkt.getString(0), pkt.getSize()};
 	Send(&pkt);
+	return pkt.getSize();
 }
 
+const BlockDictionary *Server::getBlockDictionary(const RemoteClient *client)
+{
+	if (client->net_proto_version_fm < 4)
+		return nullptr;
+	return m_env->getServerMap().m_block_dictionary.get();
+}
+
+#if MINETEST_PROTO
+
+// A delta larger than this is checked against the size of the whole block
+#define BLOCK_DELTA_CHECK_SIZE 512
+
+bool Server::SendBlockDelta(
+		RemoteClient *client, MapBlock *block, SerializedBlockCache *cache, size_t &sent)
+{
+	const auto bpos = block->getPos();
+	const u64 stamp = client->m_blocks_sent_version.get(bpos);
+	std::vector<u16> changes;
+	if (!stamp || !block->getChangesSince(stamp, changes))
+		return false;
+
+	sent = 0;
+	if (changes.empty())
+		return true;
+
+	NodeMetadataList meta_list(false);
+	for (const u16 index : changes) {
+		const v3pos_t p = MapBlock::indexToPos(index);
+		if (NodeMetadata *meta = block->m_node_metadata.get(p))
+			meta_list.set(p, meta);
+	}
+	std::string meta_data;
+	if (meta_list.size()) {
+		std::ostringstream os(std::ios_base::binary);
+		meta_list.serialize(os, client->serialization_version, false, false, true);
+		std::ostringstream compressed(std::ios_base::binary);
+		compressZlib(os.str(), compressed);
+		meta_data = compressed.str();
+	}
+
+	const size_t size = 6 + 2 + changes.size() * 6 + 4 + meta_data.size();
+	if (size > BLOCK_DELTA_CHECK_SIZE) {
+		// Fill the cache, the whole block is sent from it if it is smaller
+		const BlockDictionary *dict = getBlockDictionary(client);
+		const u16 ver = client->serialization_version;
+		const auto key = std::make_pair(bpos, (u16)(dict ? ver | 0x100 : ver));
+		auto it = cache->find(key);
+		if (it == cache->end()) {
+			thread_local const int net_compression_level =
+					rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
+			std::ostringstream os(std::ios_base::binary);
+			block->serialize(os, client->serialization_version, false,
+					net_compression_level, false, dict);
+			block->serializeNetworkSpecific(os);
+			it = cache->emplace(key, os.str()).first;
+		}
+		if (6 + it->second.size() + 2 <= size)
+			return false;
+	}
+
+	NetworkPacket pkt(TOCLIENT_BLOCK_DELTA, size, client->peer_id);
+	pkt << bpos << (u16)changes.size();
+	const MapNode *data = block->getData();
+	for (const u16 index : changes) {
+		const MapNode &n = data[index];
+		pkt << index << n.param0 << n.param1 << n.param2;
+	}
+	pkt.putLongString(meta_data);
+	Send(&pkt);
+
+	g_profiler->add("Server: block deltas sent", 1);
+	sent = pkt.getSize();
+	return true;
+}
+
+#endif
+
 uint32_t Server::SendFarBlocks(float dtime)
 {
 	ScopeProfiler sp(g_profiler, "Server: Far blocks send");
@@ -35,6 +35,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include "mapnode.h"
 #include "profiler.h"
 #include "server.h"
+#include "threading/task_scheduler.h"
 #include "fm_world_merge.h"
 
 //  https://stackoverflow.com/a/34937216
@@ -61,7 +62,7 @@ static const auto load_block = [](Map *smap, MapDatabase *dbase,
 WorldMerger::~WorldMerger()
 {
 	if (last_async.valid()) {
-		last_async.wait();
+		TaskScheduler::get().wait(last_async);
 	}
 	merge_changed();
 }
@@ -394,9 +395,14 @@ bool WorldMerger::add_changed(const v3bpos_t &bpos)
 	if (changed_blocks_for_merge.size() < 1000) {
 		return false;
 	}
-	last_async =
-			std::async(std::launch::async, [copy = std::move(changed_blocks_for_merge),
-												   this]() mutable { merge_list(copy); });
+	// One merge at a time, as before with the blocking std::async future
+	if (last_async.valid()) {
+		TaskScheduler::get().wait(last_async);
+	}
+	last_async = TaskScheduler::get().submit("world_merge", TaskPriority::Low,
+			[copy = std::move(changed_blocks_for_merge), this]() mutable {
+				merge_list(copy);
+			});
 	changed_blocks_for_merge.clear();
 	return true;
 }
@@ -27,6 +27,9 @@
 #include "porting.h"
 #include "network/socket.h"
 #include "mapblock.h"
+#include "fm_block_dictionary.h"
+#include "fm_content_id_table.h"
+#include "threading/task_scheduler.h"
 #if USE_CURSES
 	#include "terminal_chat_console.h"
 #endif
@@ -120,6 +123,7 @@ static bool determine_subgame(GameParams *game_params);
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args);
 static bool recompress_map_database(const GameParams &game_params, const Settings &cmd_args);
+static bool train_block_dictionary(const GameParams &game_params, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -414,6 +418,8 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Enable ncurses interactive terminal" SERVER_ONLY))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
 			_("Recompress the blocks of the given map database" SERVER_ONLY))));
+	allowed_options->insert(std::make_pair("train-block-dictionary", ValueSpec(VALUETYPE_FLAG,
+			_("Train a compression dictionary on the blocks of the given map database" SERVER_ONLY))));
 #if CHECK_CLIENT_BUILD()
 	allowed_options->insert(std::make_pair("address", ValueSpec(VALUETYPE_STRING,
 			_("Address to connect to ('' = local game)"))));
@@ -727,6 +733,10 @@ static bool init_common(const Settings &cmd_args, int argc, char *argv[])
 	// Initialize g_settings
 	Settings::createLayer(SL_GLOBAL);
 
+	// Created before the cleanup callback is set, so it is still there when
+	// that shuts it down
+	TaskScheduler::get();
+
 	// Set cleanup callback(s) to run at process exit
 	atexit(uninit_common);
 
@@ -766,6 +776,9 @@ static bool init_common(const Settings &cmd_args, int argc, char *argv[])
 
 static void uninit_common()
 {
+	// Queued tasks are dropped instead of running during static destruction
+	TaskScheduler::get().shutdown();
+
 	httpfetch_cleanup();
 
 	sockets_cleanup();
@@ -1156,6 +1169,9 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.getFlag("recompress"))
 		return recompress_map_database(game_params, cmd_args);
 
+	if (cmd_args.getFlag("train-block-dictionary"))
+		return train_block_dictionary(game_params, cmd_args);
+
 	// Bind address
 	std::string bind_str = g_settings->get("bind_address");
 	Address bind_addr(INADDR_ANY, game_params.socket_port);
@@ -1353,6 +1369,10 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 	const std::string &backend = world_mt.get("backend");
 	Server server(game_params.world_path, game_params.game_spec, false, Address(), false);
 	MapDatabase *db = ServerMap::createDatabase(backend, game_params.world_path, world_mt);
+	const auto dict = BlockDictionary::load(game_params.world_path);
+	// Blocks saved with and without it are rewritten as the setting says
+	ContentIdTable ids(game_params.world_path, &server);
+	const bool save_ids = ContentIdTable::isEnabled(world_mt);
 
 	u32 count = 0;
 	u64 last_update_time = 0;
@@ -1380,12 +1400,13 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 
 		{
 			MapBlock mb(v3s16(0,0,0), &server);
-			ServerMap::deSerializeBlock(&mb, iss);
+			ServerMap::deSerializeBlock(&mb, iss, &ids);
 
 			oss.str("");
 			oss.clear();
 			writeU8(oss, serialize_as_ver);
-			mb.serialize(oss, serialize_as_ver, true, -1);
+			mb.serialize(oss, serialize_as_ver, true, -1, false, dict.get(),
+					save_ids ? &ids : nullptr);
 		}
 
 		db->saveBlock(*it, oss.str());
@@ -1405,3 +1426,82 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 	actionstream << "Done, " << count << " blocks were recompressed." << std::endl;
 	return true;
 }
+
+// Blocks sampled from the world, the size of zstd's default dictionary
+#define BLOCK_DICTIONARY_SAMPLES 20000
+#define BLOCK_DICTIONARY_SIZE (110 * 1024)
+
+static bool train_block_dictionary(const GameParams &game_params, const Settings &cmd_args)
+{
+	Settings world_mt;
+	const std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.mt at " << world_mt_path << std::endl;
+		return false;
+	}
+	const std::string &backend = world_mt.get("backend");
+	Server server(game_params.world_path, game_params.game_spec, false, Address(), false);
+	MapDatabase *db = ServerMap::createDatabase(backend, game_params.world_path, world_mt);
+	// Blocks already written with a dictionary are read with it
+	const auto dict = BlockDictionary::load(game_params.world_path);
+	ContentIdTable ids(game_params.world_path, &server);
+	const bool save_ids = ContentIdTable::isEnabled(world_mt);
+
+	bool &kill = *porting::signal_handler_killstatus();
+	const u8 serialize_as_ver = SER_FMT_VER_HIGHEST_WRITE;
+
+	std::vector<v3s16> blocks;
+	db->listAllLoadableBlocks(blocks);
+	const size_t step = std::max<size_t>(blocks.size() / BLOCK_DICTIONARY_SAMPLES, 1);
+
+	// The uncompressed data of the blocks as they are saved and sent
+	std::vector<std::string> samples;
+	std::istringstream iss(std::ios_base::binary);
+	for (size_t i = 0; i < blocks.size(); i += step) {
+		if (kill) return false;
+
+		std::string data;
+		db->loadBlock(blocks[i], &data);
+		if (data.empty())
+			continue;
+
+		iss.str(data);
+		iss.clear();
+
+		MapBlock mb(v3s16(0,0,0), &server);
+		try {
+			ServerMap::deSerializeBlock(&mb, iss, &ids);
+			std::string sample[2];
+			for (const bool disk : {true, false}) {
+				std::ostringstream oss(std::ios_base::binary);
+				mb.serialize(oss, serialize_as_ver, disk, -1, false, nullptr,
+						disk && save_ids ? &ids : nullptr);
+				std::istringstream compressed(oss.str(), std::ios_base::binary);
+				std::ostringstream raw(std::ios_base::binary);
+				decompressZstd(compressed, raw);
+				sample[disk] = raw.str();
+			}
+			samples.emplace_back(std::move(sample[1]));
+			samples.emplace_back(std::move(sample[0]));
+		} catch (const std::exception &e) {
+			warningstream << "Skipping block " << blocks[i] << ": " << e.what()
+					<< std::endl;
+		}
+	}
+	delete db;
+
+	const std::string dictionary = BlockDictionary::train(samples, BLOCK_DICTIONARY_SIZE);
+	if (dictionary.empty())
+		return false;
+	if (!BlockDictionary::save(game_params.world_path, dictionary)) {
+		errorstream << "Cannot write the block dictionary to " << game_params.world_path
+				<< std::endl;
+		return false;
+	}
+
+	actionstream << "Done, a dictionary of " << dictionary.size() << " bytes was trained on "
+			<< samples.size() / 2 << " blocks. Blocks are written with it from now on, "
+			"--recompress rewrites the others." << std::endl;
+	return true;
+}
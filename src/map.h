@@ -16,6 +16,7 @@
 #include <list>
 
 #include "irrlichttypes_bloated.h"
+#include "fm_collision_cache.h"
 #include "mapblock.h"
 #include "mapnode.h"
 #include "constants.h"
@@ -32,6 +33,7 @@ class NodeMetadata;
 class IGameDef;
 class IRollbackManager;
 class MapDatabase;
+class ContentIdTable;
 
 #if !ENABLE_THREADS
 	#define MAP_NOTHREAD_LOCK(map) auto lock_map = map->m_nothread_locker.lock_unique_rec();
@@ -184,6 +186,7 @@ class Map : public NodeContainer
 	// Client leaves them as no-op.
 	virtual bool saveBlock(MapBlock *block) { return false; }
 	virtual bool deleteBlock(v3s16 blockpos) { return false; }
+	virtual ContentIdTable *getContentIdTable() { return nullptr; }
 
 	/*
 		Updates usage timers and unloads unused blocks and sectors.
@@ -287,7 +290,7 @@ class Map : public NodeContainer
 	uint64_t m_blocks_delete_time{};
 	// void getBlocks(std::list<MapBlock*> &dest);
 	concurrent_shared_unordered_set<v3bpos_t, v3posHash, v3posEqual> m_db_miss;
-	MapNode &getNodeRef(const v3pos_t &p);
+	const MapNode &getNodeRef(const v3pos_t &p);
 
 #if !ENABLE_THREADS
 	locker<> m_nothread_locker;
@@ -311,11 +314,13 @@ class Map : public NodeContainer
 	{
 		return getNodeTry(p);
 	};
-	inline MapNode &getNodeRefUnsafe(const v3pos_t &p) override { return getNodeRef(p); }
+	inline const MapNode &getNodeRefUnsafe(const v3pos_t &p) override { return getNodeRef(p); }
 
 	// bool isBlockOccluded(const v3pos_t &pos, const v3pos_t &cam_pos_nodes);
 
 	concurrent_unordered_set<v3bpos_t> changed_blocks_for_merge;
+	// Node boxes for collisionMoveSimple
+	CollisionBoxCache collision_box_cache;
 	using far_dbases_t = std::array<std::shared_ptr<MapDatabase>, FARMESH_STEP_MAX>;
 
 	virtual MapBlockPtr emergeBlockPtr(v3bpos_t p, bool create_blank=false)
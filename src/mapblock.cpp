@@ -5,6 +5,7 @@
 #include "mapblock.h"
 #include "servermap.h"
 
+#include <algorithm>
 #include <atomic>
 #include <sstream>
 #include "map.h"
@@ -27,6 +28,7 @@
 #include "util/basic_macros.h"
 
 #include "circuit.h"
+#include "fm_content_id_table.h"
 #include "profiler.h"
 
 
@@ -76,7 +78,9 @@ void MapBlock::setNode(const v3pos_t &p, const MapNode &n, bool important)
 
 	const auto &f0 = nodedef->get(data[index].getContent());
 
+	const u32 version = m_node_data_version;
 	data[index] = n;
+	++m_node_data_version;
 
 	modified_light light = modified_light_no;
 	if (f0.light_propagates != f1.light_propagates || f0.solidness != f1.solidness ||
@@ -84,6 +88,7 @@ void MapBlock::setNode(const v3pos_t &p, const MapNode &n, bool important)
 		light = modified_light_yes;
 	if (important)
 		raiseModified(MOD_STATE_WRITE_NEEDED, light, important);
+	logChange(version, index);
 }
 
 void MapBlock::raiseModified(u32 mod, modified_light light, bool important)
@@ -93,6 +98,7 @@ void MapBlock::raiseModified(u32 mod, modified_light light, bool important)
 
 		if(mod >= MOD_STATE_WRITE_NEEDED /*&& m_timestamp != BLOCK_TIMESTAMP_UNDEFINED*/) {
 			m_changed_timestamp = (unsigned int) ServerMap::time_life;
+			++m_node_data_version;
 		}
 
 	if (mod > m_modified) {
@@ -176,11 +182,82 @@ void MapBlock::incrementUsageTimer(float dtime)
 
 void MapBlock::setNodeNoLock(v3pos_t p, MapNode n, bool important)
 {
-	data[p.Z * zstride + p.Y * ystride + p.X] = n;
+	const u32 version = m_node_data_version;
+	const u32 index = p.Z * zstride + p.Y * ystride + p.X;
+	data[index] = n;
 	raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE, important);
+	logChange(version, index);
+}
+
+void MapBlock::updateContentsPresent()
+{
+	m_contents_present.clear();
+	content_t previous = CONTENT_IGNORE;
+	for (u32 i = 0; i < nodecount; ++i) {
+		const content_t c = data[i].getContent();
+		// Runs of the same content are common
+		if (c == previous && i)
+			continue;
+		previous = c;
+		m_contents_present.push_back(c);
+	}
+	std::sort(m_contents_present.begin(), m_contents_present.end());
+	m_contents_present.erase(
+			std::unique(m_contents_present.begin(), m_contents_present.end()),
+			m_contents_present.end());
+	m_contents_present_version = m_node_data_version;
+}
+
+void MapBlock::raiseModifiedNode(v3pos_t p, u32 reason)
+{
+	const u32 version = m_node_data_version;
+	raiseModified(MOD_STATE_WRITE_NEEDED, reason);
+	logChange(version, p.Z * zstride + p.Y * ystride + p.X);
+}
+
+// Enough for what a few players build, a larger change is sent as a block
+#define CHANGE_LOG_MAX 256
+
+void MapBlock::logChange(u32 version_before, s32 index)
+{
+	const std::lock_guard<std::mutex> lock(m_change_log_mutex);
+	if (version_before != m_change_log_version) {
+		// Something changed without the log, it starts over from here
+		m_change_log.clear();
+		m_change_log_from = version_before;
+	}
+	m_change_log_version = m_node_data_version;
+	if (index < 0)
+		return;
+
+	if (m_change_log.size() >= CHANGE_LOG_MAX) {
+		const auto half = m_change_log.begin() + CHANGE_LOG_MAX / 2;
+		m_change_log_from = (half - 1)->version;
+		m_change_log.erase(m_change_log.begin(), half);
+	}
+	m_change_log.push_back(NodeChange{m_change_log_version, (u16)index});
+}
+
+bool MapBlock::getChangesSince(u64 stamp, std::vector<u16> &indexes)
+{
+	const u32 version = stamp;
+	if (stamp >> 32 != m_instance_id)
+		return false;
+
+	const std::lock_guard<std::mutex> lock(m_change_log_mutex);
+	if (m_change_log_version != m_node_data_version || version < m_change_log_from ||
+			version > m_change_log_version)
+		return false;
+
+	for (auto it = m_change_log.rbegin();
+			it != m_change_log.rend() && it->version > version; ++it)
+		indexes.push_back(it->index);
+	std::sort(indexes.begin(), indexes.end());
+	indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+	return true;
 }
 
-MapNode &MapBlock::getNodeRef(const v3pos_t &p)
+const MapNode &MapBlock::getNodeRef(const v3pos_t &p)
 {
 	const auto lock = try_lock_shared_rec();
 	if (!lock->owns_lock())
@@ -286,16 +363,24 @@ bool MapBlock::saveStaticObject(u16 id, const StaticObject &obj, u32 reason)
 void MapBlock::step(float dtime, const std::function<bool(v3s16, MapNode, f32)> &on_timer_cb)
 {
 	// Run script callbacks for elapsed node_timers
-	std::vector<NodeTimer> elapsed_timers = m_node_timers.step(dtime);
-	if (!elapsed_timers.empty()) {
-		MapNode n;
-		v3s16 p;
-		for (const NodeTimer &elapsed_timer : elapsed_timers) {
-			n = getNodeNoEx(elapsed_timer.position);
-			p = elapsed_timer.position + getPosRelative();
-			if (on_timer_cb(p, n, elapsed_timer.elapsed))
-				setNodeTimer(NodeTimer(elapsed_timer.timeout, 0, elapsed_timer.position));
-		}
+	runNodeTimers(stepNodeTimers(dtime), on_timer_cb);
+}
+
+std::vector<NodeTimer> MapBlock::stepNodeTimers(float dtime)
+{
+	return m_node_timers.step(dtime);
+}
+
+void MapBlock::runNodeTimers(const std::vector<NodeTimer> &elapsed_timers,
+		const std::function<bool(v3s16, MapNode, f32)> &on_timer_cb)
+{
+	MapNode n;
+	v3s16 p;
+	for (const NodeTimer &elapsed_timer : elapsed_timers) {
+		n = getNodeNoEx(elapsed_timer.position);
+		p = elapsed_timer.position + getPosRelative();
+		if (on_timer_cb(p, n, elapsed_timer.elapsed))
+			setNodeTimer(NodeTimer(elapsed_timer.timeout, 0, elapsed_timer.position));
 	}
 }
 
@@ -341,6 +426,34 @@ void MapBlock::copyFrom(const VoxelManipulator &src)
 	// Copy from VoxelManipulator to data
 	src.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+	++m_node_data_version;
+}
+
+void MapBlock::copyNetworkDataFrom(const MapBlock &other)
+{
+	const auto lock = lock_unique_rec();
+	std::copy(other.data, other.data + nodecount, data);
+
+	m_node_metadata.clear();
+	if (other.m_node_metadata.size()) {
+		std::ostringstream os(std::ios_base::binary);
+		other.m_node_metadata.serialize(os, SER_FMT_VER_HIGHEST_WRITE, false);
+		std::istringstream is(os.str(), std::ios_base::binary);
+		m_node_metadata.deSerialize(is, m_gamedef->idef());
+	}
+
+	is_underground = other.is_underground.load();
+	m_lighting_complete = other.m_lighting_complete.load();
+	m_generated = other.m_generated.load();
+	m_is_air_expired = true;
+
+	far_step = other.far_step;
+	content_only = other.content_only.load();
+	content_only_param1 = other.content_only_param1;
+	content_only_param2 = other.content_only_param2;
+	heat = other.heat.load();
+	humidity = other.humidity.load();
+	++m_node_data_version;
 }
 
 void MapBlock::actuallyUpdateIsAir()
@@ -480,7 +593,7 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 	}
 }
 
-void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level, bool use_content_only)
+void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level, bool use_content_only, const BlockDictionary *dict, ContentIdTable *ids)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
@@ -521,6 +634,8 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 		Bulk node data
 	*/
 	NameIdMapping nimap;
+	const bool by_table = ids && version >= 29;
+	u16 table_size = 0;
 	Buffer<u8> buf;
 	const u8 content_width = 2;
 	const u8 params_width = 2;
@@ -528,7 +643,10 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 	{
 		MapNode *tmp_nodes = new MapNode[nodecount];
 		memcpy(tmp_nodes, data, nodecount * sizeof(MapNode));
-		getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
+		if (by_table)
+			table_size = ids->toStored(tmp_nodes, nodecount, nimap);
+		else
+			getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
 
 		buf = MapNode::serializeBulk(version, tmp_nodes, nodecount,
 				content_width, params_width);
@@ -538,6 +656,12 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 		if (version >= 29) {
 			writeU32(os, getTimestamp());
 
+			if (by_table) {
+				// Only the names not in the table follow
+				writeU8(os, ContentIdTable::BLOCK_MAPPING_VERSION);
+				writeU32(os, ids->getId());
+				writeU16(os, table_size);
+			}
 			nimap.serialize(os);
 		}
 	}
@@ -596,7 +720,7 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 
 	if (version >= 29) {
 		// now compress the whole thing
-		compress(os_raw.str(), os_compressed, version, compression_level);
+		compress(os_raw.str(), os_compressed, version, compression_level, dict);
 	}
 }
 
@@ -608,9 +732,11 @@ void MapBlock::serializeNetworkSpecific(std::ostream &os)
 	writeF1000(os, humidity + humidity_add); // deprecated humidity
 }
 
-bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
+bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk, ContentIdTable *ids)
 {
 	const auto lock = lock_unique_rec();
+	// The node data is replaced
+	++m_node_data_version;
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
@@ -642,6 +768,8 @@ bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	m_generated = (flags & 0x08) == 0;
 
 	NameIdMapping nimap;
+	bool by_table = false;
+	u16 table_size = 0;
 	if (disk && version >= 29) {
 		// Timestamp
 		TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
@@ -649,6 +777,16 @@ bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 		setTimestampNoChangedFlag(readU32(is));
 		m_disk_timestamp.store(m_timestamp);
 
+		if (is.peek() == ContentIdTable::BLOCK_MAPPING_VERSION) {
+			is.get();
+			const u32 table_id = readU32(is);
+			table_size = readU16(is);
+			if (!ids || ids->getId() != table_id)
+				throw SerializationError("MapBlock::deSerialize(): block needs content id table " +
+						std::to_string(table_id));
+			by_table = true;
+		}
+
 		// Node/id mapping
 		TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
 				<<": NameIdMapping"<<std::endl);
@@ -756,7 +894,10 @@ bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 		}
 
 		// Dynamically re-set ids based on node names
-		correctBlockNodeIds(&nimap, data, m_gamedef);
+		if (by_table)
+			ids->toRuntime(data, nodecount, table_size, nimap);
+		else
+			correctBlockNodeIds(&nimap, data, m_gamedef);
 
 		if(version >= 25){
 			TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
@@ -764,13 +905,22 @@ bool MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 			m_node_timers.deSerialize(is, version);
 		}
 
-		u16 dummy;
-		m_is_air = nimap.size() == 1 && nimap.getId("air", dummy);
-		m_is_air_expired = false;
+		if (!by_table) {
+			u16 dummy;
+			m_is_air = nimap.size() == 1 && nimap.getId("air", dummy);
+			m_is_air_expired = false;
+		}
 
 		analyzeContent();
 	}
 
+	// The ids are final here. Activation (LBMs) and searches skip blocks
+	// without the contents they want by this set.
+	{
+		const std::lock_guard<std::mutex> present_lock(m_contents_present_mutex);
+		updateContentsPresent();
+	}
+
 	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
 			<<": Done."<<std::endl);
 	return true;
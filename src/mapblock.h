@@ -7,6 +7,7 @@
 #include "config.h"
 
 #include <atomic>
+#include <mutex>
 #include <vector>
 #include "irr_v3d.h"
 #include "mapnode.h"
@@ -28,6 +29,8 @@ class NodeMetadataList;
 class IGameDef;
 class MapBlockMesh;
 class VoxelManipulator;
+class BlockDictionary;
+class ContentIdTable;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
 
@@ -73,6 +76,13 @@ enum ModReason : u32 {
 	MOD_REASON_UNKNOWN                    = 1 << 18,
 };
 
+// Changes which are not in what clients get of the block
+constexpr u32 MOD_REASON_OBJECTS = MOD_REASON_CLEAR_ALL_OBJECTS |
+		MOD_REASON_ADD_ACTIVE_OBJECT_RAW | MOD_REASON_REMOVE_OBJECTS_REMOVE |
+		MOD_REASON_REMOVE_OBJECTS_DEACTIVATE | MOD_REASON_TOO_MANY_OBJECTS |
+		MOD_REASON_STATIC_DATA_ADDED | MOD_REASON_STATIC_DATA_REMOVED |
+		MOD_REASON_STATIC_DATA_CHANGED;
+
 ////
 //// MapBlock itself
 ////
@@ -115,10 +125,12 @@ class MapBlock
 		} else
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = ignoreNode;
+		++m_node_data_version;
 
 		//raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
+	// Writers through the pointer must bump m_node_data_version
 	MapNode* getData()
 	{
 		return data;
@@ -129,7 +141,10 @@ class MapBlock
 	////
 	void raiseModified(u32 mod, u32 reason=MOD_REASON_UNKNOWN, bool important = true)
 	{
+		const u32 version = m_node_data_version;
 		raiseModified(mod, modified_light_no, important);
+		if (!(reason & ~MOD_REASON_OBJECTS))
+			logChange(version);
 #ifdef WTFdebug
 		if (mod > m_modified) {
 			m_modified = mod;
@@ -336,16 +351,22 @@ class MapBlock
 	{
         const auto lock = lock_unique_rec();
 
-		data[z * zstride + y * ystride + x] = n;
+		const u32 version = m_node_data_version;
+		const u32 index = z * zstride + y * ystride + x;
+		data[index] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE, false);
+		logChange(version, index);
 	}
 
 	inline void setNodeNoCheck(v3pos_t p, MapNode n, bool important = false)
 	{
 		const auto lock = lock_unique_rec();
 
-		data[p.Z * zstride + p.Y * ystride + p.X] = n;
+		const u32 version = m_node_data_version;
+		const u32 index = p.Z * zstride + p.Y * ystride + p.X;
+		data[index] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE, important);
+		logChange(version, index);
 	}
 
 	// Copies data to VoxelManipulator to getPosRelative()
@@ -373,6 +394,10 @@ class MapBlock
 	bool saveStaticObject(u16 id, const StaticObject &obj, u32 reason);
 
 	void step(float dtime, const std::function<bool(v3s16, MapNode, f32)> &on_timer_cb);
+	// The two halves of step(), only the second one calls the callbacks
+	std::vector<NodeTimer> stepNodeTimers(float dtime);
+	void runNodeTimers(const std::vector<NodeTimer> &elapsed_timers,
+			const std::function<bool(v3s16, MapNode, f32)> &on_timer_cb);
 
 	////
 	//// Timestamp (see m_timestamp)
@@ -472,10 +497,15 @@ class MapBlock
 	// These don't write or read version by itself
 	// Set disk to true for on-disk format, false for over-the-network format
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
-	void serialize(std::ostream &result, u8 version, bool disk, int compression_level, bool use_content_only = false);
+	// dict (for version >= 29) is the dictionary of the world, if the reader has it
+	// ids (for disk and version >= 29) replaces the id-name mapping of the block
+	void serialize(std::ostream &result, u8 version, bool disk, int compression_level,
+			bool use_content_only = false, const BlockDictionary *dict = nullptr,
+			ContentIdTable *ids = nullptr);
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
-	bool deSerialize(std::istream &is, u8 version, bool disk);
+	// Blocks saved with a content id table can only be read with it
+	bool deSerialize(std::istream &is, u8 version, bool disk, ContentIdTable *ids = nullptr);
 
 	void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
@@ -494,8 +524,13 @@ class MapBlock
 	void fill(const MapNode & n) {
 		for (u32 i = 0; i < nodecount; ++i)
 			data[i] = n;
+		++m_node_data_version;
 	}
 
+	// Copy what deSerialize() of network data and the far block fields
+	// read into another block, which must not be in use
+	void copyNetworkDataFrom(const MapBlock &other);
+
 	using mesh_type = std::shared_ptr<MapBlockMesh>;
 
 #if CHECK_CLIENT_BUILD() // Only on client
@@ -530,6 +565,26 @@ class MapBlock
 
 	// Last really changed time (need send to client)
 	std::atomic_uint m_changed_timestamp{};
+	// Bumped on every change of node data, lets caches derived from the
+	// nodes (pathfinder) notice that they are stale
+	std::atomic_uint32_t m_node_data_version{};
+
+	// Version of what a client got, changes to this load of the block are
+	// told apart by getChangesSince()
+	u64 getChangeStamp() const
+	{
+		return (u64)m_instance_id << 32 | m_node_data_version;
+	}
+	// Indexes into the node data of the nodes changed after the stamp.
+	// False if these are not known and the whole block has to be sent.
+	bool getChangesSince(u64 stamp, std::vector<u16> &indexes);
+	static v3pos_t indexToPos(u16 index)
+	{
+		return v3pos_t(index % MAP_BLOCKSIZE, index / ystride % MAP_BLOCKSIZE,
+				index / zstride);
+	}
+	// Node metadata at p (relative to the block) changed
+	void raiseModifiedNode(v3pos_t p, u32 reason = MOD_REASON_REPORT_META_CHANGE);
 	uint32_t m_next_analyze_timestamp{};
 	typedef std::list<abm_trigger_one> abm_triggers_type;
 	std::unique_ptr<abm_triggers_type> abm_triggers;
@@ -566,15 +621,38 @@ class MapBlock
 
 	MapNode getNodeTry(const v3pos_t &p);
 
-	MapNode &getNodeRef(const v3pos_t &p);
+	// Read only, node data is changed by the setters which bump
+	// m_node_data_version
+	const MapNode &getNodeRef(const v3pos_t &p);
 
-	MapNode &getNodeNoLock(v3pos_t p)
+	const MapNode &getNodeNoLock(v3pos_t p)
 	{
 		return data[p.Z*zstride + p.Y*ystride + p.X];
 	}
 
 	void setNodeNoLock(v3pos_t p, MapNode n, bool important = false);
 
+private:
+	// Called after a change which started at version_before. index is the
+	// changed node, without it the change is not sent to clients. Any other
+	// change of m_node_data_version drops the log.
+	void logChange(u32 version_before, s32 index = -1);
+
+	struct NodeChange
+	{
+		u32 version; // after the change
+		u16 index;
+	};
+	std::mutex m_change_log_mutex;
+	std::vector<NodeChange> m_change_log;
+	// The log has all changes from this version
+	u32 m_change_log_from{};
+	// up to this one
+	u32 m_change_log_version{};
+	inline static std::atomic_uint32_t s_instance_count{};
+	const u32 m_instance_id{++s_instance_count};
+
+public:
 	//===
 
 	bool storeActiveObject(u16 id);
@@ -656,7 +734,31 @@ class MapBlock
 	// Can be empty, in which case nothing was cached yet.
 	std::vector<content_t> contents;
 
+	// Whether pred is true for any content of the nodes. Unlike contents
+	// this is exact, the set is made when the block is deserialized and
+	// again after any change of the node data.
+	template <typename F>
+	bool hasContent(F &&pred)
+	{
+		const auto lock = lock_shared_rec();
+		const std::lock_guard<std::mutex> present_lock(m_contents_present_mutex);
+		if (m_contents_present_version != m_node_data_version)
+			updateContentsPresent();
+		for (const content_t c : m_contents_present)
+			if (pred(c))
+				return true;
+		return false;
+	}
+
 private:
+	// Needs the node data locked and m_contents_present_mutex
+	void updateContentsPresent();
+
+	// Sorted contents of the node data at m_contents_present_version
+	std::mutex m_contents_present_mutex;
+	std::vector<content_t> m_contents_present;
+	u32 m_contents_present_version{U32_MAX};
+
 	// Whether day and night lighting differs
 	bool m_is_air = false;
 	bool m_is_air_expired = true;
@@ -3,6 +3,7 @@
 // Copyright (C) 2014-2018 kwolekr, Ryan Kwolek <kwolekr@minetest.net>
 // Copyright (C) 2015-2018 paramat
 
+#include <algorithm>
 #include <fstream>
 #include "mg_schematic.h"
 #include "server.h"
@@ -77,6 +78,7 @@ ObjDef *Schematic::clone() const
 
 	def->c_nodes = c_nodes;
 	def->flags = flags;
+	def->m_use_layouts = m_use_layouts;
 	def->size = size;
 	FATAL_ERROR_IF(!schemdata, "Schematic can only be cloned after loading");
 	u32 nodecount = size.X * size.Y * size.Z;
@@ -105,46 +107,69 @@ void Schematic::resolveNodeNames()
 		// Unfold condensed ID layout to content_t
 		schemdata[i].setContent(c_nodes[c_original]);
 	}
+
+	invalidateLayouts();
 }
 
 
-void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+// Index of the first node and steps along X and Z of the rotated schematic
+static void get_rotation_steps(v3s16 size, Rotation rot,
+	int *i_start, int *i_step_x, int *i_step_z)
 {
-	assert(schemdata && slice_probs);
-	sanity_check(m_ndef != NULL);
-
 	int xstride = 1;
-	int ystride = size.X;
 	int zstride = size.X * size.Y;
 
-	s16 sx = size.X;
-	s16 sy = size.Y;
-	s16 sz = size.Z;
-
-	int i_start, i_step_x, i_step_z;
 	switch (rot) {
 		case ROTATE_90:
-			i_start  = sx - 1;
-			i_step_x = zstride;
-			i_step_z = -xstride;
-			SWAP(s16, sx, sz);
+			*i_start  = size.X - 1;
+			*i_step_x = zstride;
+			*i_step_z = -xstride;
 			break;
 		case ROTATE_180:
-			i_start  = zstride * (sz - 1) + sx - 1;
-			i_step_x = -xstride;
-			i_step_z = -zstride;
+			*i_start  = zstride * (size.Z - 1) + size.X - 1;
+			*i_step_x = -xstride;
+			*i_step_z = -zstride;
 			break;
 		case ROTATE_270:
-			i_start  = zstride * (sz - 1);
-			i_step_x = -zstride;
-			i_step_z = xstride;
-			SWAP(s16, sx, sz);
+			*i_start  = zstride * (size.Z - 1);
+			*i_step_x = -zstride;
+			*i_step_z = xstride;
 			break;
 		default:
-			i_start  = 0;
-			i_step_x = xstride;
-			i_step_z = zstride;
+			*i_start  = 0;
+			*i_step_x = xstride;
+			*i_step_z = zstride;
 	}
+}
+
+
+void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	assert(schemdata && slice_probs);
+	sanity_check(m_ndef != NULL);
+
+	if (!m_use_layouts || rot >= ROTATE_RAND) {
+		blitNodeByNode(vm, p, rot, force_place);
+		return;
+	}
+
+	auto layout = getLayout(rot);
+	blitLayout(vm, p, *layout, force_place);
+}
+
+
+void Schematic::blitNodeByNode(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	int ystride = size.X;
+
+	s16 sx = size.X;
+	s16 sy = size.Y;
+	s16 sz = size.Z;
+
+	int i_start, i_step_x, i_step_z;
+	get_rotation_steps(size, rot, &i_start, &i_step_x, &i_step_z);
+	if (rot == ROTATE_90 || rot == ROTATE_270)
+		SWAP(s16, sx, sz);
 
 	s16 y_map = p.Y;
 	for (s16 y = 0; y != sy; y++) {
@@ -191,6 +216,131 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 }
 
 
+std::shared_ptr<const SchematicLayout> Schematic::getLayout(Rotation rot)
+{
+	std::lock_guard<std::mutex> lock(m_layouts_mutex);
+	if (!m_layouts[rot])
+		m_layouts[rot] = makeLayout(rot);
+	return m_layouts[rot];
+}
+
+
+std::shared_ptr<const SchematicLayout> Schematic::makeLayout(Rotation rot) const
+{
+	auto layout = std::make_shared<SchematicLayout>();
+
+	int i_start, i_step_x, i_step_z;
+	get_rotation_steps(size, rot, &i_start, &i_step_x, &i_step_z);
+	layout->size = (rot == ROTATE_90 || rot == ROTATE_270) ?
+		v3s16(size.Z, size.Y, size.X) : size;
+	const v3s16 s = layout->size;
+
+	for (s16 y = 0; y != s.Y; y++) {
+		layout->slice_runs.push_back(layout->runs.size());
+		for (s16 z = 0; z != s.Z; z++) {
+			u32 i = z * i_step_z + y * size.X + i_start;
+			bool in_run = false;
+			for (s16 x = 0; x != s.X; x++, i += i_step_x) {
+				const MapNode &n = schemdata[i];
+				const u8 prob = n.param1 & MTSCHEM_PROB_MASK;
+				if (n.getContent() == CONTENT_IGNORE || prob == MTSCHEM_PROB_NEVER) {
+					in_run = false;
+					continue;
+				}
+
+				if (!in_run) {
+					layout->runs.push_back({x, z, 0, (u32)layout->nodes.size(),
+						true, true});
+					in_run = true;
+				}
+				SchematicLayout::Run &run = layout->runs.back();
+				run.length++;
+				run.always &= prob == MTSCHEM_PROB_ALWAYS;
+				run.forced &= (n.param1 & MTSCHEM_FORCE_PLACE) != 0;
+
+				MapNode placed = n;
+				placed.param1 = 0;
+				if (rot)
+					placed.rotateAlongYAxis(m_ndef, rot);
+				layout->nodes.push_back(placed);
+				layout->param1s.push_back(n.param1);
+			}
+		}
+	}
+	layout->slice_runs.push_back(layout->runs.size());
+
+	return layout;
+}
+
+
+// Places the same nodes and draws the same random numbers as blitNodeByNode
+void Schematic::blitLayout(MMVManip *vm, v3s16 p, const SchematicLayout &layout,
+	bool force_place)
+{
+	const VoxelArea &area = vm->m_area;
+
+	s16 y_map = p.Y;
+	for (s16 y = 0; y != layout.size.Y; y++) {
+		if ((slice_probs[y] != MTSCHEM_PROB_ALWAYS) &&
+			(slice_probs[y] <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+			continue;
+
+		if (y_map < area.MinEdge.Y || y_map > area.MaxEdge.Y) {
+			y_map++;
+			continue;
+		}
+
+		for (u32 r = layout.slice_runs[y]; r != layout.slice_runs[y + 1]; r++) {
+			const SchematicLayout::Run &run = layout.runs[r];
+			const s16 z_map = p.Z + run.z;
+			if (z_map < area.MinEdge.Z || z_map > area.MaxEdge.Z)
+				continue;
+
+			// Clip the run to the area
+			const s16 x_map = p.X + run.x;
+			const int x_begin = std::max<int>(x_map, area.MinEdge.X);
+			const int x_end = std::min<int>(x_map + run.length - 1, area.MaxEdge.X);
+			if (x_begin > x_end)
+				continue;
+
+			const u32 first = run.first + (x_begin - x_map);
+			const u32 count = x_end - x_begin + 1;
+			u32 vi = area.index(x_begin, y_map, z_map);
+
+			if (run.always && (force_place || run.forced)) {
+				std::copy_n(&layout.nodes[first], count, &vm->m_data[vi]);
+				continue;
+			}
+
+			for (u32 i = first; i != first + count; i++, vi++) {
+				const u8 param1 = layout.param1s[i];
+				if (!force_place && !(param1 & MTSCHEM_FORCE_PLACE)) {
+					content_t c = vm->m_data[vi].getContent();
+					if (c != CONTENT_AIR && c != CONTENT_IGNORE)
+						continue;
+				}
+
+				const u8 placement_prob = param1 & MTSCHEM_PROB_MASK;
+				if ((placement_prob != MTSCHEM_PROB_ALWAYS) &&
+					(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+					continue;
+
+				vm->m_data[vi] = layout.nodes[i];
+			}
+		}
+		y_map++;
+	}
+}
+
+
+void Schematic::invalidateLayouts()
+{
+	std::lock_guard<std::mutex> lock(m_layouts_mutex);
+	for (auto &layout : m_layouts)
+		layout.reset();
+}
+
+
 bool Schematic::placeOnVManip(MMVManip *vm, v3s16 p, u32 flags,
 	Rotation rot, bool force_place)
 {
@@ -356,6 +506,8 @@ bool Schematic::deserializeFromMts(std::istream *is)
 			schemdata[i].param1 >>= 1;
 	}
 
+	invalidateLayouts();
+
 	return true;
 }
 
@@ -572,6 +724,8 @@ bool Schematic::getSchematicFromMap(Map *map, v3s16 p1, v3s16 p2)
 
 	delete vm;
 
+	invalidateLayouts();
+
 	// Reset and mark as complete
 	NodeResolver::reset(true);
 
@@ -601,6 +755,8 @@ void Schematic::applyProbabilities(v3s16 p0,
 		if (slice < size.Y)
 			slice_probs[slice] = (*splist)[i].second;
 	}
+
+	invalidateLayouts();
 }
 
 
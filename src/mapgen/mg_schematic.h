@@ -6,6 +6,8 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include "mg_decoration.h"
 #include "util/string.h"
 
@@ -76,6 +78,27 @@ enum SchematicFormatType {
 	SCHEM_FMT_LUA,
 };
 
+/*
+	Nodes of a schematic in one rotation, rotated and with param1 cleared,
+	grouped in runs along X. Ignore and never placed nodes are left out.
+*/
+struct SchematicLayout {
+	struct Run {
+		s16 x, z; // of the first node in the rotated schematic
+		u16 length;
+		u32 first; // index in nodes and param1s
+		// Runs where all nodes are placed always and forced are copied at once
+		bool always;
+		bool forced;
+	};
+
+	v3s16 size; // rotated
+	std::vector<MapNode> nodes;
+	std::vector<u8> param1s; // probability and force placement bit
+	std::vector<Run> runs; // by y, z and x
+	std::vector<u32> slice_runs; // first run of each Y slice and the end
+};
+
 class Schematic : public ObjDef, public NodeResolver {
 public:
 	Schematic() = default;
@@ -103,6 +126,12 @@ class Schematic : public ObjDef, public NodeResolver {
 		std::vector<std::pair<v3s16, u8> > *plist,
 		std::vector<std::pair<s16, u8> > *splist);
 
+	// Must be called after changing schemdata of a placed schematic
+	void invalidateLayouts();
+	// When off, nodes are rotated and tested one by one while placing
+	bool getUseLayouts() const { return m_use_layouts; }
+	void setUseLayouts(bool use) { m_use_layouts = use; }
+
 	std::vector<content_t> c_nodes;
 	u32 flags = 0;
 	v3s16 size;
@@ -112,6 +141,17 @@ class Schematic : public ObjDef, public NodeResolver {
 private:
 	// Counterpart to the node resolver: Condense content_t to a sequential "m_nodenames" list
 	void condenseContentIds();
+
+	std::shared_ptr<const SchematicLayout> getLayout(Rotation rot);
+	std::shared_ptr<const SchematicLayout> makeLayout(Rotation rot) const;
+	void blitLayout(MMVManip *vm, v3s16 p, const SchematicLayout &layout,
+		bool force_place);
+	void blitNodeByNode(MMVManip *vm, v3s16 p, Rotation rot, bool force_place);
+
+	bool m_use_layouts = true;
+	std::mutex m_layouts_mutex;
+	// Made on first placement in each rotation
+	std::shared_ptr<const SchematicLayout> m_layouts[ROTATE_RAND];
 };
 
 class SchematicManager : public ObjDefManager {
@@ -0,0 +1,197 @@
+/*
+fm_impairment.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_impairment.h"
+#include <atomic>
+#include <cstring>
+#include "log.h"
+#include "porting.h"
+#include "settings.h"
+#include "util/string.h"
+
+// Datagrams waiting for the link longer than this are dropped
+#define IMPAIRMENT_MAX_BACKLOG_US 1000000
+
+// Largest datagram read from a socket
+#define IMPAIRMENT_BUFFER_SIZE 65536
+
+bool ImpairmentParams::parse(const std::string &str, ImpairmentParams &params)
+{
+	for (const auto &item : str_split(str, ' ')) {
+		if (item.empty())
+			continue;
+		const auto pos = item.find('=');
+		if (pos == std::string::npos)
+			return false;
+		const std::string key = item.substr(0, pos);
+		const std::string value = item.substr(pos + 1);
+
+		if (key == "seed")
+			params.seed = stoi(value);
+		else if (key == "loss")
+			params.loss = stof(value);
+		else if (key == "duplicate")
+			params.duplicate = stof(value);
+		else if (key == "reorder")
+			params.reorder = stof(value);
+		else if (key == "latency_ms")
+			params.latency_ms = stoi(value);
+		else if (key == "jitter_ms")
+			params.jitter_ms = stoi(value);
+		else if (key == "reorder_ms")
+			params.reorder_ms = stoi(value);
+		else if (key == "bandwidth")
+			params.bandwidth = stoi(value);
+		else
+			return false;
+	}
+	return true;
+}
+
+NetworkImpairment::NetworkImpairment(const ImpairmentParams &params) :
+		m_params(params), m_rng(params.seed), m_buffer(IMPAIRMENT_BUFFER_SIZE)
+{
+}
+
+std::unique_ptr<NetworkImpairment> NetworkImpairment::create()
+{
+	if (!g_settings)
+		return nullptr;
+	const std::string setting = g_settings->get("network_impairment");
+	if (setting.empty())
+		return nullptr;
+
+	ImpairmentParams params;
+	if (!ImpairmentParams::parse(setting, params)) {
+		errorstream << "Invalid network_impairment: \"" << setting << "\""
+				<< std::endl;
+		return nullptr;
+	}
+	if (!params.enabled())
+		return nullptr;
+
+	static std::atomic_uint32_t s_sockets{0};
+	params.seed += s_sockets++;
+	warningstream << "Network impairment enabled for a socket: " << setting
+			<< ", seed=" << params.seed << std::endl;
+	return std::make_unique<NetworkImpairment>(params);
+}
+
+bool NetworkImpairment::chance(float probability)
+{
+	// Same numbers on every platform, unlike the std distributions
+	const float value = (m_rng() >> 8) * (1.0f / (1 << 24));
+	return value < probability;
+}
+
+void NetworkImpairment::add(const Address &sender, const void *data, int size,
+		u64 now_us)
+{
+	m_stats.received++;
+	if (chance(m_params.loss)) {
+		m_stats.dropped++;
+		return;
+	}
+
+	int copies = 1;
+	if (chance(m_params.duplicate)) {
+		m_stats.duplicated++;
+		copies = 2;
+	}
+
+	for (int i = 0; i < copies; i++) {
+		u64 delay_us = m_params.latency_ms * 1000;
+		if (m_params.jitter_ms)
+			delay_us += m_rng() % (m_params.jitter_ms * 1000 + 1);
+		if (chance(m_params.reorder)) {
+			m_stats.reordered++;
+			delay_us += m_params.reorder_ms * 1000;
+		}
+
+		u64 sent_us = now_us;
+		if (m_params.bandwidth) {
+			const u64 link_us = std::max(m_link_free_us, now_us);
+			if (link_us - now_us > IMPAIRMENT_MAX_BACKLOG_US) {
+				m_stats.dropped++;
+				continue;
+			}
+			m_link_free_us = link_us + (u64)size * 1000000 / m_params.bandwidth;
+			sent_us = m_link_free_us;
+		}
+
+		m_held.push(Held{sent_us + delay_us, m_order++, sender,
+				std::string((const char *)data, size)});
+	}
+}
+
+int NetworkImpairment::take(Address &sender, void *data, int size, u64 now_us)
+{
+	if (m_held.empty() || m_held.top().due_us > now_us)
+		return -1;
+
+	const Held &held = m_held.top();
+	const int copied = std::min<int>(size, held.data.size());
+	memcpy(data, held.data.data(), copied);
+	sender = held.sender;
+	m_held.pop();
+	m_stats.delivered++;
+	return copied;
+}
+
+s64 NetworkImpairment::untilNext(u64 now_us) const
+{
+	if (m_held.empty())
+		return -1;
+	const u64 due_us = m_held.top().due_us;
+	return due_us > now_us ? due_us - now_us : 0;
+}
+
+int NetworkImpairment::receive(Address &sender, void *data, int size,
+		int timeout_ms, const ReadFunc &read)
+{
+	const u64 start_ms = porting::getTimeMs();
+	int reads = 0;
+	for (;;) {
+		u64 now_us = porting::getTimeUs();
+		int taken = take(sender, data, size, now_us);
+		if (taken >= 0)
+			return taken;
+
+		const s64 left_ms = std::max<s64>(
+				timeout_ms - (s64)(porting::getTimeMs() - start_ms), 0);
+		// Don't keep reading a flood without a timeout
+		if (left_ms == 0 && reads > IMPAIRMENT_BUFFER_SIZE / 256)
+			return -1;
+
+		const s64 next_us = untilNext(now_us);
+		const int wait_ms = next_us < 0 ? left_ms :
+				std::min<s64>(left_ms, (next_us + 999) / 1000);
+
+		Address from;
+		int received = read(from, m_buffer.data(), m_buffer.size(), wait_ms);
+		if (received >= 0) {
+			reads++;
+			add(from, m_buffer.data(), received, porting::getTimeUs());
+		} else if (wait_ms >= left_ms) {
+			return take(sender, data, size, porting::getTimeUs());
+		}
+	}
+}
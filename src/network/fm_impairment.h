@@ -0,0 +1,121 @@
+/*
+fm_impairment.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "network/address.h"
+
+struct ImpairmentParams
+{
+	u32 seed = 0;
+	// Chances per datagram
+	float loss = 0;
+	float duplicate = 0;
+	float reorder = 0; // held back for reorder_ms more
+	u32 latency_ms = 0;
+	u32 jitter_ms = 0; // random extra latency up to this
+	u32 reorder_ms = 0;
+	u32 bandwidth = 0; // bytes per second, 0 is unlimited
+
+	bool enabled() const
+	{
+		return loss > 0 || duplicate > 0 || reorder > 0 || latency_ms ||
+				jitter_ms || bandwidth;
+	}
+
+	// Reads "loss=0.05 latency_ms=50 ...", false on unknown keys
+	static bool parse(const std::string &str, ImpairmentParams &params);
+};
+
+struct ImpairmentStats
+{
+	u64 received = 0;
+	u64 dropped = 0;
+	u64 duplicated = 0;
+	u64 reordered = 0;
+	u64 delivered = 0;
+};
+
+/*
+	Simulates a bad network link in the process, for the datagrams a socket
+	receives. They are dropped, duplicated, delayed and reordered by chance
+	and held back to fit a bandwidth. The same seed makes the same choices
+	for the same datagrams.
+*/
+class NetworkImpairment
+{
+public:
+	NetworkImpairment(const ImpairmentParams &params);
+
+	// From the network_impairment setting, nullptr when it's empty. Every
+	// socket gets its own seed, counting up from the configured one.
+	static std::unique_ptr<NetworkImpairment> create();
+
+	// A datagram arrived from the socket
+	void add(const Address &sender, const void *data, int size, u64 now_us);
+	// A datagram due by now_us, returns its size or -1 if there is none
+	int take(Address &sender, void *data, int size, u64 now_us);
+	// Microseconds until the next datagram is due, -1 if none is held
+	s64 untilNext(u64 now_us) const;
+
+	// Reads datagrams from the socket, waiting at most timeout_ms, returns
+	// -1 if none came
+	using ReadFunc = std::function<int(Address &sender, void *data, int size,
+			int timeout_ms)>;
+	// Like the Receive() of a socket, with read() getting the datagrams
+	int receive(Address &sender, void *data, int size, int timeout_ms,
+			const ReadFunc &read);
+
+	const ImpairmentParams &getParams() const { return m_params; }
+	const ImpairmentStats &getStats() const { return m_stats; }
+
+private:
+	struct Held
+	{
+		u64 due_us;
+		u64 order; // keeps datagrams due at once in arrival order
+		Address sender;
+		std::string data;
+
+		bool operator>(const Held &other) const
+		{
+			return due_us != other.due_us ? due_us > other.due_us :
+					order > other.order;
+		}
+	};
+
+	bool chance(float probability);
+
+	const ImpairmentParams m_params;
+	std::mt19937 m_rng;
+	std::priority_queue<Held, std::vector<Held>, std::greater<Held>> m_held;
+	u64 m_order = 0;
+	u64 m_link_free_us = 0;
+	ImpairmentStats m_stats;
+	std::vector<char> m_buffer;
+};
@@ -7,7 +7,7 @@
 #include "../msgpack_fix.h"
 #include "../config.h"
 
-#define CLIENT_PROTOCOL_VERSION_FM 2
+#define CLIENT_PROTOCOL_VERSION_FM 4
 #define SERVER_PROTOCOL_VERSION_FM 0
 
 enum
@@ -41,6 +41,20 @@ enum
 	TOCLIENT_BLOCKDATA_CONTENT_ONLY_PARAM2
 };
 
+/*
+	Nodes of a block changed after the client got it, for clients of
+	CLIENT_PROTOCOL_VERSION_FM >= 3
+	v3bpos_t pos
+	u16 count
+	count times:
+		u16 index into the node data
+		u16 param0
+		u8 param1
+		u8 param2
+	u32 len + zlib compressed NodeMetadataList of the changed nodes
+*/
+#define TOCLIENT_BLOCK_DELTA 0x13
+
 enum
 {
 	TOCLIENT_ADDNODE_POS,
@@ -158,79 +158,87 @@ void ReliablePacketBuffer::print()
 {
 	MutexAutoLock listlock(m_list_mutex);
 	LOG(dout_con<<"Dump of ReliablePacketBuffer:" << std::endl);
+	if (m_packets.empty())
+		return;
 	unsigned int index = 0;
-	for (BufferedPacketPtr &packet : m_list) {
-		LOG(dout_con<<index<< ":" << packet->getSeqnum() << std::endl);
-		index++;
+	for (u16 seqnum = m_first; ; seqnum++) {
+		if (m_packets.find(seqnum)) {
+			LOG(dout_con<<index<< ":" << seqnum << std::endl);
+			index++;
+		}
+		if (seqnum == m_last)
+			break;
 	}
 }
 
 bool ReliablePacketBuffer::empty()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	return m_list.empty();
+	return m_packets.empty();
 }
 
 u32 ReliablePacketBuffer::size()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	return m_list.size();
+	return m_packets.size();
 }
 
-ReliablePacketBuffer::FindResult ReliablePacketBuffer::findPacketNoLock(u16 seqnum)
+ReliablePacketBuffer::Entry *ReliablePacketBuffer::findNoLock(
+		const QueuedEntry &queued)
 {
-	for (auto it = m_list.begin(); it != m_list.end(); ++it) {
-		if ((*it)->getSeqnum() == seqnum)
-			return it;
-	}
-	return m_list.end();
+	Entry *entry = m_packets.find(queued.seqnum);
+	return entry && entry->serial == queued.serial ? entry : nullptr;
 }
 
 bool ReliablePacketBuffer::getFirstSeqnum(u16& result)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (m_list.empty())
+	if (m_packets.empty())
 		return false;
-	result = m_list.front()->getSeqnum();
+	result = m_first;
 	return true;
 }
 
+BufferedPacketPtr ReliablePacketBuffer::popNoLock(u16 seqnum)
+{
+	Entry *entry = m_packets.find(seqnum);
+	BufferedPacketPtr p = std::move(entry->packet);
+	p->time = m_clock - entry->send_time;
+	p->totaltime = m_clock - entry->insert_time;
+	m_packets.erase(seqnum);
+
+	if (m_packets.empty()) {
+		// Everything queued refers to removed packets
+		m_by_age.clear();
+		m_resend_queues.clear();
+	} else if (seqnum == m_first) {
+		// All packets are between m_first and m_last
+		do {
+			m_first++;
+		} while (!m_packets.find(m_first));
+	}
+	return p;
+}
+
 BufferedPacketPtr ReliablePacketBuffer::popFirst()
 {
 	MutexAutoLock listlock(m_list_mutex);
-	if (m_list.empty())
+	if (m_packets.empty())
 		throw NotFoundException("Buffer is empty");
 
-	BufferedPacketPtr p(m_list.front());
-	m_list.pop_front();
-
-	if (m_list.empty()) {
-		m_oldest_non_answered_ack = 0;
-	} else {
-		m_oldest_non_answered_ack = m_list.front()->getSeqnum();
-	}
-	return p;
+	return popNoLock(m_first);
 }
 
 BufferedPacketPtr ReliablePacketBuffer::popSeqnum(u16 seqnum)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	auto r = findPacketNoLock(seqnum);
-	if (r == m_list.end()) {
+	if (!m_packets.find(seqnum)) {
 		LOG(dout_con<<"Sequence number: " << seqnum
 				<< " not found in reliable buffer"<<std::endl);
 		throw NotFoundException("seqnum not found in buffer");
 	}
 
-	BufferedPacketPtr p(*r);
-	m_list.erase(r);
-
-	if (m_list.empty()) {
-		m_oldest_non_answered_ack = 0;
-	} else {
-		m_oldest_non_answered_ack = m_list.front()->getSeqnum();
-	}
-	return p;
+	return popNoLock(seqnum);
 }
 
 void ReliablePacketBuffer::insert(BufferedPacketPtr &p_ptr, u16 next_expected)
@@ -262,47 +270,11 @@ void ReliablePacketBuffer::insert(BufferedPacketPtr &p_ptr, u16 next_expected)
 		return;
 	}
 
-	sanity_check(m_list.size() <= SEQNUM_MAX); // FIXME: Handle the error?
-
-	// Find the right place for the packet and insert it there
-	// If list is empty, just add it
-	if (m_list.empty()) {
-		m_list.push_back(p_ptr);
-		m_oldest_non_answered_ack = seqnum;
-		// Done.
-		return;
-	}
-
-	// Otherwise find the right place
-	auto it = m_list.begin();
-	// Find the first packet in the list which has a higher seqnum
-	u16 s = (*it)->getSeqnum();
-
-	/* case seqnum is smaller then next_expected seqnum */
-	/* this is true e.g. on wrap around */
-	if (seqnum < next_expected) {
-		while(((s < seqnum) || (s >= next_expected)) && (it != m_list.end())) {
-			++it;
-			if (it != m_list.end())
-				s = (*it)->getSeqnum();
-		}
-	}
-	/* non wrap around case (at least for incoming and next_expected */
-	else
-	{
-		while(((s < seqnum) && (s >= next_expected)) && (it != m_list.end())) {
-			++it;
-			if (it != m_list.end())
-				s = (*it)->getSeqnum();
-		}
-	}
-
-	if (s == seqnum) {
+	if (Entry *existing = m_packets.find(seqnum)) {
 		/* nothing to do this seems to be a resent packet */
 		/* for paranoia reason data should be compared */
-		auto &i = *it;
+		auto &i = existing->packet;
 		if (
-			(i->getSeqnum() != seqnum) ||
 			(i->size() != p.size()) ||
 			(i->address != p.address)
 			)
@@ -325,34 +297,78 @@ void ReliablePacketBuffer::insert(BufferedPacketPtr &p_ptr, u16 next_expected)
 			warningstream << buf << std::flush;
 			throw IncomingDataCorruption("duplicated packet isn't same as original one");
 		}
+		return;
 	}
-	/* insert or push back */
-	else if (it != m_list.end()) {
-		m_list.insert(it, p_ptr);
-	} else {
-		m_list.push_back(p_ptr);
+
+	// All seqnums of the window have their own slot
+	Entry *new_entry = m_packets.get(seqnum);
+	if (!new_entry) {
+		errorstream << "ReliablePacketBuffer::insert(): no room for seqnum "
+			<< seqnum << std::endl;
+		return;
 	}
+	Entry &entry = *new_entry;
+	if (m_packets.size() == 1) {
+		m_first = m_last = seqnum;
+	} else {
+		if (seqnum_higher(m_first, seqnum))
+			m_first = seqnum;
+		if (seqnum_higher(seqnum, m_last))
+			m_last = seqnum;
+	}
+	entry.packet = p_ptr;
+	entry.serial = m_next_serial++;
+	entry.insert_time = entry.send_time = m_clock;
+
+	const QueuedEntry queued{seqnum, entry.serial};
+	m_by_age.push_back(queued);
+	if (m_resend_queues.size() <= p.resend_count)
+		m_resend_queues.resize(p.resend_count + 1);
+	m_resend_queues[p.resend_count].push_back(queued);
+
+	if (m_by_age.size() > 2 * m_packets.size() + 64)
+		compactQueuesNoLock();
+}
+
+void ReliablePacketBuffer::compactQueuesNoLock()
+{
+	auto compact = [this] (std::deque<QueuedEntry> &queue, int resend_count) {
+		std::deque<QueuedEntry> live;
+		for (const QueuedEntry &queued : queue) {
+			Entry *entry = findNoLock(queued);
+			if (entry && (resend_count < 0 ||
+					entry->packet->resend_count == (unsigned int)resend_count))
+				live.push_back(queued);
+		}
+		queue.swap(live);
+	};
 
-	/* update last packet number */
-	m_oldest_non_answered_ack = m_list.front()->getSeqnum();
+	compact(m_by_age, -1);
+	for (size_t i = 0; i < m_resend_queues.size(); i++)
+		compact(m_resend_queues[i], i);
 }
 
 void ReliablePacketBuffer::incrementTimeouts(float dtime)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	for (auto &packet : m_list) {
-		packet->time += dtime;
-		packet->totaltime += dtime;
-	}
+	m_clock += dtime;
 }
 
 u32 ReliablePacketBuffer::getTimedOuts(float timeout)
 {
 	MutexAutoLock listlock(m_list_mutex);
+	while (!m_by_age.empty() && !findNoLock(m_by_age.front()))
+		m_by_age.pop_front();
+
+	// The oldest packets come first
 	u32 count = 0;
-	for (auto &packet : m_list) {
-		if (packet->totaltime >= timeout)
-			count++;
+	for (const QueuedEntry &queued : m_by_age) {
+		const Entry *entry = findNoLock(queued);
+		if (!entry)
+			continue;
+		if (m_clock - entry->insert_time < timeout)
+			break;
+		count++;
 	}
 	return count;
 }
@@ -361,22 +377,57 @@ std::vector<ConstSharedPtr<BufferedPacket>>
 	ReliablePacketBuffer::getResend(float timeout, u32 max_packets)
 {
 	MutexAutoLock listlock(m_list_mutex);
-	std::vector<ConstSharedPtr<BufferedPacket>> timed_outs;
-	for (auto &packet : m_list) {
+
+	// Due packets of every queue, these are the first ones of a queue
+	std::vector<std::pair<u16, Entry *>> due;
+	for (size_t resend_count = 0; resend_count < m_resend_queues.size(); resend_count++) {
+		auto &queue = m_resend_queues[resend_count];
+		auto is_queued = [&] (const QueuedEntry &queued) -> Entry * {
+			Entry *entry = findNoLock(queued);
+			return entry && entry->packet->resend_count == resend_count ?
+					entry : nullptr;
+		};
+		while (!queue.empty() && !is_queued(queue.front()))
+			queue.pop_front();
+
 		// resend time scales exponentially with each cycle
-		const float pkt_timeout = timeout * powf(RESEND_SCALE_BASE, packet->resend_count);
+		const float pkt_timeout = timeout * powf(RESEND_SCALE_BASE, resend_count);
+		for (const QueuedEntry &queued : queue) {
+			Entry *entry = is_queued(queued);
+			if (!entry)
+				continue;
+			if (m_clock - entry->send_time < pkt_timeout)
+				break;
+			due.emplace_back((u16)(queued.seqnum - m_first), entry);
+		}
+	}
 
-		if (packet->time < pkt_timeout)
-			continue;
+	// Oldest seqnums first
+	if (due.size() > max_packets) {
+		std::nth_element(due.begin(), due.begin() + max_packets, due.end(),
+				[] (const auto &a, const auto &b) { return a.first < b.first; });
+		due.resize(max_packets);
+	}
+	std::sort(due.begin(), due.end(),
+			[] (const auto &a, const auto &b) { return a.first < b.first; });
+
+	std::vector<ConstSharedPtr<BufferedPacket>> timed_outs;
+	timed_outs.reserve(due.size());
+	for (auto &it : due) {
+		Entry *entry = it.second;
+		BufferedPacketPtr &packet = entry->packet;
 
 		// caller will resend packet so reset time and increase counter
+		entry->send_time = m_clock;
 		packet->time = 0.0f;
+		packet->totaltime = m_clock - entry->insert_time;
 		packet->resend_count++;
+		if (m_resend_queues.size() <= packet->resend_count)
+			m_resend_queues.resize(packet->resend_count + 1);
+		m_resend_queues[packet->resend_count].push_back(
+				{packet->getSeqnum(), entry->serial});
 
 		timed_outs.emplace_back(packet);
-
-		if (timed_outs.size() >= max_packets)
-			break;
 	}
 	return timed_outs;
 }
@@ -427,14 +478,6 @@ SharedBuffer<u8> IncomingSplitPacket::reassemble()
 	IncomingSplitBuffer
 */
 
-IncomingSplitBuffer::~IncomingSplitBuffer()
-{
-	MutexAutoLock listlock(m_map_mutex);
-	for (auto &i : m_buf) {
-		delete i.second;
-	}
-}
-
 SharedBuffer<u8> IncomingSplitBuffer::insert(BufferedPacketPtr &p_ptr, bool reliable)
 {
 	MutexAutoLock listlock(m_map_mutex);
@@ -461,14 +504,30 @@ SharedBuffer<u8> IncomingSplitBuffer::insert(BufferedPacketPtr &p_ptr, bool reli
 		return SharedBuffer<u8>();
 	}
 
-	// Add if doesn't exist
-	IncomingSplitPacket *sp;
-	if (m_buf.find(seqnum) == m_buf.end()) {
-		sp = new IncomingSplitPacket(chunk_count, reliable);
-		m_buf[seqnum] = sp;
-	} else {
-		sp = m_buf[seqnum];
+	// Add if doesn't exist. When both need the same slot the unreliable one
+	// goes, or the older of two unreliable ones. Chunks of reliable ones are
+	// acknowledged already and never sent again, they make the buffer grow.
+	u16 taken_by;
+	auto *sp_slot = m_buf.get(seqnum, &taken_by);
+	if (!sp_slot) {
+		const bool taken_reliable = (*m_buf.find(taken_by))->reliable;
+		if (taken_reliable && reliable) {
+			sp_slot = m_buf.getGrowing(seqnum);
+		} else if (taken_reliable || (!reliable && seqnum_higher(taken_by, seqnum))) {
+			errorstream << "IncomingSplitBuffer::insert(): dropping unreliable "
+					"split packet seqnum=" << seqnum << std::endl;
+			return SharedBuffer<u8>();
+		} else {
+			errorstream << "IncomingSplitBuffer::insert(): dropping unreliable "
+					"split packet seqnum=" << taken_by << std::endl;
+			m_buf.erase(taken_by);
+			sp_slot = m_buf.get(seqnum);
+		}
 	}
+	auto &sp_ptr = *sp_slot;
+	if (!sp_ptr)
+		sp_ptr = std::make_unique<IncomingSplitPacket>(chunk_count, reliable);
+	IncomingSplitPacket *sp = sp_ptr.get();
 
 	if (chunk_count != sp->chunk_count) {
 		errorstream << "IncomingSplitBuffer::insert(): chunk_count="
@@ -497,7 +556,6 @@ SharedBuffer<u8> IncomingSplitBuffer::insert(BufferedPacketPtr &p_ptr, bool reli
 
 	// Remove sp from buffer
 	m_buf.erase(seqnum);
-	delete sp;
 
 	return fulldata;
 }
@@ -506,25 +564,26 @@ void IncomingSplitBuffer::removeUnreliableTimedOuts(float dtime, float timeout)
 {
 	MutexAutoLock listlock(m_map_mutex);
 	std::vector<u16> remove_queue;
-	{
-		for (const auto &i : m_buf) {
-			IncomingSplitPacket *p = i.second;
-			// Reliable ones are not removed by timeout
-			if (p->reliable)
-				continue;
-			p->time += dtime;
-			if (p->time >= timeout)
-				remove_queue.push_back(i.first);
-		}
-	}
+	m_buf.forEach([&] (u16 seqnum, std::unique_ptr<IncomingSplitPacket> &p) {
+		// Reliable ones are not removed by timeout
+		if (p->reliable)
+			return;
+		p->time += dtime;
+		if (p->time >= timeout)
+			remove_queue.push_back(seqnum);
+	});
 	for (u16 j : remove_queue) {
 		LOG(dout_con<<"NOTE: Removing timed out unreliable split packet"<<std::endl);
-		auto it = m_buf.find(j);
-		delete it->second;
-		m_buf.erase(it);
+		m_buf.erase(j);
 	}
 }
 
+u32 IncomingSplitBuffer::capacity()
+{
+	MutexAutoLock listlock(m_map_mutex);
+	return m_buf.capacity();
+}
+
 /*
 	ConnectionCommand
  */
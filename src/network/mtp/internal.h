@@ -5,6 +5,8 @@
 #pragma once
 
 #include "network/mtp/impl.h"
+#include <deque>
+#include <memory>
 
 // Constant that differentiates the protocol from random data and other protocols
 #define PROTOCOL_ID 0x4f457403
@@ -98,6 +100,28 @@ with a buffer in the receiving and transmitting end.
 #define SEQNUM_INITIAL 65500
 #define SEQNUM_MAX 65535
 
+/*
+ * Window sizes to use, in packets (not bytes!).
+ * 0xFFFF is theoretical maximum. don't think about
+ * touching it, the less you're away from it the more likely data corruption
+ * will occur
+ *
+ * Note: window sizes directly translate to maximum possible throughput, e.g.
+ *       (2048 * 512 bytes) / 33ms = 15 MiB/s
+ */
+
+// Due to backwards compatibility we have different window sizes for what we'll
+// accept from peers vs. what we use for sending.
+#define MAX_RELIABLE_WINDOW_SIZE 0x8000
+#define MAX_RELIABLE_WINDOW_SIZE_SEND 2048
+/* starting value for window size */
+#define START_RELIABLE_WINDOW_SIZE 64
+/* minimum value for window size */
+#define MIN_RELIABLE_WINDOW_SIZE 32
+
+/* split packets being reassembled at once, older ones are dropped */
+#define MAX_INCOMING_SPLIT_PACKETS 1024
+
 namespace con
 {
 
@@ -238,8 +262,148 @@ struct IncomingSplitPacket
 };
 
 /*
-	A buffer which stores reliable packets and sorts them internally
-	for fast access to the smallest one.
+	Values keyed by sequence number, stored at seqnum modulo the capacity.
+	The capacity is a power of two and grows when two sequence numbers in
+	use would get the same slot, up to max_capacity. It shrinks again once
+	few values are left.
+*/
+template <typename T>
+class SeqnumRing
+{
+public:
+	explicit SeqnumRing(u32 max_capacity) :
+		m_slots(MIN_CAPACITY), m_max_capacity(max_capacity)
+	{
+		sanity_check(max_capacity >= MIN_CAPACITY && max_capacity <= SEQNUM_MAX + 1);
+		sanity_check((max_capacity & (max_capacity - 1)) == 0);
+	}
+
+	T *find(u16 seqnum)
+	{
+		Slot &s = slot(seqnum);
+		return s.used && s.seqnum == seqnum ? &s.value : nullptr;
+	}
+
+	// Adds a default value if seqnum is not there.
+	// nullptr if another seqnum has its slot at the maximum capacity,
+	// that one is stored to taken_by.
+	T *get(u16 seqnum, u16 *taken_by = nullptr)
+	{
+		return getUpTo(seqnum, m_max_capacity, taken_by);
+	}
+
+	// Like get(), grows past the maximum capacity instead of failing
+	T *getGrowing(u16 seqnum)
+	{
+		return getUpTo(seqnum, SEQNUM_MAX + 1, nullptr);
+	}
+
+	void erase(u16 seqnum)
+	{
+		Slot &s = slot(seqnum);
+		if (!s.used || s.seqnum != seqnum)
+			return;
+		s = Slot();
+		m_count--;
+		if (m_count <= m_shrink_at)
+			shrink();
+	}
+
+	template <typename F>
+	void forEach(F &&f)
+	{
+		for (Slot &s : m_slots)
+			if (s.used)
+				f(s.seqnum, s.value);
+	}
+
+	u32 size() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+	u32 capacity() const { return m_slots.size(); }
+
+private:
+	static constexpr u32 MIN_CAPACITY = 16;
+
+	struct Slot
+	{
+		T value{};
+		u16 seqnum = 0;
+		bool used = false;
+	};
+
+	Slot &slot(u16 seqnum) { return m_slots[seqnum & (m_slots.size() - 1)]; }
+
+	T *getUpTo(u16 seqnum, u32 max_capacity, u16 *taken_by)
+	{
+		while (slot(seqnum).used && slot(seqnum).seqnum != seqnum) {
+			if (m_slots.size() >= max_capacity) {
+				if (taken_by)
+					*taken_by = slot(seqnum).seqnum;
+				return nullptr;
+			}
+			resize(m_slots.size() * 2);
+		}
+		Slot &s = slot(seqnum);
+		if (!s.used) {
+			s.used = true;
+			s.seqnum = seqnum;
+			m_count++;
+		}
+		return &s.value;
+	}
+
+	// Whether no two values would share a slot
+	bool fits(u32 capacity) const
+	{
+		std::vector<bool> used(capacity);
+		for (const Slot &s : m_slots) {
+			if (!s.used)
+				continue;
+			if (used[s.seqnum & (capacity - 1)])
+				return false;
+			used[s.seqnum & (capacity - 1)] = true;
+		}
+		return true;
+	}
+
+	void resize(u32 capacity)
+	{
+		std::vector<Slot> old(capacity);
+		old.swap(m_slots);
+		for (Slot &s : old)
+			if (s.used)
+				slot(s.seqnum) = std::move(s);
+		m_shrink_at = m_slots.size() > MIN_CAPACITY ? m_slots.size() / 8 : 0;
+	}
+
+	// To a quarter filled if the values do not share slots then
+	void shrink()
+	{
+		u32 capacity = MIN_CAPACITY;
+		while (capacity < m_count * 4)
+			capacity *= 2;
+		if (capacity < m_slots.size() && fits(capacity)) {
+			resize(capacity);
+			return;
+		}
+		// Try again with half as many values
+		m_shrink_at = m_count / 2;
+	}
+
+	std::vector<Slot> m_slots;
+	u32 m_max_capacity;
+	u32 m_count = 0;
+	// Shrinks when m_count gets down to this
+	u32 m_shrink_at = 0;
+};
+
+/*
+	A buffer which stores reliable packets by sequence number, with fast
+	access to the smallest one.
+
+	Packets due for a resend are found from queues of packets in the order
+	they were sent, one for every resend count, as all packets of a queue
+	wait for the same time.
 */
 
 class ReliablePacketBuffer
@@ -262,13 +426,38 @@ class ReliablePacketBuffer
 
 
 private:
-	typedef std::list<BufferedPacketPtr>::iterator FindResult;
-
-	FindResult findPacketNoLock(u16 seqnum);
-
-	std::list<BufferedPacketPtr> m_list;
-
-	u16 m_oldest_non_answered_ack;
+	struct Entry
+	{
+		BufferedPacketPtr packet;
+		u32 serial = 0; // tells apart packets with the same seqnum
+		// Values of m_clock
+		double insert_time = 0;
+		double send_time = 0;
+	};
+
+	// Refers to an Entry, outdated when it was removed or resent since
+	struct QueuedEntry
+	{
+		u16 seqnum;
+		u32 serial;
+	};
+
+	Entry *findNoLock(const QueuedEntry &queued);
+	BufferedPacketPtr popNoLock(u16 seqnum);
+	void compactQueuesNoLock();
+
+	SeqnumRing<Entry> m_packets{MAX_RELIABLE_WINDOW_SIZE};
+	// Smallest seqnum in the buffer, and one at least as big as any
+	u16 m_first = 0;
+	u16 m_last = 0;
+	u32 m_next_serial = 0;
+	// Sum of incrementTimeouts(), packet times are derived from it
+	double m_clock = 0;
+
+	// In the order of insertion
+	std::deque<QueuedEntry> m_by_age;
+	// Index is the resend count, in the order of sending
+	std::vector<std::deque<QueuedEntry>> m_resend_queues;
 
 	std::mutex m_list_mutex;
 };
@@ -280,8 +469,6 @@ class ReliablePacketBuffer
 class IncomingSplitBuffer
 {
 public:
-	~IncomingSplitBuffer();
-
 	/*
 		Returns a reference counted buffer of length != 0 when a full split
 		packet is constructed. If not, returns one of length 0.
@@ -290,9 +477,11 @@ class IncomingSplitBuffer
 
 	void removeUnreliableTimedOuts(float dtime, float timeout);
 
+	// Slots for split packets, for testing
+	u32 capacity();
+
 private:
-	// Key is seqnum
-	std::map<u16, IncomingSplitPacket*> m_buf;
+	SeqnumRing<std::unique_ptr<IncomingSplitPacket>> m_buf{MAX_INCOMING_SPLIT_PACKETS};
 
 	std::mutex m_map_mutex;
 };
@@ -342,25 +531,6 @@ struct ConnectionCommand
 	static ConnectionCommandPtr create(ConnectionCommandType type);
 };
 
-/*
- * Window sizes to use, in packets (not bytes!).
- * 0xFFFF is theoretical maximum. don't think about
- * touching it, the less you're away from it the more likely data corruption
- * will occur
- *
- * Note: window sizes directly translate to maximum possible throughput, e.g.
- *       (2048 * 512 bytes) / 33ms = 15 MiB/s
- */
-
-// Due to backwards compatibility we have different window sizes for what we'll
-// accept from peers vs. what we use for sending.
-#define MAX_RELIABLE_WINDOW_SIZE 0x8000
-#define MAX_RELIABLE_WINDOW_SIZE_SEND 2048
-/* starting value for window size */
-#define START_RELIABLE_WINDOW_SIZE 64
-/* minimum value for window size */
-#define MIN_RELIABLE_WINDOW_SIZE 32
-
 class Channel
 {
 
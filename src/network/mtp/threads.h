@@ -63,7 +63,9 @@ class ConnectionSendThread : public Thread
 private:
 	void runTimeouts(float dtime, u32 peer_packet_quota);
 	void resendReliable(Channel &channel, const BufferedPacket *k, float resend_timeout);
+	// Queues the packet for flushSend()
 	void rawSend(const BufferedPacket *p);
+	void flushSend();
 	bool rawSendAsPacket(session_t peer_id, u8 channelnum,
 			const SharedBuffer<u8> &data, bool reliable);
 
@@ -96,6 +98,10 @@ class ConnectionSendThread : public Thread
 	unsigned int m_iteration_packets_avaialble;
 	unsigned int m_max_data_packets_per_iteration;
 	unsigned int m_max_packets_requeued = 256;
+
+	// Datagrams waiting for flushSend(), with their data one after another
+	std::vector<UDPSocket::Datagram> m_send_batch;
+	std::vector<u8> m_send_data;
 };
 
 class ConnectionReceiveThread : public Thread
@@ -113,6 +119,8 @@ class ConnectionReceiveThread : public Thread
 
 private:
 	void receive(SharedBuffer<u8> &packetdata, bool &packet_queued);
+	void receiveDatagram(const Address &sender, const u8 *packetdata,
+			s32 received_size, bool &packet_queued);
 
 	// Returns next data from a buffer if possible
 	// If found, returns true; if not, false.
@@ -15,6 +15,7 @@
 #include "constants.h"
 #include "debug.h"
 #include "log.h"
+#include "network/fm_impairment.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -102,6 +103,8 @@ bool UDPSocket::init(bool ipv6, bool noExceptions)
 
 	setTimeoutMs(0);
 
+	m_impairment = NetworkImpairment::create();
+
 	if (m_addr_family == AF_INET6) {
 		// Allow our socket to accept both IPv4 and IPv6 connections
 		// required on Windows:
@@ -165,6 +168,36 @@ void UDPSocket::Bind(Address addr)
 	}
 }
 
+// Returns the size of the address written to storage
+static socklen_t toSockaddr(const Address &destination, sockaddr_storage &storage)
+{
+	memset(&storage, 0, sizeof(storage));
+	if (destination.getFamily() == AF_INET6) {
+		auto &address = reinterpret_cast<sockaddr_in6 &>(storage);
+		address = destination.getAddress6();
+		address.sin6_family = AF_INET6;
+		address.sin6_port = htons(destination.getPort());
+		return sizeof(sockaddr_in6);
+	}
+
+	auto &address = reinterpret_cast<sockaddr_in &>(storage);
+	address = destination.getAddress();
+	address.sin_family = AF_INET;
+	address.sin_port = htons(destination.getPort());
+	return sizeof(sockaddr_in);
+}
+
+static bool fromSockaddr(const sockaddr_storage &storage, Address &sender)
+{
+	if (storage.ss_family == AF_INET6)
+		sender = reinterpret_cast<const sockaddr_in6 &>(storage);
+	else if (storage.ss_family == AF_INET)
+		sender = reinterpret_cast<const sockaddr_in &>(storage);
+	else
+		return false;
+	return true;
+}
+
 void UDPSocket::Send(const Address &destination, const void *data, int size)
 {
 	bool dumping_packet = false; // for INTERNET_SIMULATOR
@@ -182,80 +215,179 @@ void UDPSocket::Send(const Address &destination, const void *data, int size)
 	if (destination.getFamily() != m_addr_family)
 		throw SendFailedException("Address family mismatch");
 
-	int sent;
-	if (m_addr_family == AF_INET6) {
-		struct sockaddr_in6 address = {};
-		address.sin6_family = AF_INET6;
-		address = destination.getAddress6();
-		address.sin6_port = htons(destination.getPort());
-
-		sent = sendto(m_handle, (const char *)data, size, 0,
-				(struct sockaddr *)&address, sizeof(struct sockaddr_in6));
-	} else {
-		struct sockaddr_in address = {};
-		address.sin_family = AF_INET;
-		address = destination.getAddress();
-		address.sin_port = htons(destination.getPort());
+	sockaddr_storage address;
+	socklen_t address_len = toSockaddr(destination, address);
 
-		sent = sendto(m_handle, (const char *)data, size, 0,
-				(struct sockaddr *)&address, sizeof(struct sockaddr_in));
-	}
+	++m_syscalls;
+	int sent = sendto(m_handle, (const char *)data, size, 0,
+			(struct sockaddr *)&address, address_len);
 
 	if (sent != size)
 		throw SendFailedException("Failed to send packet");
 }
 
+void UDPSocket::SendBatch(Datagram *datagrams, int count)
+{
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+	if (!INTERNET_SIMULATOR) {
+		mmsghdr msgs[UDP_BATCH_MAX];
+		iovec iov[UDP_BATCH_MAX];
+		sockaddr_storage addresses[UDP_BATCH_MAX];
+
+		while (count > 0) {
+			Datagram *sources[UDP_BATCH_MAX];
+			int batch = 0;
+			for (; batch < UDP_BATCH_MAX && count > 0; ++datagrams, --count) {
+				if (datagrams->address.getFamily() != m_addr_family) {
+					datagrams->size = -1;
+					continue;
+				}
+				sources[batch] = datagrams;
+				iov[batch].iov_base = datagrams->data;
+				iov[batch].iov_len = datagrams->size;
+				msgs[batch] = {};
+				msgs[batch].msg_hdr.msg_name = &addresses[batch];
+				msgs[batch].msg_hdr.msg_namelen =
+						toSockaddr(datagrams->address, addresses[batch]);
+				msgs[batch].msg_hdr.msg_iov = &iov[batch];
+				msgs[batch].msg_hdr.msg_iovlen = 1;
+				++batch;
+			}
+
+			// sendmmsg() stops at the first datagram it fails to send,
+			// skip that one and go on with the rest
+			int done = 0;
+			while (done < batch) {
+				++m_syscalls;
+				int sent = sendmmsg(m_handle, msgs + done, batch - done, 0);
+				if (sent <= 0) {
+					sources[done]->size = -1;
+					sent = 1;
+				}
+				done += sent;
+			}
+		}
+		return;
+	}
+#endif
+
+	for (int i = 0; i < count; ++i) {
+		try {
+			Send(datagrams[i].address, datagrams[i].data, datagrams[i].size);
+		} catch (SendFailedException &e) {
+			datagrams[i].size = -1;
+		}
+	}
+}
+
 int UDPSocket::Receive(Address &sender, void *data, int size)
 {
 	// Return on timeout
 	assert(m_timeout_ms >= 0);
+	if (m_impairment)
+		return receiveImpaired(sender, data, size, m_timeout_ms);
+
 	if (!WaitData(m_timeout_ms))
 		return -1;
 
-	size = MYMAX(size, 0);
-
-	int received;
-	if (m_addr_family == AF_INET6) {
-		struct sockaddr_in6 address;
-		memset(&address, 0, sizeof(address));
-		socklen_t address_len = sizeof(address);
+	return receiveFrom(sender, data, size);
+}
 
-		received = recvfrom(m_handle, (char *)data, size, 0,
-				(struct sockaddr *)&address, &address_len);
+int UDPSocket::receiveImpaired(Address &sender, void *data, int size, int timeout_ms)
+{
+	return m_impairment->receive(sender, data, size, timeout_ms,
+			[this] (Address &from, void *buffer, int buffer_size, int wait_ms) {
+				if (!WaitData(wait_ms))
+					return -1;
+				return receiveFrom(from, buffer, buffer_size);
+			});
+}
 
-		if (received < 0)
-			return -1;
+void UDPSocket::setImpairment(std::unique_ptr<NetworkImpairment> impairment)
+{
+	m_impairment = std::move(impairment);
+}
 
-/*
-		u16 address_port = ntohs(address.sin6_port);
-		const auto *bytes = reinterpret_cast<IPv6AddressBytes*>
-			(address.sin6_addr.s6_addr);
-		sender = Address(bytes, address_port);
-*/
-		sender = address;
-	} else {
-		struct sockaddr_in address;
-		memset(&address, 0, sizeof(address));
+int UDPSocket::receiveFrom(Address &sender, void *data, int size)
+{
+	size = MYMAX(size, 0);
 
-		socklen_t address_len = sizeof(address);
+	sockaddr_storage address;
+	memset(&address, 0, sizeof(address));
+	socklen_t address_len = sizeof(address);
 
-		received = recvfrom(m_handle, (char *)data, size, 0,
-				(struct sockaddr *)&address, &address_len);
+	++m_syscalls;
+	int received = recvfrom(m_handle, (char *)data, size, 0,
+			(struct sockaddr *)&address, &address_len);
 
-		if (received < 0)
-			return -1;
+	if (received < 0 || !fromSockaddr(address, sender))
+		return -1;
 
-/*
-		u32 address_ip = ntohl(address.sin_addr.s_addr);
-		u16 address_port = ntohs(address.sin_port);
+	return received;
+}
 
-		sender = Address(address_ip, address_port);
-*/
+int UDPSocket::ReceiveBatch(Datagram *datagrams, int count)
+{
+	assert(m_timeout_ms >= 0);
+	count = MYMIN(count, UDP_BATCH_MAX);
+
+	if (m_impairment) {
+		int result = 0;
+		for (; result < count; ++result) {
+			int received = receiveImpaired(datagrams[result].address,
+					datagrams[result].data, datagrams[result].size,
+					result ? 0 : m_timeout_ms);
+			if (received < 0)
+				break;
+			datagrams[result].size = received;
+		}
+		return result;
+	}
 
-		sender = address;
+	if (count <= 0 || !WaitData(m_timeout_ms))
+		return 0;
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__)
+	mmsghdr msgs[UDP_BATCH_MAX];
+	iovec iov[UDP_BATCH_MAX];
+	sockaddr_storage addresses[UDP_BATCH_MAX];
+
+	for (int i = 0; i < count; ++i) {
+		iov[i].iov_base = datagrams[i].data;
+		iov[i].iov_len = MYMAX(datagrams[i].size, 0);
+		msgs[i] = {};
+		msgs[i].msg_hdr.msg_name = &addresses[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
 	}
 
+	// Don't block for more once the waiting datagrams are read
+	++m_syscalls;
+	int received = recvmmsg(m_handle, msgs, count, MSG_DONTWAIT, nullptr);
+	if (received <= 0)
+		return 0;
+
+	for (int i = 0; i < received; ++i) {
+		// Unknown sender, left empty for the caller to drop
+		if (!fromSockaddr(addresses[i], datagrams[i].address))
+			datagrams[i].size = 0;
+		else
+			datagrams[i].size = msgs[i].msg_len;
+	}
 	return received;
+#else
+	int result = 0;
+	do {
+		int received = receiveFrom(datagrams[result].address,
+				datagrams[result].data, datagrams[result].size);
+		if (received < 0)
+			break;
+		datagrams[result].size = received;
+		++result;
+	} while (result < count && WaitData(0));
+	return result;
+#endif
 }
 
 void UDPSocket::setTimeoutMs(int timeout_ms)
@@ -267,6 +399,8 @@ bool UDPSocket::WaitData(int timeout_ms)
 {
 	timeout_ms = MYMAX(timeout_ms, 0);
 
+	++m_syscalls;
+
 #ifdef _WIN32
 	WSAPOLLFD pfd;
 	pfd.fd = m_handle;
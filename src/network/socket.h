@@ -4,12 +4,19 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <ostream>
 #include <cstring>
 #include "address.h"
 #include "irrlichttypes.h"
 #include "networkexceptions.h"
 
+// Most datagrams handled by one SendBatch() or ReceiveBatch() call
+#define UDP_BATCH_MAX 64
+
+class NetworkImpairment;
+
 void sockets_init();
 void sockets_cleanup();
 
@@ -30,11 +37,40 @@ class UDPSocket
 	// Returns true if there is data, false if timeout occurred
 	bool WaitData(int timeout_ms);
 
+	struct Datagram
+	{
+		Address address;
+		u8 *data = nullptr;
+		int size = 0;
+	};
+
+	// Sends the datagrams with as few system calls as the platform allows.
+	// The size of a datagram that could not be sent is set to -1, the
+	// others are still sent.
+	void SendBatch(Datagram *datagrams, int count);
+	// Waits like Receive(), then reads up to count datagrams that have
+	// arrived. data and size of each datagram give its buffer, address and
+	// size are set for the received ones. Returns their number.
+	int ReceiveBatch(Datagram *datagrams, int count);
+
+	// System calls made by this socket, to measure the batching
+	u64 getSyscallCount() const { return m_syscalls; }
+
+	// Received datagrams go through the impairment, init() sets it up from
+	// the network_impairment setting
+	void setImpairment(std::unique_ptr<NetworkImpairment> impairment);
+	NetworkImpairment *getImpairment() const { return m_impairment.get(); }
+
 	// Debugging purposes only
 	int GetHandle() const { return m_handle; };
 
 private:
+	int receiveFrom(Address &sender, void *data, int size);
+	int receiveImpaired(Address &sender, void *data, int size, int timeout_ms);
+
 	int m_handle = -1;
 	int m_timeout_ms = -1;
 	unsigned short m_addr_family = 0;
+	std::atomic<u64> m_syscalls{0};
+	std::unique_ptr<NetworkImpairment> m_impairment;
 };
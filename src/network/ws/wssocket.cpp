@@ -33,6 +33,7 @@ openssl req -new -x509 -key privkey.pem > fullchain.pem
 #include "constants.h"
 #include "filesys.h"
 #include "log.h"
+#include "network/fm_impairment.h"
 #include "../server/serverlist.h"
 #include "settings.h"
 #include "util/numeric.h"
@@ -239,6 +240,8 @@ bool WSSocket::init(bool ipv6, bool noExceptions)
 {
 	setTimeoutMs(0);
 
+	m_impairment = NetworkImpairment::create();
+
 /*	if (socket_enable_debug_output /*con_debug* /) {
 		server.set_error_channels(websocketpp::log::elevel::all);
 		server.set_access_channels(websocketpp::log::alevel::all ^
@@ -383,9 +386,25 @@ void WSSocket::Send(const Address &destination, const void *data, int size)
 }
 
 int WSSocket::Receive(Address &sender, void *data, int size)
+{
+	if (m_impairment)
+		return m_impairment->receive(sender, data, size, m_timeout_ms,
+				[this] (Address &from, void *buffer, int buffer_size, int wait_ms) {
+					return receiveRaw(from, buffer, buffer_size, wait_ms);
+				});
+
+	return receiveRaw(sender, data, size, m_timeout_ms);
+}
+
+void WSSocket::setImpairment(std::unique_ptr<NetworkImpairment> impairment)
+{
+	m_impairment = std::move(impairment);
+}
+
+int WSSocket::receiveRaw(Address &sender, void *data, int size, int timeout_ms)
 {
 	//  Return on timeout
-	if (!WaitData(m_timeout_ms))
+	if (!WaitData(timeout_ms))
 		return -1;
 
 	const auto item = incoming_queue.front();
@@ -22,6 +22,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <list>
+#include <memory>
 #include "network/address.h"
 
 #include <websocketpp/server.hpp>
@@ -34,6 +35,8 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <websocketpp/config/asio_no_tls.hpp>
 #endif
 
+class NetworkImpairment;
+
 //extern bool socket_enable_debug_output;
 
 class WSSocket
@@ -50,6 +53,7 @@ class WSSocket
 	void Send(const Address &destination, const void *data, int size);
 	// Returns -1 if there is no data
 	int Receive(Address &sender, void *data, int size);
+	void setImpairment(std::unique_ptr<NetworkImpairment> impairment);
 	int GetHandle(); // For debugging purposes only
 	void setTimeoutMs(int timeout_ms);
 	// Returns true if there is data, false if timeout occurred
@@ -81,6 +85,8 @@ class WSSocket
 #endif
 
 private:
+	int receiveRaw(Address &sender, void *data, int size, int timeout_ms);
+
 	struct queue_item
 	{
 		Address address;
@@ -89,4 +95,5 @@ class WSSocket
 	std::list<queue_item> incoming_queue;
 
 	int m_timeout_ms = -1;
+	std::unique_ptr<NetworkImpairment> m_impairment;
 };
@@ -1815,6 +1815,25 @@ void NodeDefManager::updateTextures(IGameDef *gamedef, void *progress_callback_a
 
 	u32 size = m_content_features.size();
 
+#if CHECK_CLIENT_BUILD()
+	// Generate the tile textures all at once, the loop finds them cached
+	if (tsrc) {
+		std::vector<std::string> names;
+		for (const ContentFeatures &f : m_content_features) {
+			// Their tiles get other names depending on the leaves style
+			if (f.drawtype != NDT_ALLFACES_OPTIONAL)
+				for (const TileDef &tiledef : f.tiledef)
+					names.emplace_back(tiledef.name.empty() ?
+							"no_texture.png" : tiledef.name);
+			for (const TileDef &tiledef : f.tiledef_overlay)
+				names.emplace_back(tiledef.name);
+			for (const TileDef &tiledef : f.tiledef_special)
+				names.emplace_back(tiledef.name);
+		}
+		tsrc->prepareTexturesForMesh(names);
+	}
+#endif
+
 	for (u32 i = 0; i < size; i++) {
 		ContentFeatures *f = &(m_content_features[i]);
 #if CHECK_CLIENT_BUILD()
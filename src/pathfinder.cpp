@@ -26,6 +26,7 @@
 #endif
 
 #include <queue>
+#include <unordered_set>
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
@@ -46,11 +47,27 @@
 #endif
 
 #define PATHFINDER_MAX_WAYPOINTS 700
+#define PATHFINDER_CACHE_MAX_BLOCKS 4096
 
 /******************************************************************************/
 /* Class definitions                                                          */
 /******************************************************************************/
 
+/** what a node is to the pathfinder */
+typedef enum : u8 {
+	PNK_IGNORE,            /**< not loaded                                    */
+	PNK_WALKABLE,          /**< solid, can be stood on                        */
+	PNK_OPEN               /**< can be moved through                          */
+} PathNodeKind;
+
+/** walkability of all nodes of a map block */
+struct PathfinderChunk {
+	std::weak_ptr<MapBlock> block;  /**< block the data was taken from        */
+	u32 version = 0;               /**< MapBlock::m_node_data_version of it  */
+	u32 id = 0;                    /**< unique per build, 0 if not cached    */
+	u8 kind[MapBlock::nodecount];  /**< PathNodeKind of each node            */
+};
+
 
 /** representation of cost in specific direction */
 class PathCost {
@@ -167,7 +184,8 @@ class Pathfinder {
 
 public:
 	Pathfinder() = delete;
-	Pathfinder(Map *map, const NodeDefManager *ndef) : m_map(map), m_ndef(ndef) {}
+	Pathfinder(Map *map, const NodeDefManager *ndef, PathfinderCache *cache) :
+		m_map(map), m_ndef(ndef), m_cache(cache) {}
 
 	~Pathfinder();
 
@@ -188,9 +206,27 @@ class Pathfinder {
 			unsigned int max_drop,
 			PathAlgorithm algo);
 
+	PathfinderStats m_stats;
+
 private:
 	/* helper functions */
 
+	/**
+	 * get what a node is to the pathfinder
+	 * @param pos real world position
+	 */
+	PathNodeKind   getNodeKind(v3s16 pos);
+
+	/**
+	 * get walkability of a block, looking it up in the cache only once
+	 * per search
+	 * @return nullptr if the block is not loaded
+	 */
+	const PathfinderChunk *getChunk(v3s16 blockpos);
+
+	/** (re)create container for the nodes of the search area */
+	void           resetNodesContainer();
+
 	/**
 	 * transform index pos to mappos
 	 * @param ipos an index position
@@ -288,6 +324,35 @@ class Pathfinder {
 	 */
 	v3s16         walkDownwards(v3s16 pos, unsigned int max_down);
 
+	/* block level search */
+
+	/**
+	 * where a move from a surface node ends, regardless of search limits;
+	 * follows the same rules as calcCost
+	 * @param pos real world position to start movement
+	 * @param dir direction to move to
+	 * @param target set to the surface node reached
+	 * @return true/false movement is possible
+	 */
+	bool          getMoveTarget(v3s16 pos, v3s16 dir, v3s16 &target);
+
+	/**
+	 * find the neighbouring blocks that a single move leads to from
+	 * any surface node of a block
+	 * @param blockpos block position
+	 * @return one bit per neighbour, see getLinkIndex
+	 */
+	u32           getBlockLinks(v3s16 blockpos);
+
+	/**
+	 * A* search over blocks, restricting the node search to the blocks
+	 * along the found route and their neighbours
+	 * @param source start position (real pos)
+	 * @param destination end position (real pos)
+	 * @return true/false destination block can be reached
+	 */
+	bool          findCorridor(v3s16 source, v3s16 destination);
+
 	/* variables */
 	int m_max_index_x = 0;            /**< max index of search area in x direction  */
 	int m_max_index_y = 0;            /**< max index of search area in y direction  */
@@ -313,6 +378,18 @@ class Pathfinder {
 
 	const NodeDefManager *m_ndef = nullptr;
 
+	/** map data shared between searches, nullptr to read the map directly */
+	PathfinderCache *m_cache = nullptr;
+
+	/** chunks looked up during this search */
+	std::unordered_map<v3s16, std::shared_ptr<const PathfinderChunk>> m_chunks;
+	v3s16 m_last_chunk_pos;
+	const PathfinderChunk *m_last_chunk = nullptr;
+	bool m_last_chunk_valid = false;
+
+	/** blocks the node search may enter, empty if it is not restricted */
+	std::unordered_set<v3s16> m_corridor;
+
 	friend class PathfinderCompareHeuristic;
 
 #ifdef PATHFINDER_DEBUG
@@ -399,10 +476,126 @@ std::vector<v3s16> get_path(Map* map, const NodeDefManager *ndef,
 		unsigned int searchdistance,
 		unsigned int max_jump,
 		unsigned int max_drop,
-		PathAlgorithm algo)
+		PathAlgorithm algo,
+		PathfinderCache *cache,
+		PathfinderStats *stats)
 {
-	return Pathfinder(map, ndef).getPath(source, destination,
+	Pathfinder pathfinder(map, ndef, cache);
+	std::vector<v3s16> path = pathfinder.getPath(source, destination,
 				searchdistance, max_jump, max_drop, algo);
+	if (stats)
+		*stats = pathfinder.m_stats;
+	return path;
+}
+
+/******************************************************************************/
+static inline PathNodeKind classifyNode(const NodeDefManager *ndef, MapNode n)
+{
+	if (n.param0 == CONTENT_IGNORE)
+		return PNK_IGNORE;
+	return ndef->get(n).walkable ? PNK_WALKABLE : PNK_OPEN;
+}
+
+/******************************************************************************/
+std::shared_ptr<const PathfinderChunk> PathfinderCache::getChunk(Map *map,
+		const NodeDefManager *ndef, v3s16 blockpos)
+{
+	MapBlockPtr block = map->getBlock(blockpos);
+	if (!block)
+		return nullptr;
+
+	// read the version first, a change while copying makes the entry stale
+	const u32 version = block->m_node_data_version;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_chunks.find(blockpos);
+		if (it != m_chunks.end() && it->second->version == version &&
+				it->second->block.lock() == block)
+			return it->second;
+	}
+
+	auto chunk = std::make_shared<PathfinderChunk>();
+	chunk->block = block;
+	chunk->version = version;
+	bool has_ignore = false;
+	{
+		const auto lock = block->lock_shared_rec();
+		const MapNode *data = block->getData();
+		for (u32 i = 0; i < MapBlock::nodecount; i++) {
+			chunk->kind[i] = classifyNode(ndef, data[i]);
+			has_ignore |= chunk->kind[i] == PNK_IGNORE;
+		}
+	}
+
+	// not generated yet, will change without a new version
+	if (has_ignore)
+		return chunk;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (++m_last_chunk_id == 0)
+		++m_last_chunk_id;
+	chunk->id = m_last_chunk_id;
+
+	if (m_chunks.size() >= PATHFINDER_CACHE_MAX_BLOCKS) {
+		for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+			if (it->second->block.expired()) {
+				m_links.erase(it->first);
+				it = m_chunks.erase(it);
+			} else {
+				++it;
+			}
+		}
+		if (m_chunks.size() >= PATHFINDER_CACHE_MAX_BLOCKS) {
+			m_chunks.clear();
+			m_links.clear();
+		}
+	}
+	m_chunks[blockpos] = chunk;
+	return chunk;
+}
+
+/******************************************************************************/
+bool PathfinderCache::getLinks(v3s16 blockpos, u32 stamp, u16 max_jump,
+		u16 max_drop, u32 &links)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_links.find(blockpos);
+	if (it == m_links.end())
+		return false;
+	for (const Links &l : it->second) {
+		if (l.stamp == stamp && l.max_jump == max_jump && l.max_drop == max_drop) {
+			links = l.links;
+			return true;
+		}
+	}
+	return false;
+}
+
+/******************************************************************************/
+void PathfinderCache::setLinks(v3s16 blockpos, u32 stamp, u16 max_jump,
+		u16 max_drop, u32 links)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<Links> &list = m_links[blockpos];
+	for (Links &l : list) {
+		if (l.max_jump == max_jump && l.max_drop == max_drop) {
+			l.stamp = stamp;
+			l.links = links;
+			return;
+		}
+	}
+	// mobs usually share a few jump/drop settings
+	if (list.size() >= 8)
+		list.erase(list.begin());
+	list.push_back({stamp, max_jump, max_drop, links});
+}
+
+/******************************************************************************/
+void PathfinderCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_chunks.clear();
+	m_links.clear();
 }
 
 /******************************************************************************/
@@ -501,20 +694,19 @@ void PathGridnode::setCost(v3s16 dir, const PathCost &cost)
 
 void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 {
-	const NodeDefManager *ndef = m_pathf->m_ndef;
 	PathGridnode &elem = *p_node;
 
 	v3s16 realpos = m_pathf->getRealPos(ipos);
 
-	MapNode current = m_pathf->m_map->getNode(realpos);
-	MapNode below   = m_pathf->m_map->getNode(realpos + v3s16(0, -1, 0));
+	PathNodeKind current = m_pathf->getNodeKind(realpos);
+	PathNodeKind below   = m_pathf->getNodeKind(realpos + v3s16(0, -1, 0));
 
 
-	if ((current.param0 == CONTENT_IGNORE) ||
-			(below.param0 == CONTENT_IGNORE)) {
+	if ((current == PNK_IGNORE) ||
+			(below == PNK_IGNORE)) {
 		DEBUG_OUT("Pathfinder: " << realpos <<
 			" current or below is invalid element" << std::endl);
-		if (current.param0 == CONTENT_IGNORE) {
+		if (current == PNK_IGNORE) {
 			elem.type = 'i';
 			DEBUG_OUT(ipos << ": " << 'i' << std::endl);
 		}
@@ -522,10 +714,10 @@ void GridNodeContainer::initNode(v3s16 ipos, PathGridnode *p_node)
 	}
 
 	//don't add anything if it isn't an air node
-	if (ndef->get(current).walkable || !ndef->get(below).walkable) {
+	if (current == PNK_WALKABLE || below != PNK_WALKABLE) {
 			DEBUG_OUT("Pathfinder: " << realpos
 				<< " not on surface" << std::endl);
-			if (ndef->get(current).walkable) {
+			if (current == PNK_WALKABLE) {
 				elem.type = 's';
 				DEBUG_OUT(ipos << ": " << 's' << std::endl);
 			} else {
@@ -639,12 +831,7 @@ std::vector<v3s16> Pathfinder::getPath(v3s16 source,
 	m_max_index_y = diff.Y;
 	m_max_index_z = diff.Z;
 
-	delete m_nodes_container;
-	if (diff.getLength() > 5) {
-		m_nodes_container = new MapGridNodeContainer(this);
-	} else {
-		m_nodes_container = new ArrayGridNodeContainer(this, diff);
-	}
+	resetNodesContainer();
 #ifdef PATHFINDER_DEBUG
 	printType();
 	printCost();
@@ -652,14 +839,12 @@ std::vector<v3s16> Pathfinder::getPath(v3s16 source,
 #endif
 
 	//fail if source or destination is walkable
-	MapNode node_at_pos = m_map->getNode(destination);
-	if (m_ndef->get(node_at_pos).walkable) {
+	if (getNodeKind(destination) == PNK_WALKABLE) {
 		VERBOSE_TARGET << "Destination is walkable. " <<
 				"Pos: " << destination << std::endl;
 		return retval;
 	}
-	node_at_pos = m_map->getNode(source);
-	if (m_ndef->get(node_at_pos).walkable) {
+	if (getNodeKind(source) == PNK_WALKABLE) {
 		VERBOSE_TARGET << "Source is walkable. " <<
 				"Pos: " << source << std::endl;
 		return retval;
@@ -713,7 +898,27 @@ std::vector<v3s16> Pathfinder::getPath(v3s16 source,
 			break;
 		case PA_PLAIN_NP:
 		case PA_PLAIN:
+			//with cached map data, search the blocks first and only look
+			//at the nodes along the route found
+			if (m_cache && m_maxjump < MAP_BLOCKSIZE &&
+					m_maxdrop < MAP_BLOCKSIZE) {
+				if (!findCorridor(source, destination)) {
+					INFO_TARGET << "No block route found" << std::endl;
+					break;
+				}
+			}
 			update_cost_retval = updateCostHeuristic(StartIndex, EndIndex);
+			if (!update_cost_retval && !m_corridor.empty()) {
+				//links are a coarse approximation, redo the search unrestricted
+				m_stats.fallback = true;
+				m_corridor.clear();
+				resetNodesContainer();
+				getIndexElement(EndIndex).target = true;
+				PathGridnode &restart = getIndexElement(StartIndex);
+				restart.source    = true;
+				restart.totalcost = 0;
+				update_cost_retval = updateCostHeuristic(StartIndex, EndIndex);
+			}
 			break;
 		default:
 			ERROR_TARGET << "Missing PathAlgorithm" << std::endl;
@@ -804,6 +1009,236 @@ Pathfinder::~Pathfinder()
 {
 	delete m_nodes_container;
 }
+
+/******************************************************************************/
+void Pathfinder::resetNodesContainer()
+{
+	v3s16 diff = m_limits.MaxEdge - m_limits.MinEdge;
+
+	delete m_nodes_container;
+	if (diff.getLength() > 5) {
+		m_nodes_container = new MapGridNodeContainer(this);
+	} else {
+		m_nodes_container = new ArrayGridNodeContainer(this, diff);
+	}
+}
+
+/******************************************************************************/
+const PathfinderChunk *Pathfinder::getChunk(v3s16 blockpos)
+{
+	if (m_last_chunk_valid && m_last_chunk_pos == blockpos)
+		return m_last_chunk;
+
+	auto it = m_chunks.find(blockpos);
+	if (it == m_chunks.end()) {
+		it = m_chunks.emplace(blockpos,
+				m_cache->getChunk(m_map, m_ndef, blockpos)).first;
+	}
+
+	m_last_chunk_pos = blockpos;
+	m_last_chunk = it->second.get();
+	m_last_chunk_valid = true;
+	return m_last_chunk;
+}
+
+/******************************************************************************/
+PathNodeKind Pathfinder::getNodeKind(v3s16 pos)
+{
+	if (!m_cache)
+		return classifyNode(m_ndef, m_map->getNode(pos));
+
+	v3s16 blockpos = getNodeBlockPos(pos);
+	const PathfinderChunk *chunk = getChunk(blockpos);
+	if (!chunk)
+		return PNK_IGNORE;
+
+	v3s16 rel = pos - blockpos * MAP_BLOCKSIZE;
+	return (PathNodeKind)chunk->kind[rel.Z * MapBlock::zstride +
+			rel.Y * MapBlock::ystride + rel.X];
+}
+
+/******************************************************************************/
+static inline u32 getLinkIndex(v3s16 dir)
+{
+	return (dir.X + 1) * 9 + (dir.Y + 1) * 3 + (dir.Z + 1);
+}
+
+/******************************************************************************/
+bool Pathfinder::getMoveTarget(v3s16 pos, v3s16 dir, v3s16 &target)
+{
+	v3s16 pos2 = pos + dir;
+	PathNodeKind node_at_pos2 = getNodeKind(pos2);
+
+	if (node_at_pos2 == PNK_IGNORE)
+		return false;
+
+	if (node_at_pos2 == PNK_OPEN) {
+		//same height or drop
+		v3s16 testpos = pos2 + v3s16(0, -1, 0);
+		for (int drop = 0; drop <= m_maxdrop; drop++) {
+			PathNodeKind node_below = getNodeKind(testpos);
+			if (node_below == PNK_WALKABLE) {
+				target = testpos + v3s16(0, 1, 0);
+				return true;
+			}
+			if (node_below == PNK_IGNORE)
+				return false;
+			testpos += v3s16(0, -1, 0);
+		}
+		return false;
+	}
+
+	//jump, the space above pos has to be free all the way up
+	v3s16 targetpos = pos2;
+	v3s16 jumppos = pos;
+	for (int up = 0; ; up++) {
+		if (getNodeKind(jumppos) != PNK_OPEN)
+			return false;
+		if (getNodeKind(targetpos) != PNK_WALKABLE) {
+			target = targetpos;
+			return true;
+		}
+		if (up >= m_maxjump)
+			return false;
+		targetpos += v3s16(0, 1, 0);
+		jumppos   += v3s16(0, 1, 0);
+	}
+}
+
+/******************************************************************************/
+u32 Pathfinder::getBlockLinks(v3s16 blockpos)
+{
+	if (!getChunk(blockpos))
+		return 0;
+
+	//links depend on the block and its neighbours, identify them by chunk id
+	u32 stamp = 2166136261U;
+	bool cacheable = true;
+	for (s16 z = -1; z <= 1; z++)
+	for (s16 y = -1; y <= 1; y++)
+	for (s16 x = -1; x <= 1; x++) {
+		const PathfinderChunk *chunk = getChunk(blockpos + v3s16(x, y, z));
+		u32 id = chunk ? chunk->id : 0;
+		if (chunk && id == 0)
+			cacheable = false;
+		stamp = (stamp ^ id) * 16777619U;
+	}
+
+	u32 links = 0;
+	if (cacheable && m_cache->getLinks(blockpos, stamp, m_maxjump, m_maxdrop, links))
+		return links;
+
+	const static v3s16 directions[4] = {
+		v3s16(1,0, 0),
+		v3s16(-1,0, 0),
+		v3s16(0,0, 1),
+		v3s16(0,0,-1)
+	};
+
+	links = 0;
+	v3s16 base = blockpos * MAP_BLOCKSIZE;
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		//moves from inner nodes stay inside the block
+		bool edge_xz = x == 0 || x == MAP_BLOCKSIZE - 1 ||
+				z == 0 || z == MAP_BLOCKSIZE - 1;
+		bool edge_y = y < m_maxdrop || y + m_maxjump >= MAP_BLOCKSIZE;
+		if (!edge_xz && !edge_y)
+			continue;
+
+		v3s16 pos = base + v3s16(x, y, z);
+		if (getNodeKind(pos) != PNK_OPEN ||
+				getNodeKind(pos + v3s16(0, -1, 0)) != PNK_WALKABLE)
+			continue;
+
+		for (v3s16 direction : directions) {
+			v3s16 target;
+			if (!getMoveTarget(pos, direction, target))
+				continue;
+			v3s16 target_block = getNodeBlockPos(target);
+			if (target_block != blockpos)
+				links |= 1U << getLinkIndex(target_block - blockpos);
+		}
+	}
+
+	if (cacheable)
+		m_cache->setLinks(blockpos, stamp, m_maxjump, m_maxdrop, links);
+	return links;
+}
+
+/******************************************************************************/
+bool Pathfinder::findCorridor(v3s16 source, v3s16 destination)
+{
+	v3s16 bsource = getNodeBlockPos(source);
+	v3s16 bdestination = getNodeBlockPos(destination);
+	v3s16 bmin = getNodeBlockPos(m_limits.MinEdge);
+	v3s16 bmax = getNodeBlockPos(m_limits.MaxEdge);
+	core::aabbox3d<s16> blimits(bmin, bmax);
+
+	auto estimate = [&] (v3s16 blockpos) {
+		return std::abs(blockpos.X - bdestination.X) +
+				std::abs(blockpos.Z - bdestination.Z);
+	};
+
+	typedef std::pair<int, v3s16> OpenBlock;
+	auto compare = [] (const OpenBlock &a, const OpenBlock &b) {
+		return a.first > b.first;
+	};
+	std::priority_queue<OpenBlock, std::vector<OpenBlock>, decltype(compare)>
+			openList(compare);
+	std::unordered_map<v3s16, std::pair<int, v3s16>> visited; // cost, previous
+	std::unordered_set<v3s16> closed;
+
+	visited[bsource] = {0, bsource};
+	openList.emplace(estimate(bsource), bsource);
+
+	bool found = false;
+	while (!openList.empty()) {
+		v3s16 current = openList.top().second;
+		openList.pop();
+		if (!closed.insert(current).second)
+			continue;
+		m_stats.blocks_expanded++;
+
+		if (current == bdestination) {
+			found = true;
+			break;
+		}
+
+		u32 links = getBlockLinks(current);
+		int cost = visited[current].first + 1;
+		for (s16 z = -1; z <= 1; z++)
+		for (s16 y = -1; y <= 1; y++)
+		for (s16 x = -1; x <= 1; x++) {
+			v3s16 dir(x, y, z);
+			if (!(links & (1U << getLinkIndex(dir))))
+				continue;
+			v3s16 next = current + dir;
+			if (!blimits.isPointInside(next) || closed.count(next))
+				continue;
+			auto it = visited.find(next);
+			if (it != visited.end() && it->second.first <= cost)
+				continue;
+			visited[next] = {cost, current};
+			openList.emplace(cost + estimate(next), next);
+		}
+	}
+
+	if (!found)
+		return false;
+
+	//node paths may cut corners, so allow the neighbours of the route too
+	for (v3s16 current = bdestination; ; current = visited[current].second) {
+		for (s16 z = -1; z <= 1; z++)
+		for (s16 y = -1; y <= 1; y++)
+		for (s16 x = -1; x <= 1; x++)
+			m_corridor.insert(current + v3s16(x, y, z));
+		if (current == bsource)
+			break;
+	}
+	return true;
+}
 /******************************************************************************/
 v3s16 Pathfinder::getRealPos(v3s16 ipos)
 {
@@ -826,28 +1261,28 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 		return retval;
 	}
 
-	MapNode node_at_pos2 = m_map->getNode(pos2);
+	PathNodeKind node_at_pos2 = getNodeKind(pos2);
 
 	//did we get information about node?
-	if (node_at_pos2.param0 == CONTENT_IGNORE ) {
+	if (node_at_pos2 == PNK_IGNORE) {
 			VERBOSE_TARGET << "Pathfinder: (1) area at pos: "
 					<< pos2 << " not loaded";
 			return retval;
 	}
 
-	if (!m_ndef->get(node_at_pos2).walkable) {
-		MapNode node_below_pos2 =
-			m_map->getNode(pos2 + v3s16(0, -1, 0));
+	if (node_at_pos2 != PNK_WALKABLE) {
+		PathNodeKind node_below_pos2 =
+			getNodeKind(pos2 + v3s16(0, -1, 0));
 
 		//did we get information about node?
-		if (node_below_pos2.param0 == CONTENT_IGNORE ) {
+		if (node_below_pos2 == PNK_IGNORE) {
 				VERBOSE_TARGET << "Pathfinder: (2) area at pos: "
 					<< (pos2 + v3s16(0, -1, 0)) << " not loaded";
 				return retval;
 		}
 
 		//test if the same-height neighbor is suitable
-		if (m_ndef->get(node_below_pos2).walkable) {
+		if (node_below_pos2 == PNK_WALKABLE) {
 			//SUCCESS!
 			retval.valid = true;
 			retval.value = 1;
@@ -858,19 +1293,17 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 		else {
 			//test if we can fall a couple of nodes (m_maxdrop)
 			v3s16 testpos = pos2 + v3s16(0, -1, 0);
-			MapNode node_at_pos = m_map->getNode(testpos);
+			PathNodeKind node_at_pos = getNodeKind(testpos);
 
-			while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-					(!m_ndef->get(node_at_pos).walkable) &&
+			while ((node_at_pos == PNK_OPEN) &&
 					(testpos.Y > m_limits.MinEdge.Y)) {
 				testpos += v3s16(0, -1, 0);
-				node_at_pos = m_map->getNode(testpos);
+				node_at_pos = getNodeKind(testpos);
 			}
 
 			//did we find surface?
 			if ((testpos.Y >= m_limits.MinEdge.Y) &&
-					(node_at_pos.param0 != CONTENT_IGNORE) &&
-					(m_ndef->get(node_at_pos).walkable)) {
+					(node_at_pos == PNK_WALKABLE)) {
 				if ((pos2.Y - testpos.Y - 1) <= m_maxdrop) {
 					//SUCCESS!
 					retval.valid = true;
@@ -896,34 +1329,31 @@ PathCost Pathfinder::calcCost(v3s16 pos, v3s16 dir)
 
 		v3s16 targetpos = pos2; // position for jump target
 		v3s16 jumppos = pos; // position for checking if jumping space is free
-		MapNode node_target = m_map->getNode(targetpos);
-		MapNode node_jump = m_map->getNode(jumppos);
+		PathNodeKind node_target = getNodeKind(targetpos);
+		PathNodeKind node_jump = getNodeKind(jumppos);
 		bool headbanger = false; // true if anything blocks jumppath
 
-		while ((node_target.param0 != CONTENT_IGNORE) &&
-				(m_ndef->get(node_target).walkable) &&
+		while ((node_target == PNK_WALKABLE) &&
 				(targetpos.Y < m_limits.MaxEdge.Y)) {
 			//if the jump would hit any solid node, discard
-			if ((node_jump.param0 == CONTENT_IGNORE) ||
-					(m_ndef->get(node_jump).walkable)) {
+			if (node_jump != PNK_OPEN) {
 					headbanger = true;
 				break;
 			}
 			targetpos += v3s16(0, 1, 0);
 			jumppos   += v3s16(0, 1, 0);
-			node_target = m_map->getNode(targetpos);
-			node_jump   = m_map->getNode(jumppos);
+			node_target = getNodeKind(targetpos);
+			node_jump   = getNodeKind(jumppos);
 
 		}
 		//check headbanger one last time
-		if ((node_jump.param0 == CONTENT_IGNORE) ||
-			(m_ndef->get(node_jump).walkable)) {
+		if (node_jump != PNK_OPEN) {
 			headbanger = true;
 		}
 
 		//did we find surface without banging our head?
 		if ((!headbanger) && (targetpos.Y <= m_limits.MaxEdge.Y) &&
-				(!m_ndef->get(node_target).walkable)) {
+				(node_target != PNK_WALKABLE)) {
 
 			if (targetpos.Y - pos2.Y <= m_maxjump) {
 				//SUCCESS!
@@ -998,6 +1428,7 @@ bool Pathfinder::updateAllCosts(v3s16 ipos,
 	PathGridnode &g_pos = getIndexElement(ipos);
 	g_pos.totalcost = current_cost;
 	g_pos.sourcedir = srcdir;
+	m_stats.nodes_expanded++;
 
 	level ++;
 
@@ -1144,6 +1575,7 @@ bool Pathfinder::updateCostHeuristic(v3s16 isource, v3s16 idestination)
 		if (!g_pos.valid) {
 			continue;
 		}
+		m_stats.nodes_expanded++;
 
 		if (current_pos == destination) {
 			// destination found, terminate
@@ -1167,6 +1599,9 @@ bool Pathfinder::updateCostHeuristic(v3s16 isource, v3s16 idestination)
 
 			// get position of true neighbor
 			v3s16 neighbor = current_pos + direction_3d;
+			if (!m_corridor.empty() &&
+					m_corridor.find(getNodeBlockPos(neighbor)) == m_corridor.end())
+				continue;
 			v3s16 ineighbor = getIndexPos(neighbor);
 			PathGridnode &n_pos = getIndexElement(ineighbor);
 
@@ -1223,20 +1658,18 @@ v3s16 Pathfinder::walkDownwards(v3s16 pos, unsigned int max_down) {
 	if (max_down == 0)
 		return pos;
 	v3s16 testpos = v3s16(pos);
-	MapNode node_at_pos = m_map->getNode(testpos);
+	PathNodeKind node_at_pos = getNodeKind(testpos);
 	unsigned int down = 0;
-	while ((node_at_pos.param0 != CONTENT_IGNORE) &&
-			(!m_ndef->get(node_at_pos).walkable) &&
+	while ((node_at_pos == PNK_OPEN) &&
 			(testpos.Y > m_limits.MinEdge.Y) &&
 			(down <= max_down)) {
 		testpos += v3s16(0, -1, 0);
 		down++;
-		node_at_pos = m_map->getNode(testpos);
+		node_at_pos = getNodeKind(testpos);
 	}
 	//did we find surface?
 	if ((testpos.Y >= m_limits.MinEdge.Y) &&
-			(node_at_pos.param0 != CONTENT_IGNORE) &&
-			(m_ndef->get(node_at_pos).walkable)) {
+			(node_at_pos == PNK_WALKABLE)) {
 		if (down == 0) {
 			pos = testpos;
 		} else if ((down - 1) <= max_down) {
@@ -7,8 +7,12 @@
 /******************************************************************************/
 /* Includes                                                                   */
 /******************************************************************************/
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "irr_v3d.h"
+#include "util/basic_macros.h"
 
 /******************************************************************************/
 /* Forward declarations                                                       */
@@ -16,6 +20,7 @@
 
 class NodeDefManager;
 class Map;
+struct PathfinderChunk;
 
 /******************************************************************************/
 /* Typedefs and macros                                                        */
@@ -35,15 +40,73 @@ typedef enum {
 	PA_PLAIN_NP          /**< A* algorithm without prefetching of map data */
 } PathAlgorithm;
 
+/** Counters of a single path search */
+struct PathfinderStats {
+	unsigned int nodes_expanded = 0;  /**< nodes taken from the open list       */
+	unsigned int blocks_expanded = 0; /**< blocks visited by the block search   */
+	bool fallback = false;            /**< path not found in the block corridor */
+};
+
 /******************************************************************************/
 /* declarations                                                               */
 /******************************************************************************/
 
-/** c wrapper function to use from scriptapi */
+/**
+ * Walkability of map blocks and the links between neighbouring blocks, kept
+ * between path searches. An entry is rebuilt once the node data of its block
+ * has changed.
+ */
+class PathfinderCache {
+public:
+	PathfinderCache() = default;
+	DISABLE_CLASS_COPY(PathfinderCache);
+
+	/**
+	 * get walkability of a block
+	 * @return nullptr if the block is not loaded
+	 */
+	std::shared_ptr<const PathfinderChunk> getChunk(Map *map,
+			const NodeDefManager *ndef, v3s16 blockpos);
+
+	/**
+	 * get links of a block to its neighbours
+	 * @param stamp ids of the chunks the links have to be computed from
+	 * @return false if there are no links for these parameters
+	 */
+	bool getLinks(v3s16 blockpos, u32 stamp, u16 max_jump, u16 max_drop,
+			u32 &links);
+	void setLinks(v3s16 blockpos, u32 stamp, u16 max_jump, u16 max_drop,
+			u32 links);
+
+	void clear();
+
+private:
+	/** links of a block for one jump/drop setting */
+	struct Links {
+		u32 stamp;
+		u16 max_jump;
+		u16 max_drop;
+		u32 links;
+	};
+
+	std::mutex m_mutex;
+	u32 m_last_chunk_id = 0;
+	std::unordered_map<v3s16, std::shared_ptr<const PathfinderChunk>> m_chunks;
+	std::unordered_map<v3s16, std::vector<Links>> m_links;
+};
+
+/**
+ * c wrapper function to use from scriptapi
+ * @param cache if given, map data is taken from it and a block level search
+ * narrows down the area searched node by node
+ * @param stats if given, receives counters of the search
+ */
 std::vector<v3s16> get_path(Map *map, const NodeDefManager *ndef,
 		v3s16 source,
 		v3s16 destination,
 		unsigned int searchdistance,
 		unsigned int max_jump,
 		unsigned int max_drop,
-		PathAlgorithm algo);
+		PathAlgorithm algo,
+		PathfinderCache *cache = nullptr,
+		PathfinderStats *stats = nullptr);
@@ -7,6 +7,7 @@
 #include "irr_v3d.h"
 #include <string>
 #include <iostream>
+#include <functional>
 #include <list>
 #include "exceptions.h"
 #include "inventory.h"
@@ -112,6 +113,15 @@ class IRollbackManager
 	// Get actions to revert <seconds> of history made by <actor>
 	virtual std::list<RollbackAction> getRevertActions(const std::string &actor,
 	                time_t seconds) = 0;
+
+	// Same as above, but actions are passed one by one as they are read,
+	// newest first. Return false from the callback to stop early.
+	// The callback must not call back into the rollback manager.
+	typedef std::function<bool(const RollbackAction &)> ActionCallback;
+	virtual void forEachNodeActor(v3s16 pos, int range, time_t seconds,
+			int limit, const ActionCallback &callback) = 0;
+	virtual void forEachRevertAction(const std::string &actor, time_t seconds,
+			const ActionCallback &callback) = 0;
 };
 
 
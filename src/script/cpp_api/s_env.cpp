@@ -103,16 +103,17 @@ class LuaLBM : public LoadingBlockModifierDef
 public:
 	LuaLBM(int id,
 			const std::vector<std::string> &trigger_contents,
-			const std::string &name, bool run_at_every_load):
+			const std::string &name, bool run_at_every_load, bool bulk):
 		m_id(id)
 	{
 		this->run_at_every_load = run_at_every_load;
+		this->bulk = bulk;
 		this->trigger_contents = trigger_contents;
 		this->name = name;
 	}
 
 	virtual void trigger(ServerEnvironment *env, MapBlock *block,
-		const std::unordered_set<v3s16> &positions, float dtime_s)
+		const std::vector<v3s16> &positions, float dtime_s)
 	{
 		auto *script = env->getScriptIface();
 		script->triggerLBM(m_id, block, positions, dtime_s);
@@ -321,8 +322,12 @@ void ScriptApiEnv::readLBMs()
 		bool run_at_every_load = getboolfield_default(L, current_lbm,
 			"run_at_every_load", false);
 
+		lua_getfield(L, current_lbm, "bulk_action");
+		bool bulk = lua_isfunction(L, -1);
+		lua_pop(L, 1);
+
 		LuaLBM *lbm = new LuaLBM(id, trigger_contents, name,
-			run_at_every_load);
+			run_at_every_load, bulk);
 
 		env->addLoadingBlockModifierDef(lbm);
 
@@ -495,7 +500,7 @@ void ScriptApiEnv::triggerABM(int id, v3s16 p, MapNode n,
 }
 
 void ScriptApiEnv::triggerLBM(int id, MapBlock *block,
-		const std::unordered_set<v3s16> &positions, float dtime_s)
+		const std::vector<v3s16> &positions, float dtime_s)
 {
 	SCRIPTAPI_PRECHECKHEADER
 
@@ -61,7 +61,7 @@ class ScriptApiEnv : virtual public ScriptApiBase
 			);
 
 	void triggerLBM(int id, MapBlock *block,
-		const std::unordered_set<v3s16> &positions, float dtime_s);
+		const std::vector<v3s16> &positions, float dtime_s);
 
 private:
 	void readABMs();
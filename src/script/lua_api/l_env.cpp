@@ -25,6 +25,7 @@
 #include "pathfinder.h"
 #include <unordered_set>
 #include "face_position_cache.h"
+#include "fm_map_search.h"
 #include "remoteplayer.h"
 #include "server/luaentity_sao.h"
 #include "server/player_sao.h"
@@ -870,14 +871,13 @@ void ModApiEnvBase::collectNodeIds(lua_State *L, int idx, const NodeDefManager *
 
 template <typename F>
 int ModApiEnvBase::findNodeNear(lua_State *L, v3s16 pos, int radius,
-		const std::vector<content_t> &filter, int start_radius, F &&getNode)
+		int start_radius, F &&matches)
 {
 	for (int d = start_radius; d <= radius; d++) {
 		const std::vector<v3s16> &list = FacePositionCache::getFacePositions(d);
 		for (const v3s16 &i : list) {
 			v3s16 p = pos + i;
-			content_t c = getNode(p).getContent();
-			if (CONTAINS(filter, c)) {
+			if (matches(p)) {
 				push_v3s16(L, p);
 				return 1;
 			}
@@ -908,10 +908,9 @@ int ModApiEnv::l_find_node_near(lua_State *L)
 		radius = client->CSMClampRadius(pos, radius);
 #endif
 
-	auto getNode = [&map] (v3s16 p) -> MapNode {
-		return map.getNode(p);
-	};
-	return findNodeNear(L, pos, radius, filter, start_radius, getNode);
+	const ContentFilter content_filter(filter);
+	MapNodeMatcher matches(map, content_filter);
+	return findNodeNear(L, pos, radius, start_radius, matches);
 }
 
 void ModApiEnvBase::checkArea(v3s16 &minp, v3s16 &maxp)
@@ -929,10 +928,48 @@ void ModApiEnvBase::checkArea(v3s16 &minp, v3s16 &maxp)
 #undef CLAMP
 }
 
+// Appends p as three little-endian s16
+static void pack_v3s16(std::string &s, v3s16 p)
+{
+	for (const s16 v : {p.X, p.Y, p.Z}) {
+		s.push_back(v & 0xFF);
+		s.push_back((u16)v >> 8);
+	}
+}
+
 template <typename F>
 int ModApiEnvBase::findNodesInArea(lua_State *L, const NodeDefManager *ndef,
-		const std::vector<content_t> &filter, bool grouped, F &&iterate)
-{
+		const std::vector<content_t> &filter, bool grouped, bool packed, F &&iterate)
+{
+	if (packed) {
+		// One string for each filter or for all
+		std::vector<std::string> found(grouped ? filter.size() : 1);
+		std::vector<u32> individual_count(filter.size());
+		iterate([&](v3s16 p, int filt_index) {
+			pack_v3s16(found[grouped ? filt_index : 0], p);
+			individual_count[filt_index]++;
+		});
+
+		if (grouped) {
+			lua_createtable(L, 0, filter.size());
+			for (u32 i = 0; i < filter.size(); i++) {
+				if (found[i].empty())
+					continue;
+				lua_pushlstring(L, found[i].data(), found[i].size());
+				lua_setfield(L, -2, ndef->get(filter[i]).name.c_str());
+			}
+			return 1;
+		}
+
+		lua_pushlstring(L, found[0].data(), found[0].size());
+		lua_createtable(L, 0, filter.size());
+		for (u32 i = 0; i < filter.size(); i++) {
+			lua_pushinteger(L, individual_count[i]);
+			lua_setfield(L, -2, ndef->get(filter[i]).name.c_str());
+		}
+		return 2;
+	}
+
 	if (grouped) {
 		// create the table we will be returning
 		lua_createtable(L, 0, filter.size());
@@ -944,18 +981,10 @@ int ModApiEnvBase::findNodesInArea(lua_State *L, const NodeDefManager *ndef,
 		for (u32 i = 0; i < filter.size(); i++)
 			lua_newtable(L);
 
-		iterate([&](v3s16 p, MapNode n) -> bool {
-			content_t c = n.getContent();
-
-			auto it = std::find(filter.begin(), filter.end(), c);
-			if (it != filter.end()) {
-				// Calculate index of the table and append the position
-				u32 filt_index = it - filter.begin();
-				push_v3s16(L, p);
-				lua_rawseti(L, base + 1 + filt_index, ++idx[filt_index]);
-			}
-
-			return true;
+		iterate([&](v3s16 p, int filt_index) {
+			// Append the position to the table of its filter
+			push_v3s16(L, p);
+			lua_rawseti(L, base + 1 + filt_index, ++idx[filt_index]);
 		});
 
 		// last filter table is at top of stack
@@ -978,19 +1007,11 @@ int ModApiEnvBase::findNodesInArea(lua_State *L, const NodeDefManager *ndef,
 
 		lua_newtable(L);
 		u32 i = 0;
-		iterate([&](v3s16 p, MapNode n) -> bool {
-			content_t c = n.getContent();
-
-			auto it = std::find(filter.begin(), filter.end(), c);
-			if (it != filter.end()) {
-				push_v3s16(L, p);
-				lua_rawseti(L, -2, ++i);
-
-				u32 filt_index = it - filter.begin();
-				individual_count[filt_index]++;
-			}
+		iterate([&](v3s16 p, int filt_index) {
+			push_v3s16(L, p);
+			lua_rawseti(L, -2, ++i);
 
-			return true;
+			individual_count[filt_index]++;
 		});
 
 		lua_createtable(L, 0, filter.size());
@@ -1002,7 +1023,7 @@ int ModApiEnvBase::findNodesInArea(lua_State *L, const NodeDefManager *ndef,
 	}
 }
 
-// find_nodes_in_area(minp, maxp, nodenames, [grouped])
+// find_nodes_in_area(minp, maxp, nodenames, [grouped], [packed])
 int ModApiEnv::l_find_nodes_in_area(lua_State *L)
 {
 	GET_PLAIN_ENV_PTR;
@@ -1027,17 +1048,20 @@ int ModApiEnv::l_find_nodes_in_area(lua_State *L)
 	collectNodeIds(L, 3, ndef, filter);
 
 	bool grouped = lua_isboolean(L, 4) && readParam<bool>(L, 4);
+	bool packed = lua_isboolean(L, 5) && readParam<bool>(L, 5);
 
+	const ContentFilter content_filter(filter);
 	auto iterate = [&] (auto &&callback) {
-		map.forEachNodeInArea(minp, maxp, callback);
+		forEachMatchingNode(map, minp, maxp, content_filter, callback);
 	};
-	return findNodesInArea(L, ndef, filter, grouped, iterate);
+	return findNodesInArea(L, ndef, filter, grouped, packed, iterate);
 }
 
 template <typename F>
 int ModApiEnvBase::findNodesInAreaUnderAir(lua_State *L, v3s16 minp, v3s16 maxp,
 	const std::vector<content_t> &filter, F &&getNode)
 {
+	const ContentFilter content_filter(filter);
 	lua_newtable(L);
 	u32 i = 0;
 	v3s16 p;
@@ -1049,7 +1073,7 @@ int ModApiEnvBase::findNodesInAreaUnderAir(lua_State *L, v3s16 minp, v3s16 maxp,
 			v3s16 psurf(p.X, p.Y + 1, p.Z);
 			content_t csurf = getNode(psurf).getContent();
 			if (c != CONTENT_AIR && csurf == CONTENT_AIR &&
-					CONTAINS(filter, c)) {
+					content_filter.contains(c)) {
 				push_v3s16(L, p);
 				lua_rawseti(L, -2, ++i);
 			}
@@ -1088,8 +1112,12 @@ int ModApiEnv::l_find_nodes_in_area_under_air(lua_State *L)
 	std::vector<content_t> filter;
 	collectNodeIds(L, 3, ndef, filter);
 
-	auto getNode = [&map] (v3s16 p) -> MapNode {
-		return map.getNode(p);
+	// Read a block at a time, with the nodes above the area
+	const VoxelArea area(minp, maxp + v3s16(0, 1, 0));
+	std::vector<content_t> contents;
+	readContents(map, area, contents);
+	auto getNode = [&] (v3s16 p) -> MapNode {
+		return MapNode(contents[area.index(p)]);
 	};
 	return findNodesInAreaUnderAir(L, minp, maxp, filter, getNode);
 }
@@ -1343,7 +1371,7 @@ int ModApiEnv::l_find_path(lua_State *L)
 	}
 
 	std::vector<v3s16> path = get_path(&env->getServerMap(), env->getGameDef()->ndef(), pos1, pos2,
-		searchdistance, max_jump, max_drop, algo);
+		searchdistance, max_jump, max_drop, algo, &env->getPathfinderCache());
 
 	if (!path.empty()) {
 		lua_createtable(L, path.size(), 0);
@@ -1613,13 +1641,14 @@ int ModApiEnvVM::l_find_node_near(lua_State *L)
 	collectNodeIds(L, 3, ndef, filter);
 	int start_radius = (lua_isboolean(L, 4) && readParam<bool>(L, 4)) ? 0 : 1;
 
-	auto getNode = [&vm] (v3s16 p) -> MapNode {
-		return vm->getNodeNoExNoEmerge(p);
+	const ContentFilter content_filter(filter);
+	auto matches = [&] (v3s16 p) -> bool {
+		return content_filter.contains(vm->getNodeNoExNoEmerge(p).getContent());
 	};
-	return findNodeNear(L, pos, radius, filter, start_radius, getNode);
+	return findNodeNear(L, pos, radius, start_radius, matches);
 }
 
-// find_nodes_in_area(minp, maxp, nodenames, [grouped])
+// find_nodes_in_area(minp, maxp, nodenames, [grouped], [packed])
 int ModApiEnvVM::l_find_nodes_in_area(lua_State *L)
 {
 	GET_VM_PTR;
@@ -1642,21 +1671,22 @@ int ModApiEnvVM::l_find_nodes_in_area(lua_State *L)
 	collectNodeIds(L, 3, ndef, filter);
 
 	bool grouped = lua_isboolean(L, 4) && readParam<bool>(L, 4);
+	bool packed = lua_isboolean(L, 5) && readParam<bool>(L, 5);
 
-	auto iterate = [&] (auto callback) {
+	const ContentFilter content_filter(filter);
+	auto iterate = [&] (auto &&callback) {
 		for (s16 z = minp.Z; z <= maxp.Z; z++)
 		for (s16 y = minp.Y; y <= maxp.Y; y++) {
 			u32 vi = vm->m_area.index(minp.X, y, z);
 			for (s16 x = minp.X; x <= maxp.X; x++) {
-				v3s16 pos(x, y, z);
-				MapNode n = vm->m_data[vi];
-				if (!callback(pos, n))
-					return;
+				const int filt_index = content_filter.find(vm->m_data[vi].getContent());
+				if (filt_index >= 0)
+					callback(v3s16(x, y, z), filt_index);
 				++vi;
 			}
 		}
 	};
-	return findNodesInArea(L, ndef, filter, grouped, iterate);
+	return findNodesInArea(L, ndef, filter, grouped, packed, iterate);
 }
 
 // find_nodes_in_area_under_air(minp, maxp, nodenames)
@@ -18,17 +18,18 @@ class ModApiEnvBase : public ModApiBase {
 
 	static void checkArea(v3s16 &minp, v3s16 &maxp);
 
-	// F must be (v3s16 pos) -> MapNode
+	// F must be (v3s16 pos) -> bool, true if the node is searched for
 	template <typename F>
 	static int findNodeNear(lua_State *L, v3s16 pos, int radius,
-		const std::vector<content_t> &filter, int start_radius, F &&getNode);
+		int start_radius, F &&matches);
 
 	// F must be (G callback) -> void
-	// with G being (v3s16 p, MapNode n) -> bool
-	// and behave like Map::forEachNodeInArea
+	// with G being (v3s16 p, int filter_index) -> void
+	// and call it for the nodes matching filter like forEachMatchingNode
 	template <typename F>
 	static int findNodesInArea(lua_State *L,  const NodeDefManager *ndef,
-		const std::vector<content_t> &filter, bool grouped, F &&iterate);
+		const std::vector<content_t> &filter, bool grouped, bool packed,
+		F &&iterate);
 
 	// F must be (v3s16 pos) -> MapNode
 	template <typename F>
@@ -9,7 +9,7 @@
 #include "rollback_interface.h"
 
 
-void push_RollbackNode(lua_State *L, RollbackNode &node)
+void push_RollbackNode(lua_State *L, const RollbackNode &node)
 {
 	lua_createtable(L, 0, 3);
 	lua_pushstring(L, node.name.c_str());
@@ -35,30 +35,30 @@ int ModApiRollback::l_rollback_get_node_actions(lua_State *L)
 		return 0;
 	}
 
-	std::list<RollbackAction> actions = rollback->getNodeActors(pos, range, seconds, limit);
-	std::list<RollbackAction>::iterator iter = actions.begin();
+	lua_newtable(L);
+	unsigned int i = 0;
+	rollback->forEachNodeActor(pos, range, seconds, limit,
+		[L, &i] (const RollbackAction &action) {
+			lua_createtable(L, 0, 5); // Make a table with enough space pre-allocated
 
-	lua_createtable(L, actions.size(), 0);
-	for (unsigned int i = 1; iter != actions.end(); ++iter, ++i) {
-		lua_createtable(L, 0, 5); // Make a table with enough space pre-allocated
+			lua_pushstring(L, action.actor.c_str());
+			lua_setfield(L, -2, "actor");
 
-		lua_pushstring(L, iter->actor.c_str());
-		lua_setfield(L, -2, "actor");
+			push_v3s16(L, action.p);
+			lua_setfield(L, -2, "pos");
 
-		push_v3s16(L, iter->p);
-		lua_setfield(L, -2, "pos");
+			lua_pushnumber(L, action.unix_time);
+			lua_setfield(L, -2, "time");
 
-		lua_pushnumber(L, iter->unix_time);
-		lua_setfield(L, -2, "time");
+			push_RollbackNode(L, action.n_old);
+			lua_setfield(L, -2, "oldnode");
 
-		push_RollbackNode(L, iter->n_old);
-		lua_setfield(L, -2, "oldnode");
+			push_RollbackNode(L, action.n_new);
+			lua_setfield(L, -2, "newnode");
 
-		push_RollbackNode(L, iter->n_new);
-		lua_setfield(L, -2, "newnode");
-
-		lua_rawseti(L, -2, i); // Add action table to main table
-	}
+			lua_rawseti(L, -2, ++i); // Add action table to main table
+			return true;
+		});
 
 	return 1;
 }
@@ -239,6 +239,14 @@ int ModApiServer::l_get_player_information(lua_State *L)
 	lua_pushstring(L, info.lang_code.c_str());
 	lua_settable(L, table);
 
+	lua_pushstring(L, "block_send_rate");
+	lua_pushnumber(L, info.block_send_rate);
+	lua_settable(L, table);
+
+	lua_pushstring(L, "block_send_queued");
+	lua_pushnumber(L, info.block_send_queued);
+	lua_settable(L, table);
+
 #ifndef NDEBUG
 	lua_pushstring(L,"serialization_version");
 	lua_pushnumber(L, info.ser_vers);
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 // Copyright (C) 2013 kwolekr, Ryan Kwolek <kwolekr@minetest.net>
 
+#include <cstring>
 #include <map>
 #include "lua_api/l_vmanip.h"
 #include "lua_api/l_mapgen.h"
@@ -9,6 +10,7 @@
 #include "common/c_content.h"
 #include "common/c_converter.h"
 #include "common/c_packer.h"
+#include "cpp_api/s_base.h"
 #include "environment.h"
 #include "map.h"
 #include "mapblock.h"
@@ -40,7 +42,9 @@ int LuaVoxelManip::l_read_from_map(lua_State *L)
 	v3s16 bp2 = getNodeBlockPos(check_v3s16(L, 3));
 	sortBoxVerticies(bp1, bp2);
 
-	vm->initialEmerge(bp1, bp2);
+	// Async workers only take a snapshot of what is loaded: blocks are pinned
+	// and copied under their shared lock, emerging is left to the server thread
+	vm->initialEmerge(bp1, bp2, !o->is_read_only);
 
 	push_v3s16(L, vm->m_area.MinEdge);
 	push_v3s16(L, vm->m_area.MaxEdge);
@@ -113,6 +117,8 @@ int LuaVoxelManip::l_write_to_map(lua_State *L)
 	// This wouldn't work anyway as we have no env ptr, but it's still unsafe.
 	if (getEmergeThread(L))
 		throw LuaError("VoxelManip:write_to_map called in mapgen environment");
+	if (o->is_read_only)
+		throw LuaError("VoxelManip:write_to_map called on a read-only VoxelManip");
 
 	GET_ENV_PTR;
 
@@ -312,6 +318,167 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 	return 0;
 }
 
+namespace
+{
+// Bytes per node of the data get_packed_data() returns for each kind
+size_t packed_size(lua_State *L, int idx, const char *&what)
+{
+	what = luaL_optstring(L, idx, "content");
+	if (!strcmp(what, "content"))
+		return 2;
+	if (!strcmp(what, "light") || !strcmp(what, "param2"))
+		return 1;
+	throw LuaError(std::string("Unknown VoxelManip data \"") + what + "\"");
+}
+
+// The area given at idx and idx + 1, all of the VoxelManip if left out
+VoxelArea read_area(lua_State *L, int idx, const MMVManip *vm)
+{
+	v3s16 pmin = lua_istable(L, idx) ? check_v3s16(L, idx) : vm->m_area.MinEdge;
+	v3s16 pmax = lua_istable(L, idx + 1) ? check_v3s16(L, idx + 1) : vm->m_area.MaxEdge;
+
+	sortBoxVerticies(pmin, pmax);
+	if (!vm->m_area.contains(VoxelArea(pmin, pmax)))
+		throw LuaError("Specified voxel area out of VoxelManipulator bounds");
+	return VoxelArea(pmin, pmax);
+}
+
+// Calls func with the index of each node of area, row by row
+template <typename F>
+void for_each_index(const MMVManip *vm, const VoxelArea &area, F &&func)
+{
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+		const u32 begin = vm->m_area.index(area.MinEdge.X, y, z);
+		const u32 end = begin + area.getExtent().X;
+		for (u32 i = begin; i != end; i++)
+			func(i);
+	}
+}
+
+// Do not use uninitialized data, as get_data() does
+inline content_t get_content(const MMVManip *vm, u32 i)
+{
+	return (vm->m_flags[i] & VOXELFLAG_NO_DATA) ? CONTENT_IGNORE : vm->m_data[i].getContent();
+}
+}
+
+int LuaVoxelManip::l_get_packed_data(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	MMVManip *vm = o->vm;
+	const char *what;
+	const size_t size = packed_size(L, 2, what);
+	const u32 volume = vm->m_area.getVolume();
+
+	std::string data(volume * size, '\0');
+	if (what[0] == 'c') {
+		for (u32 i = 0; i != volume; i++) {
+			const content_t c = get_content(vm, i);
+			data[2 * i] = c & 0xFF;
+			data[2 * i + 1] = c >> 8;
+		}
+	} else {
+		const bool light = what[0] == 'l';
+		for (u32 i = 0; i != volume; i++) {
+			if (!(vm->m_flags[i] & VOXELFLAG_NO_DATA))
+				data[i] = light ? vm->m_data[i].getParam1() : vm->m_data[i].getParam2();
+		}
+	}
+
+	lua_pushlstring(L, data.data(), data.size());
+	return 1;
+}
+
+int LuaVoxelManip::l_set_packed_data(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	MMVManip *vm = o->vm;
+	size_t len;
+	const u8 *data = reinterpret_cast<const u8 *>(luaL_checklstring(L, 2, &len));
+	const char *what;
+	const size_t size = packed_size(L, 3, what);
+	const u32 volume = vm->m_area.getVolume();
+
+	if (len != volume * size)
+		throw LuaError("VoxelManip:set_packed_data called with " +
+				std::to_string(len) + " bytes instead of " +
+				std::to_string(volume * size));
+
+	if (what[0] == 'c') {
+		for (u32 i = 0; i != volume; i++)
+			vm->m_data[i].setContent(data[2 * i] | data[2 * i + 1] << 8);
+	} else if (what[0] == 'l') {
+		for (u32 i = 0; i != volume; i++)
+			vm->m_data[i].param1 = data[i];
+	} else {
+		for (u32 i = 0; i != volume; i++)
+			vm->m_data[i].param2 = data[i];
+	}
+
+	return 0;
+}
+
+int LuaVoxelManip::l_fill_content(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	MMVManip *vm = o->vm;
+	const content_t c = luaL_checkinteger(L, 2);
+	const VoxelArea area = read_area(L, 3, vm);
+
+	for_each_index(vm, area, [&](u32 i) {
+		vm->m_data[i].setContent(c);
+	});
+
+	return 0;
+}
+
+int LuaVoxelManip::l_replace_content(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	MMVManip *vm = o->vm;
+	const content_t from = luaL_checkinteger(L, 2);
+	const content_t to = luaL_checkinteger(L, 3);
+	const VoxelArea area = read_area(L, 4, vm);
+
+	lua_Integer count = 0;
+	for_each_index(vm, area, [&](u32 i) {
+		if (get_content(vm, i) == from) {
+			vm->m_data[i].setContent(to);
+			count++;
+		}
+	});
+
+	lua_pushinteger(L, count);
+	return 1;
+}
+
+int LuaVoxelManip::l_count_content(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManip *o = checkObject<LuaVoxelManip>(L, 1);
+	MMVManip *vm = o->vm;
+	const content_t c = luaL_checkinteger(L, 2);
+	const VoxelArea area = read_area(L, 3, vm);
+
+	lua_Integer count = 0;
+	for_each_index(vm, area, [&](u32 i) {
+		count += get_content(vm, i) == c;
+	});
+
+	lua_pushinteger(L, count);
+	return 1;
+}
+
 int LuaVoxelManip::l_update_map(lua_State *L)
 {
 	return 0;
@@ -350,7 +517,9 @@ LuaVoxelManip::LuaVoxelManip(MMVManip *mmvm, bool is_mg_vm) :
 {
 }
 
-LuaVoxelManip::LuaVoxelManip(Map *map) : vm(new MMVManip(map))
+LuaVoxelManip::LuaVoxelManip(Map *map, bool read_only) :
+	is_read_only(read_only),
+	vm(new MMVManip(map))
 {
 }
 
@@ -364,9 +533,18 @@ LuaVoxelManip::~LuaVoxelManip()
 // Creates an LuaVoxelManip and leaves it on top of stack
 int LuaVoxelManip::create_object(lua_State *L)
 {
-	GET_ENV_PTR;
+	MAP_LOCK_REQUIRED;
 
-	LuaVoxelManip *o = new LuaVoxelManip(&env->getMap());
+	LuaVoxelManip *o;
+	if (Environment *env = getEnv(L)) {
+		o = new LuaVoxelManip(&env->getMap());
+	} else if (getScriptApiBase(L)->getType() == ScriptingType::Async &&
+			getServer(L)) {
+		// Read-only view of the server map for async workers
+		o = new LuaVoxelManip(&getServer(L)->getEnv().getMap(), true);
+	} else {
+		return 0;
+	}
 
 	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
 	luaL_getmetatable(L, className);
@@ -449,6 +627,11 @@ const luaL_Reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, set_light_data),
 	luamethod(LuaVoxelManip, get_param2_data),
 	luamethod(LuaVoxelManip, set_param2_data),
+	luamethod(LuaVoxelManip, get_packed_data),
+	luamethod(LuaVoxelManip, set_packed_data),
+	luamethod(LuaVoxelManip, fill_content),
+	luamethod(LuaVoxelManip, replace_content),
+	luamethod(LuaVoxelManip, count_content),
 	luamethod(LuaVoxelManip, was_modified),
 	luamethod(LuaVoxelManip, get_emerged_area),
 	{0,0}
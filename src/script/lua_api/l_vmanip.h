@@ -18,6 +18,9 @@ class LuaVoxelManip : public ModApiBase
 {
 private:
 	bool is_mapgen_vm = false;
+	// Created in an async environment: reads go straight to the server map
+	// and never load or generate blocks, writing back is refused
+	bool is_read_only = false;
 
 	static const luaL_Reg methods[];
 
@@ -42,6 +45,13 @@ class LuaVoxelManip : public ModApiBase
 	static int l_get_param2_data(lua_State *L);
 	static int l_set_param2_data(lua_State *L);
 
+	// Flat data in strings, and bulk operations on it without Lua tables
+	static int l_get_packed_data(lua_State *L);
+	static int l_set_packed_data(lua_State *L);
+	static int l_fill_content(lua_State *L);
+	static int l_replace_content(lua_State *L);
+	static int l_count_content(lua_State *L);
+
 	static int l_was_modified(lua_State *L);
 	static int l_get_emerged_area(lua_State *L);
 
@@ -49,7 +59,7 @@ class LuaVoxelManip : public ModApiBase
 	MMVManip *vm = nullptr;
 
 	LuaVoxelManip(MMVManip *mmvm, bool is_mapgen_vm);
-	LuaVoxelManip(Map *map);
+	LuaVoxelManip(Map *map, bool read_only = false);
 	~LuaVoxelManip();
 
 	// LuaVoxelManip()
@@ -3,6 +3,7 @@
 // Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
 
 #include "serialization.h"
+#include "fm_block_dictionary.h"
 #include "log.h"
 #include "util/serialize.h"
 
@@ -188,13 +189,20 @@ struct ZSTD_Deleter {
 	}
 };
 
-void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level,
+		const BlockDictionary *dict)
 {
 	// reusing the context is recommended for performance
 	// it will be destroyed when the thread ends
 	thread_local std::unique_ptr<ZSTD_CStream, ZSTD_Deleter> stream(ZSTD_createCStream());
 
 	ZSTD_initCStream(stream.get(), level);
+	if (dict) {
+		// level 0 is the default one
+		if (const ZSTD_CDict *cdict =
+						dict->getCDict(level ? level : ZSTD_CLEVEL_DEFAULT))
+			ZSTD_CCtx_refCDict(stream.get(), cdict);
+	}
 
 	const size_t bufsize = 16384;
 	char output_buffer[bufsize];
@@ -243,6 +251,8 @@ void decompressZstd(std::istream &is, std::ostream &os)
 
 	ZSTD_outBuffer output = { output_buffer, bufsize, 0 };
 	ZSTD_inBuffer input = { input_buffer, 0, 0 };
+	std::shared_ptr<BlockDictionary> dict;
+	bool frame_start = true;
 	size_t ret;
 	do
 	{
@@ -252,6 +262,17 @@ void decompressZstd(std::istream &is, std::ostream &os)
 			input.pos = 0;
 			if (input.size == 0)
 				throw SerializationError("decompressZstd: data ended too early");
+
+			if (frame_start) {
+				frame_start = false;
+				if (const u32 dict_id = ZSTD_getDictID_fromFrame(input_buffer, input.size)) {
+					dict = BlockDictionary::find(dict_id);
+					if (!dict)
+						throw SerializationError("decompressZstd: unknown dictionary " +
+								std::to_string(dict_id));
+					ZSTD_DCtx_refDDict(stream.get(), dict->getDDict());
+				}
+			}
 		}
 
 		ret = ZSTD_decompressStream(stream.get(), &output, &input);
@@ -274,12 +295,13 @@ void decompressZstd(std::istream &is, std::ostream &os)
 	}
 }
 
-void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level)
+void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level,
+		const BlockDictionary *dict)
 {
 	if(version >= 29)
 	{
 		// map the zlib levels [0,9] to [1,10]. -1 becomes 0 which indicates the default (currently 3)
-		compressZstd(data, size, os, level + 1);
+		compressZstd(data, size, os, level + 1, dict);
 		return;
 	}
 
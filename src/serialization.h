@@ -78,18 +78,26 @@ inline void compressZlib(std::string_view data, std::ostream &os, int level = 2)
 }
 void decompressZlib(std::istream &is, std::ostream &os, size_t limit = 0);
 
-void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 2);
-inline void compressZstd(std::string_view data, std::ostream &os, int level = 2)
+class BlockDictionary;
+
+// Data written with a dictionary is read with the known one of its id
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 2,
+		const BlockDictionary *dict = nullptr);
+inline void compressZstd(std::string_view data, std::ostream &os, int level = 2,
+		const BlockDictionary *dict = nullptr)
 {
-	compressZstd(reinterpret_cast<const u8*>(data.data()), data.size(), os, level);
+	compressZstd(reinterpret_cast<const u8*>(data.data()), data.size(), os, level, dict);
 }
 void decompressZstd(std::istream &is, std::ostream &os);
 
-// These choose between zstd, zlib and a self-made one according to version
-void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level = 2);
-inline void compress(std::string_view data, std::ostream &os, u8 version, int level = 2)
+// These choose between zstd, zlib and a self-made one according to version,
+// the dictionary is used with zstd
+void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level = 2,
+		const BlockDictionary *dict = nullptr);
+inline void compress(std::string_view data, std::ostream &os, u8 version, int level = 2,
+		const BlockDictionary *dict = nullptr)
 {
-	compress(reinterpret_cast<const u8*>(data.data()), data.size(), os, version, level);
+	compress(reinterpret_cast<const u8*>(data.data()), data.size(), os, version, level, dict);
 }
 void decompress(std::istream &is, std::ostream &os, u8 version);
 
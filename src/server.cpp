@@ -24,6 +24,7 @@
 #include "filesys.h"
 #include "mapblock.h"
 #include "server/serveractiveobject.h"
+#include "server/fm_object_fanout.h"
 #include "settings.h"
 #include "profiler.h"
 #include "log.h"
@@ -1067,9 +1068,9 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		EnvAutoLock envlock(this);
 		ScopeProfiler sp(g_profiler, "Server: send SAO messages");
 
-		// Key = object id
-		// Value = data sent by object
-		std::unordered_map<u16, std::vector<ActiveObjectMessage>*> buffered_messages;
+		// Messages are encoded once per object and go to the clients
+		// which know the object
+		ObjectMessageFanout fanout;
 
 		// Get active object messages from environment
 		ActiveObjectMessage aom(0);
@@ -1082,127 +1083,93 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			else
 				count_unreliable++;
 
-			std::vector<ActiveObjectMessage>* message_list = nullptr;
-			auto n = buffered_messages.find(aom.id);
-			if (n == buffered_messages.end()) {
-				message_list = new std::vector<ActiveObjectMessage>;
-				buffered_messages[aom.id] = message_list;
-			} else {
-				message_list = n->second;
-			}
-			message_list->push_back(std::move(aom));
+			fanout.add(std::move(aom));
 		}
 
 		m_aom_buffer_counter[0]->increment(count_reliable);
 		m_aom_buffer_counter[1]->increment(count_unreliable);
 
-		{
+		if (!fanout.empty()) {
 			ClientInterface::AutoLock clientlock(m_clients);
-			const auto &clients = m_clients.getClientList();
-			// Route data to every client
-#if MINETEST_PROTO
-			std::string reliable_data, unreliable_data;
-#endif
-			const auto uptime = getUptime();
-			for (const auto &client : clients) {
-#if MINETEST_PROTO
-				reliable_data.clear();
-				unreliable_data.clear();
-#else
-				ActiveObjectMessages reliable_data;
-				ActiveObjectMessages unreliable_data;
-#endif
-				//RemoteClient *client = client_it.second;
-				PlayerSAO *player = getPlayerSAO(client.second->peer_id);
-				// Go through all objects in message buffer
-				for (const auto &buffered_message : buffered_messages) {
-					// If object does not exist or is not known by client, skip it
-					u16 id = buffered_message.first;
-					ServerActiveObject *sao = m_env->getActiveObject(id);
-					if (!sao || client.second->m_known_objects.find(id) == client.second->m_known_objects.end())
-						continue;
+			struct Receiver
+			{
+				RemoteClient *client;
+				PlayerSAO *player;
+			};
+			std::unordered_map<session_t, Receiver> receivers;
+			for (const auto &client : m_clients.getClientList()) {
+				receivers[client.second->peer_id] = {client.second.get(),
+						getPlayerSAO(client.second->peer_id)};
+			}
 
-					// Get message list of object
-					std::vector<ActiveObjectMessage>* list = buffered_message.second;
-					// Go through every message
-					for (const ActiveObjectMessage &aom : *list) {
-						// Send position updates to players who do not see the attachment
-						if (aom.datastring[0] == AO_CMD_UPDATE_POSITION) {
-							if (sao->getId() == player->getId())
-								continue;
-
-							// Do not send position updates for attached players
-							// as long the parent is known to the client
-							ServerActiveObject *parent = sao->getParent();
-							if (parent && client.second->m_known_objects.find(parent->getId()) !=
-									client.second->m_known_objects.end())
-								continue;
-
-							// Limit position packets for far objects
-							constexpr static auto max_seconds_skip = 30;
-							auto &[last_time, last_dist] =
-									client.second->m_objects_last_pos_sent[id];
-						
-							if (aom.skip_by_pos && last_time && last_time + max_seconds_skip > uptime) {
-								int32_t dist = aom.skip_by_pos.value().getDistanceFrom(
-														player->getBasePosition()) /
-												(BS * MAP_BLOCKSIZE);
-								// fmtodo: dynamic values depend on load or overload
-								constexpr static auto min_dist_blocks_always_send = 3;
-								if (dist > min_dist_blocks_always_send) {
-
-									if (dist > player->getWantedRange() && last_dist == dist) {
-										continue;
-									}
-									const auto rndmax = std::min<uint32_t>(
-											max_seconds_skip /
-													m_env->getSendRecommendedInterval(),
-											dist - min_dist_blocks_always_send);
-									const auto rnd = myrand() % rndmax;
-									if (rnd) {
-										continue;
-									}
-								}
-								last_dist = dist;
-							}
-							last_time = getUptime();
+			const auto uptime = getUptime();
+			// Send position updates to players who do not see the attachment
+			auto skip_position = [&](session_t peer_id, ServerActiveObject *sao,
+					const std::optional<v3f> &skip_by_pos) {
+				const auto receiver = receivers.find(peer_id);
+				if (receiver == receivers.end() || !receiver->second.player)
+					return true;
+				RemoteClient *client = receiver->second.client;
+				PlayerSAO *player = receiver->second.player;
+
+				if (sao->getId() == player->getId())
+					return true;
+
+				// Do not send position updates for attached players
+				// as long the parent is known to the client
+				ServerActiveObject *parent = sao->getParent();
+				if (parent && client->m_known_objects.find(parent->getId()) !=
+						client->m_known_objects.end())
+					return true;
+
+				// Limit position packets for far objects
+				constexpr static auto max_seconds_skip = 30;
+				auto &[last_time, last_dist] =
+						client->m_objects_last_pos_sent[sao->getId()];
+
+				if (skip_by_pos && last_time && last_time + max_seconds_skip > uptime) {
+					int32_t dist = skip_by_pos.value().getDistanceFrom(
+											player->getBasePosition()) /
+									(BS * MAP_BLOCKSIZE);
+					// fmtodo: dynamic values depend on load or overload
+					constexpr static auto min_dist_blocks_always_send = 3;
+					if (dist > min_dist_blocks_always_send) {
+
+						if (dist > player->getWantedRange() && last_dist == dist) {
+							return true;
+						}
+						const auto rndmax = std::min<uint32_t>(
+								max_seconds_skip /
+										m_env->getSendRecommendedInterval(),
+								dist - min_dist_blocks_always_send);
+						const auto rnd = myrand() % rndmax;
+						if (rnd) {
+							return true;
 						}
-
-#if MINETEST_PROTO
-						// Add full new data to appropriate buffer
-						std::string &buffer = aom.reliable ? reliable_data : unreliable_data;
-						char idbuf[2];
-						writeU16((u8*) idbuf, aom.id);
-						// u16 id
-						// std::string data
-						buffer.append(idbuf, sizeof(idbuf));
-						buffer.append(serializeString16(aom.datastring));
-#else
-					if(aom.reliable)
-						reliable_data.push_back(make_pair(aom.id, aom.datastring));
-					else
-						unreliable_data.push_back(make_pair(aom.id, aom.datastring));
-#endif
 					}
+					last_dist = dist;
 				}
-				/*
-					reliable_data and unreliable_data are now ready.
-					Send them.
-				*/
-				if (!reliable_data.empty()) {
-					SendActiveObjectMessages(client.second->peer_id, reliable_data);
+				last_time = getUptime();
+				return false;
+			};
+
+			fanout.route([&](u16 id) { return m_env->getActiveObject(id); },
+					skip_position);
+
+			/*
+				The data of every client is now ready.
+				Send it.
+			*/
+			for (const auto &[peer_id, outgoing] : fanout.getOutgoing()) {
+				if (!outgoing.reliable.empty()) {
+					SendActiveObjectMessages(peer_id, outgoing.reliable);
 				}
 
-				if (!unreliable_data.empty()) {
-					SendActiveObjectMessages(client.second->peer_id, unreliable_data, false);
+				if (!outgoing.unreliable.empty()) {
+					SendActiveObjectMessages(peer_id, outgoing.unreliable, false);
 				}
 			}
 		}
-
-		// Clear buffered_messages
-		for (auto &buffered_message : buffered_messages) {
-			delete buffered_message.second;
-		}
 	}
 
 	/*
@@ -1266,8 +1233,7 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 
 				if (MapBlock *block = m_env->getMap().getBlockNoCreateNoEx(
 						getNodeBlockPos(event->p))) {
-					block->raiseModified(MOD_STATE_WRITE_NEEDED,
-						MOD_REASON_REPORT_META_CHANGE);
+					block->raiseModifiedNode(event->p - block->getPosRelative());
 				}
 				break;
 			}
@@ -1701,6 +1667,9 @@ bool Server::getClientInfo(session_t peer_id, ClientInfo &ret)
 
 	ret.lang_code = client->getLangCode();
 
+	ret.block_send_rate = client->m_send_budget.getSendRate();
+	ret.block_send_queued = client->m_send_budget.getQueued();
+
 	return true;
 }
 
@@ -2455,8 +2424,8 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 
 		// Remove from known objects
 		client->m_known_objects.erase(id);
-		if (obj && obj->m_known_by_count > 0)
-			obj->m_known_by_count--;
+		if (obj)
+			obj->removeKnownBy(client->peer_id);
 	}
 
 	// Note: Do yet NOT stop or remove object-attached sounds where the object goes out
@@ -2489,7 +2458,7 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 
 		// Add to known objects
 		client->m_known_objects.insert(id);
-		obj->m_known_by_count++;
+		obj->addKnownBy(client->peer_id);
 	}
 
 #if MINETEST_PROTO
@@ -2769,14 +2738,16 @@ void Server::sendMetadataChanged(const std::unordered_set<v3s16> &positions, flo
 
 #if MINETEST_PROTO
 
-void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache)
+size_t Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
+		u16 net_proto_version, SerializedBlockCache *cache, const BlockDictionary *dict)
 {
 	thread_local const int net_compression_level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
 	std::string s, *sptr = nullptr;
+	// Blocks written with the dictionary are cached on their own
+	const u16 cache_ver = dict ? ver | 0x100 : ver;
 
 	if (cache) {
-		auto it = cache->find({block->getPos(), ver});
+		auto it = cache->find({block->getPos(), cache_ver});
 		if (it != cache->end())
 			sptr = &it->second;
 	}
@@ -2784,7 +2755,7 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 	// Serialize the block in the right format
 	if (!sptr) {
 		std::ostringstream os(std::ios_base::binary);
-		block->serialize(os, ver, false, net_compression_level);
+		block->serialize(os, ver, false, net_compression_level, false, dict);
 		block->serializeNetworkSpecific(os);
 		s = os.str();
 		sptr = &s;
@@ -2798,7 +2769,9 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 
 	// Store away in cache
 	if (cache && sptr == &s)
-		(*cache)[{block->getPos(), ver}] = std::move(s);
+		(*cache)[{block->getPos(), cache_ver}] = std::move(s);
+
+	return pkt.getSize();
 }
 
 #endif
@@ -2828,6 +2801,9 @@ int Server::SendBlocks(float dtime)
 				continue;
 
 			//total_sending += client->getSendingCount();
+			client->m_send_budget.update(dtime,
+					m_con->getPeerStat(client_id, con::MIN_RTT),
+					m_con->getPeerStat(client_id, con::AVG_RTT));
 			const auto old_count = queue.size();
 			if (client->net_proto_version_fm) {
 				total += client->GetNextBlocksFm(m_env, m_emerge.get(), dtime, queue,
@@ -2879,13 +2855,29 @@ int Server::SendBlocks(float dtime)
 		if (!client)
 			continue;
 
+		// The queue is sorted by distance, a slow client stops at its nearest
+		// blocks without holding back the others
+		if (!client->m_send_budget.canSend(
+					block_to_send.priority <= BLOCK_SEND_DISABLE_LIMITS_MAX_D))
+			continue;
+
 		{
 		const auto lock = block->try_lock_shared_rec();
 		if (!lock->owns_lock())
 			continue;
 
-		SendBlockNoLock(block_to_send.peer_id, block, client->serialization_version,
-				client->net_proto_version, cache_ptr);
+		size_t sent = 0;
+		const bool delta = client->net_proto_version_fm >= 3;
+		if (!delta || !SendBlockDelta(client, block, &cache, sent)) {
+			// A delta found too large left the serialized block in the cache
+			sent = SendBlockNoLock(block_to_send.peer_id, block,
+					client->serialization_version, client->net_proto_version,
+					delta ? &cache : cache_ptr, getBlockDictionary(client));
+		}
+		if (delta)
+			client->m_blocks_sent_version.insert_or_assign(
+					block_to_send.pos, block->getChangeStamp());
+		client->m_send_budget.sent(sent);
 		}
 
 		client->SentBlock(block_to_send.pos, m_uptime_counter->get() + m_env->m_game_time_start);
@@ -2927,6 +2919,8 @@ size_t Server::addMediaFile(const std::string &filename,
 		".x", ".b3d", ".obj", ".gltf", ".glb",
 		// Translation file formats
 		".tr", ".po", ".mo",
+		// Block dictionary
+		".zdict",
 		NULL
 	};
 	if (removeStringEnd(filename, supported_ext).empty()) {
@@ -3007,6 +3001,11 @@ void Server::fillMediaCache()
 		}
 	}
 
+	// Clients read the blocks of the world with it
+	const std::string dictionary_path = m_path_world + DIR_DELIM + BLOCK_DICTIONARY_FILE;
+	if (fs::PathExists(dictionary_path))
+		size_total += addMediaFile(BLOCK_DICTIONARY_FILE, dictionary_path);
+
 	actionstream << "Server: " << m_media.size() << " media files collected" 
 	" with " << size_total << " bytes" << std::endl;
 }
@@ -3021,9 +3020,15 @@ void Server::sendMediaAnnouncement(session_t peer_id, const std::string &lang_co
 		lang_suffixes[i].append(".").append(lang_code).append(translation_formats[i]);
   }
 
+	// Blocks are sent with the dictionary only to the clients which read it
+	const RemoteClient *client = getClientNoEx(peer_id, CS_Created);
+	const bool block_dictionary = client && getBlockDictionary(client);
+
   auto include = [&] (const std::string &name, const MediaInfo &info) -> bool {
 		if (info.no_announce)
 			return false;
+		if (name == BLOCK_DICTIONARY_FILE)
+			return block_dictionary;
 		for (size_t j = 0; j < 3; j++) {
 			if (str_ends_with(name, translation_formats[j]) && !str_ends_with(name, lang_suffixes[j])) {
 				return false;
@@ -56,6 +56,7 @@ class EnvThread;
 class AbmThread;
 class AbmWorldThread;
 class WorldMergeThread;
+class BlockDictionary;
 
 
 class ClientNotFoundException : public BaseException
@@ -174,6 +175,9 @@ struct ClientInfo {
 	u16 prot_vers;
 	u8 major, minor, patch;
 	std::string vers_string, lang_code;
+	// fm: block sending to the client, bytes per second and bytes on the way
+	float block_send_rate;
+	size_t block_send_queued;
 };
 
 struct ModIPCStore {
@@ -604,8 +608,16 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// Environment and Connection must be locked when called
 	// `cache` may only be very short lived! (invalidation not handeled)
-	void SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
-		u16 net_proto_version, SerializedBlockCache *cache = nullptr);
+	// Returns the bytes sent
+	size_t SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
+		u16 net_proto_version, SerializedBlockCache *cache = nullptr,
+		const BlockDictionary *dict = nullptr);
+	// The block dictionary of the world if the client can read with it
+	const BlockDictionary *getBlockDictionary(const RemoteClient *client);
+	// Sends the nodes changed since the client got the block, false if the
+	// whole block has to be sent. The block must be locked.
+	bool SendBlockDelta(RemoteClient *client, MapBlock *block,
+			SerializedBlockCache *cache, size_t &sent);
 
 	// Sends blocks to clients (locks env and con on its own)
 public:
@@ -821,8 +833,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void SendActiveObjectMessages(
 			session_t peer_id, const ActiveObjectMessages &datas, bool reliable = true);
 public:
-	void SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver, u16 net_proto_version,
-			SerializedBlockCache *cache = nullptr);
+	size_t SendBlockFm(session_t peer_id, MapBlockPtr block, u8 ver, u16 net_proto_version,
+			SerializedBlockCache *cache = nullptr, const BlockDictionary *dict = nullptr);
 private:
 
 	float m_liquid_send_timer{};
@@ -486,6 +486,7 @@ void RemoteClient::SetBlocksNotSent(const std::vector<v3s16> &blocks)
 
 void RemoteClient::SetBlockDeleted(const v3bpos_t & p) {
 	m_blocks_sent.erase(p);
+	m_blocks_sent_version.erase(p);
 }
 
 void RemoteClient::notifyEvent(ClientStateEvent event)
@@ -966,8 +967,8 @@ void ClientInterface::DeleteClient(session_t peer_id)
 		// Get object
 		ServerActiveObject* obj = m_env->getActiveObject(id, true);
 
-		if(obj && obj->m_known_by_count > 0)
-			obj->m_known_by_count--;
+		if(obj)
+			obj->removeKnownBy(peer_id);
 	}
 	}
 
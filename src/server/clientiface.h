@@ -24,6 +24,7 @@
 #include "porting.h"
 #include "threading/mutex_auto_lock.h"
 #include "clientdynamicinfo.h"
+#include "server/fm_block_send_budget.h"
 
 #include <list>
 #include <vector>
@@ -259,6 +260,10 @@ class RemoteClient
 	int GetNextBlocksFm(ServerEnvironment *env, EmergeManager *emerge, float dtime,
 			std::vector<PrioritySortedBlockTransfer> &dest, double m_uptime, u64 max_ms);
 	uint32_t SendFarBlocks();
+	BlockSendBudget m_send_budget;
+	// MapBlock::getChangeStamp() of the blocks as the client has them, only
+	// what changed after it is sent again
+	concurrent_unordered_map<v3bpos_t, u64, v3posHash, v3posEqual> m_blocks_sent_version;
 	// ==
 
 	/* Authentication information */
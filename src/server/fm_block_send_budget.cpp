@@ -0,0 +1,113 @@
+/*
+fm_block_send_budget.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_block_send_budget.h"
+#include <algorithm>
+#include <cmath>
+#include "settings.h"
+
+// Seconds of sending the budget may save up
+#define BLOCK_SEND_BURST 0.25f
+
+BlockSendBudget::BlockSendBudget() :
+		BlockSendBudget(g_settings->getFloat("block_send_queue_delay"))
+{
+}
+
+BlockSendBudget::BlockSendBudget(float target_delay) : m_target_delay(target_delay)
+{
+}
+
+void BlockSendBudget::update(float dtime, float min_rtt, float avg_rtt)
+{
+	if (dtime <= 0)
+		return;
+
+	const std::lock_guard<std::mutex> lock(m_mutex);
+
+	const float step_rate = m_step_sent / dtime;
+	m_step_sent = 0;
+	const float smooth = std::min(dtime * 2, 1.0f);
+	m_send_rate += (step_rate - m_send_rate) * smooth;
+
+	if (m_target_delay <= 0) {
+		m_rate = RATE_MAX;
+	} else {
+		if (min_rtt >= 0 && avg_rtt >= 0)
+			m_queue_delay = std::max(avg_rtt - min_rtt, 0.0f);
+
+		m_decrease_timer -= dtime;
+		if (m_queue_delay > m_target_delay) {
+			// Once per round trip, the queue needs that long to show a cut
+			if (m_decrease_timer <= 0) {
+				m_rate = std::max(m_rate * 0.75f, RATE_MIN);
+				m_decrease_timer = std::max(avg_rtt, 0.1f);
+			}
+		} else if (m_send_rate > m_rate * 0.5f) {
+			// Only grow a budget which is used, faster while the queue is short
+			const float headroom = 1 - m_queue_delay / m_target_delay;
+			m_rate = std::min(m_rate * (1 + headroom * dtime), RATE_MAX);
+		}
+	}
+
+	m_credit = std::min(m_credit + m_rate * dtime, m_rate * BLOCK_SEND_BURST);
+}
+
+bool BlockSendBudget::canSend(bool near) const
+{
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	return near || m_credit > 0;
+}
+
+u32 BlockSendBudget::blocksLeft() const
+{
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_credit <= 0)
+		return 0;
+	return std::ceil(m_credit / m_block_size);
+}
+
+void BlockSendBudget::sent(size_t bytes)
+{
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	m_credit -= bytes;
+	m_step_sent += bytes;
+	m_block_size += (bytes - m_block_size) * 0.05f;
+}
+
+float BlockSendBudget::getRate() const
+{
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	return m_rate;
+}
+
+float BlockSendBudget::getSendRate() const
+{
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	return m_send_rate;
+}
+
+size_t BlockSendBudget::getQueued() const
+{
+	const std::lock_guard<std::mutex> lock(m_mutex);
+	// Little's law, what is sent at this rate waits this long
+	return m_queue_delay * m_send_rate;
+}
@@ -0,0 +1,75 @@
+/*
+fm_block_send_budget.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include "irrlichttypes.h"
+
+/*
+	How many block bytes a client gets per send step.
+
+	The rate grows while the round trip time stays near its minimum and is
+	cut when the time spent in queues on the way to the client goes over
+	block_send_queue_delay, so slow clients are not flooded and fast ones
+	get all they can take. Near blocks may always go out, they overdraw
+	the budget.
+*/
+class BlockSendBudget
+{
+public:
+	// Bytes per second
+	static constexpr float RATE_START = 256 * 1024;
+	static constexpr float RATE_MIN = 16 * 1024;
+	static constexpr float RATE_MAX = 64 * 1024 * 1024;
+
+	// With block_send_queue_delay as it is now
+	BlockSendBudget();
+	// Seconds in queues it cuts the rate above, 0 for no limit
+	explicit BlockSendBudget(float target_delay);
+
+	// Once per send step, with the peer's round trip times in seconds, or
+	// negative if they are not known yet
+	void update(float dtime, float min_rtt, float avg_rtt);
+
+	bool canSend(bool near = false) const;
+	// Blocks of the usual size which fit in what is left
+	u32 blocksLeft() const;
+	void sent(size_t bytes);
+
+	// Bytes per second the client may get
+	float getRate() const;
+	// Bytes per second actually sent
+	float getSendRate() const;
+	// Estimate of bytes waiting on the way to the client
+	size_t getQueued() const;
+
+private:
+	const float m_target_delay;
+	mutable std::mutex m_mutex;
+	float m_rate = RATE_START;
+	float m_credit = 0;
+	float m_block_size = 2048;
+	float m_step_sent = 0;
+	float m_send_rate = 0;
+	float m_queue_delay = 0;
+	float m_decrease_timer = 0;
+};
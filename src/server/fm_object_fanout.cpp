@@ -0,0 +1,65 @@
+/*
+fm_object_fanout.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_object_fanout.h"
+#include "util/serialize.h"
+
+void ObjectMessageFanout::add(ActiveObjectMessage &&aom)
+{
+	auto [it, inserted] = m_object_index.emplace(aom.id, m_objects.size());
+	if (inserted)
+		m_objects.push_back(Object{aom.id});
+	Object &object = m_objects[it->second];
+
+	// Position updates are checked for every client on their own, the
+	// other messages join the last chunk of their stream if they can
+	const bool position =
+			!aom.datastring.empty() && aom.datastring[0] == AO_CMD_UPDATE_POSITION;
+	int &last = aom.reliable ? object.last_reliable : object.last_unreliable;
+	if (position || last < 0 || object.chunks[last].position) {
+		last = object.chunks.size();
+		object.chunks.push_back(Chunk{aom.reliable, position, aom.skip_by_pos, {}});
+	}
+	Buffer &data = object.chunks[last].data;
+
+#if MINETEST_PROTO
+	// u16 id
+	// std::string data
+	char idbuf[2];
+	writeU16((u8 *)idbuf, aom.id);
+	data.append(idbuf, sizeof(idbuf));
+	data.append(serializeString16(aom.datastring));
+#else
+	data.emplace_back(aom.id, std::move(aom.datastring));
+#endif
+}
+
+void ObjectMessageFanout::append(Buffer &to, const Buffer &data)
+{
+	to.insert(to.end(), data.begin(), data.end());
+}
+
+void ObjectMessageFanout::clear()
+{
+	m_objects.clear();
+	m_object_index.clear();
+	m_outgoing.clear();
+}
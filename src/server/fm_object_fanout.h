@@ -0,0 +1,116 @@
+/*
+fm_object_fanout.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "activeobject.h"
+#include "config.h"
+#include "irr_v3d.h"
+#include "network/networkprotocol.h"
+#if !MINETEST_PROTO
+#include "network/fm_networkprotocol.h"
+#endif
+
+/*
+	Routes the active object messages of a server step to the clients which
+	know the objects. Messages are encoded once per object, the data of a
+	client is put together from these shared pieces, visiting only the
+	clients of objects which have messages.
+*/
+class ObjectMessageFanout
+{
+public:
+#if MINETEST_PROTO
+	using Buffer = std::string;
+#else
+	using Buffer = ActiveObjectMessages;
+#endif
+
+	struct Outgoing
+	{
+		Buffer reliable;
+		Buffer unreliable;
+	};
+
+	void add(ActiveObjectMessage &&aom);
+	bool empty() const { return m_objects.empty(); }
+
+	/*
+		get_object(id) returns the object with its m_known_by clients, or
+		nullptr if it is gone. skip(peer_id, object, skip_by_pos) returns true
+		to not send a position update of the object to the client.
+	*/
+	template <class GetObject, class Skip>
+	void route(GetObject get_object, Skip skip)
+	{
+		for (const Object &object : m_objects) {
+			auto *sao = get_object(object.id);
+			if (!sao)
+				continue;
+			for (const session_t peer_id : sao->m_known_by) {
+				Outgoing *outgoing = nullptr;
+				for (const Chunk &chunk : object.chunks) {
+					if (chunk.position && skip(peer_id, sao, chunk.skip_by_pos))
+						continue;
+					if (!outgoing)
+						outgoing = &m_outgoing[peer_id];
+					append(chunk.reliable ? outgoing->reliable : outgoing->unreliable,
+							chunk.data);
+				}
+			}
+		}
+	}
+
+	// Data of every client after route()
+	const std::unordered_map<session_t, Outgoing> &getOutgoing() const { return m_outgoing; }
+
+	void clear();
+
+private:
+	// Messages of an object which go to a client together
+	struct Chunk
+	{
+		bool reliable;
+		// A position update, the only messages not sent to every client
+		bool position;
+		std::optional<v3f> skip_by_pos;
+		Buffer data;
+	};
+
+	struct Object
+	{
+		u16 id;
+		std::vector<Chunk> chunks{};
+		// Last chunk of each stream, messages can be added to it
+		int last_reliable = -1;
+		int last_unreliable = -1;
+	};
+
+	static void append(Buffer &to, const Buffer &data);
+
+	std::vector<Object> m_objects;
+	std::unordered_map<u16, size_t> m_object_index;
+	std::unordered_map<session_t, Outgoing> m_outgoing;
+};
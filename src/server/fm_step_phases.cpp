@@ -0,0 +1,134 @@
+/*
+fm_step_phases.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fm_step_phases.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include "debug.h"
+#include "porting.h"
+#include "threading/task_scheduler.h"
+
+StepPhases::StepPhases(TaskScheduler &scheduler) : m_scheduler(scheduler)
+{
+}
+
+std::vector<size_t> StepPhases::findAll(const std::vector<const char *> &names) const
+{
+	std::vector<size_t> found;
+	for (const char *name : names) {
+		size_t i = 0;
+		while (i < m_phases.size() && std::strcmp(m_phases[i].name, name))
+			++i;
+		FATAL_ERROR_IF(i == m_phases.size(), "step phase dependency added later");
+		found.emplace_back(i);
+	}
+	return found;
+}
+
+void StepPhases::add(
+		const char *name, std::vector<const char *> after, std::function<void()> func)
+{
+	m_phases.emplace_back(Phase{name, findAll(after), 0, std::move(func), {}});
+}
+
+void StepPhases::addParallel(const char *name, std::vector<const char *> after,
+		size_t partitions, std::function<void(size_t partition)> func)
+{
+	m_phases.emplace_back(
+			Phase{name, findAll(after), std::max<size_t>(partitions, 1), {}, std::move(func)});
+}
+
+void StepPhases::run()
+{
+	const size_t count = m_phases.size();
+	m_timings.clear();
+	for (const auto &phase : m_phases)
+		m_timings.emplace_back(Timing{phase.name, phase.partitions, 0});
+	const auto parallel_us = std::make_unique<std::atomic<u64>[]>(count);
+
+	std::vector<bool> done(count);
+	std::vector<size_t> wave;
+	// Partitions of the parallel phases of a wave, as (phase, partition)
+	std::vector<std::pair<size_t, size_t>> work;
+	for (size_t left = count; left;) {
+		// Dependencies are on phases added before, there always is one
+		wave.clear();
+		work.clear();
+		for (size_t i = 0; i < count; ++i) {
+			if (done[i])
+				continue;
+			bool ready = true;
+			for (const size_t dep : m_phases[i].after)
+				ready = ready && done[dep];
+			if (!ready)
+				continue;
+			wave.emplace_back(i);
+			for (size_t p = 0; p < m_phases[i].partitions; ++p)
+				work.emplace_back(i, p);
+		}
+
+		std::atomic_size_t next{0};
+		const auto claim = [&] {
+			for (size_t w; (w = next++) < work.size();) {
+				const auto [i, p] = work[w];
+				const auto start_us = porting::getTimeUs();
+				m_phases[i].parallel(p);
+				parallel_us[i] += porting::getTimeUs() - start_us;
+			}
+		};
+
+		// This thread claims partitions too when done with the serial phases
+		const auto own = [&] {
+			try {
+				for (const size_t i : wave) {
+					if (m_phases[i].partitions)
+						continue;
+					const auto start_us = porting::getTimeUs();
+					m_phases[i].serial();
+					m_timings[i].time_us = porting::getTimeUs() - start_us;
+				}
+				claim();
+			} catch (...) {
+				// Helpers stop at their next partition
+				next = work.size();
+				throw;
+			}
+		};
+		const size_t helper_count =
+				work.size() > 1 ? std::min(work.size(), m_scheduler.getThreadCount()) : 0;
+		try {
+			m_scheduler.runWithHelpers(
+					"step phase", TaskPriority::High, helper_count, claim, own);
+		} catch (...) {
+			m_phases.clear();
+			throw;
+		}
+
+		for (const size_t i : wave) {
+			if (m_phases[i].partitions)
+				m_timings[i].time_us = parallel_us[i];
+			done[i] = true;
+			--left;
+		}
+	}
+	m_phases.clear();
+}
@@ -0,0 +1,80 @@
+/*
+fm_step_phases.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "irrlichttypes.h"
+
+class TaskScheduler;
+
+/*
+	The parts of a step, with the parts each of them needs done before.
+
+	A phase runs once on the calling thread, or is split into partitions
+	which run on the workers of the task scheduler. Phases run in waves:
+	all those whose dependencies are done start together, the partitions
+	on the workers and the serial phases on the calling thread meanwhile.
+	So a phase must not touch what others of its wave write, and only
+	serial phases may call Lua.
+*/
+class StepPhases
+{
+public:
+	struct Timing
+	{
+		const char *name;
+		size_t partitions;
+		// Of all partitions together for parallel phases
+		u64 time_us;
+	};
+
+	explicit StepPhases(TaskScheduler &scheduler);
+
+	// after names phases added before
+	void add(const char *name, std::vector<const char *> after,
+			std::function<void()> func);
+	void addParallel(const char *name, std::vector<const char *> after,
+			size_t partitions, std::function<void(size_t partition)> func);
+
+	// Runs and forgets the phases, the timings stay until the next run
+	void run();
+
+	const std::vector<Timing> &getTimings() const { return m_timings; }
+
+private:
+	struct Phase
+	{
+		const char *name;
+		std::vector<size_t> after;
+		// 0 for serial
+		size_t partitions;
+		std::function<void()> serial;
+		std::function<void(size_t)> parallel;
+	};
+
+	std::vector<size_t> findAll(const std::vector<const char *> &names) const;
+
+	TaskScheduler &m_scheduler;
+	std::vector<Phase> m_phases;
+	std::vector<Timing> m_timings;
+};
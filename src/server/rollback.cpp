@@ -15,9 +15,23 @@
 #include "util/numeric.h"
 #include "inventorymanager.h" // deserializing InventoryLocations
 #include "filesys.h"
+#include "util/thread.h"
 
 #define POINTS_PER_NODE (16.0)
 
+// Queued actions that wake up the flush thread before its next round
+#define FLUSH_BATCH_SIZE 1000
+// Queued actions that are written by the reporting thread, when the flush
+// thread can't keep up
+#define FLUSH_BUFFER_MAX 100000
+// Recent actions kept in memory for finding suspects
+#define LATEST_BUFFER_MAX 10000
+// Larger range queries scan by time instead of by block
+#define QUERY_BLOCKS_MAX 4096
+
+// Same as the key of queried blocks computed in getActionsSince_range
+#define BLOCK_KEY_SQL "((`z` >> 4) * 16777216 + (`y` >> 4) * 4096 + (`x` >> 4))"
+
 #define SQLRES(f, good) \
 	if ((f) != (good)) {\
 		throw FileNotGoodException(std::string("RollbackManager: " \
@@ -72,6 +86,22 @@ struct Entity {
 };
 
 
+// Writes reported actions to the database in large transactions
+class RollbackFlushThread : public UpdateThread
+{
+public:
+	RollbackFlushThread(RollbackManager *manager) :
+		UpdateThread("Rollback"), m_manager(manager)
+	{}
+
+protected:
+	void doUpdate() override { m_manager->flush(); }
+
+private:
+	RollbackManager *m_manager;
+};
+
+
 
 RollbackManager::RollbackManager(const std::string & world_path,
 		IGameDef * gamedef_) :
@@ -83,11 +113,17 @@ RollbackManager::RollbackManager(const std::string & world_path,
 	database_path = world_path + DIR_DELIM "rollback.sqlite";
 
 	initDatabase();
+
+	m_flush_thread = std::make_unique<RollbackFlushThread>(this);
+	m_flush_thread->start();
 }
 
 
 RollbackManager::~RollbackManager()
 {
+	m_flush_thread->stop();
+	m_flush_thread->wait();
+
 	flush();
 
 #if USE_SQLITE3
@@ -96,6 +132,9 @@ RollbackManager::~RollbackManager()
 	FINALIZE_STATEMENT(stmt_select);
 	FINALIZE_STATEMENT(stmt_select_range);
 	FINALIZE_STATEMENT(stmt_select_withActor);
+	FINALIZE_STATEMENT(stmt_select_blocks);
+	FINALIZE_STATEMENT(stmt_query_block_insert);
+	FINALIZE_STATEMENT(stmt_query_block_clear);
 	FINALIZE_STATEMENT(stmt_knownActor_select);
 	FINALIZE_STATEMENT(stmt_knownActor_insert);
 	FINALIZE_STATEMENT(stmt_knownNode_select);
@@ -243,6 +282,23 @@ bool RollbackManager::createTables()
 }
 
 
+void RollbackManager::createIndexes()
+{
+#if USE_SQLITE3
+	// Older databases only have `actionIndex`, building these may take
+	// a while once
+	SQLOK(sqlite3_exec(db,
+		"CREATE INDEX IF NOT EXISTS `actionTimeIndex` ON `action`(`timestamp`);\n"
+		"CREATE INDEX IF NOT EXISTS `actionActorIndex` ON `action`(`actor`,`timestamp`);\n"
+		"CREATE INDEX IF NOT EXISTS `actionBlockIndex` ON `action`(" BLOCK_KEY_SQL ",`timestamp`);\n"
+		"CREATE TEMP TABLE IF NOT EXISTS `query_block` (\n"
+		"	`key` INTEGER PRIMARY KEY NOT NULL\n"
+		");\n",
+		NULL, NULL, NULL));
+#endif
+}
+
+
 bool RollbackManager::initDatabase()
 {
 	verbosestream << "RollbackManager: Database connection setup" << std::endl;
@@ -255,6 +311,7 @@ bool RollbackManager::initDatabase()
 	if (needs_create) {
 		createTables();
 	}
+	createIndexes();
 
 	SQLOK(sqlite3_prepare_v2(db,
 		"INSERT INTO `action` (\n"
@@ -339,6 +396,30 @@ bool RollbackManager::initDatabase()
 		"ORDER BY `timestamp` DESC, `id` DESC\n",
 		-1, &stmt_select_withActor, NULL));
 
+	SQLOK(sqlite3_prepare_v2(db,
+		"SELECT\n"
+		"	`actor`, `timestamp`, `type`,\n"
+		"	`list`, `index`, `add`, `stackNode`, `stackQuantity`, `nodemeta`,\n"
+		"	`x`, `y`, `z`,\n"
+		"	`oldNode`, `oldParam1`, `oldParam2`, `oldMeta`,\n"
+		"	`newNode`, `newParam1`, `newParam2`, `newMeta`,\n"
+		"	`guessedActor`\n"
+		"FROM `action`\n"
+		"WHERE " BLOCK_KEY_SQL " IN (SELECT `key` FROM temp.`query_block`)\n"
+		"	AND `timestamp` >= ?\n"
+		"	AND `x` BETWEEN ? AND ?\n"
+		"	AND `y` BETWEEN ? AND ?\n"
+		"	AND `z` BETWEEN ? AND ?\n"
+		"ORDER BY `timestamp` DESC, `id` DESC\n"
+		"LIMIT 0,?",
+		-1, &stmt_select_blocks, NULL));
+
+	SQLOK(sqlite3_prepare_v2(db, "INSERT INTO temp.`query_block` (`key`) VALUES (?)",
+			-1, &stmt_query_block_insert, NULL));
+
+	SQLOK(sqlite3_prepare_v2(db, "DELETE FROM temp.`query_block`",
+			-1, &stmt_query_block_clear, NULL));
+
 	SQLOK(sqlite3_prepare_v2(db, "SELECT `id`, `name` FROM `actor`",
 			-1, &stmt_knownActor_select, NULL));
 
@@ -464,9 +545,9 @@ bool RollbackManager::registerRow(const ActionRow & row)
 
 
 #if USE_SQLITE3
-const std::list<ActionRow> RollbackManager::actionRowsFromSelect(sqlite3_stmt* stmt)
+void RollbackManager::actionsFromSelect(sqlite3_stmt* stmt,
+		const ActionCallback &callback)
 {
-	std::list<ActionRow> rows;
 	const unsigned char * text;
 	size_t size;
 
@@ -522,12 +603,12 @@ const std::list<ActionRow> RollbackManager::actionRowsFromSelect(sqlite3_stmt* s
 			row.location = getActorName(row.actor);
 		}
 
-		rows.push_back(row);
+		if (!callback(rollbackActionFromActionRow(row))) {
+			break;
+		}
 	}
 
 	SQLOK(sqlite3_reset(stmt));
-
-	return rows;
 }
 #endif
 
@@ -567,54 +648,48 @@ ActionRow RollbackManager::actionRowFromRollbackAction(const RollbackAction & ac
 }
 
 
-const std::list<RollbackAction> RollbackManager::rollbackActionsFromActionRows(
-		const std::list<ActionRow> & rows)
+RollbackAction RollbackManager::rollbackActionFromActionRow(const ActionRow &row)
 {
-	std::list<RollbackAction> actions;
-
-	for (const ActionRow &row : rows) {
-		RollbackAction action;
-		action.actor     = (row.actor) ? getActorName(row.actor) : "";
-		action.unix_time = row.timestamp;
-		action.type      = static_cast<RollbackAction::Type>(row.type);
-
-		switch (action.type) {
-		case RollbackAction::TYPE_MODIFY_INVENTORY_STACK:
-			action.inventory_location = row.location;
-			action.inventory_list     = row.list;
-			action.inventory_index    = row.index;
-			action.inventory_add      = row.add;
-			action.inventory_stack    = row.stack;
-			if (action.inventory_stack.name.empty()) {
-				action.inventory_stack.name = getNodeName(row.stack.id);
-			}
-			break;
-
-		case RollbackAction::TYPE_SET_NODE:
-			action.p            = v3s16(row.x, row.y, row.z);
-			action.n_old.name   = getNodeName(row.oldNode);
-			action.n_old.param1 = row.oldParam1;
-			action.n_old.param2 = row.oldParam2;
-			action.n_old.meta   = row.oldMeta;
-			action.n_new.name   = getNodeName(row.newNode);
-			action.n_new.param1 = row.newParam1;
-			action.n_new.param2 = row.newParam2;
-			action.n_new.meta   = row.newMeta;
-			break;
-
-		default:
-			throw ("W.T.F.");
-			break;
+	RollbackAction action;
+	action.actor     = (row.actor) ? getActorName(row.actor) : "";
+	action.unix_time = row.timestamp;
+	action.type      = static_cast<RollbackAction::Type>(row.type);
+
+	switch (action.type) {
+	case RollbackAction::TYPE_MODIFY_INVENTORY_STACK:
+		action.inventory_location = row.location;
+		action.inventory_list     = row.list;
+		action.inventory_index    = row.index;
+		action.inventory_add      = row.add;
+		action.inventory_stack    = row.stack;
+		if (action.inventory_stack.name.empty()) {
+			action.inventory_stack.name = getNodeName(row.stack.id);
 		}
-
-		actions.push_back(action);
+		break;
+
+	case RollbackAction::TYPE_SET_NODE:
+		action.p            = v3s16(row.x, row.y, row.z);
+		action.n_old.name   = getNodeName(row.oldNode);
+		action.n_old.param1 = row.oldParam1;
+		action.n_old.param2 = row.oldParam2;
+		action.n_old.meta   = row.oldMeta;
+		action.n_new.name   = getNodeName(row.newNode);
+		action.n_new.param1 = row.newParam1;
+		action.n_new.param2 = row.newParam2;
+		action.n_new.meta   = row.newMeta;
+		break;
+
+	default:
+		throw ("W.T.F.");
+		break;
 	}
 
-	return actions;
+	return action;
 }
 
 
-const std::list<ActionRow> RollbackManager::getRowsSince(time_t firstTime, const std::string & actor)
+void RollbackManager::getActionsSince(time_t firstTime,
+		const std::string &actor, const ActionCallback &callback)
 {
 #if USE_SQLITE3
 	sqlite3_stmt *stmt_stmt = actor.empty() ? stmt_select : stmt_select_withActor;
@@ -624,52 +699,60 @@ const std::list<ActionRow> RollbackManager::getRowsSince(time_t firstTime, const
 		sqlite3_bind_int(stmt_stmt, 2, getActorId(actor));
 	}
 
-	const std::list<ActionRow> & rows = actionRowsFromSelect(stmt_stmt);
-	sqlite3_reset(stmt_stmt);
-
-	return rows;
-#else
-	return std::list<ActionRow>();
+	actionsFromSelect(stmt_stmt, callback);
 #endif
 }
 
 
-const std::list<ActionRow> RollbackManager::getRowsSince_range(
-		time_t start_time, v3s16 p, int range, int limit)
+void RollbackManager::getActionsSince_range(time_t start_time, v3s16 p,
+		int range, int limit, const ActionCallback &callback)
 {
 #if USE_SQLITE3
+	const int min_x = p.X - range, max_x = p.X + range;
+	const int min_y = p.Y - range, max_y = p.Y + range;
+	const int min_z = p.Z - range, max_z = p.Z + range;
+
+	const s64 block_count = (s64)((max_x >> 4) - (min_x >> 4) + 1) *
+			((max_y >> 4) - (min_y >> 4) + 1) *
+			((max_z >> 4) - (min_z >> 4) + 1);
+
+	sqlite3_stmt *stmt = stmt_select_range;
+	if (range >= 0 && block_count <= QUERY_BLOCKS_MAX) {
+		// Look up the blocks of the range in `actionBlockIndex`
+		sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+		try {
+			SQLRES(sqlite3_step(stmt_query_block_clear), SQLITE_DONE);
+			SQLOK(sqlite3_reset(stmt_query_block_clear));
+			for (int bz = min_z >> 4; bz <= max_z >> 4; bz++)
+			for (int by = min_y >> 4; by <= max_y >> 4; by++)
+			for (int bx = min_x >> 4; bx <= max_x >> 4; bx++) {
+				SQLOK(sqlite3_bind_int64(stmt_query_block_insert, 1,
+						((s64)bz * 4096 + by) * 4096 + bx));
+				SQLRES(sqlite3_step(stmt_query_block_insert), SQLITE_DONE);
+				SQLOK(sqlite3_reset(stmt_query_block_insert));
+			}
+		} catch (...) {
+			// Don't leave the transaction open for the next writes
+			sqlite3_reset(stmt_query_block_clear);
+			sqlite3_reset(stmt_query_block_insert);
+			sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+			throw;
+		}
+		sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+		stmt = stmt_select_blocks;
+	}
 
-	sqlite3_bind_int64(stmt_select_range, 1, start_time);
-	sqlite3_bind_int  (stmt_select_range, 2, static_cast<int>(p.X - range));
-	sqlite3_bind_int  (stmt_select_range, 3, static_cast<int>(p.X + range));
-	sqlite3_bind_int  (stmt_select_range, 4, static_cast<int>(p.Y - range));
-	sqlite3_bind_int  (stmt_select_range, 5, static_cast<int>(p.Y + range));
-	sqlite3_bind_int  (stmt_select_range, 6, static_cast<int>(p.Z - range));
-	sqlite3_bind_int  (stmt_select_range, 7, static_cast<int>(p.Z + range));
-	sqlite3_bind_int  (stmt_select_range, 8, limit);
-
-	const std::list<ActionRow> & rows = actionRowsFromSelect(stmt_select_range);
-	sqlite3_reset(stmt_select_range);
+	sqlite3_bind_int64(stmt, 1, start_time);
+	sqlite3_bind_int  (stmt, 2, min_x);
+	sqlite3_bind_int  (stmt, 3, max_x);
+	sqlite3_bind_int  (stmt, 4, min_y);
+	sqlite3_bind_int  (stmt, 5, max_y);
+	sqlite3_bind_int  (stmt, 6, min_z);
+	sqlite3_bind_int  (stmt, 7, max_z);
+	sqlite3_bind_int  (stmt, 8, limit);
 
-	return rows;
-#else
-	return std::list<ActionRow>();
+	actionsFromSelect(stmt, callback);
 #endif
-
-}
-
-
-const std::list<RollbackAction> RollbackManager::getActionsSince_range(
-		time_t start_time, v3s16 p, int range, int limit)
-{
-	return rollbackActionsFromActionRows(getRowsSince_range(start_time, p, range, limit));
-}
-
-
-const std::list<RollbackAction> RollbackManager::getActionsSince(
-		time_t start_time, const std::string & actor)
-{
-	return rollbackActionsFromActionRows(getRowsSince(start_time, actor));
 }
 
 
@@ -757,7 +840,8 @@ std::string RollbackManager::getSuspect(v3s16 p, float nearness_shortcut,
 	time_t first_time = cur_time - (100 - min_nearness);
 	RollbackAction likely_suspect;
 	float likely_suspect_nearness = 0;
-	for (std::list<RollbackAction>::const_reverse_iterator
+	std::lock_guard<std::mutex> lock(m_buffer_mutex);
+	for (std::deque<RollbackAction>::const_reverse_iterator
 	     i = action_latest_buffer.rbegin();
 	     i != action_latest_buffer.rend(); ++i) {
 		if (i->unix_time < first_time) {
@@ -792,57 +876,129 @@ std::string RollbackManager::getSuspect(v3s16 p, float nearness_shortcut,
 
 void RollbackManager::flush()
 {
+	std::lock_guard<std::recursive_mutex> db_lock(m_db_mutex);
+
+	std::vector<RollbackAction> actions;
+	{
+		std::lock_guard<std::mutex> lock(m_buffer_mutex);
+		actions.swap(action_todisk_buffer);
+	}
+	if (actions.empty()) {
+		return;
+	}
+
 #if USE_SQLITE3
 	sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
 
-	std::list<RollbackAction>::const_iterator iter;
+	try {
+		for (const RollbackAction &action : actions) {
+			if (action.actor.empty()) {
+				continue;
+			}
 
-	for (iter  = action_todisk_buffer.begin();
-			iter != action_todisk_buffer.end();
-			++iter) {
-		if (iter->actor.empty()) {
-			continue;
+			registerRow(actionRowFromRollbackAction(action));
 		}
-
-		registerRow(actionRowFromRollbackAction(*iter));
+	} catch (...) {
+		sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+		throw;
 	}
 
 	sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
-	action_todisk_buffer.clear();
 #endif
 }
 
 
 void RollbackManager::addAction(const RollbackAction & action)
 {
-	action_todisk_buffer.push_back(action);
-	action_latest_buffer.push_back(action);
+	size_t queued;
+	{
+		std::lock_guard<std::mutex> lock(m_buffer_mutex);
+		action_todisk_buffer.push_back(action);
+		action_latest_buffer.push_back(action);
+		if (action_latest_buffer.size() > LATEST_BUFFER_MAX) {
+			action_latest_buffer.pop_front();
+		}
+		queued = action_todisk_buffer.size();
+	}
+
+	// Writing is left to the flush thread
+	if (queued >= FLUSH_BUFFER_MAX) {
+		flush();
+	} else if (queued >= FLUSH_BATCH_SIZE && m_flush_thread) {
+		m_flush_thread->deferUpdate();
+	}
+}
+
+// The callbacks may run Lua, which must not hold up the flush thread or
+// come back here with the database locked, so they get a copy
+static void callForActions(const std::vector<RollbackAction> &actions,
+		const RollbackManager::ActionCallback &callback)
+{
+	for (const RollbackAction &action : actions) {
+		if (!callback(action))
+			break;
+	}
+}
+
+void RollbackManager::forEachNodeActor(v3s16 pos, int range, time_t seconds,
+		int limit, const ActionCallback &callback)
+{
+	std::vector<RollbackAction> actions;
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_db_mutex);
+		flush();
+		time_t cur_time = time(0);
+		time_t first_time = cur_time - seconds;
+
+		getActionsSince_range(first_time, pos, range, limit,
+			[&actions] (const RollbackAction &action) {
+				actions.push_back(action);
+				return true;
+			});
+	}
+	callForActions(actions, callback);
+}
 
-	// Flush to disk sometimes
-	if (action_todisk_buffer.size() >= 500) {
+void RollbackManager::forEachRevertAction(const std::string &actor_filter,
+		time_t seconds, const ActionCallback &callback)
+{
+	std::vector<RollbackAction> actions;
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_db_mutex);
 		flush();
+		time_t cur_time = time(0);
+		time_t first_time = cur_time - seconds;
+
+		getActionsSince(first_time, actor_filter,
+			[&actions] (const RollbackAction &action) {
+				actions.push_back(action);
+				return true;
+			});
 	}
+	callForActions(actions, callback);
 }
 
 std::list<RollbackAction> RollbackManager::getNodeActors(v3s16 pos, int range,
 		time_t seconds, int limit)
 {
-	flush();
-	time_t cur_time = time(0);
-	time_t first_time = cur_time - seconds;
-
-	return getActionsSince_range(first_time, pos, range, limit);
+	std::list<RollbackAction> actions;
+	forEachNodeActor(pos, range, seconds, limit,
+		[&actions] (const RollbackAction &action) {
+			actions.push_back(action);
+			return true;
+		});
+	return actions;
 }
 
 std::list<RollbackAction> RollbackManager::getRevertActions(
 		const std::string &actor_filter,
 		time_t seconds)
 {
-	time_t cur_time = time(0);
-	time_t first_time = cur_time - seconds;
-
-	flush();
-
-	return getActionsSince(first_time, actor_filter);
+	std::list<RollbackAction> actions;
+	forEachRevertAction(actor_filter, seconds,
+		[&actions] (const RollbackAction &action) {
+			actions.push_back(action);
+			return true;
+		});
+	return actions;
 }
-
@@ -7,7 +7,10 @@
 #include <string>
 #include "irr_v3d.h"
 #include "rollback_interface.h"
+#include <deque>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "config.h"
@@ -19,6 +22,7 @@ class IGameDef;
 
 struct ActionRow;
 struct Entity;
+class RollbackFlushThread;
 
 class RollbackManager: public IRollbackManager
 {
@@ -39,6 +43,10 @@ class RollbackManager: public IRollbackManager
 			time_t seconds, int limit);
 	std::list<RollbackAction> getRevertActions(
 			const std::string & actor_filter, time_t seconds);
+	void forEachNodeActor(v3s16 pos, int range, time_t seconds, int limit,
+			const ActionCallback & callback);
+	void forEachRevertAction(const std::string & actor_filter, time_t seconds,
+			const ActionCallback & callback);
 
 private:
 	void registerNewActor(const int id, const std::string & name);
@@ -48,22 +56,18 @@ class RollbackManager: public IRollbackManager
 	const char * getActorName(const int id);
 	const char * getNodeName(const int id);
 	bool createTables();
+	void createIndexes();
 	bool initDatabase();
 	bool registerRow(const ActionRow & row);
 #if USE_SQLITE3
-	const std::list<ActionRow> actionRowsFromSelect(sqlite3_stmt * stmt);
+	void actionsFromSelect(sqlite3_stmt * stmt, const ActionCallback & callback);
 #endif
 	ActionRow actionRowFromRollbackAction(const RollbackAction & action);
-	const std::list<RollbackAction> rollbackActionsFromActionRows(
-			const std::list<ActionRow> & rows);
-	const std::list<ActionRow> getRowsSince(time_t firstTime,
-			const std::string & actor);
-	const std::list<ActionRow> getRowsSince_range(time_t firstTime, v3s16 p,
-			int range, int limit);
-	const std::list<RollbackAction> getActionsSince_range(time_t firstTime, v3s16 p,
-			int range, int limit);
-	const std::list<RollbackAction> getActionsSince(time_t firstTime,
-			const std::string & actor = "");
+	RollbackAction rollbackActionFromActionRow(const ActionRow & row);
+	void getActionsSince_range(time_t firstTime, v3s16 p, int range,
+			int limit, const ActionCallback & callback);
+	void getActionsSince(time_t firstTime, const std::string & actor,
+			const ActionCallback & callback);
 	static float getSuspectNearness(bool is_guess, v3s16 suspect_p,
 		time_t suspect_t, v3s16 action_p, time_t action_t);
 
@@ -73,8 +77,15 @@ class RollbackManager: public IRollbackManager
 	std::string current_actor;
 	bool current_actor_is_guess = false;
 
-	std::list<RollbackAction> action_todisk_buffer;
-	std::list<RollbackAction> action_latest_buffer;
+	// Actions waiting for the flush thread, and the most recent actions
+	// for finding suspects
+	std::mutex m_buffer_mutex;
+	std::vector<RollbackAction> action_todisk_buffer;
+	std::deque<RollbackAction> action_latest_buffer;
+	std::unique_ptr<RollbackFlushThread> m_flush_thread;
+
+	// Database, prepared statements and the known actors and nodes
+	std::recursive_mutex m_db_mutex;
 
 	std::string database_path;
 #if USE_SQLITE3
@@ -84,6 +95,9 @@ class RollbackManager: public IRollbackManager
 	sqlite3_stmt * stmt_select;
 	sqlite3_stmt * stmt_select_range;
 	sqlite3_stmt * stmt_select_withActor;
+	sqlite3_stmt * stmt_select_blocks;
+	sqlite3_stmt * stmt_query_block_insert;
+	sqlite3_stmt * stmt_query_block_clear;
 	sqlite3_stmt * stmt_knownActor_select;
 	sqlite3_stmt * stmt_knownActor_insert;
 	sqlite3_stmt * stmt_knownNode_select;
@@ -3,6 +3,7 @@
 // Copyright (C) 2010-2013 celeron55, Perttu Ahola <celeron55@gmail.com>
 
 #include "serveractiveobject.h"
+#include <algorithm>
 #include "inventory.h"
 #include "inventorymanager.h"
 #include "constants.h" // BS
@@ -69,6 +70,23 @@ void ServerActiveObject::dumpAOMessagesToQueue(std::queue<ActiveObjectMessage> &
 	*/
 }
 
+void ServerActiveObject::addKnownBy(session_t peer_id)
+{
+	m_known_by.push_back(peer_id);
+	m_known_by_count++;
+}
+
+void ServerActiveObject::removeKnownBy(session_t peer_id)
+{
+	auto it = std::find(m_known_by.begin(), m_known_by.end(), peer_id);
+	if (it == m_known_by.end())
+		return;
+	*it = m_known_by.back();
+	m_known_by.pop_back();
+	if (m_known_by_count > 0)
+		m_known_by_count--;
+}
+
 void ServerActiveObject::markForRemoval()
 {
 	if (!m_pending_removal) {
@@ -7,8 +7,10 @@
 #include <cassert>
 #include <unordered_set>
 #include <optional>
+#include <vector>
 #include "irrlichttypes_bloated.h"
 #include "activeobject.h"
+#include "network/networkprotocol.h"
 #include "itemgroup.h"
 #include "util/container.h"
 #include "threading/lock.h"
@@ -206,6 +208,15 @@ class ServerActiveObject : public ActiveObject
 	*/
 	std::atomic_ushort m_known_by_count {0};
 
+	/*
+		Peer ids of the clients which know about this object, its messages
+		are sent to them. Changed only with the environment locked, together
+		with m_known_by_count.
+	*/
+	std::vector<session_t> m_known_by;
+	void addKnownBy(session_t peer_id);
+	void removeKnownBy(session_t peer_id);
+
 	/*
 		A getter that unifies the above to answer the question:
 		"Can the environment still interact with this object?"
@@ -38,6 +38,8 @@
 #include "irrlicht_changes/printing.h"
 #include "server/luaentity_sao.h"
 #include "server/player_sao.h"
+#include "server/fm_step_phases.h"
+#include "threading/task_scheduler.h"
 
 #include "contrib/fallingsao.h"
 #include "contrib/itemsao.h"
@@ -136,20 +138,28 @@ void LBMContentMapping::addLBM(LoadingBlockModifierDef *lbm_def, IGameDef *gamed
 
 	SORT_AND_UNIQUE(c_ids);
 
-	for (content_t c_id : c_ids)
+	for (content_t c_id : c_ids) {
+		if (c_id >= map.size())
+			map.resize(c_id + 1);
 		map[c_id].push_back(lbm_def);
+	}
 }
 
 const LBMContentMapping::lbm_vector *
 LBMContentMapping::lookup(content_t c) const
 {
-	lbm_map::const_iterator it = map.find(c);
-	if (it == map.end())
-		return NULL;
-	// This first dereferences the iterator, returning
-	// a std::vector<LoadingBlockModifierDef *>
-	// reference, then we convert it to a pointer.
-	return &(it->second);
+	if (c >= map.size() || map[c].empty())
+		return nullptr;
+	return &map[c];
+}
+
+void LBMContentMapping::getTriggerContents(std::vector<bool> &contents) const
+{
+	if (contents.size() < map.size())
+		contents.resize(map.size());
+	for (size_t c = 0; c < map.size(); ++c)
+		if (!map[c].empty())
+			contents[c] = true;
 }
 
 LBMManager::~LBMManager()
@@ -251,6 +261,9 @@ void LBMManager::loadIntroductionTimes(const std::string &times,
 	// Clear the list, so that we don't delete remaining elements
 	// twice in the destructor
 	m_lbm_defs.clear();
+
+	for (const auto &it : m_lbm_lookup)
+		it.second.getTriggerContents(m_trigger_contents);
 }
 
 std::string LBMManager::createIntroductionTimesString()
@@ -282,69 +295,85 @@ void LBMManager::applyLBMs(ServerEnvironment *env, MapBlock *block,
 	FATAL_ERROR_IF(!m_query_mode,
 		"attempted to query on non fully set up LBMManager");
 
-	// Collect a list of all LBMs and associated positions
-	struct LBMToRun {
-		std::unordered_set<v3s16> p; // node positions
-		std::unordered_set<LoadingBlockModifierDef*> l;
+	const auto lbms_begin = getLBMsIntroducedAfter(stamp);
+	if (lbms_begin == m_lbm_lookup.end())
+		return;
+
+	const auto triggers = [this](content_t c) {
+		return c < m_trigger_contents.size() && m_trigger_contents[c];
 	};
-	std::unordered_map<content_t, LBMToRun> to_run;
 
-	// Note: the iteration count of this outer loop is typically very low, so it's ok.
-	for (auto it = getLBMsIntroducedAfter(stamp); it != m_lbm_lookup.end(); ++it) {
-		v3s16 pos;
-		content_t c;
+	if (!block->hasContent(triggers))
+		return;
 
-		// Cache previous lookups since it has a high performance penalty.
-		content_t previous_c = CONTENT_IGNORE;
-		const LBMContentMapping::lbm_vector *lbm_list = nullptr;
-		LBMToRun *batch = nullptr;
+	// Positions of the trigger contents, each node is read once for all LBMs
+	std::vector<std::pair<content_t, std::vector<v3s16>>> found;
+	{
+		v3s16 pos;
+		// Cache previous lookups, runs of the same content are common
+		int previous_c = -1;
+		std::vector<v3s16> *positions = nullptr;
 
 		for (pos.Z = 0; pos.Z < MAP_BLOCKSIZE; pos.Z++)
 		for (pos.Y = 0; pos.Y < MAP_BLOCKSIZE; pos.Y++)
 		for (pos.X = 0; pos.X < MAP_BLOCKSIZE; pos.X++) {
-			c = block->getNodeNoCheck(pos).getContent();
-
-			bool c_changed = false;
-			if (previous_c != c) {
-				c_changed = true;
-				lbm_list = it->second.lookup(c);
-				batch = &to_run[c];
+			const content_t c = block->getNodeNoCheck(pos).getContent();
+			if (c != previous_c) {
 				previous_c = c;
+				positions = nullptr;
+				if (triggers(c)) {
+					auto it = std::find_if(found.begin(), found.end(),
+							[c](const auto &f) { return f.first == c; });
+					if (it == found.end())
+						it = found.emplace(found.end(), c, std::vector<v3s16>());
+					positions = &it->second;
+				}
 			}
-
-			if (!lbm_list)
-				continue;
-			batch->p.insert(pos);
-			if (c_changed) {
-				batch->l.insert(lbm_list->begin(), lbm_list->end());
-			} else {
-				// we were here before so the list must be filled
-				assert(!batch->l.empty());
-			}
+			if (positions)
+				positions->push_back(pos);
 		}
 	}
+	if (found.empty())
+		return;
 
-	// Actually run them
+	// Actually run them, one call per LBM and content or per LBM if bulk
 	bool first = true;
-	for (auto &[c, batch] : to_run) {
-		for (auto &lbm_def : batch.l) {
-			if (!first) {
-				// The fun part: since any LBM call can change the nodes inside of he
-				// block, we have to recheck the positions to see if the wanted node
-				// is still there.
-				// Note that we don't rescan the whole block, we don't want to include new changes.
-				for (auto it2 = batch.p.begin(); it2 != batch.p.end(); ) {
-					if (block->getNodeNoCheck(*it2).getContent() != c)
-						it2 = batch.p.erase(it2);
-					else
-						++it2;
+	std::vector<v3s16> bulk_positions;
+	for (auto it = lbms_begin; it != m_lbm_lookup.end(); ++it) {
+		for (LoadingBlockModifierDef *lbm_def : it->second.getList()) {
+			bulk_positions.clear();
+			for (auto &[c, positions] : found) {
+				const LBMContentMapping::lbm_vector *lbm_list = it->second.lookup(c);
+				if (!lbm_list || !CONTAINS(*lbm_list, lbm_def))
+					continue;
+				if (!first) {
+					// The fun part: since any LBM call can change the nodes inside of he
+					// block, we have to recheck the positions to see if the wanted node
+					// is still there.
+					// Note that we don't rescan the whole block, we don't want to include new changes.
+					positions.erase(std::remove_if(positions.begin(), positions.end(),
+							[&, c = c](v3s16 p) {
+								return block->getNodeNoCheck(p).getContent() != c;
+							}), positions.end());
 				}
+				if (positions.empty())
+					continue;
+				if (lbm_def->bulk) {
+					bulk_positions.insert(bulk_positions.end(), positions.begin(),
+							positions.end());
+					continue;
+				}
+
+				first = false;
+				lbm_def->trigger(env, block, positions, dtime_s);
+				if (block->isOrphan())
+					return;
 			}
-			first = false;
 
-			if (batch.p.empty())
-				break;
-			lbm_def->trigger(env, block, batch.p, dtime_s);
+			if (bulk_positions.empty())
+				continue;
+			first = false;
+			lbm_def->trigger(env, block, bulk_positions, dtime_s);
 			if (block->isOrphan())
 				return;
 		}
@@ -355,27 +384,20 @@ void LBMManager::applyLBMs(ServerEnvironment *env, MapBlock *block,
 	ActiveBlockList
 */
 
-static void fillRadiusBlock(v3s16 p0, s16 r, std::set<v3s16> &list)
+// Same as p.getDistanceFrom(p0) <= r, which rounds the distance down
+static inline bool isInSphere(v3s16 p, v3s16 p0, s16 r)
 {
-	v3s16 p;
-	for(p.X=p0.X-r; p.X<=p0.X+r; p.X++)
-		for(p.Y=p0.Y-r; p.Y<=p0.Y+r; p.Y++)
-			for(p.Z=p0.Z-r; p.Z<=p0.Z+r; p.Z++)
-			{
-				// limit to a sphere
-				if (p.getDistanceFrom(p0) <= r) {
-					// Set in list
-					list.insert(p);
-				}
-			}
+	const s32 dx = p.X - p0.X, dy = p.Y - p0.Y, dz = p.Z - p0.Z;
+	return dx * dx + dy * dy + dz * dz < (r + 1) * (r + 1);
 }
 
+// Sorted, as the loops go
 static void fillViewConeBlock(v3s16 p0,
 	const s16 r,
 	const v3f camera_pos,
 	const v3f camera_dir,
 	const float camera_fov,
-	std::set<v3s16> &list)
+	std::vector<v3s16> &list)
 {
 	v3s16 p;
 	const s16 r_nodes = r * BS * MAP_BLOCKSIZE;
@@ -383,9 +405,87 @@ static void fillViewConeBlock(v3s16 p0,
 	for (p.Y = p0.Y - r; p.Y <= p0.Y+r; p.Y++)
 	for (p.Z = p0.Z - r; p.Z <= p0.Z+r; p.Z++) {
 		if (isBlockInSight(p, camera_pos, camera_dir, camera_fov, r_nodes)) {
-			list.insert(p);
+			list.emplace_back(p);
+		}
+	}
+}
+
+void ActiveBlockList::ref(v3s16 p, s16 near, s16 extra)
+{
+	auto &refs = m_refs[p];
+	refs.near += near;
+	refs.extra += extra;
+	m_touched.emplace_back(p);
+}
+
+void ActiveBlockList::refSphere(v3s16 center, s16 radius, s16 count)
+{
+	v3s16 p;
+	for (p.X = center.X - radius; p.X <= center.X + radius; p.X++)
+	for (p.Y = center.Y - radius; p.Y <= center.Y + radius; p.Y++)
+	for (p.Z = center.Z - radius; p.Z <= center.Z + radius; p.Z++) {
+		if (isInSphere(p, center, radius))
+			ref(p, count, 0);
+	}
+}
+
+void ActiveBlockList::moveSphere(ViewerState &state, v3s16 pos, s16 radius)
+{
+	v3s16 p;
+	// Entering
+	for (p.X = pos.X - radius; p.X <= pos.X + radius; p.X++)
+	for (p.Y = pos.Y - radius; p.Y <= pos.Y + radius; p.Y++)
+	for (p.Z = pos.Z - radius; p.Z <= pos.Z + radius; p.Z++) {
+		if (isInSphere(p, pos, radius) && !isInSphere(p, state.pos, state.radius))
+			ref(p, 1, 0);
+	}
+	// Leaving
+	for (p.X = state.pos.X - state.radius; p.X <= state.pos.X + state.radius; p.X++)
+	for (p.Y = state.pos.Y - state.radius; p.Y <= state.pos.Y + state.radius; p.Y++)
+	for (p.Z = state.pos.Z - state.radius; p.Z <= state.pos.Z + state.radius; p.Z++) {
+		if (isInSphere(p, state.pos, state.radius) && !isInSphere(p, pos, radius))
+			ref(p, -1, 0);
+	}
+	state.pos = pos;
+	state.radius = radius;
+}
+
+void ActiveBlockList::updateCone(ViewerState &state, const Viewer &viewer)
+{
+	if (viewer.cone_range <= 0) {
+		for (const v3s16 p : state.cone)
+			ref(p, 0, -1);
+		state.cone.clear();
+		state.cone_range = 0;
+		return;
+	}
+
+	// Turning a little keeps the cone, it only activates loaded blocks
+	if (viewer.pos == state.cone_pos &&
+			viewer.cone_range == state.cone_range && viewer.fov == state.fov &&
+			viewer.camera_dir.dotProduct(state.camera_dir) > 0.996f)
+		return;
+
+	std::vector<v3s16> cone;
+	fillViewConeBlock(viewer.pos, viewer.cone_range, viewer.camera_pos,
+			viewer.camera_dir, viewer.fov, cone);
+	auto old_it = state.cone.begin();
+	auto it = cone.begin();
+	while (old_it != state.cone.end() || it != cone.end()) {
+		if (it == cone.end() || (old_it != state.cone.end() && *old_it < *it)) {
+			ref(*old_it++, 0, -1);
+		} else if (old_it == state.cone.end() || *it < *old_it) {
+			ref(*it++, 0, 1);
+		} else {
+			++old_it;
+			++it;
 		}
 	}
+	state.cone = std::move(cone);
+	state.cone_pos = viewer.pos;
+	state.cone_range = viewer.cone_range;
+	state.camera_dir = viewer.camera_dir;
+	state.fov = viewer.fov;
 }
 
 void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
@@ -395,16 +495,13 @@ void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 	std::set<v3s16> &blocks_added,
 	std::set<v3s16> &extra_blocks_added)
 {
-	/*
-		Create the new list
-	*/
-	std::set<v3s16> newlist = m_forceloaded_list;
-	std::set<v3s16> extralist;
-	m_abm_list = m_forceloaded_list;
+	std::vector<Viewer> viewers;
+	viewers.reserve(active_players.size());
 	for (PlayerSAO *playersao : active_players) {
-		v3s16 pos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
-		fillRadiusBlock(pos, active_block_range, m_abm_list);
-		fillRadiusBlock(pos, active_block_range, newlist);
+		Viewer &viewer = viewers.emplace_back();
+		viewer.id = playersao->getId();
+		viewer.pos = getNodeBlockPos(floatToInt(playersao->getBasePosition(), BS));
+		viewer.radius = active_block_range;
 
 		s16 player_ao_range = std::min(active_object_range, playersao->getWantedRange());
 		// only do this if this would add blocks
@@ -414,66 +511,104 @@ void ActiveBlockList::update(std::vector<PlayerSAO*> &active_players,
 			camera_dir.rotateXZBy(playersao->getRotation().Y);
 			if (playersao->getCameraInverted())
 				camera_dir = -camera_dir;
-			fillViewConeBlock(pos,
-				player_ao_range,
-				playersao->getEyePosition(),
-				camera_dir,
-				playersao->getFov(),
-				extralist);
+			viewer.cone_range = player_ao_range;
+			viewer.camera_pos = playersao->getEyePosition();
+			viewer.camera_dir = camera_dir;
+			viewer.fov = playersao->getFov();
 		}
 	}
 
-	/*
-		Find out which blocks on the new list are not on the old list
-	*/
-	for (v3s16 p : newlist) {
-		// also remove duplicate blocks from the extra list
-		extralist.erase(p);
-		// If not on old list, it's been added
-		if (m_list.find(p) == m_list.end())
-			blocks_added.insert(p);
-	}
-	/*
-		Find out which blocks on the extra list are not on the old list
-	*/
-	for (v3s16 p : extralist) {
-		// also make sure newlist has all blocks
-		newlist.insert(p);
-		// If not on old list, it's been added
-		if (m_list.find(p) == m_list.end())
-			extra_blocks_added.insert(p);
-	}
+	update(viewers, blocks_removed, blocks_added, extra_blocks_added);
+}
 
+void ActiveBlockList::update(const std::vector<Viewer> &viewers,
+	std::set<v3s16> &blocks_removed,
+	std::set<v3s16> &blocks_added,
+	std::set<v3s16> &extra_blocks_added)
+{
 	/*
-		Find out which blocks on the old list are not on the new + extra list
+		Count what changed
 	*/
-	std::set_difference(m_list.begin(), m_list.end(), newlist.begin(), newlist.end(),
-			std::inserter(blocks_removed, blocks_removed.end()));
+	for (auto &[id, state] : m_viewers)
+		state.seen = false;
 
-	/*
-		Do some least-effort sanity checks to hopefully catch code bugs.
-	*/
-	assert(newlist.size() >= extralist.size());
-	assert(blocks_removed.size() <= m_list.size());
-	if (!blocks_added.empty()) {
-		assert(newlist.count(*blocks_added.begin()) > 0);
-		assert(blocks_removed.count(*blocks_added.begin()) == 0);
+	for (const Viewer &viewer : viewers) {
+		auto [it, inserted] = m_viewers.try_emplace(viewer.id);
+		ViewerState &state = it->second;
+		if (state.seen)
+			continue;
+		state.seen = true;
+
+		if (inserted) {
+			refSphere(viewer.pos, viewer.radius, 1);
+			state.pos = viewer.pos;
+			state.radius = viewer.radius;
+		} else if (viewer.pos != state.pos || viewer.radius != state.radius) {
+			moveSphere(state, viewer.pos, viewer.radius);
+		}
+		updateCone(state, viewer);
 	}
-	if (!extra_blocks_added.empty()) {
-		assert(newlist.count(*extra_blocks_added.begin()) > 0);
-		assert(extralist.count(*extra_blocks_added.begin()) > 0);
-		assert(blocks_added.count(*extra_blocks_added.begin()) == 0);
+
+	for (auto it = m_viewers.begin(); it != m_viewers.end();) {
+		if (it->second.seen) {
+			++it;
+			continue;
+		}
+		refSphere(it->second.pos, it->second.radius, -1);
+		for (const v3s16 p : it->second.cone)
+			ref(p, 0, -1);
+		it = m_viewers.erase(it);
 	}
-	if (!blocks_removed.empty()) {
-		assert(newlist.count(*blocks_removed.begin()) == 0);
-		assert(extralist.count(*blocks_removed.begin()) == 0);
-		assert(m_list.count(*blocks_removed.begin()) > 0);
+
+	if (m_forceloaded_list != m_forceloaded_counted) {
+		std::vector<v3s16> unloaded, loaded;
+		std::set_difference(m_forceloaded_counted.begin(), m_forceloaded_counted.end(),
+				m_forceloaded_list.begin(), m_forceloaded_list.end(),
+				std::back_inserter(unloaded));
+		std::set_difference(m_forceloaded_list.begin(), m_forceloaded_list.end(),
+				m_forceloaded_counted.begin(), m_forceloaded_counted.end(),
+				std::back_inserter(loaded));
+		for (const v3s16 p : unloaded)
+			ref(p, -1, 0);
+		for (const v3s16 p : loaded)
+			ref(p, 1, 0);
+		m_forceloaded_counted = m_forceloaded_list;
 	}
 
 	/*
-		Update m_list
+		Apply it to the lists
 	*/
-	m_list = std::move(newlist);
+	for (const v3s16 p : m_touched) {
+		const auto it = m_refs.find(p);
+		if (it == m_refs.end())
+			continue;
+		Refs &refs = it->second;
+		const bool near = refs.near;
+		const bool active = near || refs.extra;
+
+		if (near != refs.abm_listed) {
+			refs.abm_listed = near;
+			if (near)
+				m_abm_list.insert(p);
+			else
+				m_abm_list.erase(p);
+		}
+
+		if (active != refs.listed) {
+			refs.listed = active;
+			if (active) {
+				m_list.insert(p);
+				(near ? blocks_added : extra_blocks_added).insert(p);
+			} else {
+				m_list.erase(p);
+				blocks_removed.insert(p);
+			}
+		}
+
+		if (!active)
+			m_refs.erase(it);
+	}
+	m_touched.clear();
 }
 
 /*
@@ -1535,77 +1670,193 @@ void ServerEnvironment::step(float dtime, double uptime, unsigned int max_cycle_
 	ScopeProfiler sp2(g_profiler, "ServerEnv::step()", SPT_AVG);
 	const auto start_time = porting::getTimeUs();
 
-	/* Step time of day */
-	stepTimeOfDay(dtime);
-
-	// Update this one
-	// NOTE: This is kind of funny on a singleplayer game, but doesn't
-	// really matter that much.
-	static thread_local const float server_step =
-			g_settings->getFloat("dedicated_server_step");
-	m_recommended_send_interval = server_step;
-
-	/*
-		Increment game time
-	*/
-	{
-		m_game_time_fraction_counter += dtime;
-		u32 inc_i = (u32)m_game_time_fraction_counter;
-		m_game_time += inc_i;
-		m_game_time_fraction_counter -= (float)inc_i;
-	}
-
 	TimeTaker timer_step("Server Environment step");
 #if ENABLE_THREADS
 	g_profiler->avg("SMap: Blocks", getMap().m_blocks.size());
 #endif
 
-	{
-		getScriptIface()->player_event_process();
-	}
+	/*
+		The step is made of phases, each naming the ones it needs done
+		before. Phases working on blocks only are split in partitions of
+		the active blocks and run on the task scheduler, anything calling
+		Lua stays on this thread.
+	*/
+	StepPhases phases(TaskScheduler::get());
+	const auto run_phases = [&] {
+		phases.run();
+		for (const auto &timing : phases.getTimings())
+			g_profiler->avg(std::string("ServerEnv phase: ") + timing.name + " (ms)",
+					timing.time_us / 1000.0f);
+	};
 
-	{
-		decltype(m_script->postponed)::full_type events;
+	phases.add("time", {}, [&] {
+		/* Step time of day */
+		stepTimeOfDay(dtime);
+
+		// Update this one
+		// NOTE: This is kind of funny on a singleplayer game, but doesn't
+		// really matter that much.
+		static thread_local const float server_step =
+				g_settings->getFloat("dedicated_server_step");
+		m_recommended_send_interval = server_step;
+
+		/*
+			Increment game time
+		*/
 		{
-			const auto lock = m_script->postponed.try_lock_unique_rec();
-			if (lock->owns_lock()) {
-				std::swap(m_script->postponed, events);
-			}
+			m_game_time_fraction_counter += dtime;
+			u32 inc_i = (u32)m_game_time_fraction_counter;
+			m_game_time += inc_i;
+			m_game_time_fraction_counter -= (float)inc_i;
 		}
-		for (const auto &e : events) {
-			e();
+	});
+	phases.add("scripts", {"time"}, [&] {
+		{
+			getScriptIface()->player_event_process();
 		}
-	}
 
-	/*
-		Handle players
-	*/
-	{
+		{
+			decltype(m_script->postponed)::full_type events;
+			{
+				const auto lock = m_script->postponed.try_lock_unique_rec();
+				if (lock->owns_lock()) {
+					std::swap(m_script->postponed, events);
+				}
+			}
+			for (const auto &e : events) {
+				e();
+			}
+		}
+	});
+	phases.add("players", {"scripts"}, [&] {
+		/*
+			Handle players
+		*/
+		{
 #if !NDEBUG
-		ScopeProfiler sp(g_profiler, "ServerEnv: move players", SPT_AVG);
+			ScopeProfiler sp(g_profiler, "ServerEnv: move players", SPT_AVG);
 #endif
-		const auto lock = m_players.lock_shared_rec();
-		for (RemotePlayer *player : m_players) {
-			// Ignore disconnected players
-			if (!player || player->getPeerId() == PEER_ID_INEXISTENT)
-				continue;
+			const auto lock = m_players.lock_shared_rec();
+			for (RemotePlayer *player : m_players) {
+				// Ignore disconnected players
+				if (!player || player->getPeerId() == PEER_ID_INEXISTENT)
+					continue;
 
-			// Move
-			player->move(dtime, this, 100 * BS);
+				// Move
+				player->move(dtime, this, 100 * BS);
+			}
 		}
-	}
+	});
+	phases.add("circuit", {"players"}, [&] {
+		m_circuit.update(dtime);
+	});
+	phases.add("particle_spawners", {}, [&] {
+		/*
+			Manage particle spawner expiration
+		*/
+		if (m_particle_management_interval.step(dtime, 1.0)) {
+			for (auto i = m_particle_spawners.begin(); i != m_particle_spawners.end(); ) {
+				// non expiring spawners
+				if (i->second == PARTICLE_SPAWNER_NO_EXPIRY) {
+					++i;
+					continue;
+				}
 
-	/*
-	 * Update circuit
-	 */
-	m_circuit.update(dtime);
+				i->second -= 1.0f;
+				if (i->second <= 0.f)
+					i = m_particle_spawners.erase(i);
+				else
+					++i;
+			}
+		}
+	});
+	run_phases();
 
 #if !ENABLE_THREADS
 	auto lockmap = m_map->m_nothread_locker.try_lock_unique_rec();
 	if (!lockmap->owns_lock())
 		return;
+	const size_t partitions = 1;
+#else
+	const size_t partitions = TaskScheduler::get().getThreadCount() * 2;
 #endif
 
+	const bool run_timers = m_active_block_timer_last ||
+			m_active_blocks_nodemetadata_interval.step(dtime, m_cache_nodetimer_interval);
+
+	phases.add("active_blocks", {}, [&] {
+		updateActiveBlocks(dtime, max_cycle_ms);
+	});
+	phases.add("analyze", {"active_blocks"}, [&] {
+		if (!m_more_threads)
+			analyzeBlocks(dtime, max_cycle_ms);
+	});
+	phases.add("timer_blocks", {"active_blocks"}, [&] {
+		m_timer_blocks.clear();
+		m_elapsed_timers.resize(partitions);
+		if (!run_timers)
+			return;
+		const auto lock = m_active_blocks.m_list.lock_shared_rec();
+		m_timer_blocks.assign(m_active_blocks.m_list.begin(), m_active_blocks.m_list.end());
+	});
+	phases.addParallel("block_timers", {"analyze", "timer_blocks"}, partitions,
+			[&](size_t partition) {
+				stepBlockTimers(partition, partitions, dtime, uptime);
+			});
+	phases.add("node_timers", {"block_timers"}, [&] {
+		if (run_timers)
+			runElapsedNodeTimers(max_cycle_ms);
+	});
+	phases.add("abm", {"node_timers"}, [&] {
+		stepActiveBlockModifiers(dtime);
+	});
+	phases.add("globalstep", {"abm"}, [&] {
+		{
+		TimeTaker timer("contrib_globalstep");
+		contrib_globalstep(dtime);
+		}
+
+		ScopeProfiler sp(g_profiler, "SEnv: environment_Step AVG", SPT_AVG);
+		TimeTaker timer("environment_Step");
+
+		/*
+			Step script environment (run global on_step())
+		*/
+		m_script->environment_Step(dtime);
+
+		m_script->stepAsync();
+	});
+	phases.add("objects", {"globalstep"}, [&] {
+		stepActiveObjects(dtime);
+	});
+	phases.add("object_management", {"objects"}, [&] {
+		/*
+			Manage active objects
+		*/
+		if (m_object_management_interval.step(dtime, 5)) {
+			removeRemovedObjects();
+		}
+	});
+	phases.add("inventories", {"objects"}, [&] {
+		sendModifiedInventories();
+	});
+	phases.add("mapblocks_changed", {"objects"}, [&] {
+		// Notify mods of modified mapblocks
+		if (m_on_mapblocks_changed_receiver.receiving &&
+				!m_on_mapblocks_changed_receiver.modified_blocks.empty()) {
+			std::unordered_set<v3s16> modified_blocks;
+			std::swap(modified_blocks, m_on_mapblocks_changed_receiver.modified_blocks);
+			m_script->on_mapblocks_changed(modified_blocks);
+		}
+	});
+	run_phases();
+
+	const auto end_time = porting::getTimeUs();
+	m_step_time_counter->increment(end_time - start_time);
+}
+
+void ServerEnvironment::updateActiveBlocks(float dtime, unsigned int max_cycle_ms)
+{
 	/*
 		Manage active block list
 	*/
@@ -1744,65 +1995,79 @@ void ServerEnvironment::step(float dtime, double uptime, unsigned int max_cycle_
 			--m_fast_active_block_divider;
 	}
 
-	if (!m_more_threads)
-		analyzeBlocks(dtime, max_cycle_ms);
+}
 
+void ServerEnvironment::stepBlockTimers(
+		size_t partition, size_t partitions, float dtime, double uptime)
+{
 	/*
 		Mess around in active blocks
 	*/
-	if (m_active_block_timer_last || m_active_blocks_nodemetadata_interval.step(dtime, m_cache_nodetimer_interval)) {
-#if !NDEBUG
-		ScopeProfiler sp(g_profiler, "ServerEnv: Run node timers", SPT_AVG);
-#endif
-/*
-		float dtime = m_cache_nodetimer_interval;
-*/
-		u32 n = 0, calls = 0;
-		const auto end_ms = porting::getTimeMs() + max_cycle_ms;
-		const auto lock = m_active_blocks.m_list.lock_shared_rec();
-
-		for (const auto &p: m_active_blocks.m_list) {
-			if (n++ < m_active_block_timer_last)
-				continue;
-			else
-				m_active_block_timer_last = 0;
-			++calls;
-
-			MapBlock *block = m_map->getBlockNoCreateNoEx(p, true);
-			if (!block)
-				continue;
+	auto &elapsed = m_elapsed_timers[partition];
+	elapsed.clear();
+	const size_t count = m_timer_blocks.size();
+	const size_t end = count * (partition + 1) / partitions;
+	for (size_t i = count * partition / partitions; i < end; ++i) {
+		const auto block = m_map->getBlock(m_timer_blocks[i], true);
+		if (!block)
+			continue;
 
-			// Reset block usage timer
-			block->resetUsageTimer();
+		// Reset block usage timer
+		block->resetUsageTimer();
 
-			// Set current time as timestamp
-			block->setTimestampNoChangedFlag(m_game_time);
-			// If time has changed much from the one on disk,
-			// set block to be saved when it is unloaded
-			if(block->getDiskTimestamp() != BLOCK_TIMESTAMP_UNDEFINED && block->getTimestamp() > block->getDiskTimestamp() + 60)
-				block->raiseModified(MOD_STATE_WRITE_AT_UNLOAD,
-					MOD_REASON_BLOCK_EXPIRED);
+		// Set current time as timestamp
+		block->setTimestampNoChangedFlag(m_game_time);
+		// If time has changed much from the one on disk,
+		// set block to be saved when it is unloaded
+		if(block->getDiskTimestamp() != BLOCK_TIMESTAMP_UNDEFINED && block->getTimestamp() > block->getDiskTimestamp() + 60)
+			block->raiseModified(MOD_STATE_WRITE_AT_UNLOAD,
+				MOD_REASON_BLOCK_EXPIRED);
 
-			// Run node timers
+		// Step node timers, their callbacks run in runElapsedNodeTimers()
 
-			if (!block->m_node_timers.m_uptime_last) // not very good place, but minimum modifications
-				block->m_node_timers.m_uptime_last = uptime - dtime;
-			const auto dtime_s = uptime - block->m_node_timers.m_uptime_last;
-			block->m_node_timers.m_uptime_last = uptime;
+		if (!block->m_node_timers.m_uptime_last) // not very good place, but minimum modifications
+			block->m_node_timers.m_uptime_last = uptime - dtime;
+		const auto dtime_s = uptime - block->m_node_timers.m_uptime_last;
+		block->m_node_timers.m_uptime_last = uptime;
 
-			block->step(dtime_s, [&](v3pos_t p, MapNode n, f32 d) -> bool {
-				return m_script->node_on_timer(p, n, d);
-			});
+		auto timers = block->stepNodeTimers(dtime_s);
+		if (!timers.empty())
+			elapsed.emplace_back(ElapsedNodeTimers{block, std::move(timers)});
+	}
+}
 
-			if (porting::getTimeMs() > end_ms) {
-				m_active_block_timer_last = n;
-				break;
+void ServerEnvironment::runElapsedNodeTimers(unsigned int max_cycle_ms)
+{
+#if !NDEBUG
+	ScopeProfiler sp(g_profiler, "ServerEnv: Run node timers", SPT_AVG);
+#endif
+	const auto end_ms = porting::getTimeMs() + max_cycle_ms;
+	// Blocks with timers left for the next step
+	m_active_block_timer_last = 0;
+	for (auto &partition : m_elapsed_timers) {
+		for (const auto &[block, timers] : partition) {
+			if (!m_active_block_timer_last) {
+				block->runNodeTimers(timers, [&](v3pos_t p, MapNode n, f32 d) -> bool {
+					return m_script->node_on_timer(p, n, d);
+				});
+				if (porting::getTimeMs() > end_ms)
+					m_active_block_timer_last = 1;
+				continue;
 			}
+
+			// Elapsed again at the next step, unless set anew meanwhile
+			for (const auto &timer : timers)
+				if (!block->getNodeTimer(timer.position).timeout)
+					block->setNodeTimer(
+							NodeTimer(timer.timeout, timer.elapsed, timer.position));
+			++m_active_block_timer_last;
 		}
-		if (!calls)
-			m_active_block_timer_last = 0;
+		partition.clear();
 	}
+}
 
+void ServerEnvironment::stepActiveBlockModifiers(float dtime)
+{
 	g_profiler->avg("SMap: Blocks: Active", m_active_blocks.m_list.size());
 	m_active_block_abm_dtime_counter += dtime;
 
@@ -1896,84 +2161,46 @@ void ServerEnvironment::step(float dtime, double uptime, unsigned int max_cycle_
 		timer.stop(true);
 	}
 
-	{
-	TimeTaker timer("contrib_globalstep");
-	contrib_globalstep(dtime);
-	}
-
-	ScopeProfiler sp(g_profiler, "SEnv: environment_Step AVG", SPT_AVG);
-	TimeTaker timer("environment_Step");
-
-
-	/*
-		Step script environment (run global on_step())
-	*/
-	m_script->environment_Step(dtime);
-
-	m_script->stepAsync();
+}
 
+void ServerEnvironment::stepActiveObjects(float dtime)
+{
 	/*
 		Step active objects
 	*/
-	{
-		ScopeProfiler sp(g_profiler, "ServerEnv: Run SAO::step()", SPT_AVG);
-
-		// This helps the objects to send data at the same time
-		bool send_recommended = false;
-		m_send_recommended_timer += dtime;
-		if (m_send_recommended_timer > getSendRecommendedInterval()) {
-			m_send_recommended_timer -= getSendRecommendedInterval();
-			if (m_send_recommended_timer > getSendRecommendedInterval() * 2) {
-				m_send_recommended_timer = 0;
-			}
+	ScopeProfiler sp(g_profiler, "ServerEnv: Run SAO::step()", SPT_AVG);
 
-			send_recommended = true;
+	// This helps the objects to send data at the same time
+	bool send_recommended = false;
+	m_send_recommended_timer += dtime;
+	if (m_send_recommended_timer > getSendRecommendedInterval()) {
+		m_send_recommended_timer -= getSendRecommendedInterval();
+		if (m_send_recommended_timer > getSendRecommendedInterval() * 2) {
+			m_send_recommended_timer = 0;
 		}
 
-		u32 object_count = 0;
-
-		auto cb_state = [&](const ServerActiveObjectPtr &obj) {
-			if (!obj || obj->isGone())
-				return;
-			object_count++;
-
-			// Step object
-			obj->step(dtime, send_recommended);
-			// Read messages from object
-			obj->dumpAOMessagesToQueue(m_active_object_messages);
-		};
-		m_ao_manager.step(dtime, cb_state);
-
-		m_active_object_gauge->set(object_count);
+		send_recommended = true;
 	}
 
-	/*
-		Manage active objects
-	*/
-	if (m_object_management_interval.step(dtime, 5)) {
-		removeRemovedObjects();
-	}
+	u32 object_count = 0;
 
-	/*
-		Manage particle spawner expiration
-	*/
-	if (m_particle_management_interval.step(dtime, 1.0)) {
-		for (auto i = m_particle_spawners.begin(); i != m_particle_spawners.end(); ) {
-			// non expiring spawners
-			if (i->second == PARTICLE_SPAWNER_NO_EXPIRY) {
-				++i;
-				continue;
-			}
+	auto cb_state = [&](const ServerActiveObjectPtr &obj) {
+		if (!obj || obj->isGone())
+			return;
+		object_count++;
 
-			i->second -= 1.0f;
-			if (i->second <= 0.f)
-				i = m_particle_spawners.erase(i);
-			else
-				++i;
-		}
-	}
+		// Step object
+		obj->step(dtime, send_recommended);
+		// Read messages from object
+		obj->dumpAOMessagesToQueue(m_active_object_messages);
+	};
+	m_ao_manager.step(dtime, cb_state);
 
+	m_active_object_gauge->set(object_count);
+}
 
+void ServerEnvironment::sendModifiedInventories()
+{
   {
 	std::vector<RemotePlayer*> send_inventory;
 
@@ -2000,17 +2227,6 @@ void ServerEnvironment::step(float dtime, double uptime, unsigned int max_cycle_
 	// Send outdated detached inventories
 	if (!m_players.empty())
 		m_server->sendDetachedInventories(PEER_ID_INEXISTENT, true);
-
-	// Notify mods of modified mapblocks
-	if (m_on_mapblocks_changed_receiver.receiving &&
-			!m_on_mapblocks_changed_receiver.modified_blocks.empty()) {
-		std::unordered_set<v3s16> modified_blocks;
-		std::swap(modified_blocks, m_on_mapblocks_changed_receiver.modified_blocks);
-		m_script->on_mapblocks_changed(modified_blocks);
-	}
-
-	const auto end_time = porting::getTimeUs();
-	m_step_time_counter->increment(end_time - start_time);
 }
 
 ServerEnvironment::BlockStatus ServerEnvironment::getBlockStatus(v3s16 blockpos)
@@ -8,10 +8,13 @@
 #include "server/abmhandler.h"
 
 #include <set>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "activeobject.h"
 #include "environment.h"
+#include "pathfinder.h"
 #include "servermap.h"
 #include "settings.h"
 #include "server/activeobjectmgr.h"
@@ -109,28 +112,34 @@ struct LoadingBlockModifierDef
 	std::vector<std::string> trigger_contents;
 	std::string name;
 	bool run_at_every_load = false;
+	// Triggered once per block with the nodes of all trigger contents,
+	// instead of once for each content
+	bool bulk = false;
 
 	virtual ~LoadingBlockModifierDef() = default;
 
 	/// @brief Called to invoke LBM
 	/// @param env environment
 	/// @param block the block in question
-	/// @param positions set of node positions (block-relative!)
+	/// @param positions node positions (block-relative!), of one content unless bulk
 	/// @param dtime_s game time since last deactivation
 	virtual void trigger(ServerEnvironment *env, MapBlock *block,
-		const std::unordered_set<v3s16> &positions, float dtime_s) {};
+		const std::vector<v3s16> &positions, float dtime_s) {};
 };
 
 class LBMContentMapping
 {
 public:
 	typedef std::vector<LoadingBlockModifierDef*> lbm_vector;
-	typedef std::unordered_map<content_t, lbm_vector> lbm_map;
+	// Indexed by content, empty for contents triggering nothing
+	typedef std::vector<lbm_vector> lbm_map;
 
 	LBMContentMapping() = default;
 	void addLBM(LoadingBlockModifierDef *lbm_def, IGameDef *gamedef);
-	const lbm_map::mapped_type *lookup(content_t c) const;
+	const lbm_vector *lookup(content_t c) const;
 	const lbm_vector &getList() const { return lbm_list; }
+	// Sets the contents triggering any of the LBMs
+	void getTriggerContents(std::vector<bool> &contents) const;
 
 	// This struct owns the LBM pointers.
 	~LBMContentMapping();
@@ -176,6 +185,8 @@ class LBMManager
 	// For m_query_mode == true:
 	// The key of the map is the LBM def's first introduction time.
 	lbm_lookup_map m_lbm_lookup;
+	// Contents triggering any LBM, blocks without them are skipped
+	std::vector<bool> m_trigger_contents;
 
 	// Returns an iterator to the LBMs that were introduced
 	// after the given time. This is guaranteed to return
@@ -186,11 +197,29 @@ class LBMManager
 
 /*
 	List of active blocks, used by ServerEnvironment
+
+	Every block counts the players (and forceloads) keeping it active.
+	When a player moves to another block only the blocks entering and
+	leaving its sphere are counted again, a list which stays the same
+	costs a few comparisons per player.
 */
 
 class ActiveBlockList
 {
 public:
+	// What keeps blocks active
+	struct Viewer
+	{
+		u16 id;
+		v3s16 pos;
+		s16 radius;
+		// The view cone is only for loaded blocks, 0 for none
+		s16 cone_range = 0;
+		v3f camera_pos;
+		v3f camera_dir;
+		float fov = 0;
+	};
+
 	void update(std::vector<PlayerSAO*> &active_players,
 		s16 active_block_range,
 		s16 active_object_range,
@@ -198,6 +227,11 @@ class ActiveBlockList
 		std::set<v3s16> &blocks_added,
 		std::set<v3s16> &extra_blocks_added);
 
+	void update(const std::vector<Viewer> &viewers,
+		std::set<v3s16> &blocks_removed,
+		std::set<v3s16> &blocks_added,
+		std::set<v3s16> &extra_blocks_added);
+
 	bool contains(v3s16 p) const {
 		return (m_list.find(p) != m_list.end());
 	}
@@ -208,11 +242,22 @@ class ActiveBlockList
 
 	void clear() {
 		m_list.clear();
+		m_abm_list.clear();
+		m_refs.clear();
+		m_viewers.clear();
+		m_forceloaded_counted.clear();
+		m_touched.clear();
 	}
 
+	// Until the next update, which adds it again if it is still wanted
 	void remove(v3s16 p) {
 		m_list.erase(p);
 		m_abm_list.erase(p);
+		if (const auto it = m_refs.find(p); it != m_refs.end()) {
+			it->second.listed = false;
+			it->second.abm_listed = false;
+			m_touched.emplace_back(p);
+		}
 	}
 
 	//std::set<v3s16> m_list;
@@ -220,6 +265,41 @@ class ActiveBlockList
 	std::set<v3s16> m_abm_list;
 	// list of blocks that are always active, not modified by this class
 	std::set<v3s16> m_forceloaded_list;
+
+private:
+	struct Refs
+	{
+		u16 near = 0;
+		u16 extra = 0;
+		// In m_list and m_abm_list
+		bool listed = false;
+		bool abm_listed = false;
+	};
+
+	struct ViewerState
+	{
+		v3s16 pos;
+		s16 radius = 0;
+		v3s16 cone_pos;
+		s16 cone_range = 0;
+		v3f camera_dir;
+		float fov = 0;
+		// Sorted
+		std::vector<v3s16> cone;
+		bool seen = false;
+	};
+
+	void ref(v3s16 p, s16 near, s16 extra);
+	void refSphere(v3s16 center, s16 radius, s16 count);
+	void moveSphere(ViewerState &state, v3s16 pos, s16 radius);
+	void updateCone(ViewerState &state, const Viewer &viewer);
+
+	std::unordered_map<v3s16, Refs> m_refs;
+	std::unordered_map<u16, ViewerState> m_viewers;
+	// What of m_forceloaded_list is counted in m_refs
+	std::set<v3s16> m_forceloaded_counted;
+	// Blocks with changed counts, to be checked at the next update
+	std::vector<v3s16> m_touched;
 };
 
 /*
@@ -256,6 +336,9 @@ class ServerEnvironment final : public Environment
 
 	ServerMap & getServerMap();
 
+	PathfinderCache & getPathfinderCache()
+	{ return m_pathfinder_cache; }
+
 	//TODO find way to remove this fct!
 	ServerScripting* getScriptIface()
 	{ return m_script; }
@@ -494,6 +577,22 @@ class ServerEnvironment final : public Environment
 	float m_active_block_abm_dtime = 0;
 	float m_active_block_abm_dtime_counter = 0;
 	u32 m_active_block_timer_last = 0;
+	// Phases of step()
+	void updateActiveBlocks(float dtime, unsigned int max_cycle_ms);
+	void stepBlockTimers(size_t partition, size_t partitions, float dtime, double uptime);
+	void runElapsedNodeTimers(unsigned int max_cycle_ms);
+	void stepActiveBlockModifiers(float dtime);
+	void stepActiveObjects(float dtime);
+	void sendModifiedInventories();
+	struct ElapsedNodeTimers
+	{
+		MapBlockPtr block;
+		std::vector<NodeTimer> timers;
+	};
+	// Active blocks split in partitions for stepBlockTimers(), the
+	// timers it found elapsed for each partition
+	std::vector<v3bpos_t> m_timer_blocks;
+	std::vector<std::vector<ElapsedNodeTimers>> m_elapsed_timers;
 	std::set<v3bpos_t> m_blocks_added;
 	u32 m_blocks_added_last = 0;
 	u32 m_active_block_analyzed_last = 0;
@@ -570,6 +669,8 @@ class ServerEnvironment final : public Environment
 
 	// The map
 	std::unique_ptr<ServerMap> m_map;
+	// Map walkability shared by path searches
+	PathfinderCache m_pathfinder_cache;
 	// Lua state
 	ServerScripting* m_script;
 	// Server definition
@@ -107,6 +107,9 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 		"minetest_map_loaded_blocks", "Number of loaded blocks");
 
 	m_map_compression_level = rangelim(g_settings->getS16("map_compression_level_disk"), -1, 9);
+	m_block_dictionary = BlockDictionary::load(m_savedir);
+	m_content_id_table = std::make_unique<ContentIdTable>(m_savedir, gamedef);
+	m_save_content_ids = ContentIdTable::isEnabled(conf);
 
 	try {
 		// If directory exists, check contents and load if possible
@@ -710,10 +713,12 @@ bool ServerMap::saveBlock(MapBlock *block)
 
 	// FIXME: serialization happens under mutex
 	MutexAutoLock dblock(m_db.mutex);
-	return saveBlock(block, m_db.dbase, m_map_compression_level);
+	return saveBlock(block, m_db.dbase, m_map_compression_level, m_block_dictionary.get(),
+			m_save_content_ids ? m_content_id_table.get() : nullptr);
 }
 
-bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_level)
+bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_level,
+		const BlockDictionary *dict, ContentIdTable *ids)
 {
 	v3s16 p3d = block->getPos();
 
@@ -731,7 +736,7 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_leve
 	*/
 	std::ostringstream o(std::ios_base::binary);
 	o.write((char*) &version, 1);
-	block->serialize(o, version, true, compression_level);
+	block->serialize(o, version, true, compression_level, false, dict, ids);
 
 	// FIXME: zero copy possible in c++20 or with custom rdbuf
 	bool ret = db->saveBlock(p3d, o.str());
@@ -742,7 +747,7 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_leve
 	return ret;
 }
 
-void ServerMap::deSerializeBlock(MapBlock *block, std::istream &is)
+void ServerMap::deSerializeBlock(MapBlock *block, std::istream &is, ContentIdTable *ids)
 {
 	ScopeProfiler sp(g_profiler, "ServerMap: deSer block", SPT_AVG, PRECISION_MICRO);
 
@@ -750,7 +755,7 @@ void ServerMap::deSerializeBlock(MapBlock *block, std::istream &is)
 	if (is.fail())
 		throw SerializationError("Failed to read MapBlock version");
 
-	block->deSerialize(is, version, true);
+	block->deSerialize(is, version, true, ids);
 }
 
 MapBlockPtr ServerMap::loadBlock(const std::string &blob, v3bpos_t p3d, bool save_after_load)
@@ -773,7 +778,7 @@ MapBlockPtr ServerMap::loadBlock(const std::string &blob, v3bpos_t p3d, bool sav
 
 		{
 			std::istringstream iss(blob, std::ios_base::binary);
-			deSerializeBlock(block.get(), iss);
+			deSerializeBlock(block.get(), iss, m_content_id_table.get());
 		}
 
 		// If it's a new block, insert it to the map
@@ -6,6 +6,8 @@
 
 #include "irr_v3d.h"
 #include "mapblock.h"
+#include "fm_block_dictionary.h"
+#include "fm_content_id_table.h"
 #include "threading/concurrent_set.h"
 
 #include <vector>
@@ -195,7 +197,9 @@ class ServerMap : public Map
 	MapgenParams *getMapgenParams();
 
 	bool saveBlock(MapBlock *block) override;
-	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1);
+	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1,
+			const BlockDictionary *dict = nullptr, ContentIdTable *ids = nullptr);
+	ContentIdTable *getContentIdTable() override { return m_content_id_table.get(); }
 
 	// Load block in a synchronous fashion
 	MapBlockPtr loadBlock(v3bpos_t p);
@@ -205,7 +209,7 @@ class ServerMap : public Map
 
 	// Helper for deserializing blocks from disk
 	// @throws SerializationError
-	static void deSerializeBlock(MapBlock *block, std::istream &is);
+	static void deSerializeBlock(MapBlock *block, std::istream &is, ContentIdTable *ids = nullptr);
 
 	// Blocks are removed from the map but not deleted from memory until
 	// deleteDetachedBlocks() is called, since pointers to them may still exist
@@ -259,9 +263,14 @@ class ServerMap : public Map
 public:
 	std::string m_savedir;
 	bool m_map_saving_enabled;
+	// Blocks are written with it, nullptr if the world has none
+	std::shared_ptr<BlockDictionary> m_block_dictionary;
+	// Blocks are read with it, written too with map_content_id_table
+	std::unique_ptr<ContentIdTable> m_content_id_table;
 private:
 
 	int m_map_compression_level;
+	bool m_save_content_ids;
 
 	concurrent_set<v3s16> m_chunks_in_progress;
 
@@ -23,6 +23,7 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <cstdint>
 #include <future>
 #include <chrono>
+#include "task_scheduler.h"
 
 #if defined(DUMP_STREAM)
 #include "log.h"
@@ -31,14 +32,27 @@ along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
 class async_step_runner
 {
 	std::future<void> future;
+	TaskCancelPtr cancel;
+	const char *type;
+	TaskPriority priority;
 #if defined(DUMP_STREAM)
 	int runs = 0;
 	int skips = 0;
 #endif
 
 public:
+	async_step_runner(const char *type_ = "step",
+			TaskPriority priority_ = TaskPriority::High) :
+			type(type_),
+			priority(priority_)
+	{
+	}
+
 	~async_step_runner()
 	{
+		// A step which did not start yet is not needed anymore
+		if (cancel)
+			cancel->cancel();
 		wait();
 #if defined(DUMP_STREAM)
 		DUMP("Async steps end", (long long)this, runs, skips);
@@ -46,11 +60,17 @@ class async_step_runner
 	}
 	int wait(const int ms = 300000, const int step_ms = 100)
 	{
+		auto &scheduler = TaskScheduler::get();
 		int i = 0;
 		for (; i < ms / step_ms; ++i) { // 10s max
 			if (!valid())
 				return i;
-			future.wait_for(std::chrono::milliseconds(step_ms));
+			if (future.wait_for(std::chrono::milliseconds(0)) ==
+					std::future_status::ready)
+				return i;
+			// Don't block a worker the step may be queued on
+			if (!scheduler.isWorkerThread() || !scheduler.runPending())
+				future.wait_for(std::chrono::milliseconds(step_ms));
 		}
 		return i;
 	}
@@ -74,7 +94,9 @@ class async_step_runner
 			}
 		}
 
-		future = std::async(std::launch::async, func, std::forward<Args>(args)...);
+		cancel = std::make_shared<TaskCancel>();
+		future = TaskScheduler::get().submit(type, priority,
+				std::bind(func, std::forward<Args>(args)...), cancel);
 #if defined(DUMP_STREAM)
 		++runs;
 #endif
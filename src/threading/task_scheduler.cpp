@@ -0,0 +1,459 @@
+/*
+task_scheduler.cpp
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "task_scheduler.h"
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include "fm_porting.h"
+#include "log_internal.h"
+#include "porting.h"
+#include "profiler.h"
+
+// Worker of the scheduler running on this thread
+static thread_local const TaskScheduler *t_scheduler = nullptr;
+static thread_local size_t t_worker = 0;
+
+TaskScheduler::TaskScheduler(size_t threads)
+{
+	if (!threads)
+		threads = std::max(2u, std::thread::hardware_concurrency());
+
+	m_limit[(size_t)TaskPriority::High] = threads;
+	m_limit[(size_t)TaskPriority::Normal] = std::max<size_t>(threads - 1, 1);
+	m_limit[(size_t)TaskPriority::Low] = std::max<size_t>(threads / 2, 1);
+
+	for (size_t i = 0; i < threads; ++i)
+		m_workers.emplace_back(std::make_unique<Worker>());
+	for (size_t i = 0; i < threads; ++i)
+		m_workers[i]->thread = std::thread(&TaskScheduler::workerLoop, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	shutdown();
+}
+
+void TaskScheduler::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_stop = true;
+	}
+
+	// Tasks pushed from now on see m_stop under the worker mutex
+	std::vector<Task> dropped;
+	for (auto &worker : m_workers) {
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		for (size_t priority = 0; priority < PRIORITIES; ++priority) {
+			auto &queue = worker->queues[priority];
+			m_pending[priority] -= queue.size();
+			std::move(queue.begin(), queue.end(), std::back_inserter(dropped));
+			queue.clear();
+		}
+	}
+	for (auto &task : dropped)
+		drop(task);
+	m_sleep_cv.notify_all();
+
+	for (auto &worker : m_workers)
+		if (worker->thread.joinable())
+			worker->thread.join();
+}
+
+TaskScheduler &TaskScheduler::get()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+bool TaskScheduler::isWorkerThread() const
+{
+	return t_scheduler == this;
+}
+
+void TaskScheduler::push(Task &&task)
+{
+	task.queued_us = porting::getTimeUs();
+	{
+		std::lock_guard<std::mutex> lock(m_stats_mutex);
+		auto &stats = m_stats[task.type];
+		++stats.submitted;
+		++stats.queued;
+	}
+
+	const size_t index =
+			isWorkerThread() ? t_worker : m_next_worker++ % m_workers.size();
+	auto &worker = *m_workers[index];
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (!m_stop) {
+			++m_pending[(size_t)task.priority];
+			worker.queues[(size_t)task.priority].emplace_back(std::move(task));
+			queued = true;
+		}
+	}
+	if (!queued) {
+		drop(task);
+		return;
+	}
+
+	// Don't let a worker miss the wakeup between its check and its wait
+	{ std::lock_guard<std::mutex> lock(m_sleep_mutex); }
+	m_sleep_cv.notify_one();
+}
+
+bool TaskScheduler::pop(size_t self, Task &task, bool limited)
+{
+	for (size_t priority = 0; priority < PRIORITIES; ++priority) {
+		if (!m_pending[priority] || (limited && !reserve(priority)))
+			continue;
+		if (take(self, priority, task)) {
+			task.reserved = limited;
+			return true;
+		}
+		if (limited)
+			release(priority);
+	}
+	return false;
+}
+
+bool TaskScheduler::take(size_t self, size_t priority, Task &task)
+{
+	{
+		auto &worker = *m_workers[self];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		auto &queue = worker.queues[priority];
+		if (!queue.empty()) {
+			task = std::move(queue.back());
+			queue.pop_back();
+			--m_pending[priority];
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < m_workers.size(); ++i) {
+		auto &victim = *m_workers[(self + i) % m_workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		auto &queue = victim.queues[priority];
+		if (!queue.empty()) {
+			task = std::move(queue.front());
+			queue.pop_front();
+			--m_pending[priority];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TaskScheduler::reserve(size_t priority)
+{
+	for (size_t p = 1; p <= priority; ++p) {
+		if (m_running[p]++ >= m_limit[p]) {
+			for (size_t undo = p; undo; --undo)
+				--m_running[undo];
+			return false;
+		}
+	}
+	return true;
+}
+
+void TaskScheduler::release(size_t priority)
+{
+	for (size_t p = 1; p <= priority; ++p)
+		--m_running[p];
+}
+
+bool TaskScheduler::hasRunnable() const
+{
+	for (size_t priority = 0; priority < PRIORITIES; ++priority) {
+		if (m_running[priority] >= m_limit[priority] && priority)
+			return false;
+		if (m_pending[priority])
+			return true;
+	}
+	return false;
+}
+
+size_t TaskScheduler::pendingCount() const
+{
+	size_t count = 0;
+	for (const auto &pending : m_pending)
+		count += pending;
+	return count;
+}
+
+void TaskScheduler::run(Task &task)
+{
+	const auto start_us = porting::getTimeUs();
+	const uint64_t wait_us = start_us - task.queued_us;
+
+	if (task.cancel && task.cancel->isCancelled()) {
+		if (task.reserved)
+			release((size_t)task.priority);
+		drop(task);
+		return;
+	}
+	task.func();
+
+	if (task.reserved) {
+		release((size_t)task.priority);
+		// A worker may wait for the limit
+		if (m_pending[(size_t)TaskPriority::Normal] || m_pending[(size_t)TaskPriority::Low]) {
+			{ std::lock_guard<std::mutex> lock(m_sleep_mutex); }
+			m_sleep_cv.notify_one();
+		}
+	}
+
+	const uint64_t run_us = porting::getTimeUs() - start_us;
+	const ProfilerNames *names;
+	{
+		std::lock_guard<std::mutex> lock(m_stats_mutex);
+		auto &stats = m_stats[task.type];
+		--stats.queued;
+		++stats.completed;
+		stats.wait_us += wait_us;
+		stats.wait_max_us = std::max(stats.wait_max_us, wait_us);
+		stats.run_us += run_us;
+		stats.run_max_us = std::max(stats.run_max_us, run_us);
+
+		// Elements of the map stay where they are
+		auto [it, inserted] = m_profiler_names.try_emplace(task.type);
+		if (inserted) {
+			const std::string name = std::string("Tasks: ") + task.type;
+			it->second.wait = name + " wait [ms]";
+			it->second.run = name + " run [ms]";
+		}
+		names = &it->second;
+	}
+
+	g_profiler->avg(names->wait, wait_us / 1000.0f);
+	g_profiler->avg(names->run, run_us / 1000.0f);
+}
+
+void TaskScheduler::drop(Task &task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_stats_mutex);
+		auto &stats = m_stats[task.type];
+		--stats.queued;
+		++stats.cancelled;
+	}
+	// Drops the packaged task, breaking its promise
+	task.func = nullptr;
+	if (task.on_drop)
+		task.on_drop();
+}
+
+bool TaskScheduler::runPending()
+{
+	// Run in place of the task waiting on this thread, not limited
+	Task task;
+	if (!pop(isWorkerThread() ? t_worker : 0, task, false))
+		return false;
+	run(task);
+	return true;
+}
+
+void TaskScheduler::runWithHelpers(const char *type, TaskPriority priority,
+		size_t helpers, const std::function<void()> &help,
+		const std::function<void()> &work)
+{
+	struct State
+	{
+		std::mutex mutex;
+		std::condition_variable done_cv;
+		bool closed = false;
+		size_t running = 0;
+		std::exception_ptr error;
+	};
+	const auto state = std::make_shared<State>();
+	const auto cancel = std::make_shared<TaskCancel>();
+
+	// Helpers only touch help after checking it still waits for them
+	for (size_t h = 0; h < helpers; ++h)
+		submit(type, priority, [state, &help] {
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (state->closed)
+					return;
+				++state->running;
+			}
+			std::exception_ptr error;
+			try {
+				help();
+			} catch (...) {
+				error = std::current_exception();
+			}
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (error && !state->error)
+				state->error = error;
+			if (!--state->running)
+				state->done_cv.notify_all();
+		}, cancel);
+
+	std::exception_ptr error;
+	try {
+		work();
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	cancel->cancel();
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->closed = true;
+	state->done_cv.wait(lock, [&] { return !state->running; });
+	if (!error)
+		error = state->error;
+	lock.unlock();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void TaskScheduler::workerLoop(size_t index)
+{
+	t_scheduler = this;
+	t_worker = index;
+
+	const std::string name = "Task" + std::to_string(index);
+	porting::setThreadName(name.c_str());
+	g_logger.registerThread(name);
+
+	for (;;) {
+		Task task;
+		if (pop(index, task, true)) {
+			run(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		if (m_stop && !pendingCount())
+			break;
+		m_sleep_cv.wait(lock, [this] { return m_stop || hasRunnable(); });
+	}
+
+	g_logger.deregisterThread();
+}
+
+std::map<std::string, TaskTypeStats> TaskScheduler::getStats()
+{
+	std::map<std::string, TaskTypeStats> result;
+	std::lock_guard<std::mutex> lock(m_stats_mutex);
+	for (const auto &[type, stats] : m_stats) {
+		// Same name from different translation units
+		auto &sum = result[type];
+		sum.submitted += stats.submitted;
+		sum.completed += stats.completed;
+		sum.cancelled += stats.cancelled;
+		sum.queued += stats.queued;
+		sum.wait_us += stats.wait_us;
+		sum.wait_max_us = std::max(sum.wait_max_us, stats.wait_max_us);
+		sum.run_us += stats.run_us;
+		sum.run_max_us = std::max(sum.run_max_us, stats.run_max_us);
+	}
+	return result;
+}
+
+
+TaskGroup::TaskGroup(const char *type, TaskPriority priority, size_t max_running,
+		TaskScheduler &scheduler) :
+		m_type(type),
+		m_priority(priority), m_scheduler(scheduler), m_max_running(max_running)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	wait_until_empty();
+}
+
+void TaskGroup::enqueue(std::function<void()> func)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_waiting.emplace_back(std::move(func));
+	submitNext(lock);
+}
+
+void TaskGroup::submitNext(std::unique_lock<std::mutex> &lock)
+{
+	while (!m_waiting.empty() && (!m_max_running || m_running < m_max_running)) {
+		++m_running;
+		auto func = std::move(m_waiting.front());
+		m_waiting.pop_front();
+		// A task dropped at once calls dropTask() from submit()
+		lock.unlock();
+		m_scheduler.submit(m_type, m_priority,
+				[this, func = std::move(func)]() mutable { runTask(func); },
+				{}, [this] { dropTask(); });
+		lock.lock();
+	}
+}
+
+void TaskGroup::runTask(std::function<void()> &func)
+{
+	try {
+		func();
+	} catch (...) {
+		// Kept in the dropped future, as the thread pool did
+		std::unique_lock<std::mutex> lock(m_mutex);
+		--m_running;
+		submitNext(lock);
+		m_done_cv.notify_all();
+		throw;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	--m_running;
+	submitNext(lock);
+	m_done_cv.notify_all();
+}
+
+void TaskGroup::dropTask()
+{
+	// The scheduler is shut down, the waiting tasks would be dropped too
+	std::unique_lock<std::mutex> lock(m_mutex);
+	--m_running;
+	m_waiting.clear();
+	m_done_cv.notify_all();
+}
+
+void TaskGroup::wait_until_empty()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_running || !m_waiting.empty()) {
+		if (m_scheduler.isWorkerThread()) {
+			lock.unlock();
+			if (!m_scheduler.runPending())
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			lock.lock();
+		} else {
+			m_done_cv.wait(lock);
+		}
+	}
+}
+
+void TaskGroup::set_max_running(size_t max_running)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_max_running = max_running;
+	submitNext(lock);
+}
@@ -0,0 +1,230 @@
+/*
+task_scheduler.h
+*/
+
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+enum class TaskPriority : uint8_t
+{
+	High,	// needed for the next frame or step
+	Normal,
+	Low,	// background work
+};
+
+// Shared by the submitter and a task, a task cancelled before it started is
+// dropped and its future reports std::future_errc::broken_promise
+class TaskCancel
+{
+public:
+	void cancel() { m_cancelled = true; }
+	bool isCancelled() const { return m_cancelled; }
+
+private:
+	std::atomic_bool m_cancelled{false};
+};
+
+using TaskCancelPtr = std::shared_ptr<TaskCancel>;
+
+struct TaskTypeStats
+{
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	uint64_t cancelled = 0;
+	uint64_t queued = 0; // waiting right now
+	uint64_t wait_us = 0;
+	uint64_t wait_max_us = 0;
+	uint64_t run_us = 0;
+	uint64_t run_max_us = 0;
+};
+
+/*
+	Process-wide pool of worker threads running short tasks.
+
+	Every worker has its own deque for each priority. Tasks submitted from a
+	worker go to its own deque, others are spread over all workers. A worker
+	takes its newest task first and, when it has nothing of a priority left,
+	steals the oldest one of another worker, before going to a lower priority.
+
+	Normal and Low tasks leave one worker to High ones, Low tasks take at most
+	half of the workers. Tasks run while waiting for another are not counted,
+	they do not take another worker.
+*/
+class TaskScheduler
+{
+public:
+	// 0 threads: one per processor
+	explicit TaskScheduler(size_t threads = 0);
+	~TaskScheduler();
+
+	static TaskScheduler &get();
+
+	// Drop the queued tasks, breaking their promises, and join the workers
+	// once the running ones are done. Tasks submitted later are dropped too.
+	void shutdown();
+
+	// type names the kind of task in the stats, it must be a string literal.
+	// on_drop is called instead of func if the task is dropped without
+	// running, by cancel or by shutdown().
+	template <class F>
+	auto submit(const char *type, TaskPriority priority, F &&func,
+			TaskCancelPtr cancel = {}, std::function<void()> on_drop = {})
+			-> std::future<std::invoke_result_t<F &>>
+	{
+		using R = std::invoke_result_t<F &>;
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+		auto future = task->get_future();
+		push(Task{[task] { (*task)(); }, std::move(on_drop), type, priority,
+				std::move(cancel), 0, false});
+		return future;
+	}
+
+	// Run one queued task on the calling thread, returns false if there
+	// was none. Lets a worker wait for another task without blocking it.
+	bool runPending();
+
+	// Wait for a future, helping with other tasks when called from a worker
+	template <class T>
+	void wait(const std::future<T> &future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) ==
+				std::future_status::timeout) {
+			if (!isWorkerThread() || !runPending())
+				future.wait_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	/*
+		Run work on the calling thread with up to helpers tasks running help
+		meanwhile, help must return when there is nothing left to do. Waits
+		only for the helpers which started before work returned, the others
+		are cancelled. Rethrows the first exception of any of them.
+	*/
+	void runWithHelpers(const char *type, TaskPriority priority, size_t helpers,
+			const std::function<void()> &help, const std::function<void()> &work);
+
+	bool isWorkerThread() const;
+	size_t getThreadCount() const { return m_workers.size(); }
+	std::map<std::string, TaskTypeStats> getStats();
+
+private:
+	struct Task
+	{
+		std::function<void()> func;
+		std::function<void()> on_drop;
+		const char *type;
+		TaskPriority priority;
+		TaskCancelPtr cancel;
+		uint64_t queued_us;
+		// Counted in m_running
+		bool reserved;
+	};
+
+	static constexpr size_t PRIORITIES = 3;
+
+	struct Worker
+	{
+		std::mutex mutex;
+		std::array<std::deque<Task>, PRIORITIES> queues;
+		std::thread thread;
+	};
+
+	void push(Task &&task);
+	// limited: the task takes a worker of its own
+	bool pop(size_t self, Task &task, bool limited);
+	bool take(size_t self, size_t priority, Task &task);
+	bool reserve(size_t priority);
+	void release(size_t priority);
+	bool hasRunnable() const;
+	size_t pendingCount() const;
+	void run(Task &task);
+	void drop(Task &task);
+	void workerLoop(size_t index);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::atomic_size_t m_next_worker{0};
+	std::array<std::atomic_size_t, PRIORITIES> m_pending{};
+	// Running tasks of the priority and lower ones, at most m_limit of them,
+	// High ones are not limited
+	std::array<std::atomic_size_t, PRIORITIES> m_running{};
+	std::array<size_t, PRIORITIES> m_limit{};
+	std::atomic_bool m_stop{false};
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_sleep_cv;
+
+	std::mutex m_stats_mutex;
+	std::unordered_map<const char *, TaskTypeStats> m_stats;
+	// Profiler names of each type, made once
+	struct ProfilerNames
+	{
+		std::string wait, run;
+	};
+	std::unordered_map<const char *, ProfilerNames> m_profiler_names;
+};
+
+/*
+	Tasks of one type, with at most max_running of them on the workers at
+	once, the rest waits here in submission order.
+*/
+class TaskGroup
+{
+public:
+	// max_running 0: no limit
+	TaskGroup(const char *type, TaskPriority priority, size_t max_running = 0,
+			TaskScheduler &scheduler = TaskScheduler::get());
+	~TaskGroup();
+
+	void enqueue(std::function<void()> func);
+
+	// Wait until all enqueued tasks are done
+	void wait_until_empty();
+
+	void set_max_running(size_t max_running);
+
+private:
+	void submitNext(std::unique_lock<std::mutex> &lock);
+	void runTask(std::function<void()> &func);
+	void dropTask();
+
+	const char *m_type;
+	const TaskPriority m_priority;
+	TaskScheduler &m_scheduler;
+
+	std::mutex m_mutex;
+	std::condition_variable m_done_cv;
+	std::deque<std::function<void()>> m_waiting;
+	size_t m_running = 0;
+	size_t m_max_running;
+};
@@ -0,0 +1,116 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "server/fm_block_send_budget.h"
+
+class TestBlockSendBudget : public TestBase
+{
+public:
+	TestBlockSendBudget() { TestManager::registerTestModule(this); }
+
+	const char *getName() { return "TestBlockSendBudget"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSpend();
+	void testGrow();
+	void testCongestion();
+	void testNoDelayLimit();
+};
+
+static TestBlockSendBudget g_test_instance;
+
+void TestBlockSendBudget::runTests(IGameDef *gamedef)
+{
+	TEST(testSpend);
+	TEST(testGrow);
+	TEST(testCongestion);
+	TEST(testNoDelayLimit);
+}
+
+// Sends the whole budget of every step, returns the bytes sent
+static size_t sendAll(BlockSendBudget &budget, float seconds, float min_rtt,
+		float avg_rtt)
+{
+	size_t bytes = 0;
+	for (float time = 0; time < seconds; time += 0.1f) {
+		budget.update(0.1f, min_rtt, avg_rtt);
+		while (budget.canSend()) {
+			budget.sent(2048);
+			bytes += 2048;
+		}
+	}
+	return bytes;
+}
+
+void TestBlockSendBudget::testSpend()
+{
+	BlockSendBudget budget(0.1f);
+	UASSERT(!budget.canSend());
+	UASSERT(budget.canSend(true));
+
+	budget.update(0.1f, -1, -1);
+	UASSERT(budget.canSend());
+	const u32 blocks = budget.blocksLeft();
+	UASSERT(blocks > 0);
+
+	for (u32 i = 0; i < blocks; i++)
+		budget.sent(2048);
+	UASSERT(!budget.canSend());
+	UASSERTEQ(u32, budget.blocksLeft(), 0);
+	// Near blocks overdraw it
+	UASSERT(budget.canSend(true));
+}
+
+void TestBlockSendBudget::testGrow()
+{
+	BlockSendBudget budget(0.1f);
+	sendAll(budget, 5, 0.02f, 0.025f);
+	UASSERT(budget.getRate() > BlockSendBudget::RATE_START * 4);
+	UASSERT(budget.getSendRate() > BlockSendBudget::RATE_START * 2);
+
+	// An unused budget doesn't grow
+	BlockSendBudget idle(0.1f);
+	for (int i = 0; i < 50; i++)
+		idle.update(0.1f, 0.02f, 0.025f);
+	UASSERT(idle.getRate() == BlockSendBudget::RATE_START);
+}
+
+void TestBlockSendBudget::testCongestion()
+{
+	BlockSendBudget budget(0.1f);
+	sendAll(budget, 5, 0.02f, 0.025f);
+	const float rate = budget.getRate();
+
+	// Packets wait half a second in queues
+	const size_t sent = sendAll(budget, 2, 0.02f, 0.52f);
+	UASSERT(budget.getRate() < rate / 2);
+	UASSERT(sent < rate * 2);
+	UASSERT(budget.getQueued() > 0);
+
+	sendAll(budget, 60, 0.02f, 0.52f);
+	UASSERT(budget.getRate() == BlockSendBudget::RATE_MIN);
+}
+
+void TestBlockSendBudget::testNoDelayLimit()
+{
+	BlockSendBudget budget(0);
+	sendAll(budget, 1, 0.02f, 0.52f);
+	UASSERT(budget.getRate() == BlockSendBudget::RATE_MAX);
+}
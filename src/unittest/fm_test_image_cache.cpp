@@ -0,0 +1,107 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <IImage.h>
+#include <IVideoDriver.h>
+#include <IrrlichtDevice.h>
+#include <cstring>
+#include "irrlicht.h"
+#include "irr_ptr.h"
+#include "filesys.h"
+#include "client/fm_image_cache.h"
+#include "client/imagesource.h"
+
+class TestImageDiskCache : public TestBase
+{
+public:
+	TestImageDiskCache() { TestManager::registerTestModule(this); }
+
+	const char *getName() { return "TestImageDiskCache"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testRoundTrip();
+};
+
+static TestImageDiskCache g_test_instance;
+
+void TestImageDiskCache::runTests(IGameDef *gamedef)
+{
+	TEST(testRoundTrip);
+}
+
+namespace
+{
+video::IImage *makeImage(video::IVideoDriver *driver, u32 seed)
+{
+	video::IImage *img = driver->createImage(video::ECF_A8R8G8B8, {4, 3});
+	u32 *pixels = reinterpret_cast<u32 *>(img->getData());
+	for (u32 i = 0; i < 4 * 3; i++)
+		pixels[i] = 0xff000000 | (i * 0x10203 + seed);
+	return img;
+}
+
+bool sameImage(video::IImage *a, video::IImage *b)
+{
+	return a->getDimension() == b->getDimension() &&
+			!memcmp(a->getData(), b->getData(), a->getImageDataSizeInBytes());
+}
+}
+
+void TestImageDiskCache::testRoundTrip()
+{
+	irr::SIrrlichtCreationParameters params;
+	params.DriverType = video::EDT_NULL;
+	irr_ptr<IrrlichtDevice> device(irr::createDeviceEx(params));
+	UASSERT(device);
+	video::IVideoDriver *driver = device->getVideoDriver();
+
+	UASSERT(!ImageDiskCache::isWorthCaching("base.png"));
+	UASSERT(ImageDiskCache::isWorthCaching("base.png^[invert:rgb"));
+
+	ImageSource source;
+	video::IImage *base = makeImage(driver, 1);
+	source.insertSourceImage("base.png", base, false);
+	base->drop();
+
+	const std::string dir = getTestTempDirectory() + DIR_DELIM + "textures";
+	ImageDiskCache cache(source, driver, dir, 1 << 20);
+	const std::string name = "base.png^[invert:rgb";
+	irr_ptr<video::IImage> made(makeImage(driver, 2));
+	cache.store(name, made.get(), {"base.png"});
+
+	std::set<std::string> sources;
+	irr_ptr<video::IImage> loaded(cache.load(name, sources));
+	UASSERT(loaded);
+	UASSERT(sameImage(loaded.get(), made.get()));
+	UASSERT(sources == std::set<std::string>{"base.png"});
+
+	// Other names are not found
+	UASSERT(!irr_ptr<video::IImage>(cache.load("base.png^[brighten", sources)));
+
+	// Images of missing sources are not stored
+	cache.store("missing.png^[brighten", made.get(), {"missing.png"});
+	UASSERT(!irr_ptr<video::IImage>(cache.load("missing.png^[brighten", sources)));
+
+	// Not used once a source image is different
+	base = makeImage(driver, 3);
+	source.insertSourceImage("base.png", base, false);
+	base->drop();
+	UASSERT(!irr_ptr<video::IImage>(cache.load(name, sources)));
+}
@@ -0,0 +1,96 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "mapblock.h"
+#include "serverenvironment.h"
+
+class TestLBM : public TestBase
+{
+public:
+	TestLBM() { TestManager::registerTestModule(this); }
+
+	const char *getName() { return "TestLBM"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testDispatch(IGameDef *gamedef);
+};
+
+static TestLBM g_test_instance;
+
+void TestLBM::runTests(IGameDef *gamedef)
+{
+	TEST(testDispatch, gamedef);
+}
+
+namespace
+{
+struct RecordingLBM : LoadingBlockModifierDef
+{
+	std::vector<size_t> calls;
+
+	RecordingLBM(const std::string &name_, bool bulk_)
+	{
+		name = name_;
+		bulk = bulk_;
+		run_at_every_load = true;
+		trigger_contents = {"default:stone", "default:dirt_with_grass"};
+	}
+
+	void trigger(ServerEnvironment *env, MapBlock *block,
+			const std::vector<v3s16> &positions, float dtime_s) override
+	{
+		calls.push_back(positions.size());
+	}
+};
+}
+
+void TestLBM::testDispatch(IGameDef *gamedef)
+{
+	LBMManager mgr;
+	auto *single = new RecordingLBM("test:single", false);
+	auto *bulk = new RecordingLBM("test:bulk", true);
+	mgr.addLBMDef(single);
+	mgr.addLBMDef(bulk);
+	mgr.loadIntroductionTimes("", gamedef, 10);
+
+	MapBlock block({}, gamedef);
+	block.setNodeNoCheck({1, 2, 3}, MapNode(t_CONTENT_STONE));
+	block.setNodeNoCheck({4, 5, 6}, MapNode(t_CONTENT_STONE));
+	block.setNodeNoCheck({7, 8, 9}, MapNode(t_CONTENT_GRASS));
+
+	// One call per content or one for all of them
+	mgr.applyLBMs(nullptr, &block, 0, 1.0f);
+	UASSERTEQ(size_t, single->calls.size(), 2);
+	UASSERTEQ(size_t, single->calls[0] + single->calls[1], 3);
+	UASSERTEQ(size_t, bulk->calls.size(), 1);
+	UASSERTEQ(size_t, bulk->calls[0], 3);
+
+	// Blocks without trigger contents are skipped
+	MapBlock empty({}, gamedef);
+	mgr.applyLBMs(nullptr, &empty, 0, 1.0f);
+	UASSERTEQ(size_t, single->calls.size(), 2);
+	UASSERTEQ(size_t, bulk->calls.size(), 1);
+
+	// but not once a trigger content is set in them
+	empty.setNodeNoCheck({0, 0, 0}, MapNode(t_CONTENT_GRASS));
+	mgr.applyLBMs(nullptr, &empty, 0, 1.0f);
+	UASSERTEQ(size_t, single->calls.size(), 3);
+	UASSERTEQ(size_t, bulk->calls.size(), 2);
+}
@@ -0,0 +1,136 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include "dummygamedef.h"
+#include "filesys.h"
+#include "client/content_mapblock.h"
+#include "client/fm_cache_dir_limit.h"
+#include "client/fm_mesh_cache.h"
+#include "client/mapblock_mesh.h"
+#include "client/meshgen/collector.h"
+
+class TestMeshDiskCache : public TestBase
+{
+public:
+	TestMeshDiskCache() { TestManager::registerTestModule(this); }
+
+	const char *getName() { return "TestMeshDiskCache"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testRoundTrip();
+	void testTrim();
+};
+
+static TestMeshDiskCache g_test_instance;
+
+void TestMeshDiskCache::runTests(IGameDef *gamedef)
+{
+	TEST(testRoundTrip);
+	TEST(testTrim);
+}
+
+void TestMeshDiskCache::testRoundTrip()
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+	content_t stone;
+	{
+		ContentFeatures f;
+		f.name = "test:stone";
+		f.drawtype = NDT_NORMAL;
+		f.solidness = 2;
+		f.alpha = ALPHAMODE_OPAQUE;
+		for (TileSpec &tile : f.tiles)
+			tile.layers[0].texture_id = 42;
+		stone = ndef->set(f.name, f);
+	}
+
+	MeshMakeData data{ndef, MAP_BLOCKSIZE, true};
+	data.m_blockpos = {0, 0, 0};
+	for (s16 z = -1; z <= MAP_BLOCKSIZE; z++)
+	for (s16 y = -1; y <= MAP_BLOCKSIZE; y++)
+	for (s16 x = -1; x <= MAP_BLOCKSIZE; x++)
+		data.m_vmanip.setNode({x, y, z}, {y < 3 ? stone : CONTENT_AIR, 0, 0});
+
+	MeshCollector generated{{}};
+	MapblockMeshGenerator(&data, &generated, nullptr).generate();
+	UASSERT(!generated.prebuffers[0].empty());
+
+	const std::string dir = getTestTempDirectory() + DIR_DELIM + "meshes";
+	MeshDiskCache cache(ndef, false, dir, 1 << 20);
+	const u64 key = cache.getKey(&data);
+	UASSERT(key != 0);
+	cache.store(key, generated);
+
+	MeshCollector loaded{{}};
+	UASSERT(cache.load(key, loaded));
+	UASSERTEQ(f32, loaded.m_bounding_radius_sq, generated.m_bounding_radius_sq);
+	for (int layer = 0; layer < MAX_TILE_LAYERS; layer++) {
+		const auto &expected = generated.prebuffers[layer];
+		const auto &got = loaded.prebuffers[layer];
+		UASSERTEQ(size_t, got.size(), expected.size());
+		for (size_t i = 0; i < got.size(); i++) {
+			UASSERTEQ(u32, got[i].layer.texture_id, expected[i].layer.texture_id);
+			UASSERTEQ(size_t, got[i].vertices.size(), expected[i].vertices.size());
+			UASSERT(!memcmp(got[i].vertices.data(), expected[i].vertices.data(),
+					got[i].vertices.size() * sizeof(video::S3DVertex)));
+			UASSERT(got[i].indices == expected[i].indices);
+		}
+	}
+
+	// Another node, another mesh
+	data.m_vmanip.setNode({5, 5, 5}, {stone, 0, 0});
+	const u64 other_key = cache.getKey(&data);
+	UASSERT(other_key != key);
+	MeshCollector missing{{}};
+	UASSERT(!cache.load(other_key, missing));
+}
+
+void TestMeshDiskCache::testTrim()
+{
+	namespace stdfs = std::filesystem;
+	const std::string dir = getTestTempDirectory() + DIR_DELIM + "trim";
+	const std::string sub = dir + DIR_DELIM + "identity";
+	UASSERT(fs::CreateAllDirs(sub));
+
+	// Written a minute apart, the oldest first
+	const auto now = stdfs::file_time_type::clock::now();
+	for (int i = 0; i < 4; i++) {
+		const std::string path = sub + DIR_DELIM + std::to_string(i);
+		UASSERT(fs::safeWriteToFile(path, std::string(1000, 'x')));
+		stdfs::last_write_time(path, now - std::chrono::minutes(4 - i));
+	}
+	UASSERTEQ(u64, CacheDirLimit::trim(dir, 4000), 4000);
+
+	// The oldest was used last, the next two go down to 3/4 of 3000
+	CacheDirLimit::used(sub + DIR_DELIM + "0");
+	UASSERTEQ(u64, CacheDirLimit::trim(dir, 3000), 2000);
+	UASSERT(fs::PathExists(sub + DIR_DELIM + "0"));
+	UASSERT(!fs::PathExists(sub + DIR_DELIM + "1"));
+	UASSERT(!fs::PathExists(sub + DIR_DELIM + "2"));
+	UASSERT(fs::PathExists(sub + DIR_DELIM + "3"));
+
+	// Emptied directories are removed too
+	UASSERTEQ(u64, CacheDirLimit::trim(dir, 100), 0);
+	UASSERT(!fs::PathExists(sub));
+}
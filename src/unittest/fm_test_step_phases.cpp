@@ -0,0 +1,131 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include "exceptions.h"
+#include "server/fm_step_phases.h"
+#include "threading/task_scheduler.h"
+
+class TestStepPhases : public TestBase
+{
+public:
+	TestStepPhases() { TestManager::registerTestModule(this); }
+
+	const char *getName() { return "TestStepPhases"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testOrder();
+	void testPartitions();
+	void testException();
+	void testBusyWorkers();
+};
+
+static TestStepPhases g_test_instance;
+
+void TestStepPhases::runTests(IGameDef *gamedef)
+{
+	TEST(testOrder);
+	TEST(testPartitions);
+	TEST(testException);
+	TEST(testBusyWorkers);
+}
+
+void TestStepPhases::testOrder()
+{
+	TaskScheduler scheduler(4);
+	StepPhases phases(scheduler);
+	std::mutex mutex;
+	std::vector<std::string> order;
+	const auto log = [&](const std::string &name) {
+		const std::lock_guard lock(mutex);
+		order.emplace_back(name);
+	};
+
+	phases.add("a", {}, [&] { log("a"); });
+	phases.addParallel("b", {"a"}, 8, [&](size_t) { log("b"); });
+	phases.add("c", {"a"}, [&] { log("c"); });
+	phases.add("d", {"b", "c"}, [&] { log("d"); });
+	phases.run();
+
+	UASSERTEQ(size_t, order.size(), 11);
+	UASSERTEQ(std::string, order.front(), "a");
+	UASSERTEQ(std::string, order.back(), "d");
+	UASSERTEQ(size_t, std::count(order.begin(), order.end(), "b"), 8);
+
+	const auto &timings = phases.getTimings();
+	UASSERTEQ(size_t, timings.size(), 4);
+	UASSERTEQ(std::string, timings[1].name, "b");
+	UASSERTEQ(size_t, timings[1].partitions, 8);
+	UASSERTEQ(size_t, timings[2].partitions, 0);
+
+	// Phases are gone after a run
+	phases.run();
+	UASSERT(phases.getTimings().empty());
+}
+
+void TestStepPhases::testPartitions()
+{
+	TaskScheduler scheduler(4);
+	StepPhases phases(scheduler);
+	std::vector<std::atomic_int> runs(100);
+	phases.addParallel("count", {}, runs.size(), [&](size_t p) { ++runs[p]; });
+	phases.run();
+	for (const auto &count : runs)
+		UASSERTEQ(int, count, 1);
+}
+
+void TestStepPhases::testException()
+{
+	TaskScheduler scheduler(4);
+	StepPhases phases(scheduler);
+	std::atomic_int after{0};
+	phases.addParallel("throw", {}, 16, [](size_t p) {
+		if (p == 3)
+			throw BaseException("partition");
+	});
+	phases.add("after", {"throw"}, [&] { ++after; });
+	EXCEPTION_CHECK(BaseException, phases.run());
+	UASSERTEQ(int, after, 0);
+}
+
+void TestStepPhases::testBusyWorkers()
+{
+	TaskScheduler scheduler(1);
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	std::promise<void> started;
+	auto blocker = scheduler.submit("test", TaskPriority::Low, [&] {
+		started.set_value();
+		released.wait();
+	});
+	started.get_future().wait();
+
+	// The only worker is busy, this thread does all partitions alone
+	StepPhases phases(scheduler);
+	std::atomic_int runs{0};
+	phases.addParallel("count", {}, 8, [&](size_t) { ++runs; });
+	phases.run();
+	UASSERTEQ(int, runs, 8);
+
+	release.set_value();
+	blocker.wait();
+}
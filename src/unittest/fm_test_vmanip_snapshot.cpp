@@ -0,0 +1,63 @@
+/*
+This file is part of Freeminer.
+
+Freeminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Freeminer  is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Freeminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test.h"
+
+#include "dummymap.h"
+#include "map.h"
+
+class TestVManipSnapshot : public TestBase
+{
+public:
+	TestVManipSnapshot() { TestManager::registerTestModule(this); }
+
+	const char *getName() { return "TestVManipSnapshot"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testReadLoaded(IGameDef *gamedef);
+};
+
+static TestVManipSnapshot g_test_instance;
+
+void TestVManipSnapshot::runTests(IGameDef *gamedef)
+{
+	TEST(testReadLoaded, gamedef);
+}
+
+void TestVManipSnapshot::testReadLoaded(IGameDef *gamedef)
+{
+	// Only the block at the origin is loaded
+	DummyMap map(gamedef, v3s16(0, 0, 0), v3s16(0, 0, 0));
+	const v3s16 p(1, 2, 3);
+	map.setNode(p, MapNode(t_CONTENT_STONE));
+
+	// What async workers do: read without loading or generating
+	MMVManip vm(&map);
+	vm.initialEmerge(v3s16(0, 0, 0), v3s16(1, 0, 0), false);
+	UASSERT(vm.getNodeNoExNoEmerge(p).getContent() == t_CONTENT_STONE);
+
+	// The missing block is left missing and has no data
+	const v3s16 missing(MAP_BLOCKSIZE + 1, 2, 3);
+	UASSERT(!map.getBlock(v3s16(1, 0, 0)));
+	UASSERT(vm.getFlagsRefUnsafe(missing) & VOXELFLAG_NO_DATA);
+	UASSERT(vm.getNodeNoExNoEmerge(missing).getContent() == CONTENT_IGNORE);
+
+	// Later changes of the map are not seen through the copy
+	map.setNode(p, MapNode(t_CONTENT_WATER));
+	UASSERT(vm.getNodeNoExNoEmerge(p).getContent() == t_CONTENT_STONE);
+}
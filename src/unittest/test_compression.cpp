@@ -9,6 +9,7 @@
 #include "irrlichttypes_extrabloated.h"
 #include "log.h"
 #include "serialization.h"
+#include "fm_block_dictionary.h"
 #include "nodedef.h"
 #include "noise.h"
 
@@ -23,6 +24,7 @@ class TestCompression : public TestBase {
 	void testZlibCompression();
 	void testZlibLargeData();
 	void testZstdLargeData();
+	void testZstdDictionary();
 	void testZlibLimit();
 	void _testZlibLimit(u32 size, u32 limit);
 };
@@ -35,6 +37,7 @@ void TestCompression::runTests(IGameDef *gamedef)
 	TEST(testZlibCompression);
 	TEST(testZlibLargeData);
 	TEST(testZstdLargeData);
+	TEST(testZstdDictionary);
 	TEST(testZlibLimit);
 }
 
@@ -197,6 +200,39 @@ void TestCompression::testZstdLargeData()
 	}
 }
 
+void TestCompression::testZstdDictionary()
+{
+	// Small pieces of data which are much alike, like map blocks
+	PseudoRandom pseudorandom(9421);
+	std::vector<std::string> samples;
+	for (u32 i = 0; i < 1000; i++) {
+		std::string sample = "default:stone default:dirt_with_grass default:water_source";
+		for (u32 j = 0; j < 64; j++)
+			sample += (char)pseudorandom.range(0, 3);
+		samples.emplace_back(sample);
+	}
+
+	const auto dict = BlockDictionary::create(BlockDictionary::train(samples, 4096));
+	UASSERT(dict);
+	UASSERT(BlockDictionary::find(dict->getId()) == dict);
+
+	const std::string &data_in = samples.back();
+	std::ostringstream os_plain(std::ios::binary);
+	compressZstd(data_in, os_plain, 0);
+	std::ostringstream os_compressed(std::ios::binary);
+	compressZstd(data_in, os_compressed, 0, dict.get());
+	UASSERT(os_compressed.str().size() < os_plain.str().size());
+
+	for (const auto &compressed : {os_compressed.str(), os_plain.str()}) {
+		std::istringstream is_compressed(compressed, std::ios::binary);
+		std::ostringstream os_decompressed(std::ios::binary);
+		decompressZstd(is_compressed, os_decompressed);
+		UASSERT(os_decompressed.str() == data_in);
+	}
+
+	UASSERT(!BlockDictionary::create("not a dictionary"));
+}
+
 void TestCompression::testZlibLimit()
 {
 	// edge cases
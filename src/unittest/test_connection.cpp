@@ -29,6 +29,8 @@ class TestConnection : public TestBase {
 
 	void testNetworkPacketSerialize();
 	void testHelpers();
+	void testReliablePacketBuffer();
+	void testIncomingSplitBuffer();
 	void testConnectSendReceive();
 };
 
@@ -39,6 +41,8 @@ void TestConnection::runTests(IGameDef *gamedef)
 #if MINETEST_PROTO && MINETEST_TRANSPORT
 	TEST(testNetworkPacketSerialize);
 	TEST(testHelpers);
+	TEST(testReliablePacketBuffer);
+	TEST(testIncomingSplitBuffer);
 	TEST(testConnectSendReceive);
 #endif
 }
@@ -148,6 +152,140 @@ void TestConnection::testHelpers()
 	UASSERT(readU8(&p2[3]) == data1[0]);
 }
 
+void TestConnection::testReliablePacketBuffer()
+{
+	Address a(127,0,0,1, 10);
+	SharedBuffer<u8> data(1);
+	data[0] = 100;
+	auto make = [&] (u16 seqnum) {
+		return con::makePacket(a, con::makeReliablePacket(data, seqnum),
+				0x12345678, 123, 0);
+	};
+
+	// Out of order around the wrap of the seqnums
+	con::ReliablePacketBuffer buffer;
+	const u16 next_expected = 65530;
+	std::vector<u16> seqnums;
+	for (u16 i = 1; i < 300; i++)
+		seqnums.push_back(next_expected + (i * 7919) % 300);
+	for (u16 seqnum : seqnums) {
+		if (seqnum == next_expected)
+			continue;
+		auto p = make(seqnum);
+		buffer.insert(p, next_expected);
+	}
+	UASSERTEQ(u32, buffer.size(), 299);
+
+	u16 first;
+	UASSERT(buffer.getFirstSeqnum(first));
+	UASSERTEQ(u16, first, (u16)(next_expected + 1));
+
+	// Removing from the middle keeps the order
+	UASSERTEQ(u16, buffer.popSeqnum(100)->getSeqnum(), 100);
+	UASSERTEQ(u16, buffer.popSeqnum(next_expected + 1)->getSeqnum(),
+			(u16)(next_expected + 1));
+	EXCEPTION_CHECK(con::NotFoundException, buffer.popSeqnum(100));
+
+	u16 expected = next_expected + 2;
+	while (!buffer.empty()) {
+		if (expected == 100)
+			expected++;
+		UASSERTEQ(u16, buffer.popFirst()->getSeqnum(), expected);
+		expected++;
+	}
+	UASSERT(!buffer.getFirstSeqnum(first));
+
+	// Resends wait longer every time
+	for (u16 seqnum = 1; seqnum <= 10; seqnum++) {
+		auto p = make(seqnum);
+		buffer.insert(p, 0);
+	}
+	buffer.incrementTimeouts(0.5f);
+	UASSERT(buffer.getResend(1.0f, 100).empty());
+	buffer.incrementTimeouts(0.5f);
+	UASSERTEQ(u32, buffer.getTimedOuts(1.0f), 10);
+
+	auto resend = buffer.getResend(1.0f, 4);
+	UASSERTEQ(size_t, resend.size(), 4);
+	for (u16 i = 0; i < 4; i++)
+		UASSERTEQ(u16, resend[i]->getSeqnum(), i + 1);
+	UASSERTEQ(u32, resend[0]->resend_count, 1);
+
+	buffer.popSeqnum(6);
+	resend = buffer.getResend(1.0f, 100);
+	UASSERTEQ(size_t, resend.size(), 5);
+	UASSERTEQ(u16, resend[0]->getSeqnum(), 5);
+
+	// All of them were resent once now and wait 1.5 s
+	buffer.incrementTimeouts(1.0f);
+	UASSERT(buffer.getResend(1.0f, 100).empty());
+	buffer.incrementTimeouts(0.5f);
+	resend = buffer.getResend(1.0f, 100);
+	UASSERTEQ(size_t, resend.size(), 9);
+	UASSERTEQ(u16, resend[0]->getSeqnum(), 1);
+	UASSERTEQ(u32, resend[0]->resend_count, 2);
+}
+
+void TestConnection::testIncomingSplitBuffer()
+{
+	Address a(127,0,0,1, 10);
+	auto make = [&] (u16 seqnum, u16 chunk_num) {
+		SharedBuffer<u8> data(7 + 1);
+		writeU8(&data[0], con::PACKET_TYPE_SPLIT);
+		writeU16(&data[1], seqnum);
+		writeU16(&data[3], 2);
+		writeU16(&data[5], chunk_num);
+		writeU8(&data[7], chunk_num + 1);
+		return con::makePacket(a, data, 0x12345678, 123, 0);
+	};
+
+	// Seqnums sharing every slot up to a full ring do not grow it
+	con::IncomingSplitBuffer buffer;
+	auto p = make(0, 0);
+	UASSERTEQ(u32, buffer.insert(p, false).getSize(), 0);
+	p = make(0x8000, 0);
+	UASSERTEQ(u32, buffer.insert(p, false).getSize(), 0);
+	UASSERT(buffer.capacity() <= MAX_INCOMING_SPLIT_PACKETS);
+
+	// The newer one is kept when they share a slot in the full ring
+	p = make(MAX_INCOMING_SPLIT_PACKETS, 0);
+	buffer.insert(p, false);
+	UASSERT(buffer.capacity() <= MAX_INCOMING_SPLIT_PACKETS);
+	p = make(0, 1);
+	UASSERTEQ(u32, buffer.insert(p, false).getSize(), 0);
+	p = make(MAX_INCOMING_SPLIT_PACKETS, 1);
+	SharedBuffer<u8> full = buffer.insert(p, false);
+	UASSERTEQ(u32, full.getSize(), 2);
+	UASSERTEQ(u8, full[0], 1);
+	UASSERTEQ(u8, full[1], 2);
+
+	// Reliable ones are never dropped, an unreliable one is instead
+	p = make(0, 0);
+	buffer.insert(p, true);
+	p = make(MAX_INCOMING_SPLIT_PACKETS * 2, 0);
+	buffer.insert(p, false);
+	p = make(MAX_INCOMING_SPLIT_PACKETS * 2, 1);
+	UASSERTEQ(u32, buffer.insert(p, false).getSize(), 0);
+	p = make(MAX_INCOMING_SPLIT_PACKETS * 3, 0);
+	buffer.insert(p, true);
+	UASSERT(buffer.capacity() > MAX_INCOMING_SPLIT_PACKETS);
+	p = make(0, 1);
+	UASSERTEQ(u32, buffer.insert(p, true).getSize(), 2);
+	p = make(MAX_INCOMING_SPLIT_PACKETS * 3, 1);
+	UASSERTEQ(u32, buffer.insert(p, true).getSize(), 2);
+
+	// Shrinks once the packets are reassembled
+	for (u16 seqnum = 0; seqnum < 500; seqnum++) {
+		p = make(seqnum, 0);
+		buffer.insert(p, true);
+	}
+	UASSERT(buffer.capacity() >= 500);
+	for (u16 seqnum = 0; seqnum < 500; seqnum++) {
+		p = make(seqnum, 1);
+		UASSERTEQ(u32, buffer.insert(p, true).getSize(), 2);
+	}
+	UASSERT(buffer.capacity() < 64);
+}
 
 void TestConnection::testConnectSendReceive()
 {
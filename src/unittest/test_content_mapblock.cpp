@@ -13,6 +13,7 @@
 #include "client/mapblock_mesh.h"
 #include "client/meshgen/collector.h"
 #include "mesh_compare.h"
+#include "settings.h"
 #include "util/directiontables.h"
 
 namespace {
@@ -142,6 +143,7 @@ class TestMapblockMeshGenerator : public TestBase {
 	void testSurroundedNode();
 	void testInterliquidSame();
 	void testInterliquidDifferent();
+	void testGreedyMerge();
 };
 
 static TestMapblockMeshGenerator g_test_instance;
@@ -153,6 +155,7 @@ void TestMapblockMeshGenerator::runTests(IGameDef *gamedef)
 	TEST(testSurroundedNode);
 	TEST(testInterliquidSame);
 	TEST(testInterliquidDifferent);
+	TEST(testGreedyMerge);
 }
 
 namespace quad {
@@ -250,4 +253,38 @@ void TestMapblockMeshGenerator::testInterliquidDifferent()
 	UASSERT(checkMeshEqual(buf.vertices, buf.indices, {quad::xn, quad::xp, quad::yn, quad::yp, quad::zn, quad::zp}));
 }
 
+void TestMapblockMeshGenerator::testGreedyMerge()
+{
+	MockGameDef gamedef;
+	content_t stone = gamedef.addSimpleNode("stone", 42);
+	content_t wood = gamedef.addSimpleNode("wood", 13);
+	gamedef.finalize();
+
+	MeshMakeData data{gamedef.ndef(), 2, true};
+	data.m_blockpos = {0, 0, 0};
+	for (s16 x = -1; x <= 2; x++)
+	for (s16 y = -1; y <= 2; y++)
+	for (s16 z = -1; z <= 2; z++)
+		data.m_vmanip.setNode({x, y, z}, {CONTENT_AIR, 0, 0});
+	data.m_vmanip.setNode({0, 0, 0}, {stone, 0, 0});
+	data.m_vmanip.setNode({1, 0, 0}, {stone, 0, 0});
+	data.m_vmanip.setNode({0, 1, 0}, {wood, 0, 0});
+
+	const bool greedy_meshing = g_settings->getBool("greedy_meshing");
+	g_settings->setBool("greedy_meshing", true);
+	MeshCollector col{{}};
+	MapblockMeshGenerator mg{&data, &col, nullptr};
+	mg.generate();
+	g_settings->setBool("greedy_meshing", greedy_meshing);
+
+	UASSERTEQ(std::size_t, col.prebuffers[0].size(), 2);
+	for (auto &&buf : col.prebuffers[0]) {
+		// stone: the faces along the pair are merged, the one under the
+		// wood is not drawn; wood: all faces but the one on the stone
+		std::size_t quads = buf.layer.texture_id == 42 ? 6 : 5;
+		UASSERTEQ(std::size_t, buf.vertices.size(), quads * 4);
+		UASSERTEQ(std::size_t, buf.indices.size(), quads * 6);
+	}
+}
+
 }
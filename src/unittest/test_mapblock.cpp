@@ -10,6 +10,8 @@
 #include "serialization.h"
 #include "noise.h"
 #include "inventory.h"
+#include "fm_content_id_table.h"
+#include "filesys.h"
 
 class TestMapBlock : public TestBase
 {
@@ -33,6 +35,10 @@ class TestMapBlock : public TestBase
 
 	// Tests loading a non-standard MapBlock
 	void testLoadNonStd(IGameDef *gamedef);
+
+	void testChangeLog(IGameDef *gamedef);
+
+	void testContentIdTable(IGameDef *gamedef);
 };
 
 static TestMapBlock g_test_instance;
@@ -45,6 +51,8 @@ void TestMapBlock::runTests(IGameDef *gamedef)
 	TEST(testLoad29, gamedef);
 	TEST(testLoad20, gamedef);
 	TEST(testLoadNonStd, gamedef);
+	TEST(testChangeLog, gamedef);
+	TEST(testContentIdTable, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -357,3 +365,97 @@ void TestMapBlock::testLoadNonStd(IGameDef *gamedef)
 	for (s16 i = 0; i < 16; i++)
 		UASSERTEQ(int, block.getNodeNoEx({i, 1, 0}).param2, data_lo[i]);
 }
+
+void TestMapBlock::testChangeLog(IGameDef *gamedef)
+{
+	MapBlock block({}, gamedef);
+	const MapNode stone{t_CONTENT_STONE};
+	std::vector<u16> changes;
+
+	const u64 stamp = block.getChangeStamp();
+	UASSERT(block.getChangesSince(stamp, changes));
+	UASSERT(changes.empty());
+
+	block.setNode({1, 0, 0}, stone);
+	block.setNodeNoCheck(v3pos_t(0, 2, 0), stone);
+	block.setNode({1, 0, 0}, stone);
+	UASSERT(block.getChangesSince(stamp, changes));
+	UASSERTEQ(size_t, changes.size(), 2);
+	UASSERTEQ(u16, changes[0], 1);
+	UASSERTEQ(u16, changes[1], 2 * MapBlock::ystride);
+
+	// Objects are not sent to clients, the log stays
+	const u64 stamp_objects = block.getChangeStamp();
+	block.raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_STATIC_DATA_ADDED);
+	changes.clear();
+	UASSERT(block.getChangesSince(stamp_objects, changes));
+	UASSERT(changes.empty());
+	UASSERT(block.getChangesSince(stamp, changes));
+
+	// Another load of the block
+	MapBlock other({}, gamedef);
+	UASSERT(!other.getChangesSince(stamp, changes));
+
+	// Unlogged changes start the log over
+	block.raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_VMANIP);
+	UASSERT(!block.getChangesSince(stamp, changes));
+	const u64 stamp_vmanip = block.getChangeStamp();
+	block.raiseModifiedNode({3, 0, 0});
+	changes.clear();
+	UASSERT(block.getChangesSince(stamp_vmanip, changes));
+	UASSERTEQ(size_t, changes.size(), 1);
+	UASSERTEQ(u16, changes[0], 3);
+
+	// Only the last changes are kept
+	u64 stamp_last = 0;
+	for (s16 i = 0; i < 1000; i++) {
+		if (i == 990)
+			stamp_last = block.getChangeStamp();
+		block.setNode({(s16)(i % MAP_BLOCKSIZE), 4, 0}, stone);
+	}
+	UASSERT(!block.getChangesSince(stamp_vmanip, changes));
+	changes.clear();
+	UASSERT(block.getChangesSince(stamp_last, changes));
+	UASSERTEQ(size_t, changes.size(), 10);
+}
+
+void TestMapBlock::testContentIdTable(IGameDef *gamedef)
+{
+	const std::string world = getTestTempDirectory();
+	const MapNode stone{t_CONTENT_STONE}, water{t_CONTENT_WATER, 0, 3};
+	auto fill = [&](MapBlock &block) {
+		for (u32 i = 0; i < MapBlock::nodecount; i++)
+			block.getData()[i] = i % 3 ? stone : i % 5 ? water : MapNode(CONTENT_AIR);
+	};
+
+	std::stringstream ss, ss_plain;
+	{
+		ContentIdTable ids(world, gamedef);
+		UASSERTEQ(u16, ids.size(), 0);
+		MapBlock block({}, gamedef);
+		fill(block);
+		block.serialize(ss, SER_FMT_VER_HIGHEST_WRITE, true, -1, false, nullptr, &ids);
+		block.serialize(ss_plain, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+		UASSERTEQ(u16, ids.size(), 3);
+		UASSERT(fs::PathExists(world + DIR_DELIM CONTENT_ID_TABLE_FILE));
+	}
+
+	// Read back after a restart, blocks without it still load
+	ContentIdTable ids(world, gamedef);
+	UASSERTEQ(u16, ids.size(), 3);
+	MapBlock expect({}, gamedef);
+	fill(expect);
+	for (auto *is : {&ss, &ss_plain}) {
+		MapBlock block({}, gamedef);
+		block.deSerialize(*is, SER_FMT_VER_HIGHEST_WRITE, true, &ids);
+		for (u32 i = 0; i < MapBlock::nodecount; i++)
+			UASSERT(block.getData()[i] == expect.getData()[i]);
+	}
+
+	// Not without the table
+	ss.clear();
+	ss.seekg(0);
+	MapBlock block({}, gamedef);
+	EXCEPTION_CHECK(SerializationError,
+			block.deSerialize(ss, SER_FMT_VER_HIGHEST_WRITE, true));
+}
@@ -7,6 +7,7 @@
 #include "log.h"
 #include "settings.h"
 #include "network/socket.h"
+#include "network/fm_impairment.h"
 
 #include "util/numeric.h"
 
@@ -26,6 +27,8 @@ class TestSocket : public TestBase {
 
 	void testIPv4Socket();
 	void testIPv6Socket();
+	void testBatch();
+	void testImpairment();
 
 	int port;
 };
@@ -35,6 +38,8 @@ static TestSocket g_test_instance;
 void TestSocket::runTests(IGameDef *gamedef)
 {
 	TEST(testIPv4Socket);
+	TEST(testBatch);
+	TEST(testImpairment);
 
 	if (g_settings->getBool("enable_ipv6"))
 		TEST(testIPv6Socket);
@@ -136,3 +141,99 @@ void TestSocket::testIPv6Socket()
 				Address(&bytes, 0).getAddress6().sin6_addr.s6_addr, 16) == 0);
 	}
 }
+
+void TestSocket::testBatch()
+{
+	const Address address(127, 0, 0, 1, port + 1);
+	UDPSocket socket(false);
+	socket.Bind(address);
+
+	const int count = UDP_BATCH_MAX + 10;
+	std::vector<std::string> sent;
+	std::vector<UDPSocket::Datagram> datagrams(count);
+	for (int i = 0; i < count; i++) {
+		sent.push_back("datagram " + std::to_string(i));
+		datagrams[i].address = address;
+		datagrams[i].data = (u8 *)sent[i].data();
+		datagrams[i].size = sent[i].size();
+	}
+	socket.SendBatch(datagrams.data(), count);
+	for (int i = 0; i < count; i++)
+		UASSERTEQ(int, datagrams[i].size, (int)sent[i].size());
+
+	sleep_ms(50);
+
+	std::vector<std::string> received;
+	char buffers[UDP_BATCH_MAX][256];
+	for (;;) {
+		UDPSocket::Datagram batch[UDP_BATCH_MAX];
+		for (int i = 0; i < UDP_BATCH_MAX; i++) {
+			batch[i].data = (u8 *)buffers[i];
+			batch[i].size = sizeof(buffers[i]);
+		}
+		int n = socket.ReceiveBatch(batch, UDP_BATCH_MAX);
+		if (n == 0)
+			break;
+		for (int i = 0; i < n; i++) {
+			UASSERT(batch[i].address == address);
+			received.emplace_back((char *)batch[i].data, batch[i].size);
+		}
+	}
+
+	UASSERT(received == sent);
+}
+
+void TestSocket::testImpairment()
+{
+	ImpairmentParams params;
+	UASSERT(ImpairmentParams::parse("loss=0.1 duplicate=0.05 reorder=0.1 "
+			"reorder_ms=30 latency_ms=20 jitter_ms=5 seed=7", params));
+	UASSERT(params.enabled());
+	UASSERTEQ(u32, params.latency_ms, 20);
+	UASSERTEQ(u32, params.seed, 7);
+	UASSERT(!ImpairmentParams::parse("lost=0.1", params));
+
+	const Address sender(127, 0, 0, 1, port);
+	auto run = [&] (NetworkImpairment &impairment) {
+		std::vector<u32> order;
+		for (u32 i = 0; i < 1000; i++)
+			impairment.add(sender, &i, sizeof(i), i * 1000);
+		Address from;
+		u32 value;
+		while (impairment.take(from, &value, sizeof(value), 10000000) >= 0)
+			order.push_back(value);
+		return order;
+	};
+
+	// Same seed, same network
+	NetworkImpairment a(params), b(params);
+	std::vector<u32> order = run(a);
+	UASSERT(order == run(b));
+	const ImpairmentStats &stats = a.getStats();
+	UASSERTEQ(u64, stats.received, 1000);
+	UASSERTEQ(u64, stats.delivered, 1000 - stats.dropped + stats.duplicated);
+	UASSERT(stats.dropped > 50 && stats.dropped < 150);
+	UASSERT(stats.reordered > 50);
+	UASSERT(!std::is_sorted(order.begin(), order.end()));
+
+	params.seed = 8;
+	NetworkImpairment c(params);
+	UASSERT(order != run(c));
+
+	// Latency and bandwidth
+	ImpairmentParams slow;
+	slow.latency_ms = 50;
+	slow.bandwidth = 1000;
+	NetworkImpairment link(slow);
+	char data[100] = {};
+	link.add(sender, data, sizeof(data), 0);
+	link.add(sender, data, sizeof(data), 0);
+	Address from;
+	UASSERTEQ(int, link.take(from, data, sizeof(data), 149999), -1);
+	UASSERTEQ(s64, link.untilNext(149999), 1);
+	UASSERTEQ(int, link.take(from, data, sizeof(data), 150000), 100);
+	UASSERT(from == sender);
+	UASSERTEQ(int, link.take(from, data, sizeof(data), 249999), -1);
+	UASSERTEQ(int, link.take(from, data, sizeof(data), 250000), 100);
+	UASSERTEQ(s64, link.untilNext(250000), -1);
+}
@@ -7,6 +7,7 @@
 #include <atomic>
 #include <iostream>
 #include "threading/semaphore.h"
+#include "threading/task_scheduler.h"
 #include "threading/thread.h"
 
 
@@ -19,6 +20,11 @@ class TestThreading : public TestBase {
 	void testStartStopWait();
 	void testAtomicSemaphoreThread();
 	void testTLS();
+	void testTaskScheduler();
+	void testTaskCancel();
+	void testTaskGroup();
+	void testTaskShutdown();
+	void testTaskLimits();
 };
 
 static TestThreading g_test_instance;
@@ -28,6 +34,11 @@ void TestThreading::runTests(IGameDef *gamedef)
 	TEST(testStartStopWait);
 	TEST(testAtomicSemaphoreThread);
 	TEST(testTLS);
+	TEST(testTaskScheduler);
+	TEST(testTaskCancel);
+	TEST(testTaskGroup);
+	TEST(testTaskShutdown);
+	TEST(testTaskLimits);
 }
 
 class SimpleTestThread : public Thread {
@@ -227,3 +238,147 @@ void TestThreading::testTLS()
 		}
 	}
 }
+
+
+void TestThreading::testTaskScheduler()
+{
+	TaskScheduler scheduler(4);
+	UASSERTEQ(size_t, scheduler.getThreadCount(), 4);
+
+	// Tasks submitted from tasks, waited for on a worker
+	std::atomic_int sum{0};
+	auto outer = scheduler.submit("test", TaskPriority::Normal, [&] {
+		std::vector<std::future<int>> inner;
+		for (int i = 1; i <= 100; i++)
+			inner.push_back(scheduler.submit("test_inner", TaskPriority::Low,
+					[i] { return i; }));
+		for (auto &future : inner) {
+			scheduler.wait(future);
+			sum += future.get();
+		}
+		return sum.load();
+	});
+	UASSERTEQ(int, outer.get(), 5050);
+
+	auto failing = scheduler.submit("test", TaskPriority::High, [] () -> int {
+		throw std::runtime_error("task failed");
+	});
+	EXCEPTION_CHECK(std::runtime_error, failing.get());
+
+	// Counted after the futures are ready, done once the workers are
+	scheduler.shutdown();
+	auto stats = scheduler.getStats();
+	UASSERTEQ(u64, stats["test"].submitted, 2);
+	UASSERTEQ(u64, stats["test_inner"].completed, 100);
+}
+
+void TestThreading::testTaskCancel()
+{
+	TaskScheduler scheduler(1);
+
+	// Keep the only worker busy until the other task is cancelled
+	std::promise<void> release;
+	auto blocker = scheduler.submit("test_block", TaskPriority::High,
+			[gate = release.get_future().share()] { gate.wait(); });
+
+	bool ran = false;
+	auto cancel = std::make_shared<TaskCancel>();
+	auto cancelled = scheduler.submit("test_cancel", TaskPriority::Normal,
+			[&ran] { ran = true; }, cancel);
+	cancel->cancel();
+	release.set_value();
+
+	blocker.get();
+	EXCEPTION_CHECK(std::future_error, cancelled.get());
+	UASSERT(!ran);
+	UASSERTEQ(u64, scheduler.getStats()["test_cancel"].cancelled, 1);
+}
+
+void TestThreading::testTaskGroup()
+{
+	TaskScheduler scheduler(4);
+	TaskGroup group("test_group", TaskPriority::Normal, 2, scheduler);
+
+	std::atomic_int running{0}, max_running{0}, done{0};
+	for (int i = 0; i < 50; i++) {
+		group.enqueue([&] {
+			int now = ++running;
+			int prev = max_running.load();
+			while (now > prev && !max_running.compare_exchange_weak(prev, now))
+				;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			--running;
+			++done;
+		});
+	}
+	group.wait_until_empty();
+
+	UASSERTEQ(int, done.load(), 50);
+	UASSERT(max_running.load() <= 2);
+}
+
+void TestThreading::testTaskShutdown()
+{
+	TaskScheduler scheduler(1);
+
+	std::promise<void> release, started;
+	auto blocker = scheduler.submit("test_block", TaskPriority::High,
+			[&started, gate = release.get_future().share()] {
+				started.set_value();
+				gate.wait();
+			});
+	started.get_future().wait();
+	bool ran = false;
+	auto queued = scheduler.submit("test_queued", TaskPriority::Normal,
+			[&ran] { ran = true; });
+	TaskGroup group("test_group_queued", TaskPriority::Normal, 1, scheduler);
+	group.enqueue([&ran] { ran = true; });
+	group.enqueue([&ran] { ran = true; });
+
+	std::thread releaser([&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		release.set_value();
+	});
+	scheduler.shutdown();
+	releaser.join();
+
+	// The running task is finished, the queued one and later ones dropped
+	blocker.get();
+	EXCEPTION_CHECK(std::future_error, queued.get());
+	UASSERT(!ran);
+	auto late = scheduler.submit("test_late", TaskPriority::High, [] {});
+	EXCEPTION_CHECK(std::future_error, late.get());
+
+	// Dropped group tasks are not waited for
+	group.enqueue([&ran] { ran = true; });
+	group.wait_until_empty();
+	UASSERT(!ran);
+	UASSERTEQ(u64, scheduler.getStats()["test_queued"].cancelled, 1);
+}
+
+void TestThreading::testTaskLimits()
+{
+	TaskScheduler scheduler(2);
+
+	// Normal tasks leave a worker to High ones
+	std::promise<void> release;
+	std::shared_future<void> gate = release.get_future().share();
+	std::atomic_int blocked{0};
+	std::vector<std::future<void>> normal;
+	for (int i = 0; i < 2; i++)
+		normal.push_back(scheduler.submit("test_normal", TaskPriority::Normal,
+				[&blocked, gate] { ++blocked; gate.wait(); }));
+	while (!blocked)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	UASSERTEQ(int, blocked.load(), 1);
+
+	auto high = scheduler.submit("test_high", TaskPriority::High, [] { return 1; });
+	UASSERT(high.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	UASSERTEQ(int, high.get(), 1);
+
+	release.set_value();
+	for (auto &future : normal)
+		future.get();
+	UASSERTEQ(int, blocked.load(), 2);
+}